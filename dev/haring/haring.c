@@ -28,6 +28,8 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <arpa/inet.h>
+#include <ctype.h>
 #include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -35,11 +37,84 @@
 
 #include <haproxy/api.h>
 #include <haproxy/buf.h>
+#include <haproxy/intops.h>
+#include <haproxy/log-t.h>
 #include <haproxy/ring.h>
 
 int force = 0; // force access to a different layout
 int lfremap = 0; // remap LF in traces
 int repair = 0; // repair file
+int bindecode = 0; // decode binary log lines
+
+/* log-format variable names indexed by their LOG_FMT_* type, used to name
+ * the fields of binary log lines.
+ */
+static const char *lf_names[] = {
+	[LOG_FMT_EXPR]           = "expr",
+	[LOG_FMT_CLIENTIP]       = "ci",
+	[LOG_FMT_CLIENTPORT]     = "cp",
+	[LOG_FMT_BACKENDIP]      = "bi",
+	[LOG_FMT_BACKENDPORT]    = "bp",
+	[LOG_FMT_FRONTENDIP]     = "fi",
+	[LOG_FMT_FRONTENDPORT]   = "fp",
+	[LOG_FMT_SERVERPORT]     = "sp",
+	[LOG_FMT_SERVERIP]       = "si",
+	[LOG_FMT_COUNTER]        = "rt",
+	[LOG_FMT_LOGCNT]         = "lc",
+	[LOG_FMT_PID]            = "pid",
+	[LOG_FMT_DATE]           = "t",
+	[LOG_FMT_DATEGMT]        = "T",
+	[LOG_FMT_DATELOCAL]      = "Tl",
+	[LOG_FMT_TS]             = "Ts",
+	[LOG_FMT_MS]             = "ms",
+	[LOG_FMT_FRONTEND]       = "f",
+	[LOG_FMT_FRONTEND_XPRT]  = "ft",
+	[LOG_FMT_BACKEND]        = "b",
+	[LOG_FMT_SERVER]         = "s",
+	[LOG_FMT_BYTES]          = "B",
+	[LOG_FMT_BYTES_UP]       = "U",
+	[LOG_FMT_Ta]             = "Ta",
+	[LOG_FMT_Th]             = "Th",
+	[LOG_FMT_Ti]             = "Ti",
+	[LOG_FMT_TQ]             = "Tq",
+	[LOG_FMT_TW]             = "Tw",
+	[LOG_FMT_TC]             = "Tc",
+	[LOG_FMT_Tr]             = "Tr",
+	[LOG_FMT_tr]             = "tr",
+	[LOG_FMT_trg]            = "trg",
+	[LOG_FMT_trl]            = "trl",
+	[LOG_FMT_TR]             = "TR",
+	[LOG_FMT_TD]             = "Td",
+	[LOG_FMT_TT]             = "Tt",
+	[LOG_FMT_TU]             = "Tu",
+	[LOG_FMT_STATUS]         = "ST",
+	[LOG_FMT_CCLIENT]        = "CC",
+	[LOG_FMT_CSERVER]        = "CS",
+	[LOG_FMT_TERMSTATE]      = "ts",
+	[LOG_FMT_TERMSTATE_CK]   = "tsc",
+	[LOG_FMT_ACTCONN]        = "ac",
+	[LOG_FMT_FECONN]         = "fc",
+	[LOG_FMT_BECONN]         = "bc",
+	[LOG_FMT_SRVCONN]        = "sc",
+	[LOG_FMT_RETRIES]        = "rc",
+	[LOG_FMT_SRVQUEUE]       = "sq",
+	[LOG_FMT_BCKQUEUE]       = "bq",
+	[LOG_FMT_HDRREQUEST]     = "hr",
+	[LOG_FMT_HDRRESPONS]     = "hs",
+	[LOG_FMT_HDRREQUESTLIST] = "hrl",
+	[LOG_FMT_HDRRESPONSLIST] = "hsl",
+	[LOG_FMT_REQ]            = "r",
+	[LOG_FMT_HTTP_METHOD]    = "HM",
+	[LOG_FMT_HTTP_URI]       = "HU",
+	[LOG_FMT_HTTP_PATH]      = "HP",
+	[LOG_FMT_HTTP_PATH_ONLY] = "HPO",
+	[LOG_FMT_HTTP_QUERY]     = "HQ",
+	[LOG_FMT_HTTP_VERSION]   = "HV",
+	[LOG_FMT_HOSTNAME]       = "H",
+	[LOG_FMT_UNIQUEID]       = "ID",
+	[LOG_FMT_SSL_CIPHER]     = "sslc",
+	[LOG_FMT_SSL_VERSION]    = "sslv",
+};
 
 
 /* display the message and exit with the code */
@@ -65,10 +140,92 @@ __attribute__((noreturn)) void usage(int code, const char *arg0)
 	    "  -f           : force accessing a non-matching layout for 'ring struct'\n"
 	    "  -l           : replace LF in contents with CR VT\n"
 	    "  -r           : \"repair\" corrupted file (actively search for message boundaries)\n"
+	    "  -b           : decode binary log lines (log-format option +B)\n"
 	    "\n"
 	    "", arg0);
 }
 
+/* Dumps the <len> bytes of string <str> to stdout, escaping non-printable
+ * characters as well as quotes and backslashes.
+ */
+void dump_str(const unsigned char *str, size_t len)
+{
+	putchar('"');
+	for (; len; str++, len--) {
+		if (*str == '"' || *str == '\\')
+			printf("\\%c", *str);
+		else if (isprint(*str))
+			putchar(*str);
+		else
+			printf("\\x%02x", *str);
+	}
+	putchar('"');
+}
+
+/* Dumps message <msg> of <len> bytes to stdout, decoding the binary log line
+ * it may contain after the syslog header into a list of space-delimited
+ * name=value fields. Truncated lines are reported as such.
+ */
+void dump_bin_msg(char *msg, size_t len)
+{
+	char *end = msg + len;
+	char *bin, *p;
+	uint64_t flen, key, vlen, v;
+	char addr[INET6_ADDRSTRLEN];
+	int type;
+
+	/* the syslog header, if any, is only made of text */
+	bin = memchr(msg, LOG_BIN_MAGIC, len);
+	if (!bin) {
+		fwrite(msg, len, 1, stdout);
+		return;
+	}
+	fwrite(msg, bin - msg, 1, stdout);
+
+	p = bin + 1;
+	if (decode_varint(&p, end, &flen) == -1 || flen > end - p) {
+		printf("<truncated>");
+		return;
+	}
+	end = p + flen;
+
+	while (p < end) {
+		if (decode_varint(&p, end, &key) == -1 ||
+		    decode_varint(&p, end, &vlen) == -1 ||
+		    vlen > end - p) {
+			printf("<truncated>");
+			return;
+		}
+
+		type = key >> LOG_BIN_T_BITS;
+		if (type < sizeof(lf_names) / sizeof(*lf_names) && lf_names[type])
+			printf("%s=", lf_names[type]);
+		else
+			printf("%d=", type);
+
+		if (!vlen)
+			putchar('-');
+		else if ((key & ((1 << LOG_BIN_T_BITS) - 1)) == LOG_BIN_T_INT) {
+			char *q = p;
+
+			if (decode_varint(&q, p + vlen, &v) == -1)
+				printf("<invalid>");
+			else
+				printf("%lld", (long long)((v >> 1) ^ -(v & 1)));
+		}
+		else if ((key & ((1 << LOG_BIN_T_BITS) - 1)) == LOG_BIN_T_ADDR &&
+		         (vlen == 4 || vlen == 16) &&
+		         inet_ntop(vlen == 4 ? AF_INET : AF_INET6, p, addr, sizeof(addr)))
+			printf("%s", addr);
+		else
+			dump_str((unsigned char *)p, vlen);
+
+		p += vlen;
+		if (p < end)
+			putchar(' ');
+	}
+}
+
 /* This function dumps all events from the ring whose pointer is in <p0> into
  * the appctx's output buffer, and takes from <o0> the seek offset into the
  * buffer's history (0 for oldest known event). It looks at <i0> for boolean
@@ -85,6 +242,7 @@ int dump_ring(struct ring *ring, size_t ofs, int flags)
 	size_t len, cnt;
 	const char *blk1 = NULL, *blk2 = NULL, *p;
 	size_t len1 = 0, len2 = 0, bl;
+	char *msg = NULL;
 
 	/* Explanation: the storage area in the writing process starts after
 	 * the end of the structure. Since the whole area is mmapped(), we know
@@ -170,7 +328,15 @@ int dump_ring(struct ring *ring, size_t ofs, int flags)
 			}
 
 			len = b_getblk_nc(&buf, &blk1, &len1, &blk2, &len2, ofs + cnt, msg_len);
-			if (!lfremap) {
+			if (bindecode) {
+				/* messages may wrap, work on a linear copy */
+				if (!msg && !(msg = malloc(buf.size))) {
+					fprintf(stderr, "FATAL: out of memory\n");
+					return 1;
+				}
+				b_getblk(&buf, msg, msg_len, ofs + cnt);
+				dump_bin_msg(msg, msg_len);
+			} else if (!lfremap) {
 				if (len > 0 && len1)
 					fwrite(blk1, len1, 1, stdout);
 				if (len > 1 && len2)
@@ -214,6 +380,7 @@ int dump_ring(struct ring *ring, size_t ofs, int flags)
 		/* pause 10ms before checking for new stuff */
 		usleep(10000);
 	}
+	free(msg);
 	return 0;
 }
 
@@ -233,6 +400,8 @@ int main(int argc, char **argv)
 			lfremap = 1;
 		else if (strcmp(argv[0], "-r") == 0)
 			repair = 1;
+		else if (strcmp(argv[0], "-b") == 0)
+			bindecode = 1;
 		else if (strcmp(argv[0], "--") == 0)
 			break;
 		else
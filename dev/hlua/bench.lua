@@ -0,0 +1,52 @@
+-- Lua actions used to measure the cost of Lua on the request path depending
+-- on how the code is loaded. See README.
+
+local hits = core.shared_counter("bench.hits")
+local conf = core.shared_table("bench.conf")
+local nb_hits = 0
+
+-- only initialize the table once, the per-thread states see the same one
+if core.thread <= 1 then
+	conf:set("backend", "app")
+	conf:set("limit", 1000000000)
+end
+
+-- relies on Lua global variables: only correct with "lua-load"
+core.register_action("bench_global", { "http-req" }, function(txn)
+	nb_hits = nb_hits + 1
+	if nb_hits < 1000000000 then
+		txn:set_var("txn.backend", "app")
+	end
+end)
+
+-- relies on the shared counter and table: correct with both "lua-load" and
+-- "lua-load-per-thread"
+core.register_action("bench_shared", { "http-req" }, function(txn)
+	if hits:inc() < conf:get("limit") then
+		txn:set_var("txn.backend", conf:get("backend"))
+	end
+end)
+
+-- representative request processing: parses a token out of a header
+core.register_action("bench_tokens", { "http-req" }, function(txn)
+	local auth = txn.sf:req_hdr("authorization") or ""
+	local words = core.tokenize(auth, " ,", true)
+	if words[1] == "Bearer" and words[2] then
+		txn:set_var("txn.token", words[2])
+	end
+end)
+
+-- representative request processing: rewrites some headers
+core.register_action("bench_rewrite", { "http-req" }, function(txn)
+	local hdrs = txn.http:req_get_headers()
+	if hdrs["x-forwarded-for"] then
+		txn.http:req_del_header("x-forwarded-for")
+	end
+	txn.http:req_set_header("x-request-path", txn.sf:path())
+	txn.http:req_add_header("x-lua", "1")
+end)
+
+-- representative converter: normalizes a string
+core.register_converters("bench_conv", function(str)
+	return str:lower():gsub("[^%w]", "_")
+end)
@@ -0,0 +1,62 @@
+#!/bin/sh
+# Measures the request rate of some Lua actions and converters depending on
+# the number of threads and on the way the Lua code is loaded. See README.
+
+HAPROXY="${HAPROXY:-./haproxy}"
+THREADS="${THREADS:-1 2 4 8}"
+DURATION="${DURATION:-10}"
+CONNS="${CONNS:-200}"
+LOADER_THREADS="${LOADER_THREADS:-4}"
+BIND="${BIND:-127.0.0.1:8001}"
+
+DIR="$(cd "$(dirname "$0")" && pwd)"
+WRK_LUA="$(mktemp)"
+export BIND LUA_FILE="$DIR/bench.lua"
+
+# sends the headers used by bench_tokens and bench_rewrite on all requests
+cat > "$WRK_LUA" <<WRK
+wrk.headers["Authorization"] = "Bearer 0123456789abcdef, realm=bench"
+wrk.headers["X-Forwarded-For"] = "192.0.2.1"
+WRK
+
+# <name> <lua-load keyword> <http-request rule>
+run() {
+	export LUA_LOAD="$2" LUA_RULE="$3"
+	printf "%-30s" "$1"
+	for t in $THREADS; do
+		NBTHREAD=$t "$HAPROXY" -db -f "$DIR/bench.cfg" >/dev/null 2>&1 &
+		pid=$!
+		sleep 1
+		rate=$(wrk -t "$LOADER_THREADS" -c "$CONNS" -d "${DURATION}s" -s "$WRK_LUA" "http://$BIND/Bench/Path" |
+		       awk '/^Requests\/sec:/ { printf "%d", $2 }')
+		kill $pid
+		wait $pid 2>/dev/null
+		printf " %10s" "${rate:-error}"
+	done
+	printf "\n"
+}
+
+printf "%-30s" "test"
+for t in $THREADS; do
+	printf " %10s" "${t}thr"
+done
+printf "\n"
+
+run "baseline (no Lua)"         lua-load            "set-var(txn.none) int(0)"
+run "global: counter"           lua-load            "lua.bench_global"
+run "global: shared"            lua-load            "lua.bench_shared"
+run "per-thread: shared"        lua-load-per-thread "lua.bench_shared"
+run "per-thread: tokens"        lua-load-per-thread "lua.bench_tokens"
+run "per-thread: rewrite"       lua-load-per-thread "lua.bench_rewrite"
+run "per-thread: converter"     lua-load-per-thread "set-var(txn.path) path,lua.bench_conv"
+
+# same tests with a precompiled chunk, only the boot time is expected to differ
+if [ -n "$LUAC" ]; then
+	LUA_FILE="$(mktemp)"
+	"$LUAC" -o "$LUA_FILE" "$DIR/bench.lua" || exit 1
+	run "per-thread+luac: tokens"   lua-load-per-thread "lua.bench_tokens"
+	run "per-thread+luac: rewrite"  lua-load-per-thread "lua.bench_rewrite"
+	rm -f "$LUA_FILE"
+fi
+
+rm -f "$WRK_LUA"
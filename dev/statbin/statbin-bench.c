@@ -0,0 +1,263 @@
+/*
+ * Compares the cost of collecting HAProxy's statistics over the CLI in CSV,
+ * JSON and binary formats: bytes transferred, time to fetch them, CPU used by
+ * HAProxy to produce them (when its pid is known) and CPU used to decode them.
+ *
+ * Usage: statbin-bench [-n count] [-p pid] <socket>
+ */
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "statbin.h"
+
+struct buf {
+	char *area;
+	size_t size;
+	size_t data;
+};
+
+static const char *sock_path;
+static int server_pid;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now_us(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+/* returns the user+system CPU time consumed by process <pid> in clock ticks,
+ * or 0 if unknown.
+ */
+static unsigned long long proc_cpu(int pid)
+{
+	unsigned long long utime, stime;
+	char path[64], line[1024], *p;
+	FILE *f;
+	int i;
+
+	if (!pid)
+		return 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+	p = fgets(line, sizeof(line), f);
+	fclose(f);
+	if (!p || !(p = strrchr(line, ')')))
+		return 0;
+
+	/* utime and stime are the 14th and 15th fields, <p> is at the end of
+	 * the 2nd one.
+	 */
+	for (i = 2; i < 13 && p; i++)
+		p = strchr(p + 1, ' ');
+	if (!p || sscanf(p, " %llu %llu", &utime, &stime) != 2)
+		return 0;
+	return utime + stime;
+}
+
+/* sends <cmd> to the CLI and stores the whole response into <b> */
+static void fetch(const char *cmd, struct buf *b)
+{
+	struct sockaddr_un addr;
+	ssize_t ret;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		die("socket");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		die("connect");
+
+	if (write(fd, cmd, strlen(cmd)) < 0 || write(fd, "\n", 1) < 0)
+		die("write");
+
+	b->data = 0;
+	while (1) {
+		if (b->size - b->data < 65536) {
+			b->size = b->size * 2 + 65536;
+			b->area = realloc(b->area, b->size);
+			if (!b->area)
+				die("realloc");
+		}
+		ret = read(fd, b->area + b->data, b->size - b->data);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			die("read");
+		if (!ret)
+			break;
+		b->data += ret;
+	}
+	close(fd);
+}
+
+/* decodes a CSV output: every value is converted to a number when possible.
+ * Returns the number of lines.
+ */
+static long decode_csv(const struct buf *b, unsigned long long *sum)
+{
+	const char *p = b->area, *end = b->area + b->data;
+	long lines = 0;
+	char *e;
+
+	while (p < end) {
+		if (*p == '#' || *p == '\n') {
+			while (p < end && *p++ != '\n')
+				;
+			continue;
+		}
+		lines++;
+		while (p < end && *p != '\n') {
+			if (isdigit((unsigned char)*p) || *p == '-')
+				*sum += strtoull(p, &e, 10), p = e;
+			while (p < end && *p != ',' && *p != '\n')
+				p++;
+			if (p < end && *p == ',')
+				p++;
+		}
+		if (p < end)
+			p++;
+	}
+	return lines;
+}
+
+/* minimal JSON scanner: walks over all tokens, skips strings and converts the
+ * numbers. This is a lower bound of the cost of any real JSON parser. Returns
+ * the number of "objType" entries, which is the number of fields.
+ */
+static long decode_json(const struct buf *b, unsigned long long *sum)
+{
+	const char *p = b->area, *end = b->area + b->data;
+	long fields = 0;
+	char *e;
+
+	while (p < end) {
+		if (*p == '"') {
+			const char *s = ++p;
+
+			while (p < end && *p != '"')
+				p += (*p == '\\') ? 2 : 1;
+			if (p - s == 7 && memcmp(s, "objType", 7) == 0)
+				fields++;
+			p++;
+		}
+		else if (isdigit((unsigned char)*p) || *p == '-') {
+			*sum += strtoull(p, &e, 10);
+			p = e;
+			if (p < end && (*p == '.' || *p == 'e' || *p == 'E')) {
+				strtod(p, &e);
+				p = e;
+			}
+		}
+		else
+			p++;
+	}
+	return fields;
+}
+
+/* decodes a binary output. Returns the number of records or -1 on error. */
+static long decode_bin(const struct buf *b, unsigned long long *sum)
+{
+	struct statbin sb;
+	long recs = 0;
+	unsigned int i;
+	int ret;
+
+	if (statbin_init(&sb, b->area, b->data) < 0)
+		return -1;
+
+	while ((ret = statbin_next(&sb)) > 0) {
+		recs++;
+		for (i = 0; i < sb.nb_fields; i++) {
+			if (statbin_format(&sb.fields[i]) != STATBIN_FF_STR)
+				*sum += sb.fields[i].u.u64;
+		}
+	}
+	statbin_free(&sb);
+	return ret < 0 ? -1 : recs;
+}
+
+static void bench(const char *name, const char *cmd, int count,
+                  long (*decode)(const struct buf *, unsigned long long *))
+{
+	struct buf b = { };
+	unsigned long long sum = 0, cpu0, cpu1;
+	double fetch_us = 0, dec_us = 0, t0;
+	long ret = 0;
+	int i;
+
+	cpu0 = proc_cpu(server_pid);
+	for (i = 0; i < count; i++) {
+		t0 = now_us(CLOCK_MONOTONIC);
+		fetch(cmd, &b);
+		fetch_us += now_us(CLOCK_MONOTONIC) - t0;
+
+		t0 = now_us(CLOCK_PROCESS_CPUTIME_ID);
+		ret = decode(&b, &sum);
+		dec_us += now_us(CLOCK_PROCESS_CPUTIME_ID) - t0;
+	}
+	cpu1 = proc_cpu(server_pid);
+
+	printf("%-10s %10zu %8ld %12.1f %12.1f", name, b.data, ret,
+	       fetch_us / count, dec_us / count);
+	if (server_pid)
+		printf(" %12.1f", (cpu1 - cpu0) * 1000000.0 / sysconf(_SC_CLK_TCK) / count);
+	printf("\n");
+	free(b.area);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+	        "Usage: %s [-n count] [-p pid] <socket>\n"
+	        "  -n count : number of dumps per format (default 20)\n"
+	        "  -p pid   : also report the CPU time used by this haproxy process\n",
+	        name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int count = 20;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:p:")) != -1) {
+		switch (opt) {
+		case 'n': count = atoi(optarg); break;
+		case 'p': server_pid = atoi(optarg); break;
+		default:  usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || count <= 0)
+		usage(argv[0]);
+	sock_path = argv[optind];
+
+	printf("%-10s %10s %8s %12s %12s%s\n", "format", "bytes", "items",
+	       "fetch(us)", "decode(us)", server_pid ? "  haproxy(us)" : "");
+	bench("csv",       "show stat",           count, decode_csv);
+	bench("json",      "show stat json",      count, decode_json);
+	bench("bin",       "show stat bin",       count, decode_bin);
+	bench("bin-delta", "show stat bin delta", count, decode_bin);
+	return 0;
+}
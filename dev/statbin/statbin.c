@@ -0,0 +1,196 @@
+/*
+ * Decoder for the binary statistics output of HAProxy ("show stat bin").
+ * See statbin.h for the API.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "statbin.h"
+
+/* Decodes a varint using HAProxy's encoding (see encode_varint() in
+ * include/haproxy/intops.h). Returns 0 on success, -1 if the input is
+ * truncated.
+ */
+static int statbin_varint(struct statbin *sb, uint64_t *v)
+{
+	const unsigned char *p = sb->pos;
+	int shift = 4;
+
+	if (p >= sb->end)
+		return -1;
+
+	*v = *p++;
+	if (*v >= 240) {
+		do {
+			if (p >= sb->end)
+				return -1;
+			*v += (uint64_t)*p << shift;
+			shift += 7;
+		} while (*p++ >= 128);
+	}
+	sb->pos = p;
+	return 0;
+}
+
+static int statbin_byte(struct statbin *sb, unsigned char *c)
+{
+	if (sb->pos >= sb->end)
+		return -1;
+	*c = *sb->pos++;
+	return 0;
+}
+
+int statbin_init(struct statbin *sb, const void *buf, size_t len)
+{
+	uint64_t v;
+	unsigned int i;
+
+	memset(sb, 0, sizeof(*sb));
+	sb->pos = buf;
+	sb->end = sb->pos + len;
+
+	if (len < 6 || memcmp(buf, STATBIN_MAGIC, 4) != 0)
+		return -1;
+
+	sb->version = sb->pos[4];
+	sb->flags = sb->pos[5];
+	sb->pos += 6;
+	if (sb->version != STATBIN_VERSION)
+		return -1;
+
+	if (statbin_varint(sb, &v) < 0)
+		return -1;
+	sb->domain = v;
+
+	if (statbin_varint(sb, &v) < 0 || v > 65535)
+		return -1;
+	sb->nb_fields = v;
+
+	if (sb->flags & STATBIN_F_GEN) {
+		if (statbin_varint(sb, &v) < 0)
+			return -1;
+		sb->gen = v;
+	}
+
+	sb->names = calloc(sb->nb_fields, sizeof(*sb->names));
+	sb->fields = calloc(sb->nb_fields, sizeof(*sb->fields));
+	sb->types = calloc(sb->nb_fields, sizeof(*sb->types));
+	if (!sb->names || !sb->fields || !sb->types)
+		goto fail;
+
+	for (i = 0; i < sb->nb_fields; i++) {
+		if (statbin_varint(sb, &v) < 0 || v > sb->end - sb->pos)
+			goto fail;
+		sb->names[i] = malloc(v + 1);
+		if (!sb->names[i])
+			goto fail;
+		memcpy(sb->names[i], sb->pos, v);
+		sb->names[i][v] = 0;
+		sb->pos += v;
+	}
+	return 0;
+
+ fail:
+	statbin_free(sb);
+	return -1;
+}
+
+int statbin_next(struct statbin *sb)
+{
+	struct statbin_field *f;
+	unsigned char c, tags[3];
+	uint64_t v;
+	int64_t field = -1;
+	unsigned int i;
+
+	if (statbin_byte(sb, &c) < 0)
+		return -1;
+	if (c == STATBIN_REC_END)
+		return 0;
+	if (c != STATBIN_REC_LINE)
+		return -1;
+
+	if (!(sb->flags & STATBIN_F_DELTA)) {
+		/* full records: fields not present are empty */
+		memset(sb->fields, 0, sb->nb_fields * sizeof(*sb->fields));
+	}
+
+	while (1) {
+		if (statbin_varint(sb, &v) < 0)
+			return -1;
+		if (!v)
+			break;
+
+		field += v >> 1;
+		if (field >= sb->nb_fields)
+			return -1;
+		f = &sb->fields[field];
+
+		if (v & 1) {
+			/* new type */
+			if (statbin_byte(sb, &c) < 0)
+				return -1;
+			if (c & STATBIN_TAGS) {
+				if (statbin_byte(sb, &tags[0]) < 0 ||
+				    statbin_byte(sb, &tags[1]) < 0 ||
+				    statbin_byte(sb, &tags[2]) < 0)
+					return -1;
+				sb->types[field] = (uint32_t)tags[0] << 8 | (uint32_t)tags[1] << 16 | (uint32_t)tags[2] << 24;
+			}
+			else
+				sb->types[field] &= ~0xff;
+			sb->types[field] |= c & ~STATBIN_TAGS;
+		}
+		f->type = sb->types[field];
+		memset(&f->u, 0, sizeof(f->u));
+
+		switch (statbin_format(f)) {
+		case STATBIN_FF_EMPTY:
+			break;
+		case STATBIN_FF_S32:
+		case STATBIN_FF_S64:
+			if (statbin_varint(sb, &v) < 0)
+				return -1;
+			f->u.s64 = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+			break;
+		case STATBIN_FF_U32:
+		case STATBIN_FF_U64:
+			if (statbin_varint(sb, &v) < 0)
+				return -1;
+			f->u.u64 = v;
+			break;
+		case STATBIN_FF_FLT:
+			if (sb->end - sb->pos < 8)
+				return -1;
+			for (v = 0, i = 0; i < 8; i++)
+				v |= (uint64_t)sb->pos[i] << (8 * i);
+			memcpy(&f->u.flt, &v, sizeof(v));
+			sb->pos += 8;
+			break;
+		case STATBIN_FF_STR:
+			if (statbin_varint(sb, &v) < 0 || v > sb->end - sb->pos)
+				return -1;
+			f->u.str.ptr = (const char *)sb->pos;
+			f->u.str.len = v;
+			sb->pos += v;
+			break;
+		default:
+			return -1;
+		}
+	}
+	return 1;
+}
+
+void statbin_free(struct statbin *sb)
+{
+	unsigned int i;
+
+	for (i = 0; sb->names && i < sb->nb_fields; i++)
+		free(sb->names[i]);
+	free(sb->names);
+	free(sb->fields);
+	free(sb->types);
+	sb->names = NULL;
+	sb->fields = NULL;
+	sb->types = NULL;
+}
@@ -0,0 +1,82 @@
+/*
+ * Decoder for the binary statistics output of HAProxy ("show stat bin").
+ *
+ * This is a standalone library meant to be copied into collectors, it does
+ * not depend on HAProxy's headers. The format is described in
+ * include/haproxy/stats-t.h and in the README file next to this one.
+ */
+#ifndef _STATBIN_H
+#define _STATBIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATBIN_MAGIC       "HSTB"
+#define STATBIN_VERSION     1
+#define STATBIN_F_DELTA     0x01
+#define STATBIN_F_GEN       0x02
+#define STATBIN_TAGS        0x80
+#define STATBIN_REC_END     0x00
+#define STATBIN_REC_LINE    0x01
+
+/* field formats, same values as HAProxy's FF_* */
+enum statbin_format {
+	STATBIN_FF_EMPTY = 0,
+	STATBIN_FF_S32   = 1,
+	STATBIN_FF_U32   = 2,
+	STATBIN_FF_S64   = 3,
+	STATBIN_FF_U64   = 4,
+	STATBIN_FF_STR   = 5,
+	STATBIN_FF_FLT   = 6,
+};
+
+/* a decoded field. <type> has the same layout as HAProxy's field type: the
+ * format in the lowest byte, then the origin, nature and scope bytes. Strings
+ * are not zero-terminated and point into the buffer being decoded.
+ */
+struct statbin_field {
+	uint32_t type;
+	union {
+		int64_t s64;      /* STATBIN_FF_S32 and STATBIN_FF_S64 */
+		uint64_t u64;     /* STATBIN_FF_U32 and STATBIN_FF_U64 */
+		double flt;       /* STATBIN_FF_FLT */
+		struct {
+			const char *ptr;
+			size_t len;
+		} str;            /* STATBIN_FF_STR */
+	} u;
+};
+
+struct statbin {
+	int version;                   /* format version */
+	int flags;                     /* STATBIN_F_* */
+	unsigned int domain;           /* 0 = proxies, 1 = resolvers */
+	unsigned int nb_fields;        /* number of fields per record */
+	unsigned int gen;              /* generation, with STATBIN_F_GEN only */
+	char **names;                  /* <nb_fields> zero-terminated field names */
+	struct statbin_field *fields;  /* <nb_fields> fields of the last record */
+	uint32_t *types;               /* last type received for each field */
+	const unsigned char *pos;      /* current decoding position */
+	const unsigned char *end;      /* end of the input buffer */
+};
+
+static inline int statbin_format(const struct statbin_field *f)
+{
+	return f->type & 0xff;
+}
+
+/* Parses the header found in the <len> bytes at <buf> and prepares <sb> to
+ * decode the records following it. <buf> must remain valid as long as <sb> is
+ * used. Returns 0 on success or -1 on error.
+ */
+int statbin_init(struct statbin *sb, const void *buf, size_t len);
+
+/* Decodes the next record into sb->fields. Returns 1 if a record was decoded,
+ * 0 at the end of the output, or -1 if the input is truncated or invalid.
+ */
+int statbin_next(struct statbin *sb);
+
+/* Releases the memory allocated by statbin_init(). */
+void statbin_free(struct statbin *sb);
+
+#endif /* _STATBIN_H */
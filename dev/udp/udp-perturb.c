@@ -81,6 +81,33 @@ unsigned int corr_rate = 0;
 unsigned int corr_span = 1;
 unsigned int corr_base = 0;
 
+/* path emulation: random loss (per 10000), one-way delay, bottleneck */
+unsigned int loss_rate = 0;
+unsigned int delay_ms = 0;
+unsigned int bw_kbps = 0;            // bottleneck rate in kB/s, 0=unlimited
+unsigned int queue_max = 100;        // bottleneck queue size in packets
+
+/* a packet delayed by the path emulation */
+struct dpkt {
+	struct dpkt *next;
+	unsigned long long due;      // date to send it (us)
+	int fd;
+	struct sockaddr_storage to;  // destination, unused if tolen is zero
+	socklen_t tolen;
+	int len;
+	char data[0];
+};
+
+/* per-direction path emulation queue */
+struct path {
+	struct dpkt *head, *tail;
+	unsigned int count;
+	unsigned long long next_free; // date the bottleneck link gets idle (us)
+	unsigned long long sent, lost, dropped;
+};
+
+struct path paths[2];  // 0: client to server, 1: server to client
+
 struct conn conns[MAXCONN];        // sole connection for now
 int fd_frt;
 
@@ -167,6 +194,112 @@ int addr_to_ss(char *str, struct sockaddr_storage *ss, struct errmsg *err)
 	return 0;
 }
 
+/* returns the current date in microseconds */
+static unsigned long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* Sends <len> bytes from <buf> over <fd> to <to> (or to the connected peer if
+ * <tolen> is zero) through the emulated path <p>. The packet may be randomly
+ * lost, dropped when the bottleneck queue is full, or queued to be sent after
+ * the serialization and propagation delays. Returns <len> or -1 on error.
+ */
+int path_send(struct path *p, int fd, const char *buf, int len,
+              const struct sockaddr_storage *to, socklen_t tolen)
+{
+	unsigned long long now;
+	struct dpkt *pkt;
+	int ret;
+
+	if (loss_rate && prng(10000) < loss_rate) {
+		p->lost++;
+		return len;
+	}
+
+	if (!delay_ms && !bw_kbps) {
+		p->sent++;
+		if (tolen)
+			ret = sendto(fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL, (struct sockaddr *)to, tolen);
+		else
+			ret = send(fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+		return ret;
+	}
+
+	now = now_us();
+	if (p->next_free < now)
+		p->next_free = now;
+
+	if (bw_kbps) {
+		if (p->count >= queue_max) {
+			p->dropped++;
+			return len;
+		}
+		/* bw_kbps kB/s are bw_kbps bytes per ms */
+		p->next_free += len * 1000ULL / bw_kbps;
+	}
+
+	pkt = malloc(sizeof(*pkt) + len);
+	if (!pkt)
+		return -1;
+
+	pkt->next = NULL;
+	pkt->due = p->next_free + delay_ms * 1000ULL;
+	pkt->fd = fd;
+	pkt->tolen = tolen;
+	if (tolen)
+		memcpy(&pkt->to, to, tolen);
+	pkt->len = len;
+	memcpy(pkt->data, buf, len);
+
+	if (p->tail)
+		p->tail->next = pkt;
+	else
+		p->head = pkt;
+	p->tail = pkt;
+	p->count++;
+	return len;
+}
+
+/* Sends all packets of path <p> which are due. Returns the delay in ms before
+ * the next one, or -1 if the queue is empty.
+ */
+int path_flush(struct path *p)
+{
+	unsigned long long now = now_us();
+	struct dpkt *pkt;
+
+	while ((pkt = p->head) && pkt->due <= now) {
+		if (pkt->tolen)
+			sendto(pkt->fd, pkt->data, pkt->len, MSG_DONTWAIT | MSG_NOSIGNAL,
+			       (struct sockaddr *)&pkt->to, pkt->tolen);
+		else
+			send(pkt->fd, pkt->data, pkt->len, MSG_DONTWAIT | MSG_NOSIGNAL);
+		p->sent++;
+		p->head = pkt->next;
+		if (!p->head)
+			p->tail = NULL;
+		p->count--;
+		free(pkt);
+	}
+
+	if (!p->head)
+		return -1;
+	return (p->head->due - now + 999) / 1000;
+}
+
+/* dumps the path emulation statistics on SIGUSR1 */
+void dump_stats(int sig)
+{
+	fprintf(stderr, "c2s: sent=%llu lost=%llu dropped=%llu queued=%u\n",
+		paths[0].sent, paths[0].lost, paths[0].dropped, paths[0].count);
+	fprintf(stderr, "s2c: sent=%llu lost=%llu dropped=%llu queued=%u\n",
+		paths[1].sent, paths[1].lost, paths[1].dropped, paths[1].count);
+}
+
 /* returns <0 with err in case of error or the front FD */
 int create_udp_listener(struct sockaddr_storage *addr, struct errmsg *err)
 {
@@ -365,7 +498,7 @@ int handle_frt(int fd, struct pollfd *pfd, struct conn *conns, int nbconn)
 	if (conn->fd_bck < 0)
 		return 0;
 
-	ret = send(conn->fd_bck, pktbuf, ret, MSG_DONTWAIT | MSG_NOSIGNAL);
+	ret = path_send(&paths[0], conn->fd_bck, pktbuf, ret, NULL, 0);
 	return ret;
 }
 
@@ -415,10 +548,9 @@ int handle_bck(int fd, struct pollfd *pfd, struct conn *conns, int nbconn)
 	if (!conn)
 		return 0;
 
-	ret = sendto(fd_frt, pktbuf, ret, MSG_DONTWAIT | MSG_NOSIGNAL,
-		     (struct sockaddr *)&conn->cli_addr,
-		     conn->cli_addr.ss_family == AF_INET6 ?
-		     sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+	ret = path_send(&paths[1], fd_frt, pktbuf, ret, &conn->cli_addr,
+		        conn->cli_addr.ss_family == AF_INET6 ?
+		        sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
 	return ret;
 }
 
@@ -436,7 +568,12 @@ void usage(int status, const char *name)
 	    "  -c rate      corrupt around <rate>%% of packets\n"
 	    "  -o ofs       start offset of corrupted area (def: 0)\n"
 	    "  -w width     width of the corrupted area (def: 1)\n"
-	    "", name, prng_state);
+	    "  -l rate      randomly lose <rate>%% of packets (accepts decimals)\n"
+	    "  -d delay     add <delay> milliseconds of one-way delay\n"
+	    "  -b rate      limit the rate to <rate> kB/s in each direction\n"
+	    "  -q size      bottleneck queue size in packets with -b (def: %u)\n"
+	    "Path statistics are dumped on SIGUSR1.\n"
+	    "", name, prng_state, queue_max);
 }
 
 int main(int argc, char **argv)
@@ -450,7 +587,7 @@ int main(int argc, char **argv)
 	err.size = 100;
 	err.msg = malloc(err.size);
 
-	while ((opt = getopt(argc, argv, "hr:s:c:o:w:")) != -1) {
+	while ((opt = getopt(argc, argv, "hr:s:c:o:w:l:d:b:q:")) != -1) {
 		switch (opt) {
 		case 'r': // rand_rate%
 			rand_rate = atoi(optarg);
@@ -467,6 +604,18 @@ int main(int argc, char **argv)
 		case 'w': // corruption width
 			corr_span = atol(optarg);
 			break;
+		case 'l': // loss rate%
+			loss_rate = atof(optarg) * 100;
+			break;
+		case 'd': // one-way delay (ms)
+			delay_ms = atoi(optarg);
+			break;
+		case 'b': // bottleneck rate (kB/s)
+			bw_kbps = atoi(optarg);
+			break;
+		case 'q': // bottleneck queue size
+			queue_max = atoi(optarg);
+			break;
 		default: // help, anything else
 			usage(0, argv[0]);
 		}
@@ -494,12 +643,21 @@ int main(int argc, char **argv)
 		conns[i].fd_bck = -1;
 
 	nbfd = update_pfd(pfd, fd_frt, conns, MAXCONN);
+	signal(SIGUSR1, dump_stats);
 
 	while (1) {
 		/* listen for incoming packets */
-		int ret, i;
+		int ret, i, wait, next;
+
+		/* wake up in time for the next delayed packet */
+		wait = 1000;
+		for (i = 0; i < 2; i++) {
+			next = path_flush(&paths[i]);
+			if (next >= 0 && next < wait)
+				wait = next;
+		}
 
-		ret = poll(pfd, nbfd, 1000);
+		ret = poll(pfd, nbfd, wait);
 		if (ret <= 0)
 			continue;
 
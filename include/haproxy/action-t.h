@@ -22,6 +22,7 @@
 #ifndef _HAPROXY_ACTION_T_H
 #define _HAPROXY_ACTION_T_H
 
+#include <import/ebtree-t.h>
 #include <haproxy/applet-t.h>
 #include <haproxy/stick_table-t.h>
 #include <haproxy/vars-t.h>
@@ -191,6 +192,29 @@ struct act_rule {
 		char *file;                    /* file name where the rule appears (or NULL) */
 		int line;                      /* line number where the rule appears */
 	} conf;
+	struct act_rule_dispatch *dispatch;    /* dispatch table of the chain starting at this rule, or NULL */
+	uint64_t calls;                        /* number of evaluations while profiling */
+	uint64_t cpu_time;                     /* total evaluation time while profiling, in ns */
+};
+
+/* Dispatch table compiled for a chain of consecutive rules whose conditions
+ * all match the same sample against constant strings. It is attached to the
+ * chain's first rule and gives the first rule matching a given string.
+ */
+struct act_rule_dispatch {
+	struct sample_expr *expr;              /* sample expression shared by the chain's conditions */
+	int icase;                             /* 1 if strings are matched case-insensitively */
+	int nb_rules;                          /* number of rules in the chain */
+	struct act_rule **rules;               /* the chain's rules, in declaration order */
+	struct pat_ref **refs;                 /* the pattern reference of each rule */
+	unsigned long long *revisions;         /* the references' revisions when the table was built */
+	struct eb_root keys;                   /* act_rule_dispatch_key indexed by string */
+};
+
+/* One string of a dispatch table */
+struct act_rule_dispatch_key {
+	int idx;                               /* index of the first rule matching this string */
+	struct ebmb_node node;                 /* indexed string, must be last */
 };
 
 struct action_kw {
@@ -33,6 +33,8 @@
 #define HA_PROF_TASKS_MASK  0x00000003     /* per-task CPU profiling mask */
 
 #define HA_PROF_MEMORY      0x00000004     /* memory profiling */
+#define HA_PROF_SAMPLES     0x00000008     /* sample expressions profiling */
+#define HA_PROF_RULES       0x00000010     /* http-request/response rules profiling */
 
 /* per-thread activity reports. It's important that it's aligned on cache lines
  * because some elements will be updated very often. Most counters are OK on
@@ -65,6 +67,10 @@ struct activity {
 	unsigned int accq_full;    // accept queue connection not pushed because full
 	unsigned int pool_fail;    // failed a pool allocation
 	unsigned int buf_wait;     // waited on a buffer allocation
+	unsigned int checks;       // health checks started on this thread
+	unsigned int chk_coalesced; // health check results reused from a coalesced check
+	unsigned int smp_memo_hit;  // sample expressions found in the per-stream sample cache
+	unsigned int smp_memo_miss; // cacheable sample expressions which had to be evaluated
 #if defined(DEBUG_DEV)
 	/* keep these ones at the end */
 	unsigned int ctr0;         // general purposee debug counter
@@ -145,6 +145,17 @@ enum {
 struct tcpcheck_rule;
 struct tcpcheck_rules;
 
+/* Results of a check which performs the I/O on behalf of other identical
+ * checks ("followers"), only allocated for such leaders.
+ */
+struct check_shared {
+	struct list followers;                  /* coalesced checks, linked by their <coalesce_list> */
+	unsigned int seq;                       /* incremented after each completed check */
+	short status, code;                     /* last check result */
+	long duration;                          /* last check duration */
+	char desc[HCHK_DESC_LEN];               /* last check description */
+};
+
 struct check {
 	enum obj_type obj_type;                 /* object type == OBJ_TYPE_CHECK */
 	struct session *sess;			/* Health check session. */
@@ -164,6 +175,10 @@ struct check {
 	struct tcpcheck_rules *tcpcheck_rules;	/* tcp-check send / expect rules */
 	struct tcpcheck_rule *current_step;     /* current step when using tcpcheck */
 	int inter, fastinter, downinter;        /* checks: time in milliseconds */
+	int adaptive_inter;                     /* max interval while live traffic is healthy, 0 = disabled */
+	int adapt_inter;                        /* current adaptive interval, 0 = use inter */
+	unsigned int adapt_date;                /* date the adaptive interval was last evaluated */
+	unsigned int adapt_rtime;               /* live traffic response time when backing off started */
 	enum chk_result result;                 /* health-check result : CHK_RES_* */
 	int state;				/* state of the check : CHK_ST_*   */
 	int health;				/* 0 to rise-1 = bad;
@@ -181,6 +196,11 @@ struct check {
 	int alpn_len;                           /* ALPN string length */
 	const struct mux_proto_list *mux_proto; /* the mux to use for all outgoing connections (specified by the "proto" keyword) */
 	int via_socks4;                         /* check the connection via socks4 proxy */
+	unsigned int wheel_pos;                 /* "wheel" scheduler: offset in the interval, in 1/2^32 */
+	struct check *leader;                   /* check performing the I/O for this one when coalesced */
+	struct check_shared *shared;            /* results shared with coalesced checks (leaders only) */
+	struct list coalesce_list;              /* member of the leader's followers list */
+	unsigned int shared_seq;                /* last leader result applied (followers only) */
 };
 
 #endif /* _HAPROXY_CHECKS_T_H */
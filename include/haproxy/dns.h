@@ -26,7 +26,9 @@
 #include <haproxy/server-t.h>
 
 int dns_send_nameserver(struct dns_nameserver *ns, void *buf, size_t len);
+int dns_send_nameserver_stream(struct dns_nameserver *ns, void *buf, size_t len);
 ssize_t dns_recv_nameserver(struct dns_nameserver *ns, void *data, size_t size);
+ssize_t dns_recv_nameserver_stream(struct dns_nameserver *ns, void *data, size_t size);
 int dns_dgram_init(struct dns_nameserver *ns, struct sockaddr_storage *sk);
 int dns_stream_init(struct dns_nameserver *ns, struct server *s);
 
@@ -75,6 +75,7 @@
 #define GTUNE_IDLE_POOL_SHARED   (1<<20)
 #define GTUNE_DISABLE_H2_WEBSOCKET (1<<21)
 #define GTUNE_DISABLE_ACTIVE_CLOSE (1<<22)
+#define GTUNE_QUIC_PACING        (1<<23)
 
 extern int cluster_secret_isset; /* non zero means a cluster secret was initiliazed */
 
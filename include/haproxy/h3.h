@@ -85,6 +85,9 @@ enum h3_ft       {
 	H3_FT_GOAWAY       = 0x07,
 	/* hole */
 	H3_FT_MAX_PUSH_ID  = 0x0d,
+	/* RFC 9218 extensible priorities */
+	H3_FT_PRIORITY_UPDATE_REQ  = 0xf0700,
+	H3_FT_PRIORITY_UPDATE_PUSH = 0xf0701,
 };
 
 /* Stream types */
@@ -53,6 +53,8 @@
 #define CLASS_REGEX        "Regex"
 #define CLASS_STKTABLE     "StickTable"
 #define CLASS_CERTCACHE    "CertCache"
+#define CLASS_SHARED_TABLE "SharedTable"
+#define CLASS_SHARED_COUNTER "SharedCounter"
 
 struct stream;
 
@@ -203,6 +205,62 @@ struct hlua_httpclient {
 	struct mt_list by_hlua; /* linked in the current hlua task */
 };
 
+/* Shared data available to all Lua states (see core.shared_table() and
+ * core.shared_counter()). Tables are read-mostly: readers never lock, they
+ * use the current snapshot which is never modified. Writers build a new
+ * snapshot under the table's lock, publish it and retire the previous one,
+ * which is released once no thread references it anymore in its hazard slot.
+ */
+enum hlua_shared_type {
+	HLUA_SHARED_BOOL = 0,
+	HLUA_SHARED_INT,
+	HLUA_SHARED_FLT,
+	HLUA_SHARED_STR,
+};
+
+/* One entry of a snapshot. Keys and strings are stored after the entries,
+ * their offsets are relative to the beginning of the snapshot so that a
+ * snapshot may be copied with a simple memcpy().
+ */
+struct hlua_shared_entry {
+	unsigned int key_ofs;             /* offset of the key in the snapshot */
+	unsigned int key_len;             /* key length */
+	enum hlua_shared_type type;       /* type of the value */
+	union {
+		long long sint;           /* HLUA_SHARED_BOOL and HLUA_SHARED_INT */
+		double flt;               /* HLUA_SHARED_FLT */
+		struct {
+			unsigned int ofs; /* offset of the string in the snapshot */
+			unsigned int len; /* string length */
+		} str;                    /* HLUA_SHARED_STR */
+	} u;
+};
+
+/* An immutable version of a shared table, entries are sorted by key */
+struct hlua_shared_snap {
+	struct hlua_shared_snap *next;    /* next retired snapshot, if any */
+	unsigned long long gen;           /* incremented on each update */
+	unsigned int size;                /* total size of the snapshot */
+	unsigned int count;               /* number of entries */
+	struct hlua_shared_entry entries[VAR_ARRAY];
+};
+
+struct hlua_shared_table {
+	struct list list;                 /* linked in the shared tables list */
+	char *name;                       /* name passed to core.shared_table() */
+	struct hlua_shared_snap *cur;     /* current snapshot, never NULL */
+	struct hlua_shared_snap *retired; /* snapshots waiting to be released */
+	__decl_thread(HA_SPINLOCK_T lock);/* serializes the writers */
+};
+
+struct hlua_shared_counter {
+	struct list list;                 /* linked in the shared counters list */
+	char *name;                       /* name passed to core.shared_counter() */
+	THREAD_PAD(63);
+	long long value;                  /* only accessed atomically */
+	THREAD_PAD(63);
+};
+
 #else /* USE_LUA */
 /************************ For use when Lua is disabled ********************/
 
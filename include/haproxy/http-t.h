@@ -58,6 +58,12 @@
 #define HTTP_IS_VER_TOKEN(x) (http_char_classes[(uint8_t)(x)] & HTTP_FLG_VER)
 #define HTTP_IS_DIGIT(x)     (http_char_classes[(uint8_t)(x)] & HTTP_FLG_DIG)
 
+/* RFC9218 extensible priorities: urgency ranges from 0 (most urgent) to 7,
+ * and defaults to 3. Responses are non-incremental by default.
+ */
+#define HTTP_PRIO_URGENCY_DEF 3
+#define HTTP_PRIO_URGENCY_MAX 7
+
 /* Known HTTP methods */
 enum http_meth_t {
 	HTTP_METH_OPTIONS,
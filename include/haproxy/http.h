@@ -68,6 +68,8 @@ int http_compare_etags(struct ist etag1, struct ist etag2);
 struct ist http_trim_leading_spht(struct ist value);
 struct ist http_trim_trailing_spht(struct ist value);
 
+void http_parse_priority(const struct ist value, uint8_t *urgency, uint8_t *incremental);
+
 /*
  * Given a path string and its length, find the position of beginning of the
  * query string. Returns NULL if no query string is found in the path.
@@ -46,6 +46,11 @@ struct action_kw *action_http_req_custom(const char *kw);
 struct action_kw *action_http_res_custom(const char *kw);
 struct action_kw *action_http_after_res_custom(const char *kw);
 
+struct act_rule *http_rule_dispatch(struct act_rule_dispatch *d, struct proxy *px,
+                                    struct session *sess, struct stream *s,
+                                    unsigned int opt, int *matched);
+void http_rules_prof_reset(void);
+
 #endif /* _HAPROXY_HTTP_RULES_H */
 
 /*
@@ -223,8 +223,8 @@ struct htx {
 
 	uint64_t extra;  /* known bytes amount remaining to receive */
 	uint32_t flags;  /* HTX_FL_* */
-
-	/* XXX 4 bytes unused */
+	uint32_t gen;    /* incremented each time start-line or header blocks are
+			  * added, removed, moved or modified. 0 on a new message. */
 
 	/* Blocks representing the HTTP message itself */
 	char blocks[VAR_ARRAY] __attribute__((aligned(8)));
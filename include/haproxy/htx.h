@@ -321,6 +321,16 @@ static inline int htx_is_unique_blk(const struct htx *htx,
 	return (htx_get_blksz(blk) == htx->data);
 }
 
+/* Accounts a change of a block of type <type> in the HTX message <htx>. Only
+ * the start-line and the headers are considered, since the sample fetch cache
+ * which relies on htx->gen never depends on the payload nor the trailers.
+ */
+static inline void htx_blk_changed(struct htx *htx, enum htx_blk_type type)
+{
+	if (type <= HTX_BLK_EOH)
+		htx->gen++;
+}
+
 /* Changes the size of the value. It is the caller responsibility to change the
  * value itself, make sure there is enough space and update allocated
  * value. This function updates the HTX message accordingly.
@@ -331,6 +341,7 @@ static inline void htx_change_blk_value_len(struct htx *htx, struct htx_blk *blk
 	uint32_t oldlen, sz;
 	int32_t delta;
 
+	htx_blk_changed(htx, type);
 	sz = htx_get_blksz(blk);
 	switch (type) {
 		case HTX_BLK_HDR:
@@ -657,6 +668,7 @@ static inline void htx_reset(struct htx *htx)
 	htx->tail_addr = htx->head_addr = htx->end_addr = 0;
 	htx->extra = 0;
 	htx->flags = HTX_FL_NONE;
+	htx->gen = 0;
 }
 
 /* Returns the available room for raw data in buffer <buf> once HTX overhead is
@@ -183,6 +183,8 @@ struct bind_conf {
 	struct eb_root sni_ctx;    /* sni_ctx tree of all known certs full-names sorted by name */
 	struct eb_root sni_w_ctx;  /* sni_ctx tree of all known certs wildcards sorted by name */
 	struct tls_keys_ref *keys_ref; /* TLS ticket keys reference */
+	unsigned int tls_ticket_rotate; /* TLS ticket keys rotation period in seconds, 0 if none */
+	int tls_ticket_history;    /* number of previous rotating keys kept for decryption, 0=default */
 
 	char *ca_sign_file;        /* CAFile used to generate and sign server certificates */
 	char *ca_sign_pass;        /* CAKey passphrase */
@@ -27,6 +27,7 @@
 #include <netinet/in.h>
 
 #include <haproxy/api-t.h>
+#include <haproxy/freq_ctr-t.h>
 #include <haproxy/ring-t.h>
 #include <haproxy/thread-t.h>
 
@@ -46,6 +47,21 @@
 #define LOG_OPT_HTTP            0x00000020
 #define LOG_OPT_ESC             0x00000040
 #define LOG_OPT_MERGE_SPACES    0x00000080
+#define LOG_OPT_BIN             0x00000100
+#define LOG_OPT_BIN_OK          0x00000200  /* parsing only: the format may use "+B" */
+
+/* Binary log lines (log-format option "+B") start with LOG_BIN_MAGIC followed
+ * by a varint holding the length of the fields area. Each field is encoded as
+ * a varint key made of the node's LOG_FMT_* type shifted left by 2 bits ORed
+ * with its LOG_BIN_T_* value type, followed by a varint length and the value
+ * itself. An empty value indicates a missing field. All varints use the same
+ * encoding as encode_varint().
+ */
+#define LOG_BIN_MAGIC           0xB1
+#define LOG_BIN_T_STR           0      /* raw bytes */
+#define LOG_BIN_T_INT           1      /* zigzag-encoded signed varint */
+#define LOG_BIN_T_ADDR          2      /* 4 or 16 bytes of IPv4/IPv6 address, network order */
+#define LOG_BIN_T_BITS          2
 
 
 /* Fields that need to be extracted from the incoming connection or request for
@@ -104,7 +120,10 @@ enum log_tgt {
 	LOG_TARGET_BUFFER,    // ring buffer
 };
 
-/* lists of fields that can be logged, for logformat_node->type */
+/* lists of fields that can be logged, for logformat_node->type. These values
+ * are also used as field identifiers in binary log lines, so new entries must
+ * only be appended.
+ */
 enum {
 
 	LOG_FMT_TEXT = 0, /* raw text */
@@ -224,10 +243,25 @@ struct smp_info {
 	                            */
 };
 
+/* Adaptive log sampling information. Errors, warnings and slow streams are
+ * always logged, other lines are sampled so that the number of lines sent per
+ * second remains below <max_rate>.
+ */
+struct smp_adaptive {
+	unsigned int max_rate;     /* max number of lines per second, 0 = disabled */
+	unsigned int slow;         /* streams lasting at least this (ms) are always logged, 0 = disabled */
+	struct freq_ctr offered;   /* lines subject to sampling per second */
+	struct freq_ctr prio;      /* lines always logged per second */
+	struct freq_ctr sent;      /* lines sent per second */
+	unsigned long long kept;   /* total number of lines kept */
+	unsigned long long dropped; /* total number of lines dropped by sampling */
+};
+
 struct logsrv {
 	struct list list;
 	struct sockaddr_storage addr;
 	struct smp_info lb;
+	struct smp_adaptive adapt;
 	struct sink *sink;
 	char *ring_name;
 	enum log_tgt type;
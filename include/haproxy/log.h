@@ -106,7 +106,7 @@ void send_log(struct proxy *p, int level, const char *format, ...)
  * It doesn't care about errors nor does it report them.
  */
 
-void __send_log(struct list *logsrvs, struct buffer *tag, int level, char *message, size_t size, char *sd, size_t sd_size);
+void __send_log(struct list *logsrvs, struct buffer *tag, int level, char *message, size_t size, char *sd, size_t sd_size, int duration);
 
 /*
  * returns log format for <fmt> or LOG_FORMAT_UNSPEC if not found.
@@ -143,6 +143,11 @@ char *lf_ip(char *dst, const struct sockaddr *sockaddr, size_t size, const struc
  */
 char *lf_port(char *dst, const struct sockaddr *sockaddr, size_t size, const struct logformat_node *node);
 
+/*
+ * Returns the exact length of the binary log line starting at <msg>, or 0 if
+ * it is not a complete binary line (see LOG_BIN_MAGIC)
+ */
+size_t lf_bin_len(const char *msg, size_t size);
 
 /*
  * Function to handle log header building (exported for sinks)
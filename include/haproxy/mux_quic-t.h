@@ -181,6 +181,8 @@ struct qcs {
 	uint64_t err; /* error code to transmit via RESET_STREAM */
 
 	int start; /* base timestamp for http-request timeout */
+	uint8_t urgency;     /* RFC9218 urgency, 0 (highest) to 7 (lowest) */
+	uint8_t incremental; /* RFC9218 incremental flag, 0 or 1 */
 };
 
 /* Used as qcc_app_ops.close callback argument. */
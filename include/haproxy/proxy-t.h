@@ -475,12 +475,14 @@ struct proxy {
 struct switching_rule {
 	struct list list;			/* list linked to from the proxy */
 	struct acl_cond *cond;			/* acl condition to meet */
-	int dynamic;				/* this is a dynamic rule using the logformat expression */
+	int dynamic;				/* 1 for a dynamic rule using the logformat expression, 2 for a map */
 	union {
 		struct proxy *backend;		/* target backend */
-		char *name;			/* target backend name during config parsing */
+		char *name;			/* target backend name (or map file name) during config parsing */
 		struct list expr;		/* logformat expression to use for dynamic rules */
 	} be;
+	struct sample_expr *map_key;		/* key looked up in <map> for "use_backend_map" rules */
+	struct pattern_head *map;		/* map of keys to backends for "use_backend_map" rules */
 	char *file;
 	int line;
 };
@@ -35,6 +35,7 @@ extern struct proxy *proxies_list;
 extern struct eb_root used_proxy_id;	/* list of proxy IDs in use */
 extern unsigned int error_snapshot_id;  /* global ID assigned to each error then incremented */
 extern struct eb_root proxy_by_name;    /* tree of proxies sorted by name */
+extern struct eb_root defproxy_by_name; /* tree of default proxies sorted by name */
 
 extern const struct cfg_opt cfg_opts[];
 extern const struct cfg_opt cfg_opts2[];
@@ -56,6 +57,8 @@ const char *proxy_find_best_option(const char *word, const char **extra);
 void proxy_store_name(struct proxy *px);
 struct proxy *proxy_find_by_id(int id, int cap, int table);
 struct proxy *proxy_find_by_name(const char *name, int cap, int table);
+struct pattern_head *proxy_load_backend_map(const char *filename, const char *file, int line, char **err);
+struct proxy *proxy_map_lookup_backend(struct pattern_head *head, struct sample *smp);
 struct proxy *proxy_find_best_match(int cap, const char *name, int id, int *diff);
 struct server *findserver(const struct proxy *px, const char *name);
 int proxy_cfg_ensure_no_http(struct proxy *curproxy);
@@ -73,5 +73,13 @@ static inline void *quic_cc_priv(const struct quic_cc *cc)
 	return (void *)cc->priv;
 }
 
+/* Returns the pacing rate in bytes per second suggested by <cc> congestion
+ * controller, or 0 if it does not provide any.
+ */
+static inline uint64_t quic_cc_pacing_rate(const struct quic_cc *cc)
+{
+	return cc->algo->pacing_rate ? cc->algo->pacing_rate(cc) : 0;
+}
+
 #endif /* USE_QUIC */
 #endif /* _PROTO_QUIC_CC_H */
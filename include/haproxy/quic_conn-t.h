@@ -58,6 +58,13 @@ typedef unsigned long long ull;
 /* Lengths of the QUIC CIDs generated by the haproxy implementation. */
 #define QUIC_HAP_CID_LEN               8
 
+/* The second byte of the CIDs generated by haproxy is their first byte, which
+ * encodes the owner thread, XORed with this value. This allows to distinguish
+ * them from the CIDs chosen by the clients for their first packets (with 1/256
+ * false positives).
+ */
+#define QUIC_CID_PIN_MARK              0xa5
+
 /* Common definitions for short and long QUIC packet headers. */
 /* QUIC connection ID maximum length for version 1. */
 #define QUIC_CID_MAXLEN               20 /* bytes */
@@ -334,6 +341,9 @@ struct quic_arng_node {
 /* The maximum number of dgrams which may be sent upon PTO expirations. */
 #define QUIC_MAX_NB_PTO_DGRAMS         2
 
+/* The minimum number of dgrams which may be sent in a burst by the pacing */
+#define QUIC_PACING_MIN_BURST          2
+
 /* QUIC datagram */
 struct quic_dgram {
 	void *owner;
@@ -659,6 +669,10 @@ struct quic_conn {
 	struct qcc *qcc;
 	struct task *timer_task;
 	unsigned int timer;
+	/* Pacing task, only allocated when pacing is enabled */
+	struct task *pacing_task;
+	uint64_t pacing_last;   /* date of the last pacing credit refill (ns) */
+	uint64_t pacing_credit; /* number of bytes which may be sent without waiting */
 	/* Idle timer task */
 	struct task *idle_timer_task;
 	unsigned int flags;
@@ -219,12 +219,23 @@ static inline unsigned long quic_get_cid_tid(const unsigned char *cid)
 }
 
 /* Modify <cid> to have a CID linked to the thread ID <target_tid>. This is
- * based on quic_get_cid_tid.
+ * based on quic_get_cid_tid. The CID is also marked as generated by haproxy
+ * (see quic_cid_is_pinned()).
  */
 static inline void quic_pin_cid_to_tid(unsigned char *cid, int target_tid)
 {
 	cid[0] = MIN(cid[0], 255 - target_tid);
 	cid[0] = cid[0] - (cid[0] % global.nbthread) + target_tid;
+	cid[1] = cid[0] ^ QUIC_CID_PIN_MARK;
+}
+
+/* Returns non-zero if <cid> of length <len> was likely generated by haproxy and
+ * pinned to a thread by quic_pin_cid_to_tid(), or zero if it was chosen by a
+ * client for its first packets.
+ */
+static inline int quic_cid_is_pinned(const unsigned char *cid, size_t len)
+{
+	return len == QUIC_HAP_CID_LEN && cid[1] == (cid[0] ^ QUIC_CID_PIN_MARK);
 }
 
 /* Return a 32-bits integer in <val> from QUIC packet with <buf> as address.
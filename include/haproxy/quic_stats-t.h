@@ -48,6 +48,12 @@ enum {
 	QUIC_ST_STREAM_DATA_BLOCKED,
 	QUIC_ST_STREAMS_DATA_BLOCKED_BIDI,
 	QUIC_ST_STREAMS_DATA_BLOCKED_UNI,
+	/* Pacing related counters */
+	QUIC_ST_PACING_DEFERRED,
+	QUIC_ST_PACED_DGRAMS,
+	/* Datagrams dispatching counters */
+	QUIC_ST_DGRAM_DIRECT,
+	QUIC_ST_DGRAM_REDISPATCHED,
 	QUIC_STATS_COUNT /* must be the last */
 };
 
@@ -91,6 +97,12 @@ struct quic_counters {
 	long long stream_data_blocked;       /* total number of times STEAM_DATA_BLOCKED frame was received */
 	long long streams_data_blocked_bidi; /* total number of times STREAMS_DATA_BLOCKED_BIDI frame was received */
 	long long streams_data_blocked_uni;  /* total number of times STREAMS_DATA_BLOCKED_UNI frame was received */
+	/* Pacing related counters */
+	long long pacing_deferred; /* total number of times emission was deferred by pacing */
+	long long paced_dgrams;    /* total number of datagrams emitted under pacing control */
+	/* Datagrams dispatching counters */
+	long long dgram_direct;       /* total number of datagrams handled by the receiving thread */
+	long long dgram_redispatched; /* total number of datagrams passed to another thread */
 };
 
 #endif /* USE_QUIC */
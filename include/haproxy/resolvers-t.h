@@ -134,6 +134,7 @@ struct resolv_response {
 struct resolvers {
 	__decl_thread(HA_SPINLOCK_T lock);
 	unsigned int accepted_payload_size; /* maximum payload size we accept for responses */
+	int          tcp_fallback;          /* retry truncated responses from UDP nameservers over TCP */
 	int          nb_nameservers;        /* total number of active nameservers in a resolvers section */
 	int          resolve_retries;       /* number of retries before giving up */
 	struct {                            /* time to: */
@@ -216,6 +217,28 @@ struct resolv_resolution {
 	struct list list; /* resolution list */
 };
 
+/* Entry of the process-wide DNS answer cache. It holds a copy of the raw
+ * response received for a hostname and query type, so that any resolution for
+ * the same name, in any resolvers section, may reuse it until it expires
+ * instead of querying the nameservers again.
+ */
+struct resolv_cache_entry {
+	struct eb32_node      node;            /* indexed by hash of hostname_dn and query type */
+	struct list           list;            /* insertion order, oldest first, for eviction */
+	int                   query_type;      /* query type the response answers */
+	int                   negative;        /* 1 when caching an NXDOMAIN response */
+	int                   fallback;        /* 1 when obtained after the A<->AAAA fallback */
+	int                   prefetching;     /* 1 once a refresh query was triggered */
+	unsigned int          stored;          /* date of storage (ticks) */
+	unsigned int          expire;          /* expiration date (ticks) */
+	unsigned int          hits;            /* number of times the entry was used */
+	int                   hostname_dn_len; /* length of <hostname_dn> */
+	int                   resp_len;        /* length of <resp> */
+	char                 *hostname_dn;     /* hostname in domain name format, points to <area> */
+	unsigned char        *resp;            /* raw DNS response, points to <area> */
+	char                  area[VAR_ARRAY]; /* storage for hostname_dn and resp */
+};
+
 /* Structure used to describe the owner of a DNS resolution. */
 struct resolv_requester {
 	enum obj_type         *owner;       /* pointer to the owner (server or dns_srvrq) */
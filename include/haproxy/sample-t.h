@@ -266,6 +266,8 @@ struct sample_conv_expr {
 	struct list list;                         /* member of a sample_expr */
 	struct sample_conv *conv;                 /* sample conversion used */
 	struct arg *arg_p;                        /* optional arguments */
+	unsigned int in_type;                     /* input type expected from the previous step */
+	int (*cast)(struct sample *smp);          /* cast from <in_type> to conv->in_type, resolved at parse time */
 };
 
 /* Descriptor for a sample fetch method */
@@ -286,10 +288,48 @@ struct sample_fetch {
 
 /* sample expression */
 struct sample_expr {
-	struct list list;                         /* member of list of sample, currently not used */
+	struct list list;                         /* member of the list of all compiled sample expressions */
 	struct sample_fetch *fetch;               /* sample fetch method */
 	struct arg *arg_p;                        /* optional pointer to arguments to fetch function */
 	struct list conv_exprs;                   /* list of conversion expression to apply */
+	char *text;                               /* expression as written in the configuration */
+	const char *file;                         /* file where the expression was declared (may be NULL) */
+	int line;                                 /* line where the expression was declared */
+	uint64_t calls;                           /* number of evaluations while profiling */
+	uint64_t cpu_time;                        /* total evaluation time while profiling, in ns */
+	uint64_t memo_key;                        /* key in the per-stream sample cache, 0 if not cacheable */
+};
+
+/* Limits of what a per-stream sample cache entry may hold: the total length
+ * of the string and binary contents and the number of values for multi-valued
+ * samples (e.g. all occurrences of a header in an ACL). Larger results are
+ * always evaluated.
+ */
+#define SMP_MEMO_MAX_LEN    128
+#define SMP_MEMO_MAX_VALUES 4
+
+/* One entry of the per-stream sample cache */
+struct smp_memo_entry {
+	uint64_t key;                             /* memo_key of the expression, 0 if unused */
+	unsigned int epoch;                       /* epoch of the cache when the entry was stored */
+	unsigned int iterate;                     /* 1 if evaluated with SMP_OPT_ITERATE */
+	unsigned int flags;                       /* SMP_F_* flags of the result */
+	unsigned int count;                       /* number of values, 0 if the sample was not found */
+	struct sample_data data[SMP_MEMO_MAX_VALUES]; /* values; contents are stored in <area> */
+	char area[SMP_MEMO_MAX_LEN];              /* storage for string and binary contents */
+};
+
+/* Per-stream cache of request sample expression results, allocated on first
+ * use when tune.sample-cache.entries is set. It is a direct-mapped table: an
+ * expression may only be stored in the entry designated by its memo_key, which
+ * it takes over from any other one. The cache is emptied by bumping its epoch
+ * whenever an action may have modified the request, and when the generation of
+ * the request's HTX message changed since its entries were stored.
+ */
+struct smp_memo {
+	unsigned int epoch;                       /* entries from another epoch are unused, never 0 */
+	unsigned int htx_gen;                     /* generation of the request's HTX message */
+	struct smp_memo_entry entries[VAR_ARRAY]; /* tune.sample-cache.entries entries */
 };
 
 /* sample fetch keywords list */
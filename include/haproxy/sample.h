@@ -44,6 +44,10 @@ int sample_conv_var2smp(const struct var_desc *var, struct sample *smp, int type
 int sample_conv_var2smp_sint(const struct arg *arg, struct sample *smp);
 int sample_conv_var2smp_str(const struct arg *arg, struct sample *smp);
 void release_sample_expr(struct sample_expr *expr);
+int sample_expr_compile(struct sample_expr *expr, const char *text, const char *file, int line);
+void sample_expr_prof_reset(void);
+void smp_memo_clear(struct smp_memo *memo);
+void smp_memo_free(struct smp_memo *memo);
 void sample_register_fetches(struct sample_fetch_kw_list *psl);
 void sample_register_convs(struct sample_conv_kw_list *psl);
 const char *sample_src_names(unsigned int use);
@@ -179,4 +183,14 @@ int smp_make_rw(struct sample *smp)
 	return smp && (smp_is_rw(smp) || smp_dup(smp));
 }
 
+/* Empties the per-stream sample cache <memo> if any. It must be called each
+ * time the request may have been modified, so that cached results are not
+ * reused past this point.
+ */
+static inline void smp_memo_reset(struct smp_memo *memo)
+{
+	if (memo && unlikely(!++memo->epoch))
+		smp_memo_clear(memo);
+}
+
 #endif /* _HAPROXY_SAMPLE_H */
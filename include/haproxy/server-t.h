@@ -308,6 +308,8 @@ struct server {
 	int cur_sess;				/* number of currently active sessions (including syn_sent) */
 	int served;				/* # of active sessions currently being served (ie not pending) */
 	int consecutive_errors;			/* current number of consecutive errors */
+	unsigned int passive_ok_date;		/* last observed success from live traffic (adaptive-inter only) */
+	unsigned int passive_err_date;		/* last observed error from live traffic (adaptive-inter only) */
 	struct freq_ctr sess_per_sec;		/* sessions per second on this server */
 	struct be_counters counters;		/* statistics counters */
 
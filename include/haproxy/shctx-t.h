@@ -46,11 +46,15 @@ struct shared_block {
 };
 
 struct shared_context {
-	__decl_thread(HA_SPINLOCK_T lock);
+	__decl_thread(HA_RWLOCK_T lock);
 	struct list avail;  /* list for active and free blocks */
 	struct list hot;     /* list for locked blocks */
 	unsigned int nbav;  /* number of available blocks */
+	unsigned int nbblocks;       /* total number of blocks */
 	unsigned int max_obj_size;   /* maximum object size (in bytes). */
+	unsigned long long hits;      /* successful lookups, updated by the user */
+	unsigned long long misses;    /* failed lookups, updated by the user */
+	unsigned long long evictions; /* rows evicted to make room for new ones */
 	void (*free_block)(struct shared_block *first, struct shared_block *block);
 	short int block_size;
 	unsigned char data[VAR_ARRAY];
@@ -22,6 +22,9 @@
 int shctx_init(struct shared_context **orig_shctx,
                int maxblocks, int blocksize, unsigned int maxobjsz,
                int extra, int shared);
+int shctx_init_shards(struct shared_context **shards, int nbshards,
+                      int maxblocks, int blocksize, unsigned int maxobjsz,
+                      int extra, int shared);
 struct shared_block *shctx_row_reserve_hot(struct shared_context *shctx,
                                            struct shared_block *last, int data_len);
 void shctx_row_inc_hot(struct shared_context *shctx, struct shared_block *first);
@@ -37,8 +40,24 @@ int shctx_row_data_get(struct shared_context *shctx, struct shared_block *first,
 
 extern int use_shared_mem;
 
-#define shctx_lock(shctx)   if (use_shared_mem) HA_SPIN_LOCK(SHCTX_LOCK, &shctx->lock)
-#define shctx_unlock(shctx) if (use_shared_mem) HA_SPIN_UNLOCK(SHCTX_LOCK, &shctx->lock)
+#define shctx_lock(shctx)     if (use_shared_mem) HA_RWLOCK_WRLOCK(SHCTX_LOCK, &shctx->lock)
+#define shctx_unlock(shctx)   if (use_shared_mem) HA_RWLOCK_WRUNLOCK(SHCTX_LOCK, &shctx->lock)
+
+/* Read lock functions, only for users which never modify the rows nor the
+ * lists while holding it.
+ */
+#define shctx_rdlock(shctx)   if (use_shared_mem) HA_RWLOCK_RDLOCK(SHCTX_LOCK, &shctx->lock)
+#define shctx_rdunlock(shctx) if (use_shared_mem) HA_RWLOCK_RDUNLOCK(SHCTX_LOCK, &shctx->lock)
+
+/* Returns the shard among the <nbshards> ones of <shards> which is in charge
+ * of an object whose key hashes to <hash>. <nbshards> must be a power of two.
+ */
+static inline struct shared_context *shctx_shard(struct shared_context **shards,
+                                                 unsigned int nbshards,
+                                                 unsigned int hash)
+{
+	return shards[hash & (nbshards - 1)];
+}
 
 
 /* List Macros */
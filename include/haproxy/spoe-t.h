@@ -45,6 +45,7 @@
 #define SPOE_FL_SND_FRAGMENTATION 0x00000008 /* Set when SPOE agent supports sending fragmented payload */
 #define SPOE_FL_RCV_FRAGMENTATION 0x00000010 /* Set when SPOE agent supports receiving fragmented payload */
 #define SPOE_FL_FORCE_SET_VAR     0x00000020 /* Set when SPOE agent will set all variables from agent (and not only known variables) */
+#define SPOE_FL_BATCHING          0x00000040 /* Set to let a single applet drain the sending queue of a thread at once */
 
 /* Flags set on the SPOE context */
 #define SPOE_CTX_FL_CLI_CONNECTED 0x00000001 /* Set after that on-client-session event was processed */
@@ -59,10 +60,17 @@
 #define SPOE_APPCTX_FL_PIPELINING    0x00000001 /* Set if pipelining is supported */
 #define SPOE_APPCTX_FL_ASYNC         0x00000002 /* Set if asynchronus frames is supported */
 #define SPOE_APPCTX_FL_FRAGMENTATION 0x00000004 /* Set if fragmentation is supported */
+#define SPOE_APPCTX_FL_WOKEN         0x00000008 /* Set if the idle applet was woken up to drain the sending queue */
 
 #define SPOE_APPCTX_ERR_NONE    0x00000000 /* no error yet, leave it to zero */
 #define SPOE_APPCTX_ERR_TOUT    0x00000001 /* SPOE applet timeout */
 
+/* Number of buckets of the SPOE time histograms. Bucket 0 counts times below
+ * 1ms, bucket N counts times in [2^(N-1), 2^N[ ms, and the last one counts all
+ * larger times.
+ */
+#define SPOE_HIST_BUCKETS 12
+
 /* Flags set on the SPOE frame */
 #define SPOE_FRM_FL_FIN         0x00000001
 #define SPOE_FRM_FL_ABRT        0x00000002
@@ -309,6 +317,7 @@ struct spoe_agent {
 		struct freq_ctr err_per_sec;    /* connection errors per second */
 
 		unsigned int    idles;          /* # of idle applets */
+		unsigned int    woken;          /* # of idle applets woken up to drain the sending queue, not running yet */
 		struct eb_root  idle_applets;   /* idle SPOE applets available to process data */
 		struct list     applets;        /* all SPOE applets for this agent */
 		struct list     sending_queue;  /* Queue of streams waiting to send data */
@@ -323,6 +332,8 @@ struct spoe_agent {
 		unsigned int nb_waiting;         /* # of streams waiting for a ack */
 		unsigned long long nb_processed; /* # of frames processed by the SPOE */
 		unsigned long long nb_errors;    /* # of errors during the processing */
+		unsigned long long t_process[SPOE_HIST_BUCKETS]; /* histogram of events/groups processing times */
+		unsigned long long t_queue[SPOE_HIST_BUCKETS];   /* histogram of times spent in the sending queue */
 	} counters;
 };
 
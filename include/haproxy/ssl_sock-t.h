@@ -49,6 +49,7 @@
 #define SSL_SOCK_ST_FL_16K_WBFSIZE  0x00000002
 #define SSL_SOCK_SEND_UNLIMITED     0x00000004
 #define SSL_SOCK_RECV_HEARTBEAT     0x00000008
+#define SSL_SOCK_ST_FL_ASYNC_WAIT   0x00000010  /* handshake paused waiting for an async engine */
 
 /* bits 0xFFFFFF00 are reserved to store verify errors.
  * The CA en CRT error codes will be stored on 7 bits each
@@ -166,8 +167,13 @@ struct tls_keys_ref {
 	int unique_id; /* Each pattern reference have unique id. */
 	int refcount;  /* number of users of this tls_keys_ref. */
 	union tls_sess_key *tlskeys;
+	int nb_keys;             /* number of keys in <tlskeys> */
 	int tls_ticket_enc_index;
 	int key_size_bits;
+	unsigned int rotate;     /* automatic rotation period in seconds, 0 if none */
+	long long epoch;         /* rotation period the keys were derived for, -1 if none */
+	unsigned char secret[sizeof(union tls_sess_key)]; /* secret the rotating keys are derived from */
+	int secret_len;
 	__decl_thread(HA_RWLOCK_T lock); /* lock used to protect the ref */
 };
 
@@ -248,6 +254,8 @@ struct ssl_sock_ctx {
 	unsigned long error_code;     /* last error code of the error stack */
 	struct buffer early_buf;      /* buffer to store the early data received */
 	int sent_early_data;          /* Amount of early data we sent so far */
+	uint64_t hs_start;            /* date the handshake started at, in ns */
+	uint64_t hs_cpu;              /* CPU time spent computing the handshake so far, in ns */
 
 #ifdef USE_QUIC
 	struct quic_conn *qc;
@@ -277,6 +285,7 @@ struct global_ssl {
 	struct tls_version_filter connect_default_sslmethods;
 
 	int private_cache; /* Force to use a private session cache even if nbproc > 1 */
+	int cache_shards;  /* number of shards of the shared session cache, 0=auto */
 	unsigned int life_time;   /* SSL session lifetime in seconds */
 	unsigned int max_record; /* SSL max record size */
 	unsigned int hard_max_record; /* SSL max record size hard limit */
@@ -295,5 +304,8 @@ extern const char *SSL_SOCK_KEYTYPE_NAMES[];
 
 #define SSL_SOCK_NUM_KEYTYPES 3
 
+/* maximum number of shards of the shared session cache */
+#define SSL_SOCK_MAX_CACHE_SHARDS 64
+
 #endif /* USE_OPENSSL */
 #endif /* _HAPROXY_SSL_SOCK_T_H */
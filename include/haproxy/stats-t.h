@@ -43,11 +43,14 @@
 #define STAT_HIDE_MAINT 0x00004000	/* hide maint/disabled servers */
 #define STAT_CONVDONE   0x00008000	/* conf: rules conversion done */
 #define STAT_USE_FLOAT  0x00010000      /* use floats where possible in the outputs */
+#define STAT_FMT_BIN    0x00020000      /* dump the stats in binary format */
+#define STAT_BIN_DELTA  0x00040000      /* binary format: only emit fields which changed */
+#define STAT_CHANGES    0x00080000      /* only dump what changed since ctx->since */
 
 #define STAT_BOUND      0x00800000	/* bound statistics to selected proxies/types/services */
 #define STAT_STARTED    0x01000000	/* some output has occurred */
 
-#define STAT_FMT_MASK   0x00000007
+#define STAT_FMT_MASK   0x00020007
 
 #define STATS_TYPE_FE  0
 #define STATS_TYPE_BE  1
@@ -532,6 +535,52 @@ enum stats_domain_px_cap {
 	STATS_PX_CAP_MASK = 0xff
 };
 
+/* Binary stats output ("show stat bin"). The output starts with a header made
+ * of STATS_BIN_MAGIC, a version byte, a flags byte (STATS_BIN_F_*), the domain
+ * and the number of fields as varints, the snapshot generation as a varint if
+ * STATS_BIN_F_GEN is set, followed by the name of each field as a varint
+ * length and the string. Then each line is sent as a record starting
+ * with STATS_BIN_REC_LINE, followed by the emitted fields, and terminated by a
+ * null varint. Each field starts with a varint holding the difference between
+ * its position and the previous field's position in the record (or -1),
+ * shifted left by one bit, the lowest bit being set when the field's type
+ * differs from the one last sent for this position. In this case a byte
+ * follows with the format (FF_*), and STATS_BIN_TAGS if the origin, nature and
+ * scope also differ, in which case they follow as 3 bytes. The value comes
+ * next: unsigned integers as varints, signed ones as zigzag-encoded varints,
+ * floats as 8 bytes in little endian order and strings as a varint length
+ * followed by the characters. Without STATS_BIN_F_DELTA, all non-empty fields
+ * are emitted. With it, only the fields whose type or value differ from the
+ * previous record are emitted. The output ends with STATS_BIN_REC_END. See
+ * dev/statbin/ for a decoder.
+ */
+#define STATS_BIN_MAGIC     "HSTB"
+#define STATS_BIN_VERSION   1
+#define STATS_BIN_F_DELTA   0x01   /* records only contain changed fields */
+#define STATS_BIN_F_GEN     0x02   /* the header contains the generation */
+#define STATS_BIN_TAGS      0x80   /* field format byte: tags follow */
+#define STATS_BIN_REC_END   0x00
+#define STATS_BIN_REC_LINE  0x01
+
+/* one field as known by the decoder of a binary stats dump */
+struct stats_bin_field {
+	uint32_t type;          /* FF_* | FO_* | FN_* | FS_* */
+	uint64_t val;           /* raw value, or hash of the string */
+};
+
+/* state of a binary stats dump. The decoder's view of the fields before the
+ * last record is in <prev>, and after it in <cur>. They are swapped when a
+ * record for another object than the one identified by <key1..3> is built,
+ * since it means the previous one was sent.
+ */
+struct stats_bin_ctx {
+	const void *key1, *key2;        /* obj1 and obj2 of the last record */
+	int key3;                       /* px_st of the last record */
+	int pending;                    /* the last record was successfully built */
+	struct stats_bin_field *prev;
+	struct stats_bin_field *cur;
+};
+
 /* the context of a "show stat" command in progress on the CLI or the stats applet */
 struct show_stat_ctx {
 	struct proxy *http_px;  /* parent proxy of the current applet (only relevant for HTTP applet) */
@@ -546,6 +595,8 @@ struct show_stat_ctx {
 	int iid, type, sid;	/* proxy id, type and service id if bounding of stats is enabled */
 	int st_code;		/* the status code returned by an action */
 	enum stat_state state;  /* phase of output production */
+	struct stats_bin_ctx *bin; /* binary output state, only for STAT_FMT_BIN */
+	unsigned int since;     /* generation for STAT_CHANGES */
 };
 
 extern THREAD_LOCAL void *trash_counters;
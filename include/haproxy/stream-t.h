@@ -208,6 +208,7 @@ struct stream {
 	int tunnel_timeout;
 	const char *last_rule_file;             /* last evaluated final rule's file (def: NULL) */
 	int last_rule_line;                     /* last evaluated final rule's line (def: 0) */
+	struct smp_memo *smp_memo;              /* per-stream sample cache, NULL until used */
 
 	unsigned int stream_epoch;              /* copy of stream_epoch when the stream was created */
 	struct hlua *hlua[2];                   /* lua runtime context (0: global, 1: per-thread) */
@@ -0,0 +1,55 @@
+-- loaded with "lua-load-per-thread", so this runs once in each thread's state
+local threads = core.shared_table("threads")
+local loaded = core.shared_counter("loaded")
+
+threads:set("thread" .. core.thread, core.thread)
+loaded:inc()
+
+-- the states of the threads after the first one load the bytecode dumped from
+-- the first one, which must keep the file name and the line numbers
+local info = debug.getinfo(1, "Sl")
+core.shared_table("sources"):set("thread" .. core.thread,
+	info.short_src:match("[^/]*$") .. ":" .. info.currentline)
+
+core.register_service("shared", "http", function(applet)
+	local data = core.shared_table("data")
+	local hits = core.shared_counter("hits")
+	local value = applet.headers["x-set"]
+	local dump = {}
+	local keys = {}
+	local sources = {}
+
+	if value then
+		data:set("key", value[0])
+	elseif applet.headers["x-del"] then
+		data:del("key")
+	end
+	data:set("num", 42)
+	data:set("flag", true)
+
+	for k, v in pairs(threads:dump()) do
+		keys[#keys + 1] = k .. "=" .. tostring(v)
+	end
+	table.sort(keys)
+
+	for k, v in pairs(core.shared_table("sources"):dump()) do
+		sources[#sources + 1] = k .. "=" .. v
+	end
+	table.sort(sources)
+
+	for k, v in pairs(data:dump()) do
+		dump[#dump + 1] = k .. "=" .. tostring(v)
+	end
+	table.sort(dump)
+
+	applet:set_status(200)
+	applet:add_header("x-loaded", loaded:get())
+	applet:add_header("x-threads", table.concat(keys, ","))
+	applet:add_header("x-sources", table.concat(sources, ","))
+	applet:add_header("x-hits", hits:inc())
+	applet:add_header("x-key", tostring(data:get("key")))
+	applet:add_header("x-data", table.concat(dump, ","))
+	applet:add_header("x-count", data:count())
+	applet:add_header("content-length", "0")
+	applet:start_response()
+end)
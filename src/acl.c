@@ -179,6 +179,7 @@ struct acl_expr *parse_acl_expr(const char **args, char **err, struct arg_list *
 			memprintf(err, "out of memory when parsing ACL expression");
 			goto out_return;
 		}
+		LIST_INIT(&smp->list);
 		LIST_INIT(&(smp->conv_exprs));
 		smp->fetch = aclkw->smp;
 		smp->arg_p = empty_arg_list;
@@ -309,6 +310,11 @@ struct acl_expr *parse_acl_expr(const char **args, char **err, struct arg_list *
 			}
 		}
 		ha_free(&ckw);
+
+		if (sample_expr_compile(smp, args[0], file, line) != 0) {
+			memprintf(err, "out of memory when parsing ACL expression");
+			goto out_free_smp;
+		}
 	}
 	else {
 		/* This is not an ACL keyword, so we hope this is a sample fetch
@@ -643,7 +649,7 @@ struct acl_expr *parse_acl_expr(const char **args, char **err, struct arg_list *
 	free(expr);
  out_free_smp:
 	free(ckw);
-	free(smp);
+	release_sample_expr(smp);
  out_return:
 	return NULL;
 }
@@ -10,6 +10,7 @@
  *
  */
 
+#include <import/ebsttree.h>
 #include <haproxy/acl.h>
 #include <haproxy/action.h>
 #include <haproxy/api.h>
@@ -302,10 +303,31 @@ struct act_rule *new_act_rule(enum act_from from, const char *file, int linenum)
 	return rule;
 }
 
+/* releases the dispatch table <dispatch>, which may be NULL */
+void free_act_rule_dispatch(struct act_rule_dispatch *dispatch)
+{
+	struct act_rule_dispatch_key *key;
+	struct ebmb_node *node;
+
+	if (!dispatch)
+		return;
+
+	while ((node = ebmb_first(&dispatch->keys))) {
+		key = ebmb_entry(node, struct act_rule_dispatch_key, node);
+		ebmb_delete(node);
+		free(key);
+	}
+	free(dispatch->rules);
+	free(dispatch->refs);
+	free(dispatch->revisions);
+	free(dispatch);
+}
+
 /* fees rule <rule> and its elements as well as the condition */
 void free_act_rule(struct act_rule *rule)
 {
 	LIST_DELETE(&rule->list);
+	free_act_rule_dispatch(rule->dispatch);
 	free_acl_cond(rule->cond);
 	if (rule->release_ptr)
 		rule->release_ptr(rule);
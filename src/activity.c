@@ -18,6 +18,8 @@
 #include <haproxy/channel.h>
 #include <haproxy/cli.h>
 #include <haproxy/freq_ctr.h>
+#include <haproxy/http_rules.h>
+#include <haproxy/sample.h>
 #include <haproxy/sc_strm.h>
 #include <haproxy/stconn.h>
 #include <haproxy/tools.h>
@@ -477,8 +479,48 @@ static int cli_parse_set_profiling(char **args, char *payload, struct appctx *ap
 #endif
 	}
 
+	if (strcmp(args[2], "samples") == 0) {
+		if (strcmp(args[3], "on") == 0) {
+			unsigned int old = profiling;
+
+			/* flush current profiling stats first */
+			sample_expr_prof_reset();
+			while (!_HA_ATOMIC_CAS(&profiling, &old, old | HA_PROF_SAMPLES))
+				;
+		}
+		else if (strcmp(args[3], "off") == 0) {
+			unsigned int old = profiling;
+
+			while (!_HA_ATOMIC_CAS(&profiling, &old, old & ~HA_PROF_SAMPLES))
+				;
+		}
+		else
+			return cli_err(appctx, "Expects either 'on' or 'off'.\n");
+		return 1;
+	}
+
+	if (strcmp(args[2], "rules") == 0) {
+		if (strcmp(args[3], "on") == 0) {
+			unsigned int old = profiling;
+
+			/* flush current profiling stats first */
+			http_rules_prof_reset();
+			while (!_HA_ATOMIC_CAS(&profiling, &old, old | HA_PROF_RULES))
+				;
+		}
+		else if (strcmp(args[3], "off") == 0) {
+			unsigned int old = profiling;
+
+			while (!_HA_ATOMIC_CAS(&profiling, &old, old & ~HA_PROF_RULES))
+				;
+		}
+		else
+			return cli_err(appctx, "Expects either 'on' or 'off'.\n");
+		return 1;
+	}
+
 	if (strcmp(args[2], "tasks") != 0)
-		return cli_err(appctx, "Expects either 'tasks' or 'memory'.\n");
+		return cli_err(appctx, "Expects either 'tasks', 'memory', 'samples' or 'rules'.\n");
 
 	if (strcmp(args[3], "on") == 0) {
 		unsigned int old = profiling;
@@ -644,8 +686,12 @@ static int cli_io_handler_show_profiling(struct appctx *appctx)
 
 	chunk_printf(&trash,
 	             "Per-task CPU profiling              : %-8s      # set profiling tasks {on|auto|off}\n"
-	             "Memory usage profiling              : %-8s      # set profiling memory {on|off}\n",
-	             str, (profiling & HA_PROF_MEMORY) ? "on" : "off");
+	             "Memory usage profiling              : %-8s      # set profiling memory {on|off}\n"
+	             "Sample expressions profiling        : %-8s      # set profiling samples {on|off}\n"
+	             "HTTP rules profiling                : %-8s      # set profiling rules {on|off}\n",
+	             str, (profiling & HA_PROF_MEMORY) ? "on" : "off",
+	             (profiling & HA_PROF_SAMPLES) ? "on" : "off",
+	             (profiling & HA_PROF_RULES) ? "on" : "off");
 
 	if (applet_putchk(appctx, &trash) == -1) {
 		/* failed, try again */
@@ -997,7 +1043,7 @@ INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
 
 /* register cli keywords */
 static struct cli_kw_list cli_kws = {{ },{
-	{ { "set",  "profiling", NULL }, "set profiling <what> {auto|on|off}      : enable/disable resource profiling (tasks,memory)", cli_parse_set_profiling,  NULL },
+	{ { "set",  "profiling", NULL }, "set profiling <what> {auto|on|off}      : enable/disable resource profiling (tasks,memory,samples,rules)", cli_parse_set_profiling,  NULL },
 	{ { "show", "profiling", NULL }, "show profiling [<what>|<#lines>|byaddr]*: show profiling state (all,status,tasks,memory)",   cli_parse_show_profiling, cli_io_handler_show_profiling, NULL },
 	{ { "show", "tasks", NULL },     "show tasks                              : show running tasks",                               NULL, cli_io_handler_show_tasks,     NULL },
 	{{},}
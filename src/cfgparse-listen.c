@@ -45,7 +45,7 @@ static const char *common_kw_list[] = {
 	"persist", "appsession", "load-server-state-from-file",
 	"server-state-file-name", "max-session-srv-conns", "capture",
 	"retries", "http-request", "http-response", "http-after-response",
-	"http-send-name-header", "block", "redirect", "use_backend",
+	"http-send-name-header", "block", "redirect", "use_backend", "use_backend_map",
 	"use-server", "force-persist", "ignore-persist", "force-persist",
 	"stick-table", "stick", "stats", "option", "default_backend",
 	"http-reuse", "monitor", "transparent", "maxconn", "backlog",
@@ -1433,6 +1433,92 @@ int cfg_parse_listen(const char *file, int linenum, char **args, int kwm)
 		LIST_INIT(&rule->list);
 		LIST_APPEND(&curproxy->switching_rules, &rule->list);
 	}
+	else if (strcmp(args[0], "use_backend_map") == 0) {
+		struct switching_rule *rule;
+		struct sample_expr *expr;
+		int myidx = 2;
+
+		if (curproxy->cap & PR_CAP_DEF) {
+			ha_alert("parsing [%s:%d] : '%s' not allowed in 'defaults' section.\n", file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+
+		if (warnifnotcap(curproxy, PR_CAP_FE, file, linenum, args[0], NULL))
+			err_code |= ERR_WARN;
+
+		if (!*args[1] || !*args[2]) {
+			ha_alert("parsing [%s:%d] : '%s' expects a map file name and a sample expression.\n", file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+
+		curproxy->conf.args.ctx = ARGC_UBK;
+		curproxy->conf.args.file = file;
+		curproxy->conf.args.line = linenum;
+		expr = sample_parse_expr(args, &myidx, file, linenum, &errmsg, &curproxy->conf.args, NULL);
+		if (!expr) {
+			ha_alert("parsing [%s:%d] : '%s': %s\n", file, linenum, args[0], errmsg);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+
+		if (!(expr->fetch->val & SMP_VAL_FE_SET_BCK)) {
+			ha_alert("parsing [%s:%d] : '%s': fetch method '%s' extracts information from '%s', none of which is available when selecting the backend.\n",
+				 file, linenum, args[0], expr->fetch->kw, sample_src_names(expr->fetch->use));
+			err_code |= ERR_ALERT | ERR_FATAL;
+			release_sample_expr(expr);
+			goto out;
+		}
+
+		/* check if we need to allocate an http_txn struct for HTTP parsing */
+		curproxy->http_needed |= !!(expr->fetch->use & SMP_USE_HTTP_ANY);
+
+		if (strcmp(args[myidx], "if") == 0 || strcmp(args[myidx], "unless") == 0) {
+			if ((cond = build_acl_cond(file, linenum, &curproxy->acl, curproxy, (const char **)args + myidx, &errmsg)) == NULL) {
+				ha_alert("parsing [%s:%d] : error detected while parsing switching rule : %s.\n",
+					 file, linenum, errmsg);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				release_sample_expr(expr);
+				goto out;
+			}
+
+			err_code |= warnif_cond_conflicts(cond, SMP_VAL_FE_SET_BCK, file, linenum);
+		}
+		else if (*args[myidx]) {
+			ha_alert("parsing [%s:%d] : unexpected keyword '%s' after switching rule, only 'if' and 'unless' are allowed.\n",
+				 file, linenum, args[myidx]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			release_sample_expr(expr);
+			goto out;
+		}
+
+		rule = calloc(1, sizeof(*rule));
+		if (!rule)
+			goto use_backend_map_alloc_error;
+		rule->cond = cond;
+		rule->dynamic = 2;
+		rule->map_key = expr;
+		/* the map is loaded once all backends are known */
+		rule->be.name = strdup(args[1]);
+		if (!rule->be.name)
+			goto use_backend_map_alloc_error;
+		rule->line = linenum;
+		rule->file = strdup(file);
+		if (!rule->file) {
+		  use_backend_map_alloc_error:
+			if (cond)
+				prune_acl_cond(cond);
+			ha_free(&cond);
+			if (rule)
+				ha_free(&(rule->be.name));
+			ha_free(&rule);
+			release_sample_expr(expr);
+			goto alloc_error;
+		}
+		LIST_INIT(&rule->list);
+		LIST_APPEND(&curproxy->switching_rules, &rule->list);
+	}
 	else if (strcmp(args[0], "use-server") == 0) {
 		struct server_rule *rule;
 
@@ -1648,7 +1734,7 @@ int cfg_parse_listen(const char *file, int linenum, char **args, int kwm)
 				ha_alert("parsing [%s:%d] : '%s': fetch method '%s' extracts information from '%s', none of which is available for 'store-response'.\n",
 					 file, linenum, args[0], expr->fetch->kw, sample_src_names(expr->fetch->use));
 		                err_code |= ERR_ALERT | ERR_FATAL;
-				free(expr);
+				release_sample_expr(expr);
 			        goto out;
 			}
 		} else {
@@ -1656,7 +1742,7 @@ int cfg_parse_listen(const char *file, int linenum, char **args, int kwm)
 				ha_alert("parsing [%s:%d] : '%s': fetch method '%s' extracts information from '%s', none of which is available during request.\n",
 					 file, linenum, args[0], expr->fetch->kw, sample_src_names(expr->fetch->use));
 				err_code |= ERR_ALERT | ERR_FATAL;
-				free(expr);
+				release_sample_expr(expr);
 				goto out;
 			}
 		}
@@ -1674,7 +1760,7 @@ int cfg_parse_listen(const char *file, int linenum, char **args, int kwm)
 				ha_alert("parsing [%s:%d] : '%s': error detected while parsing sticking condition : %s.\n",
 					 file, linenum, args[0], errmsg);
 				err_code |= ERR_ALERT | ERR_FATAL;
-				free(expr);
+				release_sample_expr(expr);
 				goto out;
 			}
 		}
@@ -1682,7 +1768,7 @@ int cfg_parse_listen(const char *file, int linenum, char **args, int kwm)
 			ha_alert("parsing [%s:%d] : '%s': unknown keyword '%s'.\n",
 				 file, linenum, args[0], args[myidx]);
 			err_code |= ERR_ALERT | ERR_FATAL;
-			free(expr);
+			release_sample_expr(expr);
 			goto out;
 		}
 		if (flags & STK_ON_RSP)
@@ -30,6 +30,8 @@ static int bind_parse_quic_cc_algo(char **args, int cur_arg, struct proxy *px,
 	    cc_algo = &quic_cc_algo_nr;
 	else if (!strcmp(args[cur_arg + 1], "cubic"))
 	    cc_algo = &quic_cc_algo_cubic;
+	else if (!strcmp(args[cur_arg + 1], "bbr"))
+	    cc_algo = &quic_cc_algo_bbr;
 	else {
 		memprintf(err, "'%s' : unknown control congestion algorithm", args[cur_arg]);
 		return ERR_ALERT | ERR_FATAL;
@@ -139,11 +141,32 @@ static int cfg_parse_quic_tune_setting(char **args, int section_type,
 	return 0;
 }
 
+/* parse "tune.quic.pacing" */
+static int cfg_parse_quic_pacing(char **args, int section_type,
+                                 struct proxy *curpx,
+                                 const struct proxy *defpx,
+                                 const char *file, int line, char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0)
+		global.tune.options |= GTUNE_QUIC_PACING;
+	else if (strcmp(args[1], "off") == 0)
+		global.tune.options &= ~GTUNE_QUIC_PACING;
+	else {
+		memprintf(err, "'%s' expects 'on' or 'off' but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+	return 0;
+}
+
 static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "tune.quic.backend.max-idle-timeou", cfg_parse_quic_time },
 	{ CFG_GLOBAL, "tune.quic.frontend.conn-tx-buffers.limit", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.frontend.max-streams-bidi", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.frontend.max-idle-timeout", cfg_parse_quic_time },
+	{ CFG_GLOBAL, "tune.quic.pacing", cfg_parse_quic_pacing },
 	{ CFG_GLOBAL, "tune.quic.reorder-ratio", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.retry-threshold", cfg_parse_quic_tune_setting },
 	{ 0, NULL, NULL }
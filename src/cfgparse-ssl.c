@@ -444,6 +444,33 @@ static int ssl_parse_global_private_cache(char **args, int section_type, struct
 	return 0;
 }
 
+/* parse "tune.ssl.cache-shards".
+ * Returns <0 on alert, >0 on warning, 0 on success.
+ */
+static int ssl_parse_global_cache_shards(char **args, int section_type, struct proxy *curpx,
+                                         const struct proxy *defpx, const char *file, int line,
+                                         char **err)
+{
+	int shards;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (*(args[1]) == 0) {
+		memprintf(err, "'%s' expects an integer argument.", args[0]);
+		return -1;
+	}
+
+	shards = atoi(args[1]);
+	if (shards <= 0 || shards > SSL_SOCK_MAX_CACHE_SHARDS || (shards & (shards - 1))) {
+		memprintf(err, "'%s' expects a power of two between 1 and %d.", args[0], SSL_SOCK_MAX_CACHE_SHARDS);
+		return -1;
+	}
+
+	global_ssl.cache_shards = shards;
+	return 0;
+}
+
 /* parse "ssl.lifetime".
  * Returns <0 on alert, >0 on warning, 0 on success.
  */
@@ -1163,6 +1190,58 @@ static int bind_parse_strict_sni(char **args, int cur_arg, struct proxy *px, str
 	return 0;
 }
 
+/* parse the "tls-ticket-rotate" bind keyword */
+static int bind_parse_tls_ticket_rotate(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
+{
+#if (defined SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB && TLS_TICKETS_NO > 0)
+	const char *res;
+
+	if (!*args[cur_arg + 1]) {
+		memprintf(err, "'%s' : missing rotation period", args[cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	res = parse_time_err(args[cur_arg + 1], &conf->tls_ticket_rotate, TIME_UNIT_S);
+	if (res == PARSE_TIME_OVER) {
+		memprintf(err, "timer overflow in argument '%s' to '%s' (maximum value is 2147483647 s or ~68 years).",
+		          args[cur_arg + 1], args[cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+	else if (res == PARSE_TIME_UNDER || (!res && !conf->tls_ticket_rotate)) {
+		memprintf(err, "'%s' : the rotation period must be at least 1 second.", args[cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+	else if (res) {
+		memprintf(err, "'%s' : unexpected character '%c' in rotation period.", args[cur_arg], *res);
+		return ERR_ALERT | ERR_FATAL;
+	}
+	return 0;
+#else
+	memprintf(err, "'%s' : TLS ticket callback extension not supported", args[cur_arg]);
+	return ERR_ALERT | ERR_FATAL;
+#endif /* SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB */
+}
+
+/* parse the "tls-ticket-history" bind keyword */
+static int bind_parse_tls_ticket_history(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
+{
+#if (defined SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB && TLS_TICKETS_NO > 0)
+	char *stop;
+	long count;
+
+	count = strtol(args[cur_arg + 1], &stop, 10);
+	if (!*args[cur_arg + 1] || *stop || count < 1 || count > 64) {
+		memprintf(err, "'%s' : expects a number of keys between 1 and 64", args[cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+	conf->tls_ticket_history = count;
+	return 0;
+#else
+	memprintf(err, "'%s' : TLS ticket callback extension not supported", args[cur_arg]);
+	return ERR_ALERT | ERR_FATAL;
+#endif /* SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB */
+}
+
 /* parse the "tls-ticket-keys" bind keyword */
 static int bind_parse_tls_ticket_keys(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
 {
@@ -1191,6 +1270,7 @@ static int bind_parse_tls_ticket_keys(char **args, int cur_arg, struct proxy *px
 	}
 
 	keys_ref->tlskeys = malloc(TLS_TICKETS_NO * sizeof(union tls_sess_key));
+	keys_ref->nb_keys = TLS_TICKETS_NO;
 	if (!keys_ref->tlskeys) {
 		memprintf(err, "'%s' : allocation error", args[cur_arg+1]);
 		goto fail;
@@ -1251,6 +1331,7 @@ static int bind_parse_tls_ticket_keys(char **args, int cur_arg, struct proxy *px
 	keys_ref->tls_ticket_enc_index = i < 0 ? 0 : i % TLS_TICKETS_NO;
 	keys_ref->unique_id = -1;
 	keys_ref->refcount = 1;
+	keys_ref->epoch = -1;
 	HA_RWLOCK_INIT(&keys_ref->lock);
 	conf->keys_ref = keys_ref;
 
@@ -1917,7 +1998,9 @@ static struct bind_kw_list bind_kws = { "SSL", { }, {
 	{ "ssl-min-ver",           bind_parse_tls_method_minmax,  1 }, /* minimum version */
 	{ "ssl-max-ver",           bind_parse_tls_method_minmax,  1 }, /* maximum version */
 	{ "strict-sni",            bind_parse_strict_sni,         0 }, /* refuse negotiation if sni doesn't match a certificate */
+	{ "tls-ticket-history",    bind_parse_tls_ticket_history, 1 }, /* number of previous rotating TLS ticket keys kept */
 	{ "tls-ticket-keys",       bind_parse_tls_ticket_keys,    1 }, /* set file to load TLS ticket keys from */
+	{ "tls-ticket-rotate",     bind_parse_tls_ticket_rotate,  1 }, /* automatically rotate TLS ticket keys */
 	{ "verify",                bind_parse_verify,             1 }, /* set SSL verify method */
 	{ "npn",                   bind_parse_npn,                1 }, /* set NPN supported protocols */
 	{ "prefer-client-ciphers", bind_parse_pcc,                0 }, /* prefer client ciphers */
@@ -1999,6 +2082,7 @@ static struct cfg_kw_list cfg_kws = {ILH, {
 #endif
 	{ CFG_GLOBAL, "ssl-skip-self-issued-ca", ssl_parse_skip_self_issued_ca },
 	{ CFG_GLOBAL, "tune.ssl.cachesize", ssl_parse_global_int },
+	{ CFG_GLOBAL, "tune.ssl.cache-shards", ssl_parse_global_cache_shards },
 #ifndef OPENSSL_NO_DH
 	{ CFG_GLOBAL, "tune.ssl.default-dh-param", ssl_parse_global_default_dh },
 #endif
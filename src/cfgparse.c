@@ -2918,6 +2918,23 @@ int check_config_validity()
 			struct logformat_node *node;
 			char *pxname;
 
+			if (rule->dynamic == 2) {
+				/* "use_backend_map": backends are resolved when loading the map */
+				err = NULL;
+				rule->map = proxy_load_backend_map(rule->be.name, rule->file, rule->line, &err);
+				if (!rule->map) {
+					ha_alert("Parsing [%s:%d]: failed to load the map of use_backend_map rule '%s' : %s.\n",
+						 rule->file, rule->line, rule->be.name, err);
+					free(err);
+					cfgerr++;
+					continue;
+				}
+				ha_free(&rule->be.name);
+				rule->be.backend = NULL;
+				err_code |= warnif_tcp_http_cond(curproxy, rule->cond);
+				continue;
+			}
+
 			/* Try to parse the string as a log format expression. If the result
 			 * of the parsing is only one entry containing a simple string, then
 			 * it's a standard string corresponding to a static rule, thus the
@@ -3252,7 +3269,7 @@ int check_config_validity()
 			curproxy->conf.args.line = curproxy->conf.lfs_line;
 			err = NULL;
 			if (!parse_logformat_string(curproxy->conf.logformat_string, curproxy, &curproxy->logformat,
-			                            LOG_OPT_MANDATORY|LOG_OPT_MERGE_SPACES,
+			                            LOG_OPT_MANDATORY|LOG_OPT_MERGE_SPACES|LOG_OPT_BIN_OK,
 			                            SMP_VAL_FE_LOG_END, &err)) {
 				ha_alert("Parsing [%s:%d]: failed to parse log-format : %s.\n",
 					 curproxy->conf.lfs_file, curproxy->conf.lfs_line, err);
@@ -3313,7 +3330,7 @@ int check_config_validity()
 			curproxy->conf.args.line = curproxy->conf.elfs_line;
 			err = NULL;
 			if (!parse_logformat_string(curproxy->conf.error_logformat_string, curproxy, &curproxy->logformat_error,
-			                            LOG_OPT_MANDATORY|LOG_OPT_MERGE_SPACES,
+			                            LOG_OPT_MANDATORY|LOG_OPT_MERGE_SPACES|LOG_OPT_BIN_OK,
 			                            SMP_VAL_FE_LOG_END, &err)) {
 				ha_alert("Parsing [%s:%d]: failed to parse error-log-format : %s.\n",
 					 curproxy->conf.elfs_file, curproxy->conf.elfs_line, err);
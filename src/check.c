@@ -28,6 +28,8 @@
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 
+#include <import/ebmbtree.h>
+
 #include <haproxy/action.h>
 #include <haproxy/api.h>
 #include <haproxy/arg.h>
@@ -143,6 +145,16 @@ INITCALL1(STG_REGISTER, trace_register_source, TRACE_SOURCE);
 /* Dummy frontend used to create all checks sessions. */
 struct proxy checks_fe;
 
+/* health checks scheduling modes, set by "check-scheduler" */
+enum {
+	CHK_SCHED_DEFAULT = 0,  /* shared tasks, optionally randomly spread */
+	CHK_SCHED_WHEEL,        /* fixed slots evenly spread over time and threads */
+};
+
+static int check_scheduler = CHK_SCHED_DEFAULT;
+static unsigned int check_wheel_origin;  /* date the wheel slots are computed from */
+static unsigned int check_wheel_thr;     /* next thread to assign a check to */
+
 
 static inline void check_trace_buf(const struct buffer *buf, size_t ofs, size_t len)
 {
@@ -658,9 +670,29 @@ void __health_adjust(struct server *s, short status)
 	if (!failed) {
 		/* good: clear consecutive_errors */
 		s->consecutive_errors = 0;
+		/* only touch the shared date once per millisecond */
+		if (s->check.adaptive_inter && s->passive_ok_date != now_ms)
+			s->passive_ok_date = now_ms;
 		return;
 	}
 
+	if (s->check.adaptive_inter) {
+		/* live traffic doesn't prove the server healthy anymore, get
+		 * back to the configured interval right now.
+		 */
+		s->passive_err_date = now_ms;
+		if (s->check.adapt_inter) {
+			HA_SPIN_LOCK(SERVER_LOCK, &s->lock);
+			s->check.adapt_inter = 0;
+			s->check.adapt_rtime = 0;
+			HA_SPIN_UNLOCK(SERVER_LOCK, &s->lock);
+
+			expire = tick_add(now_ms, MS_TO_TICKS(s->check.inter));
+			if (tick_is_lt(expire, s->check.task->expire))
+				task_schedule(s->check.task, expire);
+		}
+	}
+
 	_HA_ATOMIC_INC(&s->consecutive_errors);
 
 	if (s->consecutive_errors < s->consecutive_errors_limit)
@@ -719,6 +751,48 @@ void __health_adjust(struct server *s, short status)
 	}
 }
 
+/* Updates the adaptive interval of the main check <check> of a server which
+ * just completed. As long as the check passes, the server is fully up, live
+ * traffic reported successes and no error since the previous evaluation, and
+ * the live traffic's response time did not more than double since backing off
+ * started, the interval is doubled up to "adaptive-inter". Otherwise it gets
+ * back to "inter". Must be called with the server lock held.
+ */
+static void check_update_adaptive_inter(struct check *check)
+{
+	struct server *s = check->server;
+	unsigned int rtime;
+	int healthy, inter;
+
+	if (!check->adaptive_inter || check != &s->check)
+		return;
+
+	rtime = swrate_avg(s->counters.c_time, TIME_STATS_SAMPLES) +
+		swrate_avg(s->counters.d_time, TIME_STATS_SAMPLES);
+
+	healthy = check->result == CHK_RES_PASSED &&
+		check->health == check->rise + check->fall - 1 &&
+		tick_isset(check->adapt_date) &&
+		tick_isset(s->passive_ok_date) &&
+		!tick_is_lt(s->passive_ok_date, check->adapt_date) &&
+		(!tick_isset(s->passive_err_date) || tick_is_lt(s->passive_err_date, check->adapt_date)) &&
+		(!check->adapt_rtime || rtime <= 2 * check->adapt_rtime);
+
+	if (healthy) {
+		if (!check->adapt_rtime)
+			check->adapt_rtime = rtime ? rtime : 1;
+		inter = (check->adapt_inter ? check->adapt_inter : check->inter) * 2;
+		if (inter > check->adaptive_inter)
+			inter = check->adaptive_inter;
+		check->adapt_inter = inter;
+	}
+	else {
+		check->adapt_inter = 0;
+		check->adapt_rtime = 0;
+	}
+	check->adapt_date = now_ms;
+}
+
 /* Checks the connection. If an error has already been reported or the socket is
  * closed, keep errno intact as it is supposed to contain the valid error code.
  * If no error is reported, check the socket's error queue using getsockopt().
@@ -1075,6 +1149,93 @@ struct task *srv_chk_io_cb(struct task *t, void *ctx, unsigned int state)
 	return NULL;
 }
 
+/* Returns the next date at which check <check> must run according to the
+ * "wheel" scheduler: its slot in the current interval, or in the next one if
+ * it is already past. Slots are fixed so that checks never drift towards each
+ * other whatever their duration.
+ */
+static inline int check_wheel_next_date(const struct check *check)
+{
+	int inter = MS_TO_TICKS(srv_getinter(check));
+	int phase = ((unsigned long long)inter * check->wheel_pos) >> 32;
+	int ofs;
+
+	ofs = (int)(now_ms - check_wheel_origin - phase) % inter;
+	if (ofs < 0)
+		ofs += inter;
+	return tick_add(now_ms, inter - ofs);
+}
+
+/* Returns non-zero if check <check> is enabled, not paused and attached to a
+ * running proxy, i.e. if it is expected to periodically produce results.
+ */
+static inline int check_is_running(const struct check *check)
+{
+	return (check->state & (CHK_ST_ENABLED | CHK_ST_PAUSED | CHK_ST_PURGE)) == CHK_ST_ENABLED &&
+		!(check->proxy->flags & (PR_FL_DISABLED|PR_FL_STOPPED));
+}
+
+/* Saves the result of the check <check> which just completed into its shared
+ * area and wakes up the checks coalesced with it so that they apply it. Must
+ * be called with the server lock held.
+ */
+static void check_publish_result(struct check *check)
+{
+	struct check_shared *shared = check->shared;
+	struct check *follower;
+
+	if (check->result != CHK_RES_FAILED && check->result != CHK_RES_PASSED &&
+	    check->result != CHK_RES_CONDPASS)
+		return;
+
+	shared->status   = check->status;
+	shared->code     = check->code;
+	shared->duration = check->duration;
+	memcpy(shared->desc, check->desc, sizeof(shared->desc));
+	shared->seq++;
+
+	list_for_each_entry(follower, &shared->followers, coalesce_list)
+		task_wakeup(follower->task, TASK_WOKEN_MSG);
+}
+
+/* Applies to the coalesced check <check> the last result of its leader, if it
+ * was not already done, exactly as if it had been produced by this check.
+ * Must be called with the check's server lock held, the leader's one will be
+ * taken.
+ */
+static void check_apply_leader_result(struct check *check)
+{
+	struct check *leader = check->leader;
+	char desc[HCHK_DESC_LEN];
+	short status, code;
+	long duration;
+
+	HA_SPIN_LOCK(SERVER_LOCK, &leader->server->lock);
+	if (check->shared_seq == leader->shared->seq) {
+		HA_SPIN_UNLOCK(SERVER_LOCK, &leader->server->lock);
+		return;
+	}
+	check->shared_seq = leader->shared->seq;
+	status   = leader->shared->status;
+	code     = leader->shared->code;
+	duration = leader->shared->duration;
+	memcpy(desc, leader->shared->desc, sizeof(desc));
+	HA_SPIN_UNLOCK(SERVER_LOCK, &leader->server->lock);
+
+	activity[tid].chk_coalesced++;
+	set_server_check_status(check, HCHK_STATUS_START, NULL);
+	check->code = code;
+	set_server_check_status(check, status, desc);
+	check->duration = duration;
+
+	if (check->result == CHK_RES_FAILED)
+		check_notify_failure(check);
+	else if (check->result == CHK_RES_CONDPASS)
+		check_notify_stopping(check);
+	else if (check->result == CHK_RES_PASSED)
+		check_notify_success(check);
+}
+
 /* manages a server health-check that uses a connection. Returns
  * the time the task accepts to wait, or TIME_ETERNITY for infinity.
  *
@@ -1099,7 +1260,18 @@ struct task *process_chk_conn(struct task *t, void *context, unsigned int state)
 		TRACE_STATE("health-check state to purge", CHK_EV_TASK_WAKE, check);
 	}
 	else if (!(check->state & (CHK_ST_INPROGRESS))) {
-		/* no check currently running */
+		/* no check currently running. A coalesced check only applies
+		 * the results of its leader as long as this one runs, and is
+		 * woken up by it. It performs its own checks again otherwise.
+		 */
+		if (check->leader && check_is_running(check->leader)) {
+			if ((check->state & (CHK_ST_ENABLED | CHK_ST_PAUSED)) == CHK_ST_ENABLED &&
+			    !(proxy->flags & (PR_FL_DISABLED|PR_FL_STOPPED)))
+				check_apply_leader_result(check);
+			t->expire = tick_add(now_ms, MS_TO_TICKS(2 * srv_getinter(check)));
+			goto out_unlock;
+		}
+
 		if (!expired) /* woke up too early */ {
 			TRACE_STATE("health-check wake up too early", CHK_EV_TASK_WAKE, check);
 			goto out_unlock;
@@ -1117,6 +1289,7 @@ struct task *process_chk_conn(struct task *t, void *context, unsigned int state)
 
 		/* we'll initiate a new check */
 		set_server_check_status(check, HCHK_STATUS_START, NULL);
+		activity[tid].checks++;
 
 		check->state |= CHK_ST_INPROGRESS;
 		TRACE_STATE("init new health-check", CHK_EV_TASK_WAKE|CHK_EV_HCHK_START, check);
@@ -1214,17 +1387,25 @@ struct task *process_chk_conn(struct task *t, void *context, unsigned int state)
 			TRACE_DEVEL("report success", CHK_EV_TASK_WAKE|CHK_EV_HCHK_END|CHK_EV_HCHK_SUCC, check);
 			check_notify_success(check);
 		}
+
+		check_update_adaptive_inter(check);
+		if (check->shared)
+			check_publish_result(check);
 	}
 
         if (LIST_INLIST(&check->buf_wait.list))
                 LIST_DEL_INIT(&check->buf_wait.list);
 
-	task_set_affinity(t, MAX_THREADS_MASK);
+	/* checks scheduled by the wheel stay on their own thread */
+	if (check_scheduler != CHK_SCHED_WHEEL)
+		task_set_affinity(t, MAX_THREADS_MASK);
 	check_release_buf(check, &check->bi);
 	check_release_buf(check, &check->bo);
 	check->state &= ~(CHK_ST_INPROGRESS|CHK_ST_IN_ALLOC|CHK_ST_OUT_ALLOC);
 
-	if (check->server) {
+	if (check->server && check_scheduler == CHK_SCHED_WHEEL)
+		t->expire = check_wheel_next_date(check);
+	else if (check->server) {
 		rv = 0;
 		if (global.spread_checks > 0) {
 			rv = srv_getinter(check) * global.spread_checks / 100;
@@ -1343,6 +1524,7 @@ void free_check(struct check *check)
 	}
 
 	task_destroy(check->task);
+	ha_free(&check->shared);
 
 	check_release_buf(check, &check->bi);
 	check_release_buf(check, &check->bo);
@@ -1384,7 +1566,9 @@ int start_check_task(struct check *check, int mininter,
 	struct task *t;
 	ulong boottime = tv_ms_remain(&start_date, &ready_date);
 
-	/* task for the check. Process-based checks exclusively run on thread 1. */
+	/* task for the check. Process-based checks exclusively run on thread 1.
+	 * The wheel scheduler assigns the other ones to threads in turn.
+	 */
 	if (check->type == PR_O2_EXT_CHK)
 		t = task_new_on(0);
 	else
@@ -1393,10 +1577,27 @@ int start_check_task(struct check *check, int mininter,
 	if (!t)
 		goto fail_alloc_task;
 
+	/* the task remains in the shared wait queue so that any thread may
+	 * still reschedule it (e.g. on observed errors).
+	 */
+	if (check->type != PR_O2_EXT_CHK && check_scheduler == CHK_SCHED_WHEEL)
+		task_set_affinity(t, 1UL << (HA_ATOMIC_FETCH_ADD(&check_wheel_thr, 1) % global.nbthread));
+
 	check->task = t;
 	t->process = process_chk;
 	t->context = check;
 
+	if (check_scheduler == CHK_SCHED_WHEEL) {
+		/* each check gets its own slot in its interval, checks being
+		 * evenly spread over the whole interval.
+		 */
+		check->wheel_pos = ((unsigned long long)srvpos << 32) / nbcheck;
+		t->expire = tick_add(check_wheel_next_date(check), MS_TO_TICKS(boottime));
+		check->start = now;
+		task_queue(t);
+		return 1;
+	}
+
 	if (mininter < srv_getinter(check))
 		mininter = srv_getinter(check);
 
@@ -1424,6 +1625,132 @@ int start_check_task(struct check *check, int mininter,
 	return 0;
 }
 
+static int srv_check_healthcheck_port(struct check *chk);
+
+/* Identifies the checks which may be coalesced: they must target the same
+ * address and port, run the same ruleset over the same transport and mux,
+ * from the same namespace, at the same pace. The whole struct is used as the
+ * tree key so it must be zeroed before being filled.
+ */
+struct check_coalesce_key {
+	struct sockaddr_storage addr;
+	const void *rules;
+	const void *xprt;
+	const void *mux_proto;
+	const void *netns;
+	int inter, fastinter, downinter;
+};
+
+struct check_coalesce_node {
+	struct check *leader;
+	struct ebmb_node node;         /* key is a struct check_coalesce_key */
+};
+
+/* Returns non-zero if the main check of server <s> is eligible to coalescing,
+ * i.e. if it only depends on settings covered by struct check_coalesce_key.
+ * Servers whose address may change at runtime, checks using per-server
+ * settings (SNI, ALPN, SSL, PROXY protocol, source) or external checks are
+ * excluded.
+ */
+static int check_may_coalesce(const struct server *s)
+{
+	const struct check *check = &s->check;
+	const struct proxy *px = s->proxy;
+
+	if (!(check->state & CHK_ST_CONFIGURED) || check->type == PR_O2_EXT_CHK)
+		return 0;
+	if (px->flags & PR_FL_DISABLED)
+		return 0;
+	if ((s->flags & (SRV_F_DYNAMIC|SRV_F_MAPPORTS)) || s->hostname || s->resolvers_id)
+		return 0;
+	if (check->sni || check->alpn_str || check->send_proxy || check->via_socks4 || check->adaptive_inter)
+		return 0;
+	if (check->use_ssl > 0 || (!check->use_ssl && s->use_ssl > 0))
+		return 0;
+	if (s->conn_src.opts || px->conn_src.opts || (px->options2 & PR_O2_CHK_SNDST))
+		return 0;
+	if (!check->tcpcheck_rules || !LIST_ISEMPTY(&check->tcpcheck_rules->preset_vars))
+		return 0;
+	return 1;
+}
+
+/* Coalesces the identical main checks of all servers: the first server found
+ * for a given key becomes the leader and the other ones its followers, which
+ * will not perform any I/O as long as the leader runs and will apply its
+ * results instead. Only used by the "wheel" scheduler. Returns 0 on success
+ * or -1 on memory allocation failure.
+ */
+static int check_coalesce_all()
+{
+	struct eb_root root = EB_ROOT_UNIQUE;
+	struct check_coalesce_node *cn;
+	struct check_coalesce_key key;
+	struct ebmb_node *node;
+	struct proxy *px;
+	struct server *s;
+	int ret = 0;
+
+	for (px = proxies_list; px; px = px->next) {
+		for (s = px->srv; s; s = s->next) {
+			struct check *check = &s->check;
+
+			if (!check_may_coalesce(s))
+				continue;
+
+			memset(&key, 0, sizeof(key));
+			if (is_addr(&check->addr))
+				key.addr = check->addr;
+			else
+				key.addr = s->addr;
+			set_host_port(&key.addr, srv_check_healthcheck_port(check));
+			key.rules     = check->tcpcheck_rules->list;
+			key.xprt      = check->xprt;
+			key.mux_proto = check->mux_proto;
+			key.netns     = s->netns;
+			key.inter     = check->inter;
+			key.fastinter = check->fastinter;
+			key.downinter = check->downinter;
+
+			node = ebmb_lookup(&root, &key, sizeof(key));
+			if (!node) {
+				cn = calloc(1, sizeof(*cn) + sizeof(key));
+				if (!cn) {
+					ret = -1;
+					goto end;
+				}
+				cn->leader = check;
+				memcpy(cn->node.key, &key, sizeof(key));
+				ebmb_insert(&root, &cn->node, sizeof(key));
+				continue;
+			}
+
+			cn = ebmb_entry(node, struct check_coalesce_node, node);
+			if (!cn->leader->shared) {
+				cn->leader->shared = calloc(1, sizeof(*cn->leader->shared));
+				if (!cn->leader->shared) {
+					ret = -1;
+					goto end;
+				}
+				LIST_INIT(&cn->leader->shared->followers);
+			}
+
+			check->leader = cn->leader;
+			LIST_APPEND(&cn->leader->shared->followers, &check->coalesce_list);
+
+			/* neither may disappear while they are linked together */
+			s->flags |= SRV_F_NON_PURGEABLE;
+			cn->leader->server->flags |= SRV_F_NON_PURGEABLE;
+		}
+	}
+
+ end:
+	while ((node = ebmb_first(&root))) {
+		ebmb_delete(node);
+		free(ebmb_entry(node, struct check_coalesce_node, node));
+	}
+	return ret;
+}
+
 /*
  * Start health-check.
  * Returns 0 if OK, ERR_FATAL on error, and prints the error in this case.
@@ -1445,6 +1772,17 @@ static int start_checks()
 	checks_fe.options2 |= PR_O2_INDEPSTR | PR_O2_SMARTCON | PR_O2_SMARTACC;
 	checks_fe.timeout.client = TICK_ETERNITY;
 
+	/* the wheel scheduler merges identical checks first so that only the
+	 * leaders are counted and started.
+	 */
+	if (check_scheduler == CHK_SCHED_WHEEL) {
+		check_wheel_origin = now_ms;
+		if (check_coalesce_all() != 0) {
+			ha_alert("Starting checks: out of memory.\n");
+			return ERR_ALERT | ERR_FATAL;
+		}
+	}
+
 	/* 1- count the checkers to run simultaneously.
 	 * We also determine the minimum interval among all of those which
 	 * have an interval larger than SRV_CHK_INTER_THRES. This interval
@@ -1454,7 +1792,10 @@ static int start_checks()
 	 */
 	for (px = proxies_list; px; px = px->next) {
 		for (s = px->srv; s; s = s->next) {
-			if (s->check.state & CHK_ST_CONFIGURED) {
+			if (s->check.leader) {
+				/* coalesced, doesn't take a slot */
+			}
+			else if (s->check.state & CHK_ST_CONFIGURED) {
 				nbcheck++;
 				if ((srv_getinter(&s->check) >= SRV_CHK_INTER_THRES) &&
 				    (!mininter || mininter > srv_getinter(&s->check)))
@@ -1497,7 +1838,8 @@ static int start_checks()
 				}
 				if (!start_check_task(&s->check, mininter, nbcheck, srvpos))
 					return ERR_ALERT | ERR_FATAL;
-				srvpos++;
+				if (!s->check.leader)
+					srvpos++;
 			}
 
 			/* A task for a auxiliary agent check */
@@ -1564,6 +1906,12 @@ int init_srv_check(struct server *srv)
 
 	check_type = srv->check.tcpcheck_rules->flags & TCPCHK_RULES_PROTO_CHK;
 
+	if (srv->check.adaptive_inter && !srv->observe) {
+		ha_warning("config: %s '%s': server '%s': 'adaptive-inter' has no effect without 'observe'.\n",
+			   proxy_type_str(srv->proxy), srv->proxy->id, srv->id);
+		ret |= ERR_WARN;
+	}
+
 	if (!(srv->flags & SRV_F_DYNAMIC)) {
 		/* If neither a port nor an addr was specified and no check
 		 * transport layer is forced, then the transport layer used by
@@ -2221,6 +2569,50 @@ static int srv_parse_check_inter(char **args, int *cur_arg, struct proxy *curpx,
 }
 
 
+/* Parse the "adaptive-inter" server keyword */
+static int srv_parse_check_adaptive_inter(char **args, int *cur_arg, struct proxy *curpx, struct server *srv,
+					  char **errmsg)
+{
+	const char *err = NULL;
+	unsigned int delay;
+	int err_code = 0;
+
+	if (!*(args[*cur_arg+1])) {
+		memprintf(errmsg, "'%s' expects a delay as argument.", args[*cur_arg]);
+		goto error;
+	}
+
+	err = parse_time_err(args[*cur_arg+1], &delay, TIME_UNIT_MS);
+	if (err == PARSE_TIME_OVER) {
+		memprintf(errmsg, "timer overflow in argument <%s> to <%s> of server %s, maximum value is 2147483647 ms (~24.8 days).",
+			  args[*cur_arg+1], args[*cur_arg], srv->id);
+		goto error;
+	}
+	else if (err == PARSE_TIME_UNDER) {
+		memprintf(errmsg, "timer underflow in argument <%s> to <%s> of server %s, minimum non-null value is 1 ms.",
+			  args[*cur_arg+1], args[*cur_arg], srv->id);
+		goto error;
+	}
+	else if (err) {
+		memprintf(errmsg, "unexpected character '%c' in '%s' argument of server %s.",
+			  *err, args[*cur_arg], srv->id);
+		goto error;
+	}
+	if (delay <= 0) {
+		memprintf(errmsg, "invalid value %d for argument '%s' of server %s.",
+			  delay, args[*cur_arg], srv->id);
+		goto error;
+	}
+	srv->check.adaptive_inter = delay;
+
+  out:
+	return err_code;
+
+  error:
+	err_code |= ERR_ALERT | ERR_FATAL;
+	goto out;
+}
+
 /* Parse the "fastinter" server keyword */
 static int srv_parse_check_fastinter(char **args, int *cur_arg, struct proxy *curpx, struct server *srv,
 				     char **errmsg)
@@ -2343,6 +2735,7 @@ static int srv_parse_check_port(char **args, int *cur_arg, struct proxy *curpx,
 
 static struct srv_kw_list srv_kws = { "CHK", { }, {
 	{ "addr",                srv_parse_addr,                1,  1,  1 }, /* IP address to send health to or to probe from agent-check */
+	{ "adaptive-inter",      srv_parse_check_adaptive_inter, 1, 1,  1 }, /* Set the max interval for health checks while live traffic is healthy */
 	{ "agent-addr",          srv_parse_agent_addr,          1,  1,  1 }, /* Enable an auxiliary agent check */
 	{ "agent-check",         srv_parse_agent_check,         0,  1,  1 }, /* Enable agent checks */
 	{ "agent-inter",         srv_parse_agent_inter,         1,  1,  1 }, /* Set the interval between two agent checks */
@@ -2366,6 +2759,32 @@ static struct srv_kw_list srv_kws = { "CHK", { }, {
 
 INITCALL1(STG_REGISTER, srv_register_keywords, &srv_kws);
 
+/* config parser for global "check-scheduler" */
+static int check_parse_global_scheduler(char **args, int section_type, struct proxy *curpx,
+                                        const struct proxy *defpx, const char *file, int line,
+                                        char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "default") == 0)
+		check_scheduler = CHK_SCHED_DEFAULT;
+	else if (strcmp(args[1], "wheel") == 0)
+		check_scheduler = CHK_SCHED_WHEEL;
+	else {
+		memprintf(err, "'%s' expects either 'default' or 'wheel' but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+	return 0;
+}
+
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "check-scheduler", check_parse_global_scheduler },
+	{ 0, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
 /*
  * Local variables:
  *  c-indent-level: 8
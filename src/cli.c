@@ -1553,6 +1553,10 @@ static int cli_io_handler_show_activity(struct appctx *appctx)
 	chunk_appendf(&trash, "stream_calls:"); SHOW_TOT(thr, activity[thr].stream_calls);
 	chunk_appendf(&trash, "pool_fail:");    SHOW_TOT(thr, activity[thr].pool_fail);
 	chunk_appendf(&trash, "buf_wait:");     SHOW_TOT(thr, activity[thr].buf_wait);
+	chunk_appendf(&trash, "checks:");       SHOW_TOT(thr, activity[thr].checks);
+	chunk_appendf(&trash, "chk_coalesced:"); SHOW_TOT(thr, activity[thr].chk_coalesced);
+	chunk_appendf(&trash, "smp_memo_hit:");  SHOW_TOT(thr, activity[thr].smp_memo_hit);
+	chunk_appendf(&trash, "smp_memo_miss:"); SHOW_TOT(thr, activity[thr].smp_memo_miss);
 	chunk_appendf(&trash, "cpust_ms_tot:"); SHOW_TOT(thr, activity[thr].cpust_total / 2);
 	chunk_appendf(&trash, "cpust_ms_1s:");  SHOW_TOT(thr, read_freq_ctr(&activity[thr].cpust_1s) / 2);
 	chunk_appendf(&trash, "cpust_ms_15s:"); SHOW_TOT(thr, read_freq_ctr_period(&activity[thr].cpust_15s, 15000) / 2);
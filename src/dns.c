@@ -127,19 +127,31 @@ int dns_send_nameserver(struct dns_nameserver *ns, void *buf, size_t len)
 		ns->counters->sent++;
 		HA_SPIN_UNLOCK(DNS_LOCK, &dgram->lock);
 	}
-	else if (ns->stream) {
-		struct ist myist;
+	else if (ns->stream)
+		ret = dns_send_nameserver_stream(ns, buf, len);
 
-		myist = ist2(buf, len);
-                ret = ring_write(ns->stream->ring_req, DNS_TCP_MSG_MAX_SIZE, NULL, 0, &myist, 1);
-		if (!ret) {
-			ns->counters->snd_error++;
-			return -1;
-		}
-		task_wakeup(ns->stream->task_req, TASK_WOKEN_MSG);
-		return ret;
-	}
+	return ret;
+}
 
+/* Sends a message to a name server over its stream transport, even if it also
+ * has a datagram one, which is used to retry truncated responses over TCP.
+ * It returns the same values as dns_send_nameserver().
+ */
+int dns_send_nameserver_stream(struct dns_nameserver *ns, void *buf, size_t len)
+{
+	struct ist myist;
+	int ret;
+
+	if (!ns->stream)
+		return -1;
+
+	myist = ist2(buf, len);
+	ret = ring_write(ns->stream->ring_req, DNS_TCP_MSG_MAX_SIZE, NULL, 0, &myist, 1);
+	if (!ret) {
+		ns->counters->snd_error++;
+		return -1;
+	}
+	task_wakeup(ns->stream->task_req, TASK_WOKEN_MSG);
 	return ret;
 }
 
@@ -178,7 +190,21 @@ ssize_t dns_recv_nameserver(struct dns_nameserver *ns, void *data, size_t size)
 		}
 		HA_SPIN_UNLOCK(DNS_LOCK, &dgram->lock);
 	}
-	else if (ns->stream) {
+	else if (ns->stream)
+		ret = dns_recv_nameserver_stream(ns, data, size);
+
+	return ret;
+}
+
+/* Receives a dns message from the stream transport of a name server, even if
+ * it also has a datagram one, which delivers the responses to queries retried
+ * over TCP. It returns the same values as dns_recv_nameserver().
+ */
+ssize_t dns_recv_nameserver_stream(struct dns_nameserver *ns, void *data, size_t size)
+{
+	ssize_t ret = -1;
+
+	if (ns->stream) {
 		struct dns_stream_server *dss = ns->stream;
 		struct dns_session *ds;
 
@@ -19,6 +19,7 @@
 #include <haproxy/arg.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/check.h>
+#include <haproxy/cli.h>
 #include <haproxy/filters.h>
 #include <haproxy/freq_ctr.h>
 #include <haproxy/frontend.h>
@@ -260,6 +261,20 @@ generate_pseudo_uuid()
 }
 
 
+/* Accounts time <t> in milliseconds in histogram <hist>, ignoring unset times */
+static inline void
+spoe_update_stat_hist(unsigned long long *hist, long t)
+{
+	int bucket;
+
+	if (t < 0)
+		return;
+	bucket = t ? my_flsl(t) : 0;
+	if (bucket >= SPOE_HIST_BUCKETS)
+		bucket = SPOE_HIST_BUCKETS - 1;
+	_HA_ATOMIC_INC(&hist[bucket]);
+}
+
 static inline void
 spoe_update_stat_time(struct timeval *tv, long *t)
 {
@@ -1301,6 +1316,10 @@ spoe_release_appctx(struct appctx *appctx)
 			_HA_ATOMIC_DEC(&agent->counters.idles);
 			agent->rt[tid].idles--;
 		}
+		if (spoe_appctx->flags & SPOE_APPCTX_FL_WOKEN) {
+			spoe_appctx->flags &= ~SPOE_APPCTX_FL_WOKEN;
+			agent->rt[tid].woken--;
+		}
 
 		appctx->st0 = SPOE_APPCTX_ST_END;
 		if (spoe_appctx->status_code == SPOE_FRM_ERR_NONE)
@@ -1721,6 +1740,33 @@ spoe_handle_receiving_frame_appctx(struct appctx *appctx, int *skip)
 	return ret;
 }
 
+/* Wakes up the least loaded idle applet of the current thread, if any. In
+ * batching mode, the applet is marked as woken so that no other one is woken
+ * up for the same sending queue until it runs. Returns 1 if an applet was
+ * woken up, otherwise 0.
+ */
+static int
+spoe_wakeup_idle_appctx(struct spoe_agent *agent)
+{
+	struct spoe_appctx *spoe_appctx;
+	struct eb32_node *node;
+
+	node = eb32_first(&agent->rt[tid].idle_applets);
+	if (!node)
+		return 0;
+
+	spoe_appctx = eb32_entry(node, struct spoe_appctx, node);
+	eb32_delete(&spoe_appctx->node);
+	spoe_appctx->node.key++;
+	eb32_insert(&agent->rt[tid].idle_applets, &spoe_appctx->node);
+	if ((agent->flags & SPOE_FL_BATCHING) && !(spoe_appctx->flags & SPOE_APPCTX_FL_WOKEN)) {
+		spoe_appctx->flags |= SPOE_APPCTX_FL_WOKEN;
+		agent->rt[tid].woken++;
+	}
+	spoe_wakeup_appctx(spoe_appctx->owner);
+	return 1;
+}
+
 static int
 spoe_handle_processing_appctx(struct appctx *appctx)
 {
@@ -1815,6 +1861,14 @@ spoe_handle_processing_appctx(struct appctx *appctx)
 		SPOE_APPCTX(appctx)->task->expire = tick_add_ifset(now_ms, agent->timeout.idle);
 	}
 
+	/* In batching mode, a single applet is woken up for the whole sending
+	 * queue. If it could not drain it, it hands the rest over to another
+	 * idle applet.
+	 */
+	if ((agent->flags & SPOE_FL_BATCHING) && !agent->rt[tid].woken &&
+	    !LIST_ISEMPTY(&agent->rt[tid].sending_queue))
+		spoe_wakeup_idle_appctx(agent);
+
 	if (appctx->st0 == SPOE_APPCTX_ST_PROCESSING && SPOE_APPCTX(appctx)->cur_fpa < agent->max_fpa) {
 		/* If applet must be closed, don't switch it in IDLE state and
 		 * close it when the last waiting frame is acknowledged.
@@ -1996,6 +2050,10 @@ spoe_handle_appctx(struct appctx *appctx)
 			_HA_ATOMIC_DEC(&agent->counters.idles);
 			agent->rt[tid].idles--;
 			eb32_delete(&SPOE_APPCTX(appctx)->node);
+			if (SPOE_APPCTX(appctx)->flags & SPOE_APPCTX_FL_WOKEN) {
+				SPOE_APPCTX(appctx)->flags &= ~SPOE_APPCTX_FL_WOKEN;
+				agent->rt[tid].woken--;
+			}
 			if (stopping &&
 			    LIST_ISEMPTY(&agent->rt[tid].sending_queue) &&
 			    LIST_ISEMPTY(&SPOE_APPCTX(appctx)->waiting_queue)) {
@@ -2127,7 +2185,6 @@ spoe_queue_context(struct spoe_context *ctx)
 {
 	struct spoe_config *conf = FLT_CONF(ctx->filter);
 	struct spoe_agent  *agent = conf->agent;
-	struct spoe_appctx *spoe_appctx;
 
 	/* Check if we need to create a new SPOE applet or not. */
 	if (!LIST_ISEMPTY(&agent->rt[tid].applets) &&
@@ -2166,19 +2223,11 @@ spoe_queue_context(struct spoe_context *ctx)
 		    ctx->strm, agent->counters.applets, agent->counters.idles,
 		    agent->rt[tid].processing);
 
-	/* Finally try to wakeup an IDLE applet. */
-	if (!eb_is_empty(&agent->rt[tid].idle_applets)) {
-		struct eb32_node *node;
-
-		node = eb32_first(&agent->rt[tid].idle_applets);
-		spoe_appctx = eb32_entry(node, struct spoe_appctx, node);
-		if (node && spoe_appctx) {
-			eb32_delete(&spoe_appctx->node);
-			spoe_appctx->node.key++;
-			eb32_insert(&agent->rt[tid].idle_applets, &spoe_appctx->node);
-			spoe_wakeup_appctx(spoe_appctx->owner);
-		}
-	}
+	/* Finally try to wakeup an IDLE applet. In batching mode, an applet
+	 * already woken up will take this context along with the other ones.
+	 */
+	if (!(agent->flags & SPOE_FL_BATCHING) || !agent->rt[tid].woken)
+		spoe_wakeup_idle_appctx(agent);
 	return 1;
 }
 
@@ -2564,6 +2613,8 @@ spoe_update_stats(struct stream *s, struct spoe_agent *agent,
 		tv_zero(&ctx->stats.tv_queue);
 		tv_zero(&ctx->stats.tv_wait);
 		tv_zero(&ctx->stats.tv_response);
+		spoe_update_stat_hist(agent->counters.t_process, ctx->stats.t_process);
+		spoe_update_stat_hist(agent->counters.t_queue, ctx->stats.t_queue);
 	}
 
 	if (agent->var_t_process) {
@@ -3148,6 +3199,7 @@ spoe_check(struct proxy *px, struct flt_conf *fconf)
 		conf->agent->rt[i].frame_size   = conf->agent->max_frame_size;
 		conf->agent->rt[i].processing   = 0;
 		conf->agent->rt[i].idles        = 0;
+		conf->agent->rt[i].woken        = 0;
 		LIST_INIT(&conf->agent->rt[i].applets);
 		LIST_INIT(&conf->agent->rt[i].sending_queue);
 		LIST_INIT(&conf->agent->rt[i].waiting_queue);
@@ -3605,6 +3657,15 @@ cfg_parse_spoe_agent(const char *file, int linenum, char **args, int kwm)
 				curagent->flags |= SPOE_FL_ASYNC;
 			goto out;
 		}
+		else if (strcmp(args[1], "batching") == 0) {
+			if (alertif_too_many_args(1, file, linenum, args, &err_code))
+				goto out;
+			if (kwm == 1)
+				curagent->flags &= ~SPOE_FL_BATCHING;
+			else
+				curagent->flags |= SPOE_FL_BATCHING;
+			goto out;
+		}
 		else if (strcmp(args[1], "send-frag-payload") == 0) {
 			if (alertif_too_many_args(1, file, linenum, args, &err_code))
 				goto out;
@@ -4753,6 +4814,76 @@ parse_send_spoe_group(const char **args, int *orig_arg, struct proxy *px,
 	return ACT_RET_PRS_OK;
 }
 
+/* context used by "show spoe" */
+struct show_spoe_ctx {
+	struct proxy *px;       /* current proxy being dumped */
+};
+
+/* appends to <out> the histogram <hist> labelled <name> */
+static void spoe_dump_hist(struct buffer *out, const char *name, unsigned long long *hist)
+{
+	int i;
+
+	chunk_appendf(out, "  %s:", name);
+	for (i = 0; i < SPOE_HIST_BUCKETS - 1; i++)
+		chunk_appendf(out, " <%d:%llu", 1 << i, HA_ATOMIC_LOAD(&hist[i]));
+	chunk_appendf(out, " >=%d:%llu\n", 1 << (i - 1), HA_ATOMIC_LOAD(&hist[i]));
+}
+
+/* parse a "show spoe" command. It returns 1 on failure, 0 if it starts to dump. */
+static int cli_parse_show_spoe(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct show_spoe_ctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+
+	if (!cli_has_level(appctx, ACCESS_LVL_OPER))
+		return 1;
+
+	ctx->px = proxies_list;
+	return 0;
+}
+
+/* dumps the state of the SPOE agents of all proxies, one proxy at a time.
+ * Returns 0 if the output buffer is full and it needs to be called again,
+ * otherwise non-zero.
+ */
+static int cli_io_handler_show_spoe(struct appctx *appctx)
+{
+	struct show_spoe_ctx *ctx = appctx->svcctx;
+	struct flt_conf *fconf;
+
+	for (; ctx->px; ctx->px = ctx->px->next) {
+		chunk_reset(&trash);
+		list_for_each_entry(fconf, &ctx->px->filter_configs, list) {
+			struct spoe_agent *agent;
+
+			if (fconf->id != spoe_filter_id)
+				continue;
+
+			agent = ((struct spoe_config *)fconf->conf)->agent;
+			chunk_appendf(&trash, "%s/%s: applets=%u idles=%u sending=%u waiting=%u processed=%llu errors=%llu%s\n",
+			              ctx->px->id, agent->id,
+			              HA_ATOMIC_LOAD(&agent->counters.applets),
+			              HA_ATOMIC_LOAD(&agent->counters.idles),
+			              HA_ATOMIC_LOAD(&agent->counters.nb_sending),
+			              HA_ATOMIC_LOAD(&agent->counters.nb_waiting),
+			              HA_ATOMIC_LOAD(&agent->counters.nb_processed),
+			              HA_ATOMIC_LOAD(&agent->counters.nb_errors),
+			              (agent->flags & SPOE_FL_BATCHING) ? " batching" : "");
+			spoe_dump_hist(&trash, "process_ms", agent->counters.t_process);
+			spoe_dump_hist(&trash, "queue_ms", agent->counters.t_queue);
+		}
+		if (applet_putchk(appctx, &trash) == -1)
+			return 0;
+	}
+	return 1;
+}
+
+static struct cli_kw_list cli_kws = {{ },{
+	{ { "show", "spoe", NULL }, "show spoe                               : show SPOE agents activity and time histograms", cli_parse_show_spoe, cli_io_handler_show_spoe, NULL },
+	{{},}
+}};
+
+INITCALL1(STG_REGISTER, cli_register_kw, &cli_kws);
 
 /* Declare the filter parser for "spoe" keyword */
 static struct flt_kw_list flt_kws = { "SPOE", { }, {
@@ -326,6 +326,18 @@ static int h3_is_frame_valid(struct h3c *h3c, struct qcs *qcs, uint64_t ftype)
 		return h3s->type == H3S_T_CTRL &&
 		       !(h3c->flags & H3_CF_SETTINGS_RECV);
 
+	case H3_FT_PRIORITY_UPDATE_REQ:
+	case H3_FT_PRIORITY_UPDATE_PUSH:
+		/* RFC 9218 7.2. The HTTP/3 PRIORITY_UPDATE Frame
+		 *
+		 * The PRIORITY_UPDATE frame MUST be sent on the client control
+		 * stream. Receiving a PRIORITY_UPDATE frame on a stream other
+		 * than the client control stream MUST be treated as a
+		 * connection error of type H3_FRAME_UNEXPECTED.
+		 */
+		return h3s->type == H3S_T_CTRL &&
+		       (h3c->flags & H3_CF_SETTINGS_RECV);
+
 	case H3_FT_PUSH_PROMISE:
 		/* RFC 9114 7.2.5. PUSH_PROMISE
 		 * A client MUST NOT send a PUSH_PROMISE frame. A server MUST treat the
@@ -685,6 +697,10 @@ static ssize_t h3_headers_to_htx(struct qcs *qcs, const struct buffer *buf,
 				goto out;
 			}
 		}
+		else if (isteq(list[hdr_idx].n, ist("priority"))) {
+			/* RFC 9218 5. The Priority HTTP Header Field */
+			http_parse_priority(list[hdr_idx].v, &qcs->urgency, &qcs->incremental);
+		}
 		else if (isteq(list[hdr_idx].n, ist("cookie"))) {
 			http_cookie_register(list, hdr_idx, &cookie, &last_cookie);
 			++hdr_idx;
@@ -968,6 +984,59 @@ static ssize_t h3_parse_settings_frm(struct h3c *h3c, const struct buffer *buf,
 	return ret;
 }
 
+/* Parse a PRIORITY_UPDATE frame for a request stream of length <len> of
+ * payload <buf> received on the control stream <qcs>, and update the priority
+ * of the designated stream if it is still known. Unknown streams are ignored
+ * as permitted by RFC 9218 7.
+ *
+ * Returns the number of consumed bytes or a negative error code.
+ */
+static ssize_t h3_parse_priority_update_frm(struct qcs *qcs, const struct buffer *buf,
+                                            size_t len)
+{
+	struct h3s *h3s = qcs->ctx;
+	struct h3c *h3c = h3s->h3c;
+	struct qcs *target;
+	struct eb64_node *node;
+	struct buffer b;
+	char field[256];
+	uint64_t id;
+	size_t ret = 0;
+
+	/* Work on a copy of <buf>. */
+	b = b_make(b_orig(buf), b_size(buf), b_head_ofs(buf), len);
+
+	if (!b_quic_dec_int(&id, &b, &ret)) {
+		h3c->err = H3_FRAME_ERROR;
+		return -1;
+	}
+
+	/* RFC 9218 7.2. The HTTP/3 PRIORITY_UPDATE Frame
+	 *
+	 * If a PRIORITY_UPDATE frame is received with a Prioritized Element ID
+	 * that refers to a stream that is not a client-initiated bidirectional
+	 * stream, this MUST be treated as a connection error of type
+	 * H3_ID_ERROR.
+	 */
+	if (!quic_stream_is_bidi(id) || !quic_stream_is_remote(qcs->qcc, id)) {
+		h3c->err = H3_ID_ERROR;
+		return -1;
+	}
+
+	if (b_data(&b) > sizeof(field))
+		return len;
+
+	node = eb64_lookup(&qcs->qcc->streams_by_id, id);
+	if (node) {
+		target = eb64_entry(node, struct qcs, by_id);
+		/* the value may wrap in the buffer */
+		ret = b_getblk(&b, field, b_data(&b), 0);
+		http_parse_priority(ist2(field, ret), &target->urgency, &target->incremental);
+	}
+
+	return len;
+}
+
 /* Decode <qcs> remotely initiated bidi-stream. <fin> must be set to indicate
  * that we received the last data of the stream.
  *
@@ -1111,6 +1180,17 @@ static ssize_t h3_decode_qcs(struct qcs *qcs, struct buffer *b, int fin)
 			/* Not supported */
 			ret = flen;
 			break;
+		case H3_FT_PRIORITY_UPDATE_REQ:
+			ret = h3_parse_priority_update_frm(qcs, b, flen);
+			if (ret < 0) {
+				qcc_emit_cc_app(qcs->qcc, h3c->err, 1);
+				return -1;
+			}
+			break;
+		case H3_FT_PRIORITY_UPDATE_PUSH:
+			/* Server push is not supported. */
+			ret = flen;
+			break;
 		case H3_FT_SETTINGS:
 			ret = h3_parse_settings_frm(qcs->qcc->ctx, b, flen);
 			if (ret < 0) {
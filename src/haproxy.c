@@ -3482,6 +3482,8 @@ int main(int argc, char **argv)
 			else if (ret == 0) { /* child breaks here */
 				/* This one must not be exported, it's internal! */
 				unsetenv("HAPROXY_MWORKER_REEXEC");
+				/* nor this secret kept by the master for TLS ticket keys */
+				unsetenv("HAPROXY_TLSKEYS_SECRET");
 				ha_random_jump96(1);
 			}
 			else { /* parent here */
@@ -144,8 +144,21 @@ static struct list referenced_functions = LIST_HEAD_INIT(referenced_functions);
  */
 static int hlua_state_id;
 
-/* This is a NULL-terminated list of lua file which are referenced to load per thread */
-static char **per_thread_load = NULL;
+/* A file referenced by "lua-load-per-thread". It is compiled once into the
+ * first thread's state, and the resulting bytecode is loaded into the other
+ * threads' states instead of parsing the file again.
+ */
+struct hlua_load_per_thread {
+	char *filename;
+	char *bytecode;     /* NULL if not dumped (yet), the file is then parsed */
+	size_t len;         /* bytecode length */
+	size_t size;        /* allocated bytecode size */
+};
+
+/* This is a list of lua file which are referenced to load per thread,
+ * terminated by an entry with a NULL filename.
+ */
+static struct hlua_load_per_thread *per_thread_load = NULL;
 
 lua_State *hlua_init_state(int thread_id);
 
@@ -11739,32 +11752,13 @@ static int hlua_parse_maxmem(char **args, int section_type, struct proxy *curpx,
 }
 
 
-/* This function is called by the main configuration key "lua-load". It loads and
- * execute an lua file during the parsing of the HAProxy configuration file. It is
- * the main lua entry point.
- *
- * This function runs with the HAProxy keywords API. It returns -1 if an error
- * occurs, otherwise it returns 0.
- *
- * In some error case, LUA set an error message in top of the stack. This function
- * returns this error message in the HAProxy logs and pop it from the stack.
- *
- * This function can fail with an abort() due to an Lua critical error.
- * We are in the configuration parsing process of HAProxy, this abort() is
- * tolerated.
+/* Executes the chunk loaded on the top of the stack of <L> by one of the
+ * functions below. Returns 0 on success or -1 on error with <err> filled.
  */
-static int hlua_load_state(char *filename, lua_State *L, char **err)
+static int hlua_exec_chunk(lua_State *L, char **err)
 {
 	int error;
 
-	/* Just load and compile the file. */
-	error = luaL_loadfile(L, filename);
-	if (error) {
-		memprintf(err, "error in Lua file '%s': %s", filename, hlua_tostring_safe(L, -1));
-		lua_pop(L, 1);
-		return -1;
-	}
-
 	/* If no syntax error where detected, execute the code. */
 	error = lua_pcall(L, 0, LUA_MULTRET, 0);
 	switch (error) {
@@ -11796,6 +11790,86 @@ static int hlua_load_state(char *filename, lua_State *L, char **err)
 	return 0;
 }
 
+/* This function is called by the main configuration key "lua-load". It loads and
+ * execute an lua file during the parsing of the HAProxy configuration file. It is
+ * the main lua entry point.
+ *
+ * This function runs with the HAProxy keywords API. It returns -1 if an error
+ * occurs, otherwise it returns 0.
+ *
+ * In some error case, LUA set an error message in top of the stack. This function
+ * returns this error message in the HAProxy logs and pop it from the stack.
+ *
+ * This function can fail with an abort() due to an Lua critical error.
+ * We are in the configuration parsing process of HAProxy, this abort() is
+ * tolerated.
+ */
+static int hlua_load_state(char *filename, lua_State *L, char **err)
+{
+	int error;
+
+	/* Just load and compile the file. */
+	error = luaL_loadfile(L, filename);
+	if (error) {
+		memprintf(err, "error in Lua file '%s': %s", filename, hlua_tostring_safe(L, -1));
+		lua_pop(L, 1);
+		return -1;
+	}
+
+	return hlua_exec_chunk(L, err);
+}
+
+/* lua_Writer used by lua_dump() to store the bytecode of a per-thread file
+ * into the hlua_load_per_thread passed in <ud>. Returns non-zero on error.
+ */
+static int hlua_dump_writer(lua_State *L, const void *p, size_t sz, void *ud)
+{
+	struct hlua_load_per_thread *ptl = ud;
+	size_t size;
+	char *new;
+
+	if (ptl->len + sz > ptl->size) {
+		size = (ptl->len + sz) * 2;
+		new = realloc(ptl->bytecode, size);
+		if (!new)
+			return 1;
+		ptl->bytecode = new;
+		ptl->size = size;
+	}
+	memcpy(ptl->bytecode + ptl->len, p, sz);
+	ptl->len += sz;
+	return 0;
+}
+
+/* Loads and executes the per-thread file <ptl> into state <L>. The first call
+ * compiles the file and keeps its bytecode, which the next calls load instead
+ * of parsing the file again. Returns 0 on success or -1 on error with <err>
+ * filled.
+ */
+static int hlua_load_per_thread_state(struct hlua_load_per_thread *ptl, lua_State *L, char **err)
+{
+	int error;
+
+	if (ptl->bytecode)
+		error = luaL_loadbufferx(L, ptl->bytecode, ptl->len, ptl->filename, "b");
+	else {
+		error = luaL_loadfile(L, ptl->filename);
+		if (!error && lua_dump(L, hlua_dump_writer, ptl, 0) != 0) {
+			/* not fatal, the next thread will parse the file */
+			ha_free(&ptl->bytecode);
+			ptl->len = ptl->size = 0;
+		}
+	}
+
+	if (error) {
+		memprintf(err, "error in Lua file '%s': %s", ptl->filename, hlua_tostring_safe(L, -1));
+		lua_pop(L, 1);
+		return -1;
+	}
+
+	return hlua_exec_chunk(L, err);
+}
+
 static int hlua_load(char **args, int section_type, struct proxy *curpx,
                      const struct proxy *defpx, const char *file, int line,
                      char **err)
@@ -11832,7 +11906,7 @@ static int hlua_load_per_thread(char **args, int section_type, struct proxy *cur
 	}
 
 	/* count used entries */
-	for (len = 0; per_thread_load[len] != NULL; len++)
+	for (len = 0; per_thread_load[len].filename != NULL; len++)
 		;
 
 	per_thread_load = realloc(per_thread_load, (len + 2) * sizeof(*per_thread_load));
@@ -11841,10 +11915,10 @@ static int hlua_load_per_thread(char **args, int section_type, struct proxy *cur
 		return -1;
 	}
 
-	per_thread_load[len]     = strdup(args[1]);
-	per_thread_load[len + 1] = NULL;
+	memset(&per_thread_load[len], 0, 2 * sizeof(*per_thread_load));
+	per_thread_load[len].filename = strdup(args[1]);
 
-	if (per_thread_load[len] == NULL) {
+	if (per_thread_load[len].filename == NULL) {
 		memprintf(err, "out of memory error");
 		return -1;
 	}
@@ -11852,7 +11926,7 @@ static int hlua_load_per_thread(char **args, int section_type, struct proxy *cur
 	/* loading for thread 1 only */
 	hlua_state_id = 1;
 	ha_set_thread(NULL);
-	return hlua_load_state(args[1], hlua_states[1], err);
+	return hlua_load_per_thread_state(&per_thread_load[len], hlua_states[1], err);
 }
 
 /* Prepend the given <path> followed by a semicolon to the `package.<type>` variable
@@ -12318,8 +12392,8 @@ int hlua_post_init()
 		hlua_states[hlua_state_id] = hlua_init_state(hlua_state_id);
 
 		/* Load lua files */
-		for (i = 0; per_thread_load && per_thread_load[i]; i++) {
-			ret = hlua_load_state(per_thread_load[i], hlua_states[hlua_state_id], &err);
+		for (i = 0; per_thread_load && per_thread_load[i].filename; i++) {
+			ret = hlua_load_per_thread_state(&per_thread_load[i], hlua_states[hlua_state_id], &err);
 			if (ret != 0) {
 				ha_alert("Lua init: %s\n", err);
 				return 0;
@@ -12327,6 +12401,12 @@ int hlua_post_init()
 		}
 	}
 
+	/* the bytecode is not needed anymore once all states are loaded */
+	for (i = 0; per_thread_load && per_thread_load[i].filename; i++) {
+		ha_free(&per_thread_load[i].bytecode);
+		per_thread_load[i].len = per_thread_load[i].size = 0;
+	}
+
 	/* Reset thread context */
 	ha_set_thread(NULL);
 
@@ -23,11 +23,14 @@
 
 #include <import/ebmbtree.h>
 
+#include <haproxy/chunk.h>
 #include <haproxy/cli-t.h>
 #include <haproxy/errors.h>
+#include <haproxy/global.h>
 #include <haproxy/hlua-t.h>
 #include <haproxy/hlua_fcn.h>
 #include <haproxy/http.h>
+#include <haproxy/init.h>
 #include <haproxy/net_helper.h>
 #include <haproxy/pattern-t.h>
 #include <haproxy/proxy.h>
@@ -36,6 +39,7 @@
 #include <haproxy/stats.h>
 #include <haproxy/stick_table.h>
 #include <haproxy/stream-t.h>
+#include <haproxy/thread.h>
 #include <haproxy/time.h>
 #include <haproxy/tools.h>
 
@@ -46,6 +50,8 @@ static int class_server_ref;
 static int class_listener_ref;
 static int class_regex_ref;
 static int class_stktable_ref;
+static int class_shared_table_ref;
+static int class_shared_counter_ref;
 
 #define STATS_LEN (MAX((int)ST_F_TOTAL_FIELDS, (int)INF_TOTAL_FIELDS))
 
@@ -1681,6 +1687,563 @@ static int hlua_regex_free(struct lua_State *L)
 	return 0;
 }
 
+/* Shared tables and counters are allocated once for the whole process and are
+ * reachable from all Lua states, including the per-thread ones. This allows
+ * programs loaded with "lua-load-per-thread" to share some state without the
+ * global Lua lock. Tables and counters are never released before deinit.
+ */
+static struct list hlua_shared_tables = LIST_HEAD_INIT(hlua_shared_tables);
+static struct list hlua_shared_counters = LIST_HEAD_INIT(hlua_shared_counters);
+__decl_spinlock(hlua_shared_lock);
+
+/* The snapshot each thread is currently reading, if any. A retired snapshot
+ * is only released once it doesn't appear in any slot anymore.
+ */
+static struct {
+	struct hlua_shared_snap *snap;
+} THREAD_ALIGNED(64) hlua_shared_hazard[MAX_THREADS];
+
+static struct hlua_shared_table *hlua_check_shared_table(lua_State *L, int ud)
+{
+	return hlua_checkudata(L, ud, class_shared_table_ref);
+}
+
+static struct hlua_shared_counter *hlua_check_shared_counter(lua_State *L, int ud)
+{
+	return hlua_checkudata(L, ud, class_shared_counter_ref);
+}
+
+/* Returns the current snapshot of table <t> once it is published in the
+ * calling thread's hazard slot. It remains valid until hlua_shared_release()
+ * is called, which must be done before calling any Lua function since these
+ * may trigger a garbage collection running some Lua code, which may read
+ * another table.
+ */
+static inline struct hlua_shared_snap *hlua_shared_acquire(struct hlua_shared_table *t)
+{
+	struct hlua_shared_snap *snap;
+
+	do {
+		snap = HA_ATOMIC_LOAD(&t->cur);
+		HA_ATOMIC_STORE(&hlua_shared_hazard[tid].snap, snap);
+		__ha_barrier_full();
+	} while (snap != HA_ATOMIC_LOAD(&t->cur));
+	return snap;
+}
+
+static inline void hlua_shared_release()
+{
+	HA_ATOMIC_STORE(&hlua_shared_hazard[tid].snap, NULL);
+}
+
+/* Looks up key <key> of length <len> in snapshot <snap>. Returns the entry or
+ * NULL if not found. If <pos> is not NULL, it is set to the entry's position,
+ * or to the position where it would be inserted.
+ */
+static struct hlua_shared_entry *hlua_shared_lookup(struct hlua_shared_snap *snap,
+                                                     const char *key, size_t len,
+                                                     unsigned int *pos)
+{
+	unsigned int lo = 0, hi = snap->count, mid;
+	struct hlua_shared_entry *e;
+	int cmp;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		e = &snap->entries[mid];
+		cmp = memcmp(key, (char *)snap + e->key_ofs, MIN(len, e->key_len));
+		if (!cmp)
+			cmp = (len > e->key_len) - (len < e->key_len);
+		if (!cmp) {
+			lo = mid;
+			goto found;
+		}
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	e = NULL;
+ found:
+	if (pos)
+		*pos = lo;
+	return e;
+}
+
+/* Pushes the value of entry <e> on the stack, its string is found at offset
+ * e->u.str.ofs from <base>.
+ */
+static void hlua_shared_push(lua_State *L, const struct hlua_shared_entry *e,
+                             const char *base)
+{
+	switch (e->type) {
+	case HLUA_SHARED_BOOL:
+		lua_pushboolean(L, e->u.sint);
+		break;
+	case HLUA_SHARED_INT:
+		lua_pushinteger(L, e->u.sint);
+		break;
+	case HLUA_SHARED_FLT:
+		lua_pushnumber(L, e->u.flt);
+		break;
+	case HLUA_SHARED_STR:
+		lua_pushlstring(L, base + e->u.str.ofs, e->u.str.len);
+		break;
+	}
+}
+
+/* Appends at <*data> in snapshot <snap> the key <key> and the string <str>
+ * of entry <src> which is copied to <e>, and advances <*data>.
+ */
+static void hlua_shared_put(struct hlua_shared_snap *snap, char **data,
+                            struct hlua_shared_entry *e,
+                            const struct hlua_shared_entry *src,
+                            const char *key, const char *str)
+{
+	*e = *src;
+	e->key_ofs = *data - (char *)snap;
+	memcpy(*data, key, e->key_len);
+	*data += e->key_len;
+	if (e->type == HLUA_SHARED_STR) {
+		e->u.str.ofs = *data - (char *)snap;
+		memcpy(*data, str, e->u.str.len);
+		*data += e->u.str.len;
+	}
+}
+
+/* Releases the retired snapshots of table <t> which do not appear in any
+ * hazard slot. Must be called with the table's lock held.
+ */
+static void hlua_shared_collect(struct hlua_shared_table *t)
+{
+	struct hlua_shared_snap **prev = &t->retired;
+	struct hlua_shared_snap *snap;
+	int thr;
+
+	while ((snap = *prev)) {
+		for (thr = 0; thr < MAX_THREADS; thr++) {
+			if (HA_ATOMIC_LOAD(&hlua_shared_hazard[thr].snap) == snap)
+				break;
+		}
+		if (thr < MAX_THREADS) {
+			prev = &snap->next;
+			continue;
+		}
+		*prev = snap->next;
+		free(snap);
+	}
+}
+
+/* Sets the entry of key <key> of length <klen> in table <t> to the value <val>
+ * whose string if any is <str>, or removes it if <val> is NULL. A new snapshot
+ * is built and published, and the previous one is retired. Returns 0 on
+ * success or -1 on allocation failure. No Lua function may be called here.
+ */
+static int hlua_shared_update(struct hlua_shared_table *t, const char *key, size_t klen,
+                              struct hlua_shared_entry *val, const char *str)
+{
+	struct hlua_shared_snap *old, *new;
+	struct hlua_shared_entry *found, *e;
+	unsigned int pos, count, i, j;
+	size_t size;
+	char *data;
+
+	HA_SPIN_LOCK(LUA_LOCK, &t->lock);
+	old = t->cur;
+	found = hlua_shared_lookup(old, key, klen, &pos);
+	if (!found && !val)
+		goto end;
+
+	count = old->count;
+	size = sizeof(*new);
+	for (i = 0; i < old->count; i++) {
+		e = &old->entries[i];
+		if (e == found)
+			continue;
+		size += e->key_len;
+		if (e->type == HLUA_SHARED_STR)
+			size += e->u.str.len;
+	}
+
+	if (found)
+		count--;
+
+	if (val) {
+		val->key_len = klen;
+		size += klen;
+		if (val->type == HLUA_SHARED_STR)
+			size += val->u.str.len;
+		count++;
+	}
+
+	size += count * sizeof(*new->entries);
+	if (size > UINT_MAX)
+		goto fail;
+
+	new = malloc(size);
+	if (!new)
+		goto fail;
+
+	new->next = NULL;
+	new->gen = old->gen + 1;
+	new->size = size;
+	new->count = count;
+	data = (char *)&new->entries[count];
+
+	/* the new value is inserted at <pos>, replacing the old one if any */
+	for (i = j = 0; i <= old->count; i++) {
+		if (i == pos && val)
+			hlua_shared_put(new, &data, &new->entries[j++], val, key, str);
+		if (i == old->count)
+			break;
+		e = &old->entries[i];
+		if (e == found)
+			continue;
+		hlua_shared_put(new, &data, &new->entries[j++], e,
+		                (char *)old + e->key_ofs, (char *)old + e->u.str.ofs);
+	}
+
+	/* readers may still be using the old snapshot, the barrier guarantees
+	 * that those which published it in their hazard slot are seen.
+	 */
+	HA_ATOMIC_STORE(&t->cur, new);
+	__ha_barrier_full();
+	old->next = t->retired;
+	t->retired = old;
+	hlua_shared_collect(t);
+ end:
+	HA_SPIN_UNLOCK(LUA_LOCK, &t->lock);
+	return 0;
+ fail:
+	HA_SPIN_UNLOCK(LUA_LOCK, &t->lock);
+	return -1;
+}
+
+/* Returns the shared table called <name>, or creates it. Returns NULL on
+ * allocation failure.
+ */
+static struct hlua_shared_table *hlua_shared_table_get_by_name(const char *name)
+{
+	struct hlua_shared_table *t;
+
+	HA_SPIN_LOCK(LUA_LOCK, &hlua_shared_lock);
+	list_for_each_entry(t, &hlua_shared_tables, list) {
+		if (strcmp(t->name, name) == 0)
+			goto end;
+	}
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		goto end;
+
+	t->name = strdup(name);
+	t->cur = calloc(1, sizeof(*t->cur));
+	if (!t->name || !t->cur) {
+		free(t->name);
+		free(t->cur);
+		free(t);
+		t = NULL;
+		goto end;
+	}
+	t->cur->size = sizeof(*t->cur);
+	HA_SPIN_INIT(&t->lock);
+	LIST_APPEND(&hlua_shared_tables, &t->list);
+ end:
+	HA_SPIN_UNLOCK(LUA_LOCK, &hlua_shared_lock);
+	return t;
+}
+
+/* Returns the shared counter called <name>, or creates it. Returns NULL on
+ * allocation failure.
+ */
+static struct hlua_shared_counter *hlua_shared_counter_get_by_name(const char *name)
+{
+	struct hlua_shared_counter *c;
+
+	HA_SPIN_LOCK(LUA_LOCK, &hlua_shared_lock);
+	list_for_each_entry(c, &hlua_shared_counters, list) {
+		if (strcmp(c->name, name) == 0)
+			goto end;
+	}
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		goto end;
+
+	c->name = strdup(name);
+	if (!c->name) {
+		free(c);
+		c = NULL;
+		goto end;
+	}
+	LIST_APPEND(&hlua_shared_counters, &c->list);
+ end:
+	HA_SPIN_UNLOCK(LUA_LOCK, &hlua_shared_lock);
+	return c;
+}
+
+/* core.shared_table(name): returns the shared table <name>, creating it if
+ * needed. All Lua states get the same table for the same name.
+ */
+static int hlua_shared_table_new(lua_State *L)
+{
+	struct hlua_shared_table *t;
+
+	t = hlua_shared_table_get_by_name(luaL_checkstring(L, 1));
+	if (!t)
+		return luaL_error(L, "out of memory");
+
+	lua_newtable(L);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, class_shared_table_ref);
+	lua_setmetatable(L, -2);
+	lua_pushlightuserdata(L, t);
+	lua_rawseti(L, -2, 0);
+	return 1;
+}
+
+/* SharedTable:get(key): returns the value of <key> or nil. The value is copied
+ * into a trash chunk so that the snapshot is released before pushing it.
+ */
+static int hlua_shared_table_get(lua_State *L)
+{
+	struct hlua_shared_table *t;
+	struct hlua_shared_snap *snap;
+	struct hlua_shared_entry *e, val;
+	struct buffer *trash;
+	const char *key;
+	size_t len;
+
+	t = hlua_check_shared_table(L, 1);
+	key = luaL_checklstring(L, 2, &len);
+	trash = get_trash_chunk();
+
+	snap = hlua_shared_acquire(t);
+	e = hlua_shared_lookup(snap, key, len, NULL);
+	if (e) {
+		val = *e;
+		if (val.type == HLUA_SHARED_STR) {
+			if (val.u.str.len > trash->size)
+				e = NULL;
+			else
+				memcpy(trash->area, (char *)snap + val.u.str.ofs, val.u.str.len);
+			val.u.str.ofs = 0;
+		}
+	}
+	hlua_shared_release();
+
+	if (!e)
+		lua_pushnil(L);
+	else
+		hlua_shared_push(L, &val, trash->area);
+	return 1;
+}
+
+/* SharedTable:set(key, value): sets <key> to <value> which must be a boolean,
+ * a number or a string, or removes it if <value> is nil.
+ */
+static int hlua_shared_table_set(lua_State *L)
+{
+	struct hlua_shared_table *t;
+	struct hlua_shared_entry val;
+	const char *key, *str = NULL;
+	size_t klen, len;
+	int ret;
+
+	t = hlua_check_shared_table(L, 1);
+	key = luaL_checklstring(L, 2, &klen);
+
+	if (lua_isnoneornil(L, 3)) {
+		ret = hlua_shared_update(t, key, klen, NULL, NULL);
+		goto end;
+	}
+
+	memset(&val, 0, sizeof(val));
+	switch (lua_type(L, 3)) {
+	case LUA_TBOOLEAN:
+		val.type = HLUA_SHARED_BOOL;
+		val.u.sint = lua_toboolean(L, 3);
+		break;
+	case LUA_TNUMBER:
+		if (lua_isinteger(L, 3)) {
+			val.type = HLUA_SHARED_INT;
+			val.u.sint = lua_tointeger(L, 3);
+		}
+		else {
+			val.type = HLUA_SHARED_FLT;
+			val.u.flt = lua_tonumber(L, 3);
+		}
+		break;
+	case LUA_TSTRING:
+		str = lua_tolstring(L, 3, &len);
+		if (len > global.tune.bufsize)
+			return luaL_argerror(L, 3, "string larger than tune.bufsize");
+		val.type = HLUA_SHARED_STR;
+		val.u.str.len = len;
+		break;
+	default:
+		return luaL_argerror(L, 3, "boolean, number, string or nil expected");
+	}
+	ret = hlua_shared_update(t, key, klen, &val, str);
+ end:
+	if (ret < 0)
+		return luaL_error(L, "out of memory");
+	return 0;
+}
+
+/* SharedTable:del(key): removes <key> */
+static int hlua_shared_table_del(lua_State *L)
+{
+	struct hlua_shared_table *t;
+	const char *key;
+	size_t klen;
+
+	t = hlua_check_shared_table(L, 1);
+	key = luaL_checklstring(L, 2, &klen);
+	if (hlua_shared_update(t, key, klen, NULL, NULL) < 0)
+		return luaL_error(L, "out of memory");
+	return 0;
+}
+
+/* SharedTable:count(): returns the number of entries */
+static int hlua_shared_table_count(lua_State *L)
+{
+	struct hlua_shared_table *t;
+	unsigned int count;
+
+	t = hlua_check_shared_table(L, 1);
+	count = hlua_shared_acquire(t)->count;
+	hlua_shared_release();
+	lua_pushinteger(L, count);
+	return 1;
+}
+
+/* SharedTable:dump(): returns a Lua table containing all the entries as they
+ * were at a single point in time. The snapshot is copied into a userdata
+ * allocated before it is read, and the copy is retried if the table changed
+ * between the allocation and the copy.
+ */
+static int hlua_shared_table_dump(lua_State *L)
+{
+	struct hlua_shared_table *t;
+	struct hlua_shared_snap *snap, *copy;
+	struct hlua_shared_entry *e;
+	unsigned long long gen;
+	unsigned int size, i;
+
+	t = hlua_check_shared_table(L, 1);
+
+	while (1) {
+		snap = hlua_shared_acquire(t);
+		size = snap->size;
+		gen = snap->gen;
+		hlua_shared_release();
+
+		copy = lua_newuserdata(L, size);
+
+		snap = hlua_shared_acquire(t);
+		if (snap->gen == gen) {
+			memcpy(copy, snap, size);
+			hlua_shared_release();
+			break;
+		}
+		hlua_shared_release();
+		lua_pop(L, 1);
+	}
+
+	lua_newtable(L);
+	for (i = 0; i < copy->count; i++) {
+		e = &copy->entries[i];
+		lua_pushlstring(L, (char *)copy + e->key_ofs, e->key_len);
+		hlua_shared_push(L, e, (char *)copy);
+		lua_rawset(L, -3);
+	}
+	lua_remove(L, -2); /* remove the copy */
+	return 1;
+}
+
+/* core.shared_counter(name): returns the shared counter <name>, creating it
+ * if needed. All Lua states get the same counter for the same name.
+ */
+static int hlua_shared_counter_new(lua_State *L)
+{
+	struct hlua_shared_counter *c;
+
+	c = hlua_shared_counter_get_by_name(luaL_checkstring(L, 1));
+	if (!c)
+		return luaL_error(L, "out of memory");
+
+	lua_newtable(L);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, class_shared_counter_ref);
+	lua_setmetatable(L, -2);
+	lua_pushlightuserdata(L, c);
+	lua_rawseti(L, -2, 0);
+	return 1;
+}
+
+static int hlua_shared_counter_get(lua_State *L)
+{
+	struct hlua_shared_counter *c;
+
+	c = hlua_check_shared_counter(L, 1);
+	lua_pushinteger(L, HA_ATOMIC_LOAD(&c->value));
+	return 1;
+}
+
+static int hlua_shared_counter_set(lua_State *L)
+{
+	struct hlua_shared_counter *c;
+
+	c = hlua_check_shared_counter(L, 1);
+	HA_ATOMIC_STORE(&c->value, luaL_checkinteger(L, 2));
+	return 0;
+}
+
+/* SharedCounter:inc([n]): adds <n> (default 1), returns the new value */
+static int hlua_shared_counter_inc(lua_State *L)
+{
+	struct hlua_shared_counter *c;
+
+	c = hlua_check_shared_counter(L, 1);
+	lua_pushinteger(L, HA_ATOMIC_ADD_FETCH(&c->value, luaL_optinteger(L, 2, 1)));
+	return 1;
+}
+
+/* SharedCounter:dec([n]): subtracts <n> (default 1), returns the new value */
+static int hlua_shared_counter_dec(lua_State *L)
+{
+	struct hlua_shared_counter *c;
+
+	c = hlua_check_shared_counter(L, 1);
+	lua_pushinteger(L, HA_ATOMIC_SUB_FETCH(&c->value, luaL_optinteger(L, 2, 1)));
+	return 1;
+}
+
+static void hlua_shared_deinit(void)
+{
+	struct hlua_shared_table *t, *tb;
+	struct hlua_shared_counter *c, *cb;
+	struct hlua_shared_snap *snap;
+
+	list_for_each_entry_safe(t, tb, &hlua_shared_tables, list) {
+		while ((snap = t->retired)) {
+			t->retired = snap->next;
+			free(snap);
+		}
+		free(t->cur);
+		free(t->name);
+		LIST_DELETE(&t->list);
+		free(t);
+	}
+
+	list_for_each_entry_safe(c, cb, &hlua_shared_counters, list) {
+		free(c->name);
+		LIST_DELETE(&c->list);
+		free(c);
+	}
+}
+
+REGISTER_POST_DEINIT(hlua_shared_deinit);
+
 int hlua_fcn_reg_core_fcn(lua_State *L)
 {
 	if (!hlua_concat_init(L))
@@ -1696,6 +2259,8 @@ int hlua_fcn_reg_core_fcn(lua_State *L)
 	hlua_class_function(L, "parse_addr", hlua_parse_addr);
 	hlua_class_function(L, "match_addr", hlua_match_addr);
 	hlua_class_function(L, "tokenize", hlua_tokenize);
+	hlua_class_function(L, "shared_table", hlua_shared_table_new);
+	hlua_class_function(L, "shared_counter", hlua_shared_counter_new);
 
 	/* Create regex object. */
 	lua_newtable(L);
@@ -1775,5 +2340,28 @@ int hlua_fcn_reg_core_fcn(lua_State *L)
 	lua_settable(L, -3); /* -> META["__index"] = TABLE */
 	class_proxy_ref = hlua_register_metatable(L, CLASS_PROXY);
 
+	/* Create shared table object. */
+	lua_newtable(L);
+	lua_pushstring(L, "__index");
+	lua_newtable(L);
+	hlua_class_function(L, "get", hlua_shared_table_get);
+	hlua_class_function(L, "set", hlua_shared_table_set);
+	hlua_class_function(L, "del", hlua_shared_table_del);
+	hlua_class_function(L, "count", hlua_shared_table_count);
+	hlua_class_function(L, "dump", hlua_shared_table_dump);
+	lua_settable(L, -3); /* -> META["__index"] = TABLE */
+	class_shared_table_ref = hlua_register_metatable(L, CLASS_SHARED_TABLE);
+
+	/* Create shared counter object. */
+	lua_newtable(L);
+	lua_pushstring(L, "__index");
+	lua_newtable(L);
+	hlua_class_function(L, "get", hlua_shared_counter_get);
+	hlua_class_function(L, "set", hlua_shared_counter_set);
+	hlua_class_function(L, "inc", hlua_shared_counter_inc);
+	hlua_class_function(L, "dec", hlua_shared_counter_dec);
+	lua_settable(L, -3); /* -> META["__index"] = TABLE */
+	class_shared_counter_ref = hlua_register_metatable(L, CLASS_SHARED_COUNTER);
+
 	return 5;
 }
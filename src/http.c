@@ -1329,3 +1329,81 @@ struct ist http_trim_trailing_spht(struct ist value)
 
 	return ret;
 }
+
+/* Skips the remaining of a structured field item starting at <p> and ending
+ * before <end>, stopping on the first unquoted character present in <stop>.
+ * Quoted strings and their escaped characters are skipped as a whole. Returns
+ * the position of the stop character or <end>.
+ */
+static const char *http_sf_skip_item(const char *p, const char *end, const char *stop)
+{
+	int quoted = 0;
+
+	for (; p < end; p++) {
+		if (quoted) {
+			if (*p == '\\' && p + 1 < end)
+				p++;
+			else if (*p == '"')
+				quoted = 0;
+			continue;
+		}
+		if (*p == '"')
+			quoted = 1;
+		else if (strchr(stop, *p))
+			break;
+	}
+	return p;
+}
+
+/*
+ * Parses the value of a "priority" header field or of a PRIORITY_UPDATE frame
+ * as described in RFC9218, which is a structured field dictionary. Only the
+ * "u" (urgency, 0..7) and "i" (incremental, boolean) members are considered,
+ * and <urgency> and <incremental> are only updated for valid values, the
+ * latter being NULL if the caller does not need it. Unknown
+ * members, parameters and invalid values are ignored as mandated by the spec,
+ * so this may be called for each occurrence of the header field, the last
+ * valid value winning.
+ */
+void http_parse_priority(const struct ist value, uint8_t *urgency, uint8_t *incremental)
+{
+	const char *p = istptr(value);
+	const char *end = istend(value);
+	struct ist key, val;
+
+	while (p < end) {
+		/* skip OWS and empty members */
+		while (p < end && (HTTP_IS_SPHT(*p) || *p == ','))
+			p++;
+		if (p >= end)
+			break;
+
+		key = ist2(p, 0);
+		while (p < end && *p != '=' && *p != ';' && *p != ',' && !HTTP_IS_SPHT(*p))
+			p++;
+		key.len = p - key.ptr;
+
+		/* a member without a value is a boolean true */
+		val = IST_NULL;
+		if (p < end && *p == '=') {
+			val = ist2(++p, 0);
+			p = http_sf_skip_item(p, end, ";, \t");
+			val.len = p - val.ptr;
+		}
+
+		/* skip the member's parameters, if any */
+		p = http_sf_skip_item(p, end, ",");
+
+		if (isteq(key, ist("u"))) {
+			if (istlen(val) == 1 && *istptr(val) >= '0' &&
+			    *istptr(val) <= '0' + HTTP_PRIO_URGENCY_MAX)
+				*urgency = *istptr(val) - '0';
+		}
+		else if (incremental && isteq(key, ist("i"))) {
+			if (!isttest(val) || isteq(val, ist("?1")))
+				*incremental = 1;
+			else if (isteq(val, ist("?0")))
+				*incremental = 0;
+		}
+	}
+}
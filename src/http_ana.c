@@ -12,6 +12,7 @@
 
 #include <haproxy/acl.h>
 #include <haproxy/action-t.h>
+#include <haproxy/activity.h>
 #include <haproxy/api.h>
 #include <haproxy/applet.h>
 #include <haproxy/backend.h>
@@ -26,11 +27,13 @@
 #include <haproxy/http.h>
 #include <haproxy/http_ana.h>
 #include <haproxy/http_htx.h>
+#include <haproxy/http_rules.h>
 #include <haproxy/htx.h>
 #include <haproxy/log.h>
 #include <haproxy/net_helper.h>
 #include <haproxy/proxy.h>
 #include <haproxy/regex.h>
+#include <haproxy/sample.h>
 #include <haproxy/sc_strm.h>
 #include <haproxy/server-t.h>
 #include <haproxy/stats.h>
@@ -2786,6 +2789,20 @@ int http_res_set_status(unsigned int status, struct ist reason, struct stream *s
 	return 0;
 }
 
+/* Accounts to rule <rule> the time elapsed since <start> when rules profiling
+ * is enabled, <start> being zero otherwise. <call> is non-zero when the rule's
+ * condition was evaluated, and zero for the time spent in its action.
+ */
+static inline void http_rule_prof(struct act_rule *rule, uint64_t start, int call)
+{
+	if (likely(!start))
+		return;
+
+	if (call)
+		_HA_ATOMIC_INC(&rule->calls);
+	_HA_ATOMIC_ADD(&rule->cpu_time, now_mono_time() - start);
+}
+
 /* Executes the http-request rules <rules> for stream <s>, proxy <px> and
  * transaction <txn>. Returns the verdict of the first rule that prevents
  * further processing of the request (auth, deny, ...), and defaults to
@@ -2801,8 +2818,12 @@ static enum rule_result http_req_get_intercept_rule(struct proxy *px, struct lis
 	struct session *sess = strm_sess(s);
 	struct http_txn *txn = s->txn;
 	struct act_rule *rule;
+	struct act_rule *next;
 	enum rule_result rule_ret = HTTP_RULE_RES_CONT;
+	enum act_return act_ret;
+	uint64_t prof_start;
 	int act_opts = 0;
+	int matched;
 
 	/* If "the current_rule_list" match the executed rule list, we are in
 	 * resume condition. If a resume is needed it is always in the action
@@ -2822,8 +2843,19 @@ static enum rule_result http_req_get_intercept_rule(struct proxy *px, struct lis
 	txn->req.flags &= ~HTTP_MSGF_SOFT_RW;
 
 	list_for_each_entry(rule, s->current_rule_list, list) {
-		/* check optional condition */
-		if (rule->cond) {
+		prof_start = unlikely(profiling & HA_PROF_RULES) ? now_mono_time() : 0;
+
+		/* a chain of rules matching the same sample against constant
+		 * strings is resolved at once by its dispatch table.
+		 */
+		if (rule->dispatch &&
+		    (next = http_rule_dispatch(rule->dispatch, px, sess, s, SMP_OPT_DIR_REQ|SMP_OPT_FINAL, &matched))) {
+			http_rule_prof(rule, prof_start, 1);
+			rule = next;
+			if (!matched) /* no condition matched in the chain */
+				continue;
+		}
+		else if (rule->cond) {
 			int ret;
 
 			ret = acl_exec_cond(rule->cond, px, sess, s, SMP_OPT_DIR_REQ|SMP_OPT_FINAL);
@@ -2832,9 +2864,12 @@ static enum rule_result http_req_get_intercept_rule(struct proxy *px, struct lis
 			if (rule->cond->pol == ACL_COND_UNLESS)
 				ret = !ret;
 
+			http_rule_prof(rule, prof_start, 1);
 			if (!ret) /* condition not matched */
 				continue;
 		}
+		else
+			http_rule_prof(rule, prof_start, 1);
 
 		act_opts |= ACT_OPT_FIRST;
   resume_execution:
@@ -2848,7 +2883,14 @@ static enum rule_result http_req_get_intercept_rule(struct proxy *px, struct lis
 			     (px->options & PR_O_ABRT_CLOSE)))
 				act_opts |= ACT_OPT_FINAL;
 
-			switch (rule->action_ptr(rule, px, sess, s, act_opts)) {
+			prof_start = unlikely(profiling & HA_PROF_RULES) ? now_mono_time() : 0;
+			act_ret = rule->action_ptr(rule, px, sess, s, act_opts);
+			http_rule_prof(rule, prof_start, 0);
+
+			/* the action may have modified the request */
+			smp_memo_reset(s->smp_memo);
+
+			switch (act_ret) {
 				case ACT_RET_CONT:
 					break;
 				case ACT_RET_STOP:
@@ -2973,6 +3015,8 @@ static enum rule_result http_res_get_intercept_rule(struct proxy *px, struct lis
 	struct http_txn *txn = s->txn;
 	struct act_rule *rule;
 	enum rule_result rule_ret = HTTP_RULE_RES_CONT;
+	enum act_return act_ret;
+	uint64_t prof_start;
 	int act_opts = 0;
 
 	/* If "the current_rule_list" match the executed rule list, we are in
@@ -2994,6 +3038,8 @@ static enum rule_result http_res_get_intercept_rule(struct proxy *px, struct lis
 	txn->rsp.flags &= ~HTTP_MSGF_SOFT_RW;
 
 	list_for_each_entry(rule, s->current_rule_list, list) {
+		prof_start = unlikely(profiling & HA_PROF_RULES) ? now_mono_time() : 0;
+
 		/* check optional condition */
 		if (rule->cond) {
 			int ret;
@@ -3004,9 +3050,12 @@ static enum rule_result http_res_get_intercept_rule(struct proxy *px, struct lis
 			if (rule->cond->pol == ACL_COND_UNLESS)
 				ret = !ret;
 
+			http_rule_prof(rule, prof_start, 1);
 			if (!ret) /* condition not matched */
 				continue;
 		}
+		else
+			http_rule_prof(rule, prof_start, 1);
 
 		act_opts |= ACT_OPT_FIRST;
 resume_execution:
@@ -3020,7 +3069,11 @@ static enum rule_result http_res_get_intercept_rule(struct proxy *px, struct lis
 			     (px->options & PR_O_ABRT_CLOSE)))
 				act_opts |= ACT_OPT_FINAL;
 
-			switch (rule->action_ptr(rule, px, sess, s, act_opts)) {
+			prof_start = unlikely(profiling & HA_PROF_RULES) ? now_mono_time() : 0;
+			act_ret = rule->action_ptr(rule, px, sess, s, act_opts);
+			http_rule_prof(rule, prof_start, 0);
+
+			switch (act_ret) {
 				case ACT_RET_CONT:
 					break;
 				case ACT_RET_STOP:
@@ -33,6 +33,7 @@
 #include <haproxy/sc_strm.h>
 #include <haproxy/server.h>
 #include <haproxy/ssl_sock-t.h>
+#include <haproxy/ssl_sock.h>
 #include <haproxy/sock_inet.h>
 #include <haproxy/stconn.h>
 #include <haproxy/tools.h>
@@ -49,9 +50,15 @@ static int hard_error_ssl = 0;
 static struct server *httpclient_srv_ssl;
 static int httpclient_ssl_verify = SSL_SOCK_VERIFY_REQUIRED;
 static char *httpclient_ssl_ca_file = NULL;
+static int httpclient_h2 = 0;          /* advertise h2 in ALPN for HTTPS */
 #endif
 static struct applet httpclient_applet;
 
+/* connections reuse between requests, disabled by default */
+static int httpclient_reuse = PR_O_REUSE_NEVR;
+static int httpclient_max_idle = -1;   /* max idle conns per server, -1 = unlimited */
+static int httpclient_maxconn = 0;     /* max concurrent conns per server, 0 = unlimited */
+
 /* if the httpclient is not configured, error are ignored and features are limited */
 static int hard_error_resolvers = 0;
 static char *resolvers_id = NULL;
@@ -1147,6 +1154,18 @@ static int httpclient_resolve_init()
 
 
 
+/* Applies the connection pooling settings to the httpclient server <srv>.
+ * Idle connections are kept in the server's per-thread idle lists, exactly
+ * like for regular servers, only when reuse is enabled.
+ */
+static void httpclient_srv_pool_init(struct server *srv)
+{
+	srv->max_idle_conns = (httpclient_reuse != PR_O_REUSE_NEVR) ? httpclient_max_idle : 0;
+	srv->pool_purge_delay = 5000;
+	srv->max_reuse = -1;
+	srv->maxconn = httpclient_maxconn;
+}
+
 /*
  * Initialize the proxy for the HTTP client with 2 servers, one for raw HTTP,
  * the other for HTTPS.
@@ -1167,7 +1186,7 @@ static int httpclient_precheck()
 	}
 
 
-	httpclient_proxy->options |= PR_O_WREQ_BODY;
+	httpclient_proxy->options |= PR_O_WREQ_BODY | httpclient_reuse;
 	httpclient_proxy->retry_type |= PR_RE_CONN_FAILED | PR_RE_DISCONNECTED | PR_RE_TIMEOUT;
 	httpclient_proxy->options2 |= PR_O2_INDEPSTR;
 	httpclient_proxy->mode = PR_MODE_HTTP;
@@ -1192,6 +1211,7 @@ static int httpclient_precheck()
 	httpclient_srv_raw->uweight = 0;
 	httpclient_srv_raw->xprt = xprt_get(XPRT_RAW);
 	httpclient_srv_raw->flags |= SRV_F_MAPPORTS;  /* needed to apply the port change with resolving */
+	httpclient_srv_pool_init(httpclient_srv_raw);
 	httpclient_srv_raw->id = strdup("<HTTPCLIENT>");
 	if (!httpclient_srv_raw->id) {
 		memprintf(&errmsg, "out of memory.");
@@ -1213,6 +1233,7 @@ static int httpclient_precheck()
 	httpclient_srv_ssl->xprt = xprt_get(XPRT_SSL);
 	httpclient_srv_ssl->use_ssl = 1;
 	httpclient_srv_ssl->flags |= SRV_F_MAPPORTS;  /* needed to apply the port change with resolving */
+	httpclient_srv_pool_init(httpclient_srv_ssl);
 	httpclient_srv_ssl->id = strdup("<HTTPSCLIENT>");
 	if (!httpclient_srv_ssl->id) {
 		memprintf(&errmsg, "out of memory.");
@@ -1220,6 +1241,14 @@ static int httpclient_precheck()
 		goto err;
 	}
 
+	/* let the server choose HTTP/2 to multiplex the requests */
+	if (httpclient_h2 &&
+	    ssl_sock_parse_alpn("h2,http/1.1", &httpclient_srv_ssl->ssl_ctx.alpn_str,
+				&httpclient_srv_ssl->ssl_ctx.alpn_len, &errmsg) != 0) {
+		err_code |= ERR_ALERT | ERR_FATAL;
+		goto err;
+	}
+
 	httpclient_srv_ssl->ssl_ctx.verify = httpclient_ssl_verify;
 	/* if the verify is required, try to load the system CA */
 	if (httpclient_ssl_verify == SSL_SOCK_VERIFY_REQUIRED) {
@@ -1307,7 +1336,7 @@ static int httpclient_postcheck()
 	if (curproxy->conf.logformat_string) {
 		curproxy->conf.args.ctx = ARGC_LOG;
 		if (!parse_logformat_string(curproxy->conf.logformat_string, curproxy, &curproxy->logformat,
-					    LOG_OPT_MANDATORY|LOG_OPT_MERGE_SPACES,
+					    LOG_OPT_MANDATORY|LOG_OPT_MERGE_SPACES|LOG_OPT_BIN_OK,
 					    SMP_VAL_FE_LOG_END, &errmsg)) {
 			memprintf(&errmsg, "failed to parse log-format : %s.", errmsg);
 			err_code |= ERR_ALERT | ERR_FATAL;
@@ -1384,6 +1413,53 @@ static int httpclient_parse_global_prefer(char **args, int section_type, struct
 }
 
 
+static int httpclient_parse_global_reuse(char **args, int section_type, struct proxy *curpx,
+                                        const struct proxy *defpx, const char *file, int line,
+                                        char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "never") == 0)
+		httpclient_reuse = PR_O_REUSE_NEVR;
+	else if (strcmp(args[1], "safe") == 0)
+		httpclient_reuse = PR_O_REUSE_SAFE;
+	else if (strcmp(args[1], "aggressive") == 0)
+		httpclient_reuse = PR_O_REUSE_AGGR;
+	else if (strcmp(args[1], "always") == 0)
+		httpclient_reuse = PR_O_REUSE_ALWS;
+	else {
+		memprintf(err, "'%s' expects 'never', 'safe', 'aggressive' or 'always' as argument.", args[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* parses "httpclient.pool.max-idle" and "httpclient.pool.maxconn" */
+static int httpclient_parse_global_pool(char **args, int section_type, struct proxy *curpx,
+                                        const struct proxy *defpx, const char *file, int line,
+                                        char **err)
+{
+	int val;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	val = atoi(args[1]);
+	if (!*args[1] || val < 0) {
+		memprintf(err, "'%s' expects a positive integer as argument.", args[0]);
+		return -1;
+	}
+
+	if (strcmp(args[0], "httpclient.pool.max-idle") == 0)
+		httpclient_max_idle = val;
+	else
+		httpclient_maxconn = val;
+
+	return 0;
+}
+
 #ifdef USE_OPENSSL
 static int httpclient_parse_global_ca_file(char **args, int section_type, struct proxy *curpx,
                                         const struct proxy *defpx, const char *file, int line,
@@ -1422,12 +1498,35 @@ static int httpclient_parse_global_verify(char **args, int section_type, struct
 
 	return 0;
 }
+
+static int httpclient_parse_global_h2(char **args, int section_type, struct proxy *curpx,
+                                        const struct proxy *defpx, const char *file, int line,
+                                        char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0)
+		httpclient_h2 = 1;
+	else if (strcmp(args[1], "off") == 0)
+		httpclient_h2 = 0;
+	else {
+		memprintf(err, "'%s' expects 'on' or 'off' as argument.", args[0]);
+		return -1;
+	}
+
+	return 0;
+}
 #endif /* ! USE_OPENSSL */
 
 static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "httpclient.resolvers.id", httpclient_parse_global_resolvers },
 	{ CFG_GLOBAL, "httpclient.resolvers.prefer", httpclient_parse_global_prefer },
+	{ CFG_GLOBAL, "httpclient.reuse", httpclient_parse_global_reuse },
+	{ CFG_GLOBAL, "httpclient.pool.max-idle", httpclient_parse_global_pool },
+	{ CFG_GLOBAL, "httpclient.pool.maxconn", httpclient_parse_global_pool },
 #ifdef USE_OPENSSL
+	{ CFG_GLOBAL, "httpclient.h2", httpclient_parse_global_h2 },
 	{ CFG_GLOBAL, "httpclient.ssl.verify", httpclient_parse_global_verify },
 	{ CFG_GLOBAL, "httpclient.ssl.ca-file", httpclient_parse_global_ca_file },
 #endif
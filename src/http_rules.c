@@ -16,18 +16,24 @@
 #include <string.h>
 #include <time.h>
 
+#include <import/ebpttree.h>
+#include <import/ebsttree.h>
 #include <haproxy/acl.h>
 #include <haproxy/action.h>
+#include <haproxy/activity.h>
 #include <haproxy/api.h>
+#include <haproxy/applet.h>
 #include <haproxy/arg.h>
 #include <haproxy/capture-t.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/chunk.h>
+#include <haproxy/cli.h>
 #include <haproxy/global.h>
 #include <haproxy/http.h>
 #include <haproxy/http_ana-t.h>
 #include <haproxy/http_rules.h>
 #include <haproxy/log.h>
+#include <haproxy/pattern.h>
 #include <haproxy/pool.h>
 #include <haproxy/proxy.h>
 #include <haproxy/sample.h>
@@ -526,6 +532,414 @@ struct redirect_rule *http_parse_redirect_rule(const char *file, int linenum, st
 	return NULL;
 }
 
+/* Calls <fct> for each list of http-request (dir=0), http-response (dir=1) and
+ * http-after-response (dir=2) rules of all proxies, including the defaults
+ * sections, with <ctx> as last argument.
+ */
+static void http_rules_foreach_list(void (*fct)(struct proxy *px, struct list *rules, int dir, void *ctx),
+                                    void *ctx)
+{
+	struct ebpt_node *node;
+	struct proxy *px;
+
+	for (px = proxies_list; px; px = px->next) {
+		fct(px, &px->http_req_rules, 0, ctx);
+		fct(px, &px->http_res_rules, 1, ctx);
+		fct(px, &px->http_after_res_rules, 2, ctx);
+	}
+
+	for (node = ebpt_first(&defproxy_by_name); node; node = ebpt_next(node)) {
+		px = container_of(node, struct proxy, conf.by_name);
+		fct(px, &px->http_req_rules, 0, ctx);
+		fct(px, &px->http_res_rules, 1, ctx);
+		fct(px, &px->http_after_res_rules, 2, ctx);
+	}
+}
+
+/* Returns the pattern reference used by the condition of rule <rule> if it
+ * may be part of a dispatch table, that is if it is made of a single ACL with
+ * a single expression matching a string sample against constant strings. The
+ * ACL expression is returned in <aexpr>. Otherwise NULL is returned.
+ */
+static struct pat_ref *http_rule_dispatch_ref(const struct act_rule *rule, struct acl_expr **aexpr)
+{
+	const struct acl_term_suite *suite;
+	const struct acl_term *term;
+	const struct pattern_expr_list *pel;
+	struct acl_expr *expr;
+
+	if (!rule->cond || rule->cond->pol != ACL_COND_IF)
+		return NULL;
+
+	if (LIST_ISEMPTY(&rule->cond->suites) || rule->cond->suites.n != rule->cond->suites.p)
+		return NULL;
+	suite = LIST_NEXT(&rule->cond->suites, const struct acl_term_suite *, list);
+
+	if (LIST_ISEMPTY(&suite->terms) || suite->terms.n != suite->terms.p)
+		return NULL;
+	term = LIST_NEXT(&suite->terms, const struct acl_term *, list);
+	if (term->neg)
+		return NULL;
+
+	if (LIST_ISEMPTY(&term->acl->expr) || term->acl->expr.n != term->acl->expr.p)
+		return NULL;
+	expr = LIST_NEXT(&term->acl->expr, struct acl_expr *, list);
+
+	if (expr->pat.match != pat_match_str || !expr->smp->text ||
+	    smp_expr_output_type(expr->smp) != SMP_T_STR)
+		return NULL;
+
+	if (LIST_ISEMPTY(&expr->pat.head) || expr->pat.head.n != expr->pat.head.p)
+		return NULL;
+	pel = LIST_NEXT(&expr->pat.head, const struct pattern_expr_list *, list);
+	if (!pel->expr->ref)
+		return NULL;
+
+	*aexpr = expr;
+	return pel->expr->ref;
+}
+
+/* Returns non-zero if ACL expressions <a> and <b> match the same sample in the
+ * same way, so that their rules may share a dispatch table.
+ */
+static int http_rule_dispatch_compatible(const struct acl_expr *a, const struct acl_expr *b)
+{
+	const struct pattern_expr_list *pa, *pb;
+
+	pa = LIST_NEXT(&a->pat.head, const struct pattern_expr_list *, list);
+	pb = LIST_NEXT(&b->pat.head, const struct pattern_expr_list *, list);
+
+	return strcmp(a->smp->text, b->smp->text) == 0 &&
+	       !(pa->expr->mflags & PAT_MF_IGNORE_CASE) == !(pb->expr->mflags & PAT_MF_IGNORE_CASE);
+}
+
+/* Builds the dispatch table of the <nb> rules starting at <first> and attaches
+ * it to this rule. Returns 0 on success or -1 on memory allocation failure.
+ */
+static int http_rule_build_dispatch(struct act_rule *first, int nb)
+{
+	struct act_rule_dispatch *d;
+	struct act_rule_dispatch_key *key;
+	struct pat_ref_elt *elt;
+	struct acl_expr *aexpr;
+	struct act_rule *rule;
+	struct pat_ref *ref;
+	size_t len;
+	int i;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return -1;
+
+	d->keys = EB_ROOT_UNIQUE;
+	d->nb_rules = nb;
+	d->rules = calloc(nb, sizeof(*d->rules));
+	d->refs = calloc(nb, sizeof(*d->refs));
+	d->revisions = calloc(nb, sizeof(*d->revisions));
+	if (!d->rules || !d->refs || !d->revisions)
+		goto fail;
+
+	rule = first;
+	for (i = 0; i < nb; i++) {
+		ref = http_rule_dispatch_ref(rule, &aexpr);
+		if (!i) {
+			d->expr = aexpr->smp;
+			d->icase = !!(LIST_NEXT(&aexpr->pat.head, struct pattern_expr_list *, list)->expr->mflags & PAT_MF_IGNORE_CASE);
+		}
+		d->rules[i] = rule;
+		d->refs[i] = ref;
+		d->revisions[i] = ref->revision;
+
+		list_for_each_entry(elt, &ref->head, list) {
+			if (elt->gen_id != ref->curr_gen)
+				continue;
+			len = strlen(elt->pattern);
+			key = malloc(sizeof(*key) + len + 1);
+			if (!key)
+				goto fail;
+			key->idx = i;
+			memcpy(key->node.key, elt->pattern, len + 1);
+			if (d->icase) {
+				char *p;
+
+				for (p = (char *)key->node.key; *p; p++)
+					*p = tolower((unsigned char)*p);
+			}
+			/* only the first rule matching a string is kept */
+			if (ebst_insert(&d->keys, &key->node) != &key->node)
+				free(key);
+		}
+		rule = LIST_NEXT(&rule->list, struct act_rule *, list);
+	}
+
+	first->dispatch = d;
+	return 0;
+
+ fail:
+	free_act_rule_dispatch(d);
+	return -1;
+}
+
+/* Detects in http-request rules list <rules> the chains of at least two
+ * consecutive rules testing the same sample against constant strings, and
+ * compiles each of them into a dispatch table. Lists already compiled (e.g.
+ * defaults sections shared by several proxies) are left untouched.
+ */
+static void http_rules_compile_dispatch(struct proxy *px, struct list *rules, int dir, void *ctx)
+{
+	struct act_rule *rule, *next;
+	struct acl_expr *first_expr, *expr;
+	int *err = ctx;
+	int nb;
+
+	if (dir != 0)
+		return;
+
+	rule = LIST_NEXT(rules, struct act_rule *, list);
+	while (&rule->list != rules) {
+		if (rule->dispatch) {
+			/* already compiled */
+			return;
+		}
+
+		if (!http_rule_dispatch_ref(rule, &first_expr)) {
+			rule = LIST_NEXT(&rule->list, struct act_rule *, list);
+			continue;
+		}
+
+		nb = 1;
+		next = LIST_NEXT(&rule->list, struct act_rule *, list);
+		while (&next->list != rules && http_rule_dispatch_ref(next, &expr) &&
+		       http_rule_dispatch_compatible(first_expr, expr)) {
+			nb++;
+			next = LIST_NEXT(&next->list, struct act_rule *, list);
+		}
+
+		if (nb >= 2 && http_rule_build_dispatch(rule, nb) < 0)
+			*err = 1;
+		rule = next;
+	}
+}
+
+/* Compiles the dispatch tables of all http-request rules once the
+ * configuration is fully parsed and ACL patterns are loaded.
+ */
+static int http_rules_dispatch_init(void)
+{
+	int err = 0;
+
+	http_rules_foreach_list(http_rules_compile_dispatch, &err);
+	if (err) {
+		ha_alert("out of memory while compiling http-request rules.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+	return ERR_NONE;
+}
+
+REGISTER_POST_CHECK(http_rules_dispatch_init);
+
+/* Looks up in the dispatch table <d> the first rule of its chain whose
+ * condition matches for stream <s>. All values of the sample, fetched with
+ * options <opt>, are considered like acl_exec_cond() does. The matching rule
+ * is returned with <matched> set to 1, or the chain's last rule is returned
+ * with <matched> set to 0 if none matches. NULL is returned if one of the
+ * rules' patterns was updated at runtime, in which case the rules must be
+ * evaluated one at a time.
+ */
+struct act_rule *http_rule_dispatch(struct act_rule_dispatch *d, struct proxy *px,
+                                    struct session *sess, struct stream *s,
+                                    unsigned int opt, int *matched)
+{
+	struct act_rule_dispatch_key *key;
+	struct ebmb_node *node;
+	struct buffer *str;
+	struct sample smp;
+	int best = d->nb_rules;
+	int i;
+
+	for (i = 0; i < d->nb_rules; i++) {
+		if (HA_ATOMIC_LOAD(&d->refs[i]->revision) != d->revisions[i])
+			return NULL;
+	}
+
+	memset(&smp, 0, sizeof(smp));
+	while (sample_process(px, sess, s, opt | SMP_OPT_ITERATE, d->expr, &smp)) {
+		if (smp.data.type == SMP_T_STR || sample_convert(&smp, SMP_T_STR)) {
+			str = get_trash_chunk();
+			if (smp.data.u.str.data < str->size) {
+				if (d->icase) {
+					for (i = 0; i < smp.data.u.str.data; i++)
+						str->area[i] = tolower((unsigned char)smp.data.u.str.area[i]);
+				}
+				else
+					memcpy(str->area, smp.data.u.str.area, smp.data.u.str.data);
+				str->area[smp.data.u.str.data] = 0;
+
+				node = ebst_lookup(&d->keys, str->area);
+				if (node) {
+					key = ebmb_entry(node, struct act_rule_dispatch_key, node);
+					if (key->idx < best)
+						best = key->idx;
+				}
+			}
+		}
+
+		if (!best || !(smp.flags & SMP_F_NOT_LAST))
+			break;
+	}
+
+	*matched = best < d->nb_rules;
+	return d->rules[*matched ? best : d->nb_rules - 1];
+}
+
+/* Resets the profiling counters of the rules of list <rules> */
+static void http_rules_prof_reset_list(struct proxy *px, struct list *rules, int dir, void *ctx)
+{
+	struct act_rule *rule;
+
+	list_for_each_entry(rule, rules, list) {
+		HA_ATOMIC_STORE(&rule->calls, 0);
+		HA_ATOMIC_STORE(&rule->cpu_time, 0);
+	}
+}
+
+/* Resets the profiling counters of all http-request/response rules */
+void http_rules_prof_reset(void)
+{
+	http_rules_foreach_list(http_rules_prof_reset_list, NULL);
+}
+
+static const char *http_rules_dir_names[3] = { "http-request", "http-response", "http-after-response" };
+
+/* one entry of the snapshot dumped by "show rules-profile" */
+struct rule_prof_entry {
+	uint64_t calls;
+	uint64_t cpu_time;
+	char loc[64];
+	char text[128];
+};
+
+/* context for "show rules-profile" */
+struct show_rules_prof_ctx {
+	struct rule_prof_entry *entries; /* snapshot sorted by decreasing CPU time */
+	int count;                       /* number of valid entries */
+	int max;                         /* allocated entries */
+	int pos;                         /* next entry to dump */
+};
+
+/* Adds the rules of list <rules> to the "show rules-profile" snapshot in
+ * <ctx>, keeping only the ones having used the most CPU.
+ */
+static void http_rules_prof_snapshot(struct proxy *px, struct list *rules, int dir, void *ctx)
+{
+	struct show_rules_prof_ctx *sctx = ctx;
+	struct rule_prof_entry *ent;
+	struct act_rule *rule;
+	int i;
+
+	list_for_each_entry(rule, rules, list) {
+		uint64_t cpu_time = HA_ATOMIC_LOAD(&rule->cpu_time);
+		uint64_t calls = HA_ATOMIC_LOAD(&rule->calls);
+
+		/* rules resolved by a dispatch table only account for their
+		 * action's time.
+		 */
+		if (!calls && !cpu_time)
+			continue;
+
+		/* insertion sort, dropping the last entry when full */
+		for (i = sctx->count; i > 0 && sctx->entries[i - 1].cpu_time < cpu_time; i--) {
+			if (i < sctx->max)
+				sctx->entries[i] = sctx->entries[i - 1];
+		}
+		if (i >= sctx->max)
+			continue;
+		if (sctx->count < sctx->max)
+			sctx->count++;
+
+		ent = &sctx->entries[i];
+		ent->calls = calls;
+		ent->cpu_time = cpu_time;
+		snprintf(ent->loc, sizeof(ent->loc), "%s:%d", rule->conf.file ? rule->conf.file : "?", rule->conf.line);
+		if (rule->dispatch)
+			snprintf(ent->text, sizeof(ent->text), "%s %s %s (dispatch of %d rules)",
+			         px->id, http_rules_dir_names[dir],
+			         rule->kw ? rule->kw->kw : "?", rule->dispatch->nb_rules);
+		else
+			snprintf(ent->text, sizeof(ent->text), "%s %s %s",
+			         px->id, http_rules_dir_names[dir],
+			         rule->kw ? rule->kw->kw : "?");
+	}
+}
+
+/* parses "show rules-profile [<max>]". A snapshot of the <max> (default 20)
+ * http-request/response rules having used the most CPU is taken at once.
+ */
+static int cli_parse_show_rules_profile(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct show_rules_prof_ctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+
+	if (!cli_has_level(appctx, ACCESS_LVL_OPER))
+		return 1;
+
+	ctx->max = 20;
+	if (*args[2]) {
+		ctx->max = atoi(args[2]);
+		if (ctx->max <= 0 || ctx->max > 1000)
+			return cli_err(appctx, "Expects a max number of rules between 1 and 1000.\n");
+	}
+
+	ctx->entries = calloc(ctx->max, sizeof(*ctx->entries));
+	if (!ctx->entries)
+		return cli_err(appctx, "Out of memory.\n");
+
+	http_rules_foreach_list(http_rules_prof_snapshot, ctx);
+	return 0;
+}
+
+/* dumps the snapshot taken by cli_parse_show_rules_profile(). Returns 0 if
+ * the output buffer is full and it needs to be called again, otherwise 1.
+ */
+static int cli_io_handler_show_rules_profile(struct appctx *appctx)
+{
+	struct show_rules_prof_ctx *ctx = appctx->svcctx;
+	struct rule_prof_entry *ent;
+
+	if (!ctx->pos) {
+		chunk_printf(&trash, "HTTP rules profiling is %s (set profiling rules {on|off}).\n"
+		             "  calls      cpu_tot(us)   cpu_avg(ns)  location                      rule\n",
+		             (profiling & HA_PROF_RULES) ? "on" : "off");
+		if (applet_putchk(appctx, &trash) == -1)
+			return 0;
+		ctx->pos = 1;
+	}
+
+	while (ctx->pos <= ctx->count) {
+		ent = &ctx->entries[ctx->pos - 1];
+		chunk_printf(&trash, "  %-10llu %-13llu %-12llu %-29s %s\n",
+		             (unsigned long long)ent->calls, (unsigned long long)(ent->cpu_time / 1000),
+		             (unsigned long long)(ent->calls ? ent->cpu_time / ent->calls : 0), ent->loc, ent->text);
+		if (applet_putchk(appctx, &trash) == -1)
+			return 0;
+		ctx->pos++;
+	}
+	return 1;
+}
+
+static void cli_release_show_rules_profile(struct appctx *appctx)
+{
+	struct show_rules_prof_ctx *ctx = appctx->svcctx;
+
+	ha_free(&ctx->entries);
+}
+
+static struct cli_kw_list cli_kws = {{ },{
+	{ { "show", "rules-profile", NULL }, "show rules-profile [<max>]               : show the http-request/response rules using the most CPU", cli_parse_show_rules_profile, cli_io_handler_show_rules_profile, cli_release_show_rules_profile },
+	{{},}
+}};
+
+INITCALL1(STG_REGISTER, cli_register_kw, &cli_kws);
+
 /*
  * Local variables:
  *  c-indent-level: 8
@@ -324,6 +324,7 @@ struct htx_blk *htx_add_blk(struct htx *htx, enum htx_blk_type type, uint32_t bl
 	BUG_ON(blk->addr > htx->size);
 
 	blk->info = (type << 28);
+	htx_blk_changed(htx, type);
 	return blk;
 }
 
@@ -338,16 +339,21 @@ struct htx_blk *htx_remove_blk(struct htx *htx, struct htx_blk *blk)
 
 	BUG_ON(!blk || htx->head == -1);
 
+	type = htx_get_blk_type(blk);
+
 	/* This is the last block in use */
 	if (htx->head == htx->tail) {
 		uint32_t flags = (htx->flags & ~HTX_FL_FRAGMENTED); /* Preserve flags except FRAGMENTED */
+		uint32_t gen = htx->gen;
 
 		htx_reset(htx);
 		htx->flags = flags; /* restore flags */
+		htx->gen = gen;
+		htx_blk_changed(htx, type);
 		return NULL;
 	}
 
-	type = htx_get_blk_type(blk);
+	htx_blk_changed(htx, type);
 	pos  = htx_get_blk_pos(htx, blk);
 	sz   = htx_get_blksz(blk);
 	addr = blk->addr;
@@ -464,9 +470,13 @@ struct htx_ret htx_drain(struct htx *htx, uint32_t count)
 
 	if (count == htx->data) {
 		uint32_t flags = (htx->flags & ~HTX_FL_FRAGMENTED); /* Preserve flags except FRAGMENTED */
+		uint32_t gen = htx->gen;
+		enum htx_blk_type type = htx_get_head_type(htx);
 
 		htx_reset(htx);
 		htx->flags = flags; /* restore flags */
+		htx->gen = gen;
+		htx_blk_changed(htx, type);
 		htxret.ret = count;
 		return htxret;
 	}
@@ -596,6 +606,7 @@ struct htx_blk *htx_replace_blk_value(struct htx *htx, struct htx_blk *blk,
 	ret = htx_prepare_blk_expansion(htx, blk, delta);
 	if (!ret)
 		return NULL; /* not enough space */
+	htx_blk_changed(htx, htx_get_blk_type(blk));
 
 	if (ret == 1) { /* Replace in place */
 		if (delta <= 0) {
@@ -708,6 +719,7 @@ struct htx_ret htx_xfer_blks(struct htx *dst, struct htx *src, uint32_t count,
 		if (!dstblk)
 			break;
 		dstblk->info = info;
+		htx_blk_changed(dst, type);
 		memcpy(htx_get_blk_ptr(dst, dstblk), htx_get_blk_ptr(src, blk), sz);
 
 		count -= sizeof(dstblk) + sz;
@@ -791,6 +803,7 @@ struct htx_blk *htx_replace_header(struct htx *htx, struct htx_blk *blk,
 	ret = htx_prepare_blk_expansion(htx, blk, delta);
 	if (!ret)
 		return NULL; /* not enough space */
+	htx->gen++;
 
 
 	/* Replace in place or at a new address is the same. We replace all the
@@ -839,6 +852,7 @@ struct htx_sl *htx_replace_stline(struct htx *htx, struct htx_blk *blk, const st
 	ret = htx_prepare_blk_expansion(htx, blk, delta);
 	if (!ret)
 		return NULL; /* not enough space */
+	htx->gen++;
 
 	/* Replace in place or at a new address is the same. We replace all the
 	 * start-line. Only take care to defrag the message if necessary. */
@@ -1039,6 +1053,8 @@ void htx_move_blk_before(struct htx *htx, struct htx_blk **blk, struct htx_blk *
 {
 	struct htx_blk *cblk, *pblk;
 
+	/* moving any block also moves the headers it passes over */
+	htx->gen++;
 	cblk = *blk;
 	for (pblk = htx_get_prev_blk(htx, cblk); pblk; pblk = htx_get_prev_blk(htx, pblk)) {
 		/* Swap .addr and .info fields */
@@ -26,8 +26,10 @@
 #include <haproxy/api.h>
 #include <haproxy/applet.h>
 #include <haproxy/cfgparse.h>
+#include <haproxy/cli.h>
 #include <haproxy/clock.h>
 #include <haproxy/fd.h>
+#include <haproxy/freq_ctr.h>
 #include <haproxy/frontend.h>
 #include <haproxy/global.h>
 #include <haproxy/http.h>
@@ -229,6 +231,7 @@ struct logformat_var_args var_args_list[] = {
 	{ "Q", LOG_OPT_QUOTE },
 	{ "X", LOG_OPT_HEXA },
 	{ "E", LOG_OPT_ESC },
+	{ "B", LOG_OPT_BIN },
 	{  0,  0 }
 };
 
@@ -487,13 +490,14 @@ int add_sample_to_logformat_list(char *text, char *arg, int arg_len, struct prox
  *  fmt: the string to parse
  *  curproxy: the proxy affected
  *  list_format: the destination list
- *  options: LOG_OPT_* to force on every node
+ *  options: LOG_OPT_* to force on every node, LOG_OPT_BIN_OK allows binary lines
  *  cap: all SMP_VAL_* flags supported by the consumer
  *
  * The function returns 1 in success case, otherwise, it returns 0 and err is filled.
  */
 int parse_logformat_string(const char *fmt, struct proxy *curproxy, struct list *list_format, int options, int cap, char **err)
 {
+	struct logformat_node *node;
 	char *sp, *str, *backfmt; /* start pointer for text parts */
 	char *arg = NULL; /* start pointer for args */
 	char *var = NULL; /* start pointer for vars */
@@ -501,8 +505,10 @@ int parse_logformat_string(const char *fmt, struct proxy *curproxy, struct list
 	int var_len = 0;
 	int cformat; /* current token format */
 	int pformat; /* previous token format */
+	int bin_ok = options & LOG_OPT_BIN_OK;
 	struct logformat_node *tmplf, *back;
 
+	options &= ~LOG_OPT_BIN_OK;
 	sp = str = backfmt = strdup(fmt);
 	if (!str) {
 		memprintf(err, "out of memory error");
@@ -652,6 +658,25 @@ int parse_logformat_string(const char *fmt, struct proxy *curproxy, struct list
 		memprintf(err, "truncated line after '%s'", var ? var : arg ? arg : "%");
 		goto fail;
 	}
+
+	/* a single binary node turns the whole line into a binary one, in
+	 * which case quoting, escaping and textual representations are
+	 * meaningless.
+	 */
+	list_for_each_entry(node, list_format, list) {
+		if (node->options & LOG_OPT_BIN)
+			break;
+	}
+	if (&node->list != list_format) {
+		if (!bin_ok) {
+			memprintf(err, "the binary encoding flag 'B' is only supported by 'log-format' and 'error-log-format'");
+			goto fail;
+		}
+		list_for_each_entry(node, list_format, list) {
+			node->options |= LOG_OPT_BIN;
+			node->options &= ~(LOG_OPT_QUOTE | LOG_OPT_ESC | LOG_OPT_MANDATORY | LOG_OPT_HEXA);
+		}
+	}
 	free(backfmt);
 
 	return 1;
@@ -998,6 +1023,37 @@ int parse_logsrv(char **args, struct list *logsrvs, int do_del, const char *file
 
 		cur_arg += 2;
 	}
+
+	/* adaptive sampling: lines per second budget, optionally followed by
+	 * the duration above which streams are always logged.
+	 */
+	if (strcmp(args[cur_arg], "max-rate") == 0) {
+		const char *res;
+
+		logsrv->adapt.max_rate = atoi(args[cur_arg+1]);
+		if (!logsrv->adapt.max_rate) {
+			memprintf(err, "'max-rate' expects a strictly positive number of lines per second");
+			goto error;
+		}
+		cur_arg += 2;
+
+		if (strcmp(args[cur_arg], "slow") == 0) {
+			res = parse_time_err(args[cur_arg+1], &logsrv->adapt.slow, TIME_UNIT_MS);
+			if (res == PARSE_TIME_OVER) {
+				memprintf(err, "timer overflow in argument '%s' to 'slow' (maximum value is 2147483647 ms or ~24.8 days)", args[cur_arg+1]);
+				goto error;
+			}
+			else if (res == PARSE_TIME_UNDER) {
+				memprintf(err, "timer underflow in argument '%s' to 'slow' (minimum non-null value is 1 ms)", args[cur_arg+1]);
+				goto error;
+			}
+			else if (res) {
+				memprintf(err, "unexpected character '%c' in argument to 'slow'", *res);
+				goto error;
+			}
+			cur_arg += 2;
+		}
+	}
 	HA_SPIN_INIT(&logsrv->lock);
 	/* parse the facility */
 	logsrv->facility = get_log_facility(args[cur_arg]);
@@ -1141,7 +1197,17 @@ static char *lf_encode_string(char *start, char *stop,
                               const char *string,
                               struct logformat_node *node)
 {
-	if (node->options & LOG_OPT_ESC) {
+	if (node->options & LOG_OPT_BIN) {
+		size_t len = strlen(string);
+
+		if (start + len >= stop)
+			return NULL;
+		memcpy(start, string, len);
+		start += len;
+		*start = '\0';
+		return start;
+	}
+	else if (node->options & LOG_OPT_ESC) {
 		if (start < stop) {
 			stop--; /* reserve one byte for the final '\0' */
 			while (start < stop && *string != '\0') {
@@ -1191,7 +1257,15 @@ static char *lf_encode_chunk(char *start, char *stop,
 {
 	char *str, *end;
 
-	if (node->options & LOG_OPT_ESC) {
+	if (node->options & LOG_OPT_BIN) {
+		if (start + chunk->data >= stop)
+			return NULL;
+		memcpy(start, chunk->area, chunk->data);
+		start += chunk->data;
+		*start = '\0';
+		return start;
+	}
+	else if (node->options & LOG_OPT_ESC) {
 		if (start < stop) {
 			str = chunk->area;
 			end = chunk->area + chunk->data;
@@ -1236,6 +1310,19 @@ static char *lf_encode_chunk(char *start, char *stop,
  */
 char *lf_text_len(char *dst, const char *src, size_t len, size_t size, const struct logformat_node *node)
 {
+	if (node->options & LOG_OPT_BIN) {
+		/* raw bytes, a missing value is left empty */
+		if (len >= size)
+			return NULL;
+		if (src && len)
+			memcpy(dst, src, len);
+		else
+			len = 0;
+		dst += len;
+		*dst = '\0';
+		return dst;
+	}
+
 	if (size < 2)
 		return NULL;
 
@@ -1284,9 +1371,148 @@ char *lf_text_len(char *dst, const char *src, size_t len, size_t size, const str
 
 static inline char *lf_text(char *dst, const char *src, size_t size, const struct logformat_node *node)
 {
+	if (node->options & LOG_OPT_BIN)
+		return lf_text_len(dst, src, src ? strlen(src) : 0, size, node);
 	return lf_text_len(dst, src, size, size, node);
 }
 
+/*
+ * Write a signed integer to the log string
+ * +B option writes it as a zigzag-encoded varint
+ *
+ * Return the address of the \0 character, or NULL on error
+ */
+static char *lf_int(char *dst, long long v, size_t size, const struct logformat_node *node)
+{
+	char *end = dst + size;
+
+	if (!(node->options & LOG_OPT_BIN))
+		return lltoa(v, dst, size);
+
+	if (encode_varint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63), &dst, end) == -1 || dst >= end)
+		return NULL;
+	*dst = '\0';
+	return dst;
+}
+
+/* Returns the LOG_BIN_T_* value type used to encode nodes of type <type> in
+ * binary log lines.
+ */
+static int lf_bin_type(int type)
+{
+	switch (type) {
+	case LOG_FMT_CLIENTIP:
+	case LOG_FMT_FRONTENDIP:
+	case LOG_FMT_BACKENDIP:
+	case LOG_FMT_SERVERIP:
+		return LOG_BIN_T_ADDR;
+
+	case LOG_FMT_CLIENTPORT:
+	case LOG_FMT_FRONTENDPORT:
+	case LOG_FMT_BACKENDPORT:
+	case LOG_FMT_SERVERPORT:
+	case LOG_FMT_COUNTER:
+	case LOG_FMT_LOGCNT:
+	case LOG_FMT_PID:
+	case LOG_FMT_DATE:
+	case LOG_FMT_DATEGMT:
+	case LOG_FMT_DATELOCAL:
+	case LOG_FMT_TS:
+	case LOG_FMT_MS:
+	case LOG_FMT_BYTES:
+	case LOG_FMT_BYTES_UP:
+	case LOG_FMT_Ta:
+	case LOG_FMT_Th:
+	case LOG_FMT_Ti:
+	case LOG_FMT_TQ:
+	case LOG_FMT_TW:
+	case LOG_FMT_TC:
+	case LOG_FMT_Tr:
+	case LOG_FMT_tr:
+	case LOG_FMT_trg:
+	case LOG_FMT_trl:
+	case LOG_FMT_TR:
+	case LOG_FMT_TD:
+	case LOG_FMT_TT:
+	case LOG_FMT_TU:
+	case LOG_FMT_STATUS:
+	case LOG_FMT_ACTCONN:
+	case LOG_FMT_FECONN:
+	case LOG_FMT_BECONN:
+	case LOG_FMT_SRVCONN:
+	case LOG_FMT_RETRIES:
+	case LOG_FMT_SRVQUEUE:
+	case LOG_FMT_BCKQUEUE:
+		return LOG_BIN_T_INT;
+
+	default:
+		return LOG_BIN_T_STR;
+	}
+}
+
+/*
+ * Turns the value emitted between <start> and <end> into a complete binary
+ * field for a node of type <type>, by inserting the field's key and length in
+ * front of it. <limit> is the end of the output area.
+ *
+ * Return the address of the \0 character, or NULL on error
+ */
+static char *lf_bin_field(char *start, char *end, char *limit, int type)
+{
+	char hdr[20];
+	char *p = hdr;
+	size_t len = end - start;
+
+	encode_varint(((uint64_t)type << LOG_BIN_T_BITS) | lf_bin_type(type), &p, hdr + sizeof(hdr));
+	encode_varint(len, &p, hdr + sizeof(hdr));
+	if (end + (p - hdr) >= limit)
+		return NULL;
+
+	memmove(start + (p - hdr), start, len);
+	memcpy(start, hdr, p - hdr);
+	end += p - hdr;
+	*end = '\0';
+	return end;
+}
+
+/* Returns the exact length of the binary log line starting at <msg> according
+ * to its header, or 0 if <size> bytes are not enough to hold it or it is not a
+ * binary line. This is used to get rid of any trailing byte added by the
+ * transport without touching the line's contents. Since a text line may also
+ * start with the magic byte, only LF or zero bytes may follow the announced
+ * length, otherwise the line is not considered as binary.
+ */
+size_t lf_bin_len(const char *msg, size_t size)
+{
+	char *p = (char *)msg + 1;
+	const char *end;
+	uint64_t len;
+
+	if (!size || (unsigned char)*msg != LOG_BIN_MAGIC)
+		return 0;
+
+	if (decode_varint(&p, (char *)msg + size, &len) == -1 || len > msg + size - p)
+		return 0;
+
+	for (end = p + len; end < msg + size; end++) {
+		if (*end != '\n' && *end != 0)
+			return 0;
+	}
+
+	return p - msg + len;
+}
+
+/*
+ * Write a date to the log string as a number of microseconds since the epoch,
+ * only used with the +B option as textual dates are specific to each variable.
+ *
+ * Return the address of the \0 character, or NULL on error
+ */
+static inline char *lf_date(char *dst, const struct timeval *tv, size_t size, const struct logformat_node *node)
+{
+	return lf_int(dst, (long long)tv->tv_sec * 1000000 + tv->tv_usec, size, node);
+}
+
 /*
  * Write a IP address to the log string
  * +X option write in hexadecimal notation, most significant byte on the left
@@ -1297,7 +1523,23 @@ char *lf_ip(char *dst, const struct sockaddr *sockaddr, size_t size, const struc
 	int iret;
 	char pn[INET6_ADDRSTRLEN];
 
-	if (node->options & LOG_OPT_HEXA) {
+	if (node->options & LOG_OPT_BIN) {
+		const void *addr = NULL;
+		size_t len = 0;
+
+		switch (sockaddr->sa_family) {
+		case AF_INET:
+			addr = &((struct sockaddr_in *)sockaddr)->sin_addr.s_addr;
+			len = 4;
+			break;
+		case AF_INET6:
+			addr = &((struct sockaddr_in6 *)sockaddr)->sin6_addr.s6_addr;
+			len = 16;
+			break;
+		}
+		return lf_text_len(dst, addr, len, size, node);
+	}
+	else if (node->options & LOG_OPT_HEXA) {
 		unsigned char *addr = NULL;
 		switch (sockaddr->sa_family) {
 		case AF_INET:
@@ -1341,7 +1583,7 @@ char *lf_port(char *dst, const struct sockaddr *sockaddr, size_t size, const str
 			return NULL;
 		ret += iret;
 	} else {
-		ret = ltoa_o(get_host_port((struct sockaddr_storage *)sockaddr), dst, size);
+		ret = lf_int(dst, get_host_port((struct sockaddr_storage *)sockaddr), size, node);
 		if (ret == NULL)
 			return NULL;
 	}
@@ -1368,7 +1610,7 @@ void send_log(struct proxy *p, int level, const char *format, ...)
 	va_end(argp);
 
 	__send_log((p ? &p->logsrvs : NULL), (p ? &p->log_tag : NULL), level,
-		   logline, data_len, default_rfc5424_sd_log_format, 2);
+		   logline, data_len, default_rfc5424_sd_log_format, 2, -1);
 }
 /*
  * This function builds a log header of given format using given
@@ -1692,15 +1934,23 @@ static inline void __do_send_log(struct logsrv *logsrv, int nblogger, int level,
 	int *plogfd;
 	int sent;
 	size_t nbelem;
+	size_t bin_len;
 	struct ist *msg_header = NULL;
 
 	msghdr.msg_iov = iovec;
 
-	/* historically some messages used to already contain the trailing LF
-	 * or Zero. Let's remove all trailing LF or Zero
+	/* binary lines carry their own length and may legitimately end with
+	 * LF or zero bytes. Otherwise, historically some messages used to
+	 * already contain the trailing LF or Zero. Let's remove all trailing
+	 * LF or Zero.
 	 */
-	while (size && (message[size-1] == '\n' || (message[size-1] == 0)))
-		size--;
+	bin_len = lf_bin_len(message, size);
+	if (bin_len)
+		size = bin_len;
+	else {
+		while (size && (message[size-1] == '\n' || (message[size-1] == 0)))
+			size--;
+	}
 
 	if (logsrv->type == LOG_TARGET_BUFFER) {
 		plogfd = NULL;
@@ -1805,15 +2055,58 @@ static inline void __do_send_log(struct logsrv *logsrv, int nblogger, int level,
 	}
 }
 
+/*
+ * Adaptive sampling for log server <logsrv> configured with a "max-rate".
+ * Returns non-zero if a line of level <level> relative to a stream which
+ * lasted <duration> milliseconds must be sent, otherwise zero. A negative
+ * <duration> indicates a line which must always be sent (error, anomaly,
+ * event). Warnings, errors and slow streams are always sent, and count
+ * against the budget. The other lines are sampled with a probability
+ * matching the remaining budget over the rate at which they are offered,
+ * so that the sampling ratio automatically follows the traffic.
+ */
+static int logsrv_adaptive_keep(struct logsrv *logsrv, int level, int duration)
+{
+	struct smp_adaptive *adapt = &logsrv->adapt;
+	unsigned int offered, budget;
+
+	if (duration < 0 || level <= LOG_WARNING ||
+	    (adapt->slow && duration >= adapt->slow)) {
+		update_freq_ctr(&adapt->prio, 1);
+		goto keep;
+	}
+
+	update_freq_ctr(&adapt->offered, 1);
+	offered = read_freq_ctr(&adapt->offered);
+	budget = read_freq_ctr(&adapt->prio);
+	budget = (budget < adapt->max_rate) ? adapt->max_rate - budget : 0;
+
+	if (offered > budget && statistical_prng_range(offered) >= budget)
+		goto drop;
+
+	/* hard limit in case of sudden bursts */
+	if (!freq_ctr_remain(&adapt->sent, adapt->max_rate, 0))
+		goto drop;
+ keep:
+	update_freq_ctr(&adapt->sent, 1);
+	_HA_ATOMIC_INC(&adapt->kept);
+	return 1;
+ drop:
+	_HA_ATOMIC_INC(&adapt->dropped);
+	return 0;
+}
+
 /*
  * This function sends a syslog message.
  * It doesn't care about errors nor does it report them.
  * The argument <metadata> MUST be an array of size
  * LOG_META_FIELDS*sizeof(struct ist)  containing
- * data to build the header.
+ * data to build the header. <duration> is the total time in milliseconds
+ * of the stream the message is about, used by adaptive sampling to always
+ * keep slow streams, or -1 if the message must never be sampled out.
  */
 void process_send_log(struct list *logsrvs, int level, int facility,
-	                struct ist *metadata, char *message, size_t size)
+	                struct ist *metadata, char *message, size_t size, int duration)
 {
 	struct logsrv *logsrv;
 	int nblogger;
@@ -1844,6 +2137,11 @@ void process_send_log(struct list *logsrvs, int level, int facility,
 			logsrv->lb.curr_idx = (logsrv->lb.curr_idx + 1) % logsrv->lb.smp_sz;
 			HA_SPIN_UNLOCK(LOGSRV_LOCK, &logsrv->lock);
 		}
+
+		/* targets inherited using "log global" share the global budget */
+		if (in_range && logsrv->adapt.max_rate)
+			in_range = logsrv_adaptive_keep(logsrv->ref ? logsrv->ref : logsrv, level, duration);
+
 		if (in_range)
 			__do_send_log(logsrv, ++nblogger,  MAX(level, logsrv->minlvl),
 			              (facility == -1) ? logsrv->facility : facility,
@@ -1855,10 +2153,11 @@ void process_send_log(struct list *logsrvs, int level, int facility,
  * This function sends a syslog message.
  * It doesn't care about errors nor does it report them.
  * The arguments <sd> and <sd_size> are used for the structured-data part
- * in RFC5424 formatted syslog messages.
+ * in RFC5424 formatted syslog messages. <duration> is passed to the adaptive
+ * sampling, see process_send_log().
  */
 void __send_log(struct list *logsrvs, struct buffer *tagb, int level,
-		char *message, size_t size, char *sd, size_t sd_size)
+		char *message, size_t size, char *sd, size_t sd_size, int duration)
 {
 	static THREAD_LOCAL pid_t curr_pid;
 	static THREAD_LOCAL char pidstr[16];
@@ -1898,7 +2197,7 @@ void __send_log(struct list *logsrvs, struct buffer *tagb, int level,
 	while (metadata[LOG_META_STDATA].len && metadata[LOG_META_STDATA].ptr[metadata[LOG_META_STDATA].len-1] == ' ')
 		metadata[LOG_META_STDATA].len--;
 
-	return process_send_log(logsrvs, level, -1, metadata, message, size);
+	return process_send_log(logsrvs, level, -1, metadata, message, size, duration);
 }
 
 const char sess_cookie[8]     = "NIDVEOU7";	/* No cookie, Invalid cookie, cookie for a Down server, Valid cookie, Expired cookie, Old cookie, Unused, unknown */
@@ -2047,6 +2346,9 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 	struct strm_logs tmp_strm_log;
 	struct ist path;
 	struct http_uri_parser parser;
+	char *bin_start = NULL;
+	char *bin_field = NULL;
+	char *bin_end = NULL;
 
 	/* FIXME: let's limit ourselves to frontend logging for now. */
 
@@ -2132,6 +2434,18 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 	if (LIST_ISEMPTY(list_format))
 		return 0;
 
+	if (LIST_NEXT(list_format, struct logformat_node *, list)->options & LOG_OPT_BIN) {
+		/* binary line: the magic is followed by enough room to store
+		 * the final length of the fields area.
+		 */
+		iret = 1 + varint_bytes(maxsize);
+		if (iret >= maxsize)
+			return 0;
+		*tmplog = LOG_BIN_MAGIC;
+		tmplog += iret;
+		bin_start = bin_end = tmplog;
+	}
+
 	list_for_each_entry(tmp, list_format, list) {
 #ifdef USE_OPENSSL
 		struct connection *conn;
@@ -2141,6 +2455,13 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 		struct sample *key;
 		const struct buffer empty = { };
 
+		if (bin_start) {
+			/* text and separators have no meaning in binary lines */
+			if (tmp->type == LOG_FMT_TEXT || tmp->type == LOG_FMT_SEPARATOR)
+				continue;
+			bin_field = tmplog;
+		}
+
 		switch (tmp->type) {
 			case LOG_FMT_SEPARATOR:
 				if (!last_isspace) {
@@ -2202,7 +2523,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				if (addr) {
 					/* sess->listener is always defined when the session's owner is an inbound connections */
 					if (addr->ss_family == AF_UNIX)
-						ret = ltoa_o(sess->listener->luid, tmplog, dst + maxsize - tmplog);
+						ret = lf_int(tmplog, sess->listener->luid, dst + maxsize - tmplog, tmp);
 					else
 						ret = lf_port(tmplog, (struct sockaddr *)addr, dst + maxsize - tmplog, tmp);
 				}
@@ -2233,7 +2554,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				if (addr) {
 					/* sess->listener is always defined when the session's owner is an inbound connections */
 					if (addr->ss_family == AF_UNIX)
-						ret = ltoa_o(sess->listener->luid, tmplog, dst + maxsize - tmplog);
+						ret = lf_int(tmplog, sess->listener->luid, dst + maxsize - tmplog, tmp);
 					else
 						ret = lf_port(tmplog, (struct sockaddr *)addr, dst + maxsize - tmplog, tmp);
 				}
@@ -2295,8 +2616,12 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_DATE: // %t = accept date
-				get_localtime(logs->accept_date.tv_sec, &tm);
-				ret = date2str_log(tmplog, &tm, &logs->accept_date, dst + maxsize - tmplog);
+				if (tmp->options & LOG_OPT_BIN)
+					ret = lf_date(tmplog, &logs->accept_date, dst + maxsize - tmplog, tmp);
+				else {
+					get_localtime(logs->accept_date.tv_sec, &tm);
+					ret = date2str_log(tmplog, &tm, &logs->accept_date, dst + maxsize - tmplog);
+				}
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2306,8 +2631,12 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 			case LOG_FMT_tr: // %tr = start of request date
 				/* Note that the timers are valid if we get here */
 				tv_ms_add(&tv, &logs->accept_date, logs->t_idle >= 0 ? logs->t_idle + logs->t_handshake : 0);
-				get_localtime(tv.tv_sec, &tm);
-				ret = date2str_log(tmplog, &tm, &tv, dst + maxsize - tmplog);
+				if (tmp->options & LOG_OPT_BIN)
+					ret = lf_date(tmplog, &tv, dst + maxsize - tmplog, tmp);
+				else {
+					get_localtime(tv.tv_sec, &tm);
+					ret = date2str_log(tmplog, &tm, &tv, dst + maxsize - tmplog);
+				}
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2315,8 +2644,12 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_DATEGMT: // %T = accept date, GMT
-				get_gmtime(logs->accept_date.tv_sec, &tm);
-				ret = gmt2str_log(tmplog, &tm, dst + maxsize - tmplog);
+				if (tmp->options & LOG_OPT_BIN)
+					ret = lf_date(tmplog, &logs->accept_date, dst + maxsize - tmplog, tmp);
+				else {
+					get_gmtime(logs->accept_date.tv_sec, &tm);
+					ret = gmt2str_log(tmplog, &tm, dst + maxsize - tmplog);
+				}
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2325,8 +2658,12 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 
 			case LOG_FMT_trg: // %trg = start of request date, GMT
 				tv_ms_add(&tv, &logs->accept_date, logs->t_idle >= 0 ? logs->t_idle + logs->t_handshake : 0);
-				get_gmtime(tv.tv_sec, &tm);
-				ret = gmt2str_log(tmplog, &tm, dst + maxsize - tmplog);
+				if (tmp->options & LOG_OPT_BIN)
+					ret = lf_date(tmplog, &tv, dst + maxsize - tmplog, tmp);
+				else {
+					get_gmtime(tv.tv_sec, &tm);
+					ret = gmt2str_log(tmplog, &tm, dst + maxsize - tmplog);
+				}
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2334,8 +2671,12 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_DATELOCAL: // %Tl = accept date, local
-				get_localtime(logs->accept_date.tv_sec, &tm);
-				ret = localdate2str_log(tmplog, logs->accept_date.tv_sec, &tm, dst + maxsize - tmplog);
+				if (tmp->options & LOG_OPT_BIN)
+					ret = lf_date(tmplog, &logs->accept_date, dst + maxsize - tmplog, tmp);
+				else {
+					get_localtime(logs->accept_date.tv_sec, &tm);
+					ret = localdate2str_log(tmplog, logs->accept_date.tv_sec, &tm, dst + maxsize - tmplog);
+				}
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2344,8 +2685,12 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 
 			case LOG_FMT_trl: // %trl = start of request date, local
 				tv_ms_add(&tv, &logs->accept_date, logs->t_idle >= 0 ? logs->t_idle + logs->t_handshake : 0);
-				get_localtime(tv.tv_sec, &tm);
-				ret = localdate2str_log(tmplog, tv.tv_sec, &tm, dst + maxsize - tmplog);
+				if (tmp->options & LOG_OPT_BIN)
+					ret = lf_date(tmplog, &tv, dst + maxsize - tmplog, tmp);
+				else {
+					get_localtime(tv.tv_sec, &tm);
+					ret = localdate2str_log(tmplog, tv.tv_sec, &tm, dst + maxsize - tmplog);
+				}
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2360,7 +2705,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 					last_isspace = 0;
 					tmplog += iret;
 				} else {
-					ret = ltoa_o(logs->accept_date.tv_sec, tmplog, dst + maxsize - tmplog);
+					ret = lf_int(tmplog, logs->accept_date.tv_sec, dst + maxsize - tmplog, tmp);
 					if (ret == NULL)
 						goto out;
 					tmplog = ret;
@@ -2375,6 +2720,11 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 						goto out;
 					last_isspace = 0;
 					tmplog += iret;
+			} else if (tmp->options & LOG_OPT_BIN) {
+				ret = lf_int(tmplog, logs->accept_date.tv_usec / 1000, dst + maxsize - tmplog, tmp);
+				if (ret == NULL)
+					goto out;
+				tmplog = ret;
 			} else {
 				if ((dst + maxsize - tmplog) < 4)
 					goto out;
@@ -2473,7 +2823,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_Th: // %Th = handshake time
-				ret = ltoa_o(logs->t_handshake, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, logs->t_handshake, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2481,7 +2831,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_Ti: // %Ti = HTTP idle time
-				ret = ltoa_o(logs->t_idle, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, logs->t_idle, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2489,8 +2839,8 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_TR: // %TR = HTTP request time
-				ret = ltoa_o((t_request >= 0) ? t_request - logs->t_idle - logs->t_handshake : -1,
-				             tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, (t_request >= 0) ? t_request - logs->t_idle - logs->t_handshake : -1,
+				             dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2498,7 +2848,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_TQ: // %Tq = Th + Ti + TR
-				ret = ltoa_o(t_request, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, t_request, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2506,8 +2856,8 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_TW: // %Tw
-				ret = ltoa_o((logs->t_queue >= 0) ? logs->t_queue - t_request : -1,
-						tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, (logs->t_queue >= 0) ? logs->t_queue - t_request : -1,
+				             dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2515,8 +2865,8 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_TC: // %Tc
-				ret = ltoa_o((logs->t_connect >= 0) ? logs->t_connect - logs->t_queue : -1,
-						tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, (logs->t_connect >= 0) ? logs->t_connect - logs->t_queue : -1,
+				             dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2524,8 +2874,8 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_Tr: // %Tr
-				ret = ltoa_o((logs->t_data >= 0) ? logs->t_data - logs->t_connect : -1,
-						tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, (logs->t_data >= 0) ? logs->t_data - logs->t_connect : -1,
+				             dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2534,11 +2884,11 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 
 			case LOG_FMT_TD: // %Td
 				if (be->mode == PR_MODE_HTTP)
-					ret = ltoa_o((logs->t_data >= 0) ? logs->t_close - logs->t_data : -1,
-					             tmplog, dst + maxsize - tmplog);
+					ret = lf_int(tmplog, (logs->t_data >= 0) ? logs->t_close - logs->t_data : -1,
+					             dst + maxsize - tmplog, tmp);
 				else
-					ret = ltoa_o((logs->t_connect >= 0) ? logs->t_close - logs->t_connect : -1,
-					             tmplog, dst + maxsize - tmplog);
+					ret = lf_int(tmplog, (logs->t_connect >= 0) ? logs->t_close - logs->t_connect : -1,
+					             dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2546,10 +2896,10 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_Ta:  // %Ta = active time = Tt - Th - Ti
-				if (!(fe->to_log & LW_BYTES))
+				if (!(fe->to_log & LW_BYTES) && !(tmp->options & LOG_OPT_BIN))
 					LOGCHAR('+');
-				ret = ltoa_o(logs->t_close - (logs->t_idle >= 0 ? logs->t_idle + logs->t_handshake : 0),
-					     tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, logs->t_close - (logs->t_idle >= 0 ? logs->t_idle + logs->t_handshake : 0),
+				             dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2557,9 +2907,9 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_TT:  // %Tt = total time
-				if (!(fe->to_log & LW_BYTES))
+				if (!(fe->to_log & LW_BYTES) && !(tmp->options & LOG_OPT_BIN))
 					LOGCHAR('+');
-				ret = ltoa_o(logs->t_close, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, logs->t_close, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2567,10 +2917,10 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_TU:  // %Tu = total time seen by user = Tt - Ti
-				if (!(fe->to_log & LW_BYTES))
+				if (!(fe->to_log & LW_BYTES) && !(tmp->options & LOG_OPT_BIN))
 					LOGCHAR('+');
-				ret = ltoa_o(logs->t_close - (logs->t_idle >= 0 ? logs->t_idle : 0),
-					     tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, logs->t_close - (logs->t_idle >= 0 ? logs->t_idle : 0),
+				             dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2578,7 +2928,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_STATUS: // %ST
-				ret = ltoa_o(status, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, status, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2586,9 +2936,9 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_BYTES: // %B
-				if (!(fe->to_log & LW_BYTES))
+				if (!(fe->to_log & LW_BYTES) && !(tmp->options & LOG_OPT_BIN))
 					LOGCHAR('+');
-				ret = lltoa(logs->bytes_out, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, logs->bytes_out, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2596,7 +2946,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_BYTES_UP: // %U
-				ret = lltoa(logs->bytes_in, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, logs->bytes_in, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2637,7 +2987,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_ACTCONN: // %ac
-				ret = ltoa_o(actconn, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, actconn, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2645,7 +2995,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_FECONN:  // %fc
-				ret = ltoa_o(fe->feconn, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, fe->feconn, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2653,7 +3003,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_BECONN:  // %bc
-				ret = ltoa_o(be->beconn, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, be->beconn, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2663,16 +3013,15 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 			case LOG_FMT_SRVCONN:  // %sc
 				switch (obj_type(s ? s->target : sess->origin)) {
 				case OBJ_TYPE_SERVER:
-					ret = ultoa_o(__objt_server(s->target)->cur_sess,
-						      tmplog, dst + maxsize - tmplog);
+					ret = lf_int(tmplog, __objt_server(s->target)->cur_sess, dst + maxsize - tmplog, tmp);
 					break;
 				case OBJ_TYPE_CHECK:
-					ret = ultoa_o(__objt_check(sess->origin)->server
+					ret = lf_int(tmplog, __objt_check(sess->origin)->server
 						      ? __objt_check(sess->origin)->server->cur_sess
-						      : 0, tmplog, dst + maxsize - tmplog);
+						      : 0, dst + maxsize - tmplog, tmp);
 					break;
 				default:
-					ret = ultoa_o(0, tmplog, dst + maxsize - tmplog);
+					ret = lf_int(tmplog, 0, dst + maxsize - tmplog, tmp);
 					break;
 				}
 
@@ -2683,9 +3032,9 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_RETRIES:  // %rq
-				if (s_flags & SF_REDISP)
+				if ((s_flags & SF_REDISP) && !(tmp->options & LOG_OPT_BIN))
 					LOGCHAR('+');
-				ret = ltoa_o((s  ? s->conn_retries : 0), tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, (s  ? s->conn_retries : 0), dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2693,7 +3042,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_SRVQUEUE: // %sq
-				ret = ltoa_o(logs->srv_queue_pos, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, logs->srv_queue_pos, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -2701,7 +3050,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_BCKQUEUE:  // %bq
-				ret = ltoa_o(logs->prx_queue_pos, tmplog, dst + maxsize - tmplog);
+				ret = lf_int(tmplog, logs->prx_queue_pos, dst + maxsize - tmplog, tmp);
 				if (ret == NULL)
 					goto out;
 				tmplog = ret;
@@ -3061,7 +3410,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 					last_isspace = 0;
 					tmplog += iret;
 				} else {
-					ret = ltoa_o(uniq_id, tmplog, dst + maxsize - tmplog);
+					ret = lf_int(tmplog, uniq_id, dst + maxsize - tmplog, tmp);
 					if (ret == NULL)
 						goto out;
 					tmplog = ret;
@@ -3077,7 +3426,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 					last_isspace = 0;
 					tmplog += iret;
 				} else {
-					ret = ultoa_o(fe->log_count, tmplog, dst + maxsize - tmplog);
+					ret = lf_int(tmplog, fe->log_count, dst + maxsize - tmplog, tmp);
 					if (ret == NULL)
 						goto out;
 					tmplog = ret;
@@ -3102,7 +3451,7 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 					last_isspace = 0;
 					tmplog += iret;
 				} else {
-					ret = ltoa_o(pid, tmplog, dst + maxsize - tmplog);
+					ret = lf_int(tmplog, pid, dst + maxsize - tmplog, tmp);
 					if (ret == NULL)
 						goto out;
 					tmplog = ret;
@@ -3123,9 +3472,26 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 		}
+
+		if (bin_start) {
+			ret = lf_bin_field(bin_field, tmplog, dst + maxsize, tmp->type);
+			if (ret == NULL)
+				goto out;
+			tmplog = bin_end = ret;
+		}
 	}
 
 out:
+	if (bin_start) {
+		/* drop any partially emitted field, and store the length of
+		 * the fields area right after the magic.
+		 */
+		ret = dst + 1;
+		encode_varint(bin_end - bin_start, &ret, bin_start);
+		memmove(ret, bin_start, bin_end - bin_start);
+		tmplog = ret + (bin_end - bin_start);
+	}
+
 	/* *tmplog is a unused character */
 	*tmplog = '\0';
 	return tmplog - dst;
@@ -3181,7 +3547,8 @@ void strm_log(struct stream *s)
 	if (size > 0) {
 		_HA_ATOMIC_INC(&sess->fe->log_count);
 		__send_log(&sess->fe->logsrvs, &sess->fe->log_tag, level,
-			   logline, size + 1, logline_rfc5424, sd_size);
+			   logline, size + 1, logline_rfc5424, sd_size,
+			   err ? -1 : s->logs.t_close);
 		s->logs.logwait = 0;
 	}
 }
@@ -3223,7 +3590,7 @@ void sess_log(struct session *sess)
 	if (size > 0) {
 		_HA_ATOMIC_INC(&sess->fe->log_count);
 		__send_log(&sess->fe->logsrvs, &sess->fe->log_tag, level,
-			   logline, size + 1, logline_rfc5424, sd_size);
+			   logline, size + 1, logline_rfc5424, sd_size, -1);
 	}
 }
 
@@ -3241,7 +3608,7 @@ void app_log(struct list *logsrvs, struct buffer *tag, int level, const char *fo
 		data_len = global.max_syslog_len;
 	va_end(argp);
 
-	__send_log(logsrvs, tag, level, logline, data_len, default_rfc5424_sd_log_format, 2);
+	__send_log(logsrvs, tag, level, logline, data_len, default_rfc5424_sd_log_format, 2, -1);
 }
 /*
  * This function parse a received log message <buf>, of size <buflen>
@@ -3615,7 +3982,7 @@ void syslog_fd_handler(int fd)
 
 			parse_log_message(buf->area, buf->data, &level, &facility, metadata, &message, &size);
 
-			process_send_log(&l->bind_conf->frontend->logsrvs, level, facility, metadata, message, size);
+			process_send_log(&l->bind_conf->frontend->logsrvs, level, facility, metadata, message, size, 0);
 
 		} while (--max_accept);
 	}
@@ -3722,7 +4089,7 @@ static void syslog_io_handler(struct appctx *appctx)
 
 		parse_log_message(buf->area, buf->data, &level, &facility, metadata, &message, &size);
 
-		process_send_log(&frontend->logsrvs, level, facility, metadata, message, size);
+		process_send_log(&frontend->logsrvs, level, facility, metadata, message, size, 0);
 
 	}
 
@@ -4021,6 +4388,87 @@ int cfg_parse_log_forward(const char *file, int linenum, char **args, int kwm)
 }
 
 
+/* context used by "show log-sampling" */
+struct show_log_smp_ctx {
+	struct proxy *px;       /* current proxy, NULL for the global section */
+	int state;              /* 0=global, 1=proxies, 2=log-forward sections */
+};
+
+/* appends to <out> the adaptive sampling state of all log servers from list
+ * <logsrvs> which belong to section <name>. Servers inherited using "log
+ * global" share the state of the global one and are not reported.
+ */
+static void log_smp_dump_list(struct buffer *out, const char *name, struct list *logsrvs)
+{
+	struct logsrv *logsrv;
+
+	list_for_each_entry(logsrv, logsrvs, list) {
+		if (!logsrv->adapt.max_rate || logsrv->ref)
+			continue;
+		chunk_appendf(out, "%s %s:%d %u %u %u %u %u %llu %llu\n",
+		              name, logsrv->conf.file, logsrv->conf.line,
+		              logsrv->adapt.max_rate, logsrv->adapt.slow,
+		              read_freq_ctr(&logsrv->adapt.offered),
+		              read_freq_ctr(&logsrv->adapt.prio),
+		              read_freq_ctr(&logsrv->adapt.sent),
+		              HA_ATOMIC_LOAD(&logsrv->adapt.kept),
+		              HA_ATOMIC_LOAD(&logsrv->adapt.dropped));
+	}
+}
+
+/* parse a "show log-sampling" command. It returns 1 on failure, 0 if it
+ * starts to dump.
+ */
+static int cli_parse_show_log_sampling(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct show_log_smp_ctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+
+	if (!cli_has_level(appctx, ACCESS_LVL_OPER))
+		return 1;
+
+	ctx->px = NULL;
+	ctx->state = 0;
+	return 0;
+}
+
+/* dumps the adaptive sampling state of all log servers having a "max-rate",
+ * one line per server. Returns 0 if the output buffer is full and it needs to
+ * be called again, otherwise non-zero.
+ */
+static int cli_io_handler_show_log_sampling(struct appctx *appctx)
+{
+	struct show_log_smp_ctx *ctx = appctx->svcctx;
+
+	if (ctx->state == 0) {
+		chunk_reset(&trash);
+		chunk_appendf(&trash, "# section target max_rate slow offered/s prio/s sent/s kept dropped\n");
+		log_smp_dump_list(&trash, "global", &global.logsrvs);
+		if (applet_putchk(appctx, &trash) == -1)
+			return 0;
+		ctx->px = proxies_list;
+		ctx->state = 1;
+	}
+
+	while (ctx->state <= 2) {
+		for (; ctx->px; ctx->px = ctx->px->next) {
+			chunk_reset(&trash);
+			log_smp_dump_list(&trash, ctx->px->id, &ctx->px->logsrvs);
+			if (applet_putchk(appctx, &trash) == -1)
+				return 0;
+		}
+		ctx->px = cfg_log_forward;
+		ctx->state++;
+	}
+	return 1;
+}
+
+static struct cli_kw_list cli_kws = {{ },{
+	{ { "show", "log-sampling", NULL }, "show log-sampling                       : show adaptive log sampling state", cli_parse_show_log_sampling, cli_io_handler_show_log_sampling, NULL },
+	{{},}
+}};
+
+INITCALL1(STG_REGISTER, cli_register_kw, &cli_kws);
+
 /* config parsers for this section */
 REGISTER_CONFIG_SECTION("log-forward", cfg_parse_log_forward, NULL);
 
@@ -20,6 +20,7 @@
 #include <haproxy/hpack-dec.h>
 #include <haproxy/hpack-enc.h>
 #include <haproxy/hpack-tbl.h>
+#include <haproxy/http.h>
 #include <haproxy/http_htx.h>
 #include <haproxy/htx.h>
 #include <haproxy/istbuf.h>
@@ -82,6 +83,11 @@ static const struct h2s *h2_idle_stream;
 /* Note: changed value from 2.7 (0x00000010 there) */
 #define H2_CF_WAIT_INLIST       0x00800000  // there is at least one stream blocked by another stream in send_list/fctl_list
 
+/* receive window auto-tuning */
+#define H2_CF_BDP_PING_WANT     0x01000000  // a BDP estimation PING must be sent
+#define H2_CF_BDP_PING_SENT     0x02000000  // a BDP estimation PING was sent, waiting for its ACK
+#define H2_CF_RWIN_UPDATE       0x04000000  // a SETTINGS frame must advertise the new streams receive window
+
 /* H2 connection state, in h2c->st0 */
 enum h2_cs {
 	H2_CS_PREFACE,   // init done, waiting for connection preface
@@ -139,7 +145,7 @@ struct h2c {
 	int timeout;        /* idle timeout duration in ticks */
 	int shut_timeout;   /* idle timeout duration in ticks after GOAWAY was sent */
 	int idle_start;     /* date of the last time the connection went idle (no stream + empty mbuf), or the start of current http req */
-	/* 32-bit hole here */
+	unsigned int sched_round; /* scheduling round, used to weigh urgencies in send lists */
 	unsigned int nb_streams;  /* number of streams in the tree */
 	unsigned int nb_sc;       /* number of attached stream connectors */
 	unsigned int nb_reserved; /* number of reserved streams */
@@ -147,6 +153,16 @@ struct h2c {
 	struct proxy *proxy; /* the proxy this connection was created for */
 	struct task *task;  /* timeout management task */
 	struct h2_counters *px_counters; /* h2 counters attached to proxy */
+
+	/* receive window auto-tuning, see h2c_bdp_sample() */
+	int32_t rwin;        /* streams initial window currently advertised to the peer */
+	uint32_t bdp_bytes;  /* DATA bytes received since the BDP PING was sent */
+	uint64_t bdp_start;  /* date (ns) the BDP PING was sent */
+	uint32_t srtt;       /* smoothed RTT measured by BDP PINGs, in microseconds, 0 if unknown */
+	uint32_t bdp;        /* last measured bandwidth-delay product in bytes */
+	uint32_t stalls_sfctl; /* number of times a stream was blocked by its send window */
+	uint32_t stalls_mfctl; /* number of times a stream was blocked by the connection's send window */
+
 	struct eb_root streams_by_id; /* all active streams by their ID */
 	struct list send_list; /* list of blocked streams requesting to send */
 	struct list fctl_list; /* list of streams blocked by connection's fctl */
@@ -227,6 +243,7 @@ struct h2s {
 	enum h2_err errcode; /* H2 err code (H2_ERR_*) */
 	enum h2_ss st;
 	uint16_t status;     /* HTTP response status */
+	uint8_t urgency;     /* RFC9218 urgency, 0 (highest) to 7 (lowest) */
 	unsigned long long body_len; /* remaining body length according to content-length if H2_SF_DATA_CLEN */
 	struct buffer rxbuf; /* receive buffer, always valid (buf_empty or real buffer) */
 	struct wait_event *subs;  /* recv wait_event the stream connector associated is waiting on (via h2_subscribe) */
@@ -419,6 +436,10 @@ enum {
 	H2_ST_TOTAL_CONN,
 	H2_ST_TOTAL_STREAM,
 
+	H2_ST_STRM_WIN_STALLS,
+	H2_ST_CONN_WIN_STALLS,
+	H2_ST_RWIN_GROWTHS,
+
 	H2_STATS_COUNT /* must be the last member of the enum */
 };
 
@@ -451,6 +472,13 @@ static struct name_desc h2_stats[] = {
 	                         .desc = "Total number of connections" },
 	[H2_ST_TOTAL_STREAM] = { .name = "h2_backend_total_streams",
 	                         .desc = "Total number of streams" },
+
+	[H2_ST_STRM_WIN_STALLS] = { .name = "h2_strm_window_stalls",
+	                            .desc = "Total number of times a stream was blocked by the peer's stream window" },
+	[H2_ST_CONN_WIN_STALLS] = { .name = "h2_conn_window_stalls",
+	                            .desc = "Total number of times a stream was blocked by the peer's connection window" },
+	[H2_ST_RWIN_GROWTHS]    = { .name = "h2_rwin_growths",
+	                            .desc = "Total number of auto-tuned enlargements of the advertised streams window" },
 };
 
 static struct h2_counters {
@@ -469,6 +497,10 @@ static struct h2_counters {
 	long long open_streams;  /* count of currently open streams */
 	long long total_conns;   /* total number of connections */
 	long long total_streams; /* total number of streams */
+
+	long long strm_win_stalls; /* total number of streams blocked by the peer's stream window */
+	long long conn_win_stalls; /* total number of streams blocked by the peer's connection window */
+	long long rwin_growths;    /* total number of advertised streams window enlargements */
 } h2_counters;
 
 static void h2_fill_stats(void *data, struct field *stats)
@@ -490,6 +522,10 @@ static void h2_fill_stats(void *data, struct field *stats)
 	stats[H2_ST_OPEN_STREAM]  = mkf_u64(FN_GAUGE,   counters->open_streams);
 	stats[H2_ST_TOTAL_CONN]   = mkf_u64(FN_COUNTER, counters->total_conns);
 	stats[H2_ST_TOTAL_STREAM] = mkf_u64(FN_COUNTER, counters->total_streams);
+
+	stats[H2_ST_STRM_WIN_STALLS] = mkf_u64(FN_COUNTER, counters->strm_win_stalls);
+	stats[H2_ST_CONN_WIN_STALLS] = mkf_u64(FN_COUNTER, counters->conn_win_stalls);
+	stats[H2_ST_RWIN_GROWTHS]    = mkf_u64(FN_COUNTER, counters->rwin_growths);
 }
 
 static struct stats_module h2_stats_module = {
@@ -526,6 +562,11 @@ static int h2_settings_header_table_size      =  4096; /* initial value */
 static int h2_settings_initial_window_size    = 65535; /* initial value */
 static unsigned int h2_settings_max_concurrent_streams = 100;
 static int h2_settings_max_frame_size         = 0;     /* unset */
+static int h2_stream_priorities               = 1;     /* RFC9218 priorities enabled */
+static int h2_settings_max_window_size        = 0;     /* receive window auto-tuning disabled */
+
+/* payload of the PINGs used to measure the RTT for window auto-tuning */
+#define H2_BDP_PING_DATA "HAP-BDP\x01"
 
 /* a dummy closed endpoint */
 static const struct sedesc closed_ep = {
@@ -1172,6 +1213,14 @@ static int h2_init(struct connection *conn, struct proxy *prx, struct session *s
 	h2c->nb_sc = 0;
 	h2c->nb_reserved = 0;
 	h2c->stream_cnt = 0;
+	h2c->sched_round = 0;
+	h2c->rwin = h2_settings_initial_window_size;
+	h2c->bdp_bytes = 0;
+	h2c->bdp_start = 0;
+	h2c->srtt = 0;
+	h2c->bdp = 0;
+	h2c->stalls_sfctl = 0;
+	h2c->stalls_mfctl = 0;
 
 	h2c->dbuf = *input;
 	h2c->dsi = -1;
@@ -1342,6 +1391,34 @@ static inline int h2s_mws(const struct h2s *h2s)
 	return h2s->sws + h2s->h2c->miw;
 }
 
+/* Queues stream <h2s> into list <head> (the h2c's send_list or fctl_list)
+ * according to its RFC9218 urgency: streams are sorted by increasing urgency
+ * and appended after those of the same urgency, so that these ones are served
+ * round-robin each time they're queued again. The incremental parameter is
+ * not considered: most clients leave it to its default (non-incremental)
+ * value, which would otherwise serialize all their responses. Without
+ * priorities, and on the backend side where the client's signals are not
+ * relayed, this is a plain append. The lists are short, so they're scanned
+ * from the tail.
+ */
+static inline void h2s_queue(struct h2s *h2s, struct list *head)
+{
+	struct h2s *prev;
+
+	if (!h2_stream_priorities || (h2s->h2c->flags & H2_CF_IS_BACK)) {
+		LIST_APPEND(head, &h2s->list);
+		return;
+	}
+
+	list_for_each_entry_rev(prev, head, list) {
+		if (prev->urgency <= h2s->urgency) {
+			LIST_INSERT(&prev->list, &h2s->list);
+			return;
+		}
+	}
+	LIST_INSERT(head, &h2s->list);
+}
+
 /* returns true of the mux is currently busy as seen from stream <h2s> */
 static inline __maybe_unused int h2c_mux_busy(const struct h2c *h2c, const struct h2s *h2s)
 {
@@ -1665,6 +1742,7 @@ static struct h2s *h2s_new(struct h2c *h2c, int id)
 	h2s->errcode   = H2_ERR_NO_ERROR;
 	h2s->st        = H2_SS_IDLE;
 	h2s->status    = 0;
+	h2s->urgency   = HTTP_PRIO_URGENCY_DEF;
 	h2s->body_len  = 0;
 	h2s->rxbuf     = BUF_NULL;
 	memset(h2s->upgrade_protocol, 0, sizeof(h2s->upgrade_protocol));
@@ -1845,6 +1923,12 @@ static int h2c_send_settings(struct h2c *h2c)
 	if (!(global.tune.options & GTUNE_DISABLE_H2_WEBSOCKET))
 		chunk_memcat(&buf, "\x00\x08\x00\x00\x00\x01", 6);
 
+	/* rfc 9218 #2.1 SETTINGS_NO_RFC7540_PRIORITIES=1, we only support
+	 * extensible priorities on the frontend side.
+	 */
+	if (!(h2c->flags & H2_CF_IS_BACK) && h2_stream_priorities)
+		chunk_memcat(&buf, "\x00\x09\x00\x00\x00\x01", 6);
+
 	if (h2_settings_header_table_size != 4096) {
 		char str[6] = "\x00\x01"; /* header_table_size */
 
@@ -2378,7 +2462,7 @@ static void h2c_unblock_sfctl(struct h2c *h2c)
 			LIST_DEL_INIT(&h2s->list);
 			if ((h2s->subs && h2s->subs->events & SUB_RETRY_SEND) ||
 			    h2s->flags & (H2_SF_WANT_SHUTR|H2_SF_WANT_SHUTW))
-				LIST_APPEND(&h2c->send_list, &h2s->list);
+				h2s_queue(h2s, &h2c->send_list);
 		}
 		node = eb32_next(node);
 	}
@@ -2524,6 +2608,156 @@ static int h2c_ack_settings(struct h2c *h2c)
 	return ret;
 }
 
+/* Accounts for a DATA frame of <len> bytes for the receive window auto-tuning.
+ * While a BDP PING is in flight, the received bytes are summed, otherwise a new
+ * PING is scheduled as long as the advertised window may still grow.
+ */
+static inline void h2c_bdp_account(struct h2c *h2c, uint32_t len)
+{
+	if (h2c->flags & H2_CF_BDP_PING_SENT)
+		h2c->bdp_bytes += len;
+	else if (h2c->rwin < h2_settings_max_window_size)
+		h2c->flags |= H2_CF_BDP_PING_WANT;
+}
+
+/* Called when the ACK of the BDP PING is received. The amount of DATA received
+ * during this round trip is the bandwidth-delay product currently achieved by
+ * the peer. If it used at least 2/3 of the advertised window, it is likely
+ * limited by it, so the window is doubled from the measured BDP, within the
+ * limit set by tune.h2.max-window-size, and the new value will be advertised
+ * in a SETTINGS frame. The window is never shrunk.
+ */
+static void h2c_bdp_sample(struct h2c *h2c)
+{
+	uint64_t rtt = (now_mono_time() - h2c->bdp_start) / 1000;
+	uint64_t win;
+
+	h2c->flags &= ~H2_CF_BDP_PING_SENT;
+	if (!rtt)
+		rtt = 1;
+	h2c->srtt = h2c->srtt ? (7 * (uint64_t)h2c->srtt + rtt) / 8 : rtt;
+	h2c->bdp = h2c->bdp_bytes;
+
+	if ((uint64_t)h2c->bdp_bytes * 3 < (uint64_t)h2c->rwin * 2)
+		return;
+
+	win = MIN((uint64_t)h2c->bdp_bytes * 2, h2_settings_max_window_size);
+	if (win > h2c->rwin) {
+		TRACE_STATE("enlarging streams receive window", H2_EV_RX_FRAME|H2_EV_RX_PING, h2c->conn);
+		h2c->rwin = win;
+		h2c->flags |= H2_CF_RWIN_UPDATE;
+		HA_ATOMIC_INC(&h2c->px_counters->rwin_growths);
+	}
+}
+
+/* Try to send a PING frame used to measure the RTT and the BDP for the receive
+ * window auto-tuning. Returns > 0 on success or zero on missing room or
+ * failure. It may return an error in h2c.
+ */
+static int h2c_send_bdp_ping(struct h2c *h2c)
+{
+	struct buffer *res;
+	char str[17];
+	int ret = 0;
+
+	TRACE_ENTER(H2_EV_TX_FRAME|H2_EV_TX_PING, h2c->conn);
+
+	if (h2c_mux_busy(h2c, NULL)) {
+		h2c->flags |= H2_CF_DEM_MBUSY;
+		goto out;
+	}
+
+	memcpy(str,
+	       "\x00\x00\x08"     /* length : 8 */
+	       "\x06" "\x00"      /* type   : 6, flags : none */
+	       "\x00\x00\x00\x00" /* stream ID */
+	       H2_BDP_PING_DATA, 17);
+
+	res = br_tail(h2c->mbuf);
+ retry:
+	if (!h2_get_buf(h2c, res)) {
+		h2c->flags |= H2_CF_MUX_MALLOC;
+		h2c->flags |= H2_CF_DEM_MROOM;
+		goto out;
+	}
+
+	ret = b_istput(res, ist2(str, 17));
+	if (unlikely(ret <= 0)) {
+		if (!ret) {
+			if ((res = br_tail_add(h2c->mbuf)) != NULL)
+				goto retry;
+			h2c->flags |= H2_CF_MUX_MFULL;
+			h2c->flags |= H2_CF_DEM_MROOM;
+		}
+		else {
+			h2c_error(h2c, H2_ERR_INTERNAL_ERROR);
+			ret = 0;
+		}
+		goto out;
+	}
+
+	h2c->flags = (h2c->flags & ~H2_CF_BDP_PING_WANT) | H2_CF_BDP_PING_SENT;
+	h2c->bdp_bytes = 0;
+	h2c->bdp_start = now_mono_time();
+ out:
+	TRACE_LEAVE(H2_EV_TX_FRAME|H2_EV_TX_PING, h2c->conn);
+	return ret;
+}
+
+/* Try to send a SETTINGS frame advertising the auto-tuned streams initial
+ * window <h2c->rwin>. The peer applies the difference to all of its streams
+ * (RFC7540#6.9.2). Returns > 0 on success or zero on missing room or failure.
+ * It may return an error in h2c.
+ */
+static int h2c_send_rwin_settings(struct h2c *h2c)
+{
+	struct buffer *res;
+	char str[15];
+	int ret = 0;
+
+	TRACE_ENTER(H2_EV_TX_FRAME|H2_EV_TX_SETTINGS, h2c->conn);
+
+	if (h2c_mux_busy(h2c, NULL)) {
+		h2c->flags |= H2_CF_DEM_MBUSY;
+		goto out;
+	}
+
+	memcpy(str,
+	       "\x00\x00\x06"     /* length : 6 */
+	       "\x04\x00"          /* type   : 4 (settings), flags : none */
+	       "\x00\x00\x00\x00" /* stream ID */
+	       "\x00\x04", 11);    /* initial_window_size */
+	write_n32(str + 11, h2c->rwin);
+
+	res = br_tail(h2c->mbuf);
+ retry:
+	if (!h2_get_buf(h2c, res)) {
+		h2c->flags |= H2_CF_MUX_MALLOC;
+		h2c->flags |= H2_CF_DEM_MROOM;
+		goto out;
+	}
+
+	ret = b_istput(res, ist2(str, 15));
+	if (unlikely(ret <= 0)) {
+		if (!ret) {
+			if ((res = br_tail_add(h2c->mbuf)) != NULL)
+				goto retry;
+			h2c->flags |= H2_CF_MUX_MFULL;
+			h2c->flags |= H2_CF_DEM_MROOM;
+		}
+		else {
+			h2c_error(h2c, H2_ERR_INTERNAL_ERROR);
+			ret = 0;
+		}
+		goto out;
+	}
+
+	h2c->flags &= ~H2_CF_RWIN_UPDATE;
+ out:
+	TRACE_LEAVE(H2_EV_TX_FRAME|H2_EV_TX_SETTINGS, h2c->conn);
+	return ret;
+}
+
 /* processes a PING frame and schedules an ACK if needed. The caller must pass
  * the pointer to the payload in <payload>. Returns > 0 on success or zero on
  * missing data. The caller must have already verified frame length
@@ -2531,9 +2765,20 @@ static int h2c_ack_settings(struct h2c *h2c)
  */
 static int h2c_handle_ping(struct h2c *h2c)
 {
+	char data[8];
+
 	/* schedule a response */
 	if (!(h2c->dff & H2_F_PING_ACK))
 		h2c->st0 = H2_CS_FRAME_A;
+	else if (h2c->flags & H2_CF_BDP_PING_SENT) {
+		if (b_data(&h2c->dbuf) < 8) {
+			h2c->flags |= H2_CF_DEM_SHORT_READ;
+			return 0;
+		}
+		h2_get_buf_bytes(data, 8, &h2c->dbuf, 0);
+		if (memcmp(data, H2_BDP_PING_DATA, 8) == 0)
+			h2c_bdp_sample(h2c);
+	}
 	return 1;
 }
 
@@ -2738,7 +2983,7 @@ static int h2c_handle_window_update(struct h2c *h2c, struct h2s *h2s)
 			LIST_DEL_INIT(&h2s->list);
 			if ((h2s->subs && h2s->subs->events & SUB_RETRY_SEND) ||
 			    h2s->flags & (H2_SF_WANT_SHUTR|H2_SF_WANT_SHUTW))
-				LIST_APPEND(&h2c->send_list, &h2s->list);
+				h2s_queue(h2s, &h2c->send_list);
 		}
 	}
 	else {
@@ -2829,6 +3074,70 @@ static int h2c_handle_priority(struct h2c *h2c)
 	return 1;
 }
 
+/* processes a PRIORITY_UPDATE frame, and updates the urgency of the designated
+ * stream. Returns > 0 on success or zero on missing data. It may return an error in h2c. The frame is ignored when priorities
+ * are disabled, when it is too large to reasonably carry a priority, or when
+ * the stream it refers to is unknown (not yet opened or already closed),
+ * which RFC9218#7 permits. Described in RFC9218#7.1.
+ */
+static int h2c_handle_priority_update(struct h2c *h2c)
+{
+	struct h2s *h2s;
+	int32_t sid;
+
+	TRACE_ENTER(H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+
+	if (h2c->dsi != 0 || (h2c->flags & H2_CF_IS_BACK)) {
+		/* RFC9218#7.1: only sent by clients, on stream 0 */
+		TRACE_ERROR("invalid PRIORITY_UPDATE stream or direction", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		h2c_error(h2c, H2_ERR_PROTOCOL_ERROR);
+		HA_ATOMIC_INC(&h2c->px_counters->conn_proto_err);
+		goto fail;
+	}
+
+	if (h2c->dfl < 4) {
+		TRACE_ERROR("too short PRIORITY_UPDATE frame", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		h2c_error(h2c, H2_ERR_FRAME_SIZE_ERROR);
+		HA_ATOMIC_INC(&h2c->px_counters->conn_proto_err);
+		goto fail;
+	}
+
+	if (!h2_stream_priorities || h2c->dfl > 256)
+		goto end;
+
+	/* process full frame only */
+	if (b_data(&h2c->dbuf) < h2c->dfl) {
+		TRACE_DEVEL("leaving on missing data", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		h2c->flags |= H2_CF_DEM_SHORT_READ;
+		return 0;
+	}
+
+	sid = h2_get_n32(&h2c->dbuf, 0) & 0x7FFFFFFF;
+	if (!sid) {
+		TRACE_ERROR("PRIORITY_UPDATE on stream 0", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		h2c_error(h2c, H2_ERR_PROTOCOL_ERROR);
+		HA_ATOMIC_INC(&h2c->px_counters->conn_proto_err);
+		goto fail;
+	}
+
+	h2s = h2c_st_by_id(h2c, sid);
+	if (h2s->id && h2s->st != H2_SS_CLOSED) {
+		char field[252];
+		int len = h2c->dfl - 4;
+
+		/* the value may wrap in the buffer */
+		h2_get_buf_bytes(field, len, &h2c->dbuf, 4);
+		http_parse_priority(ist2(field, len), &h2s->urgency, NULL);
+		TRACE_STATE("updated stream priority", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn, h2s);
+	}
+ end:
+	TRACE_LEAVE(H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+	return 1;
+ fail:
+	TRACE_DEVEL("leaving on error", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+	return 0;
+}
+
 /* processes an RST_STREAM frame, and sets the 32-bit error code on the stream.
  * Returns > 0 on success or zero on missing data. The caller must have already
  * verified frame length and stream ID validity. Described in RFC7540#6.4.
@@ -2874,6 +3183,7 @@ static struct h2s *h2c_frt_handle_headers(struct h2c *h2c, struct h2s *h2s)
 {
 	struct buffer rxbuf = BUF_NULL;
 	unsigned long long body_len = 0;
+	uint8_t urgency = HTTP_PRIO_URGENCY_DEF;
 	uint32_t flags = 0;
 	int error;
 
@@ -2986,6 +3296,17 @@ static struct h2s *h2c_frt_handle_headers(struct h2c *h2c, struct h2s *h2s)
 	if (h2c->dsi > h2c->max_id)
 		h2c->max_id = h2c->dsi;
 
+	/* RFC9218#5: retrieve the stream's initial priority before the rxbuf
+	 * is transferred to the stream.
+	 */
+	if (h2_stream_priorities) {
+		struct htx *htx = htxbuf(&rxbuf);
+		struct http_hdr_ctx ctx = { .blk = NULL };
+
+		while (http_find_header(htx, ist("priority"), &ctx, 1))
+			http_parse_priority(ctx.value, &urgency, NULL);
+	}
+
 	/* Note: we don't emit any other logs below because ff we return
 	 * positively from h2c_frt_stream_new(), the stream will report the error,
 	 * and if we return in error, h2c_frt_stream_new() will emit the error.
@@ -3002,6 +3323,7 @@ static struct h2s *h2c_frt_handle_headers(struct h2c *h2c, struct h2s *h2s)
 	h2s->st = H2_SS_OPEN;
 	h2s->flags |= flags;
 	h2s->body_len = body_len;
+	h2s->urgency = urgency;
 
  done:
 	if (h2c->dff & H2_F_HEADERS_END_STREAM)
@@ -3611,6 +3933,9 @@ static void h2_process_demux(struct h2c *h2c)
 			 */
 			if (hdr.ft == H2_FT_HEADERS)
 				h2c->idle_start = now_ms;
+
+			if (hdr.ft == H2_FT_DATA && h2_settings_max_window_size)
+				h2c_bdp_account(h2c, hdr.len);
 		}
 
 		/* Only H2_CS_FRAME_P, H2_CS_FRAME_A and H2_CS_FRAME_E here.
@@ -3722,6 +4047,13 @@ static void h2_process_demux(struct h2c *h2c)
 			}
 			break;
 
+		case H2_FT_PRIORITY_UPDATE:
+			if (h2c->st0 == H2_CS_FRAME_P) {
+				TRACE_PROTO("receiving H2 PRIORITY_UPDATE frame", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn, h2s);
+				ret = h2c_handle_priority_update(h2c);
+			}
+			break;
+
 		case H2_FT_RST_STREAM:
 			if (h2c->st0 == H2_CS_FRAME_P) {
 				TRACE_PROTO("receiving H2 RST_STREAM frame", H2_EV_RX_FRAME|H2_EV_RX_RST|H2_EV_RX_EOI, h2c->conn, h2s);
@@ -3793,6 +4125,18 @@ static void h2_process_demux(struct h2c *h2c)
 		h2c_send_conn_wu(h2c);
 	}
 
+	if ((h2c->flags & H2_CF_RWIN_UPDATE) &&
+	    !(h2c->flags & (H2_CF_MUX_MFULL | H2_CF_DEM_MBUSY | H2_CF_DEM_MROOM))) {
+		TRACE_PROTO("sending H2 SETTINGS frame for new window", H2_EV_TX_FRAME|H2_EV_TX_SETTINGS, h2c->conn);
+		h2c_send_rwin_settings(h2c);
+	}
+
+	if ((h2c->flags & H2_CF_BDP_PING_WANT) &&
+	    !(h2c->flags & (H2_CF_MUX_MFULL | H2_CF_DEM_MBUSY | H2_CF_DEM_MROOM))) {
+		TRACE_PROTO("sending H2 PING frame for BDP estimation", H2_EV_TX_FRAME|H2_EV_TX_PING, h2c->conn);
+		h2c_send_bdp_ping(h2c);
+	}
+
  done:
 	if (h2c->st0 >= H2_CS_ERROR || (h2c->flags & H2_CF_DEM_SHORT_READ)) {
 		if (h2c->flags & H2_CF_RCVD_SHUT)
@@ -3822,23 +4166,45 @@ static void h2_process_demux(struct h2c *h2c)
 	return;
 }
 
-/* resume each h2s eligible for sending in list head <head> */
+/* resume each h2s eligible for sending in list head <head>. The list is sorted
+ * by urgency (see h2s_queue()). Streams less urgent than the head of the list
+ * are weighted: a stream whose urgency is N levels lower than the head's is
+ * only resumed once every 2^N rounds (N capped to 3), so that urgent streams
+ * get most of the bandwidth without starving the other ones. Skipped streams
+ * will be reconsidered on the next round, which is triggered by the streams
+ * that were resumed or are still about to send. If there is none, the skipped
+ * ones are resumed anyway.
+ */
 static void h2_resume_each_sending_h2s(struct h2c *h2c, struct list *head)
 {
 	struct h2s *h2s, *h2s_back;
+	int best = -1;
+	int woken = 0, pending = 0, skipped = 0, all = 0;
 
 	TRACE_ENTER(H2_EV_H2C_SEND|H2_EV_H2S_WAKE, h2c->conn);
 
+	h2c->sched_round++;
+ again:
 	list_for_each_entry_safe(h2s, h2s_back, head, list) {
 		if (h2c->mws <= 0 ||
 		    h2c->flags & H2_CF_MUX_BLOCK_ANY ||
 		    h2c->st0 >= H2_CS_ERROR)
 			break;
 
+		if (best < 0)
+			best = h2s->urgency;
+		else if (!all && h2s->urgency > best && !(h2s->flags & H2_SF_NOTIFIED) &&
+			 (h2c->sched_round & ((1U << MIN(h2s->urgency - best, 3)) - 1))) {
+			skipped++;
+			continue;
+		}
+
 		h2s->flags &= ~H2_SF_BLK_ANY;
 
-		if (h2s->flags & H2_SF_NOTIFIED)
+		if (h2s->flags & H2_SF_NOTIFIED) {
+			pending++;
 			continue;
+		}
 
 		/* If the sender changed his mind and unsubscribed, let's just
 		 * remove the stream from the send_list.
@@ -3855,12 +4221,19 @@ static void h2_resume_each_sending_h2s(struct h2c *h2c, struct list *head)
 			h2s->subs->events &= ~SUB_RETRY_SEND;
 			if (!h2s->subs->events)
 				h2s->subs = NULL;
+			woken++;
 		}
 		else if (h2s->flags & (H2_SF_WANT_SHUTR|H2_SF_WANT_SHUTW)) {
 			tasklet_wakeup(h2s->shut_tl);
+			woken++;
 		}
 	}
 
+	if (skipped && !woken && !pending && !all) {
+		all = 1;
+		goto again;
+	}
+
 	TRACE_LEAVE(H2_EV_H2C_SEND|H2_EV_H2S_WAKE, h2c->conn);
 }
 
@@ -3920,6 +4293,17 @@ static int h2_process_mux(struct h2c *h2c)
 	    h2c_send_conn_wu(h2c) < 0)
 		goto fail;
 
+	/* then the receive window auto-tuning frames */
+	if ((h2c->flags & H2_CF_RWIN_UPDATE) &&
+	    !(h2c->flags & (H2_CF_MUX_MFULL | H2_CF_MUX_MALLOC)) &&
+	    h2c_send_rwin_settings(h2c) < 0)
+		goto fail;
+
+	if ((h2c->flags & H2_CF_BDP_PING_WANT) &&
+	    !(h2c->flags & (H2_CF_MUX_MFULL | H2_CF_MUX_MALLOC)) &&
+	    h2c_send_bdp_ping(h2c) < 0)
+		goto fail;
+
 	/* First we always process the flow control list because the streams
 	 * waiting there were already elected for immediate emission but were
 	 * blocked just on this.
@@ -4768,9 +5152,9 @@ static void h2_do_shutr(struct h2s *h2s)
 	h2s->flags |= H2_SF_WANT_SHUTR;
 	if (!LIST_INLIST(&h2s->list)) {
 		if (h2s->flags & H2_SF_BLK_MFCTL)
-			LIST_APPEND(&h2c->fctl_list, &h2s->list);
+			h2s_queue(h2s, &h2c->fctl_list);
 		else if (h2s->flags & (H2_SF_BLK_MBUSY|H2_SF_BLK_MROOM))
-			LIST_APPEND(&h2c->send_list, &h2s->list);
+			h2s_queue(h2s, &h2c->send_list);
 	}
 	TRACE_LEAVE(H2_EV_STRM_SHUT, h2c->conn, h2s);
 	return;
@@ -4843,9 +5227,9 @@ static void h2_do_shutw(struct h2s *h2s)
 	h2s->flags |= H2_SF_WANT_SHUTW;
 	if (!LIST_INLIST(&h2s->list)) {
 		if (h2s->flags & H2_SF_BLK_MFCTL)
-			LIST_APPEND(&h2c->fctl_list, &h2s->list);
+			h2s_queue(h2s, &h2c->fctl_list);
 		else if (h2s->flags & (H2_SF_BLK_MBUSY|H2_SF_BLK_MROOM))
-			LIST_APPEND(&h2c->send_list, &h2s->list);
+			h2s_queue(h2s, &h2c->send_list);
 	}
 	TRACE_LEAVE(H2_EV_STRM_SHUT, h2c->conn, h2s);
 	return;
@@ -6244,6 +6628,8 @@ static size_t h2s_make_data(struct h2s *h2s, struct buffer *buf, size_t count)
 
 	if (h2s_mws(h2s) <= 0) {
 		h2s->flags |= H2_SF_BLK_SFCTL;
+		h2c->stalls_sfctl++;
+		HA_ATOMIC_INC(&h2c->px_counters->strm_win_stalls);
 		if (LIST_INLIST(&h2s->list))
 			h2_remove_from_list(h2s);
 		LIST_APPEND(&h2c->blocked_list, &h2s->list);
@@ -6285,6 +6671,8 @@ static size_t h2s_make_data(struct h2s *h2s, struct buffer *buf, size_t count)
 
 	if (h2c->mws <= 0) {
 		h2s->flags |= H2_SF_BLK_MFCTL;
+		h2c->stalls_mfctl++;
+		HA_ATOMIC_INC(&h2c->px_counters->conn_win_stalls);
 		TRACE_STATE("connection window <=0, stream flow-controlled", H2_EV_TX_FRAME|H2_EV_TX_DATA|H2_EV_H2C_FCTL, h2c->conn, h2s);
 		goto end;
 	}
@@ -6637,11 +7025,11 @@ static int h2_subscribe(struct stconn *sc, int event_type, struct wait_event *es
 		    !LIST_INLIST(&h2s->list)) {
 			if (h2s->flags & H2_SF_BLK_MFCTL) {
 				TRACE_DEVEL("Adding to fctl list", H2_EV_STRM_SEND, h2c->conn, h2s);
-				LIST_APPEND(&h2c->fctl_list, &h2s->list);
+				h2s_queue(h2s, &h2c->fctl_list);
 			}
 			else {
 				TRACE_DEVEL("Adding to send list", H2_EV_STRM_SEND, h2c->conn, h2s);
-				LIST_APPEND(&h2c->send_list, &h2s->list);
+				h2s_queue(h2s, &h2c->send_list);
 			}
 		}
 	}
@@ -7004,6 +7392,9 @@ static int h2_show_fd(struct buffer *msg, struct connection *conn)
 		      (unsigned int)b_data(tmbuf), b_orig(tmbuf),
 		      (unsigned int)b_head_ofs(tmbuf), (unsigned int)b_size(tmbuf));
 
+	chunk_appendf(msg, " .rwin=%d .srtt=%u .bdp=%u .stalls=[s:%u,c:%u]",
+		      h2c->rwin, h2c->srtt, h2c->bdp, h2c->stalls_sfctl, h2c->stalls_mfctl);
+
 	chunk_appendf(msg, " .task=%p", h2c->task);
 	if (h2c->task) {
 		chunk_appendf(msg, " .exp=%s",
@@ -7182,6 +7573,46 @@ static int h2_parse_max_frame_size(char **args, int section_type, struct proxy *
 	return 0;
 }
 
+/* config parser for global "tune.h2.max-window-size" */
+static int h2_parse_max_window_size(char **args, int section_type, struct proxy *curpx,
+                                    const struct proxy *defpx, const char *file, int line,
+                                    char **err)
+{
+	char *stop;
+	long long val;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	/* RFC7540#6.9.1: a window may not exceed 2^31-1 bytes */
+	val = strtoll(args[1], &stop, 10);
+	if (!*args[1] || *stop || val < 0 || val > 2147483647) {
+		memprintf(err, "'%s' expects a numeric value between 0 and 2147483647.", args[0]);
+		return -1;
+	}
+	h2_settings_max_window_size = val;
+	return 0;
+}
+
+/* config parser for global "tune.h2.stream-priorities" */
+static int h2_parse_stream_priorities(char **args, int section_type, struct proxy *curpx,
+                                      const struct proxy *defpx, const char *file, int line,
+                                      char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0)
+		h2_stream_priorities = 1;
+	else if (strcmp(args[1], "off") == 0)
+		h2_stream_priorities = 0;
+	else {
+		memprintf(err, "'%s' expects 'on' or 'off'.", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
 
 /****************************************/
 /* MUX initialization and instantiation */
@@ -7221,6 +7652,8 @@ static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "tune.h2.initial-window-size",    h2_parse_initial_window_size    },
 	{ CFG_GLOBAL, "tune.h2.max-concurrent-streams", h2_parse_max_concurrent_streams },
 	{ CFG_GLOBAL, "tune.h2.max-frame-size",         h2_parse_max_frame_size         },
+	{ CFG_GLOBAL, "tune.h2.max-window-size",        h2_parse_max_window_size        },
+	{ CFG_GLOBAL, "tune.h2.stream-priorities",      h2_parse_stream_priorities      },
 	{ 0, NULL, NULL }
 }};
 
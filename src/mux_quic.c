@@ -6,6 +6,7 @@
 #include <haproxy/connection.h>
 #include <haproxy/dynbuf.h>
 #include <haproxy/freq_ctr.h>
+#include <haproxy/http-t.h>
 #include <haproxy/list.h>
 #include <haproxy/ncbuf.h>
 #include <haproxy/pool.h>
@@ -117,6 +118,12 @@ static struct qcs *qcs_new(struct qcc *qcc, uint64_t id, enum qcs_type type)
 	LIST_INIT(&qcs->el_opening);
 	qcs->start = TICK_ETERNITY;
 
+	/* RFC 9218 default priority. Local unidirectional streams carry the
+	 * control and QPACK data which must not wait behind responses.
+	 */
+	qcs->urgency = quic_stream_is_uni(id) ? 0 : HTTP_PRIO_URGENCY_DEF;
+	qcs->incremental = 0;
+
 	/* store transport layer stream descriptor in qcc tree */
 	qcs->id = qcs->by_id.key = id;
 	eb64_insert(&qcc->streams_by_id, &qcs->by_id);
@@ -1713,7 +1720,8 @@ static int qc_send(struct qcc *qcc)
 	struct list frms = LIST_HEAD_INIT(frms);
 	struct eb64_node *node;
 	struct qcs *qcs, *qcs_tmp;
-	int ret, total = 0, tmp_total = 0;
+	unsigned int urg_mask = 0;
+	int ret, urg, total = 0, tmp_total = 0;
 
 	TRACE_ENTER(QMUX_EV_QCC_SEND, qcc->conn);
 
@@ -1740,51 +1748,67 @@ static int qc_send(struct qcc *qcc)
 	}
 
 	/* loop through all streams, construct STREAM frames if data available.
+	 * Streams are visited by increasing RFC 9218 urgency then by ID, so
+	 * that the frames of the most urgent ones are emitted first. Only the
+	 * urgency levels in use are visited.
 	 * TODO optimize the loop to favor streams which are not too heavy.
 	 */
-	node = eb64_first(&qcc->streams_by_id);
-	while (node) {
-		uint64_t id;
-
-		qcs = eb64_entry(node, struct qcs, by_id);
-		id = qcs->id;
+	for (node = eb64_first(&qcc->streams_by_id); node; node = eb64_next(node))
+		urg_mask |= 1U << eb64_entry(node, struct qcs, by_id)->urgency;
 
-		if (quic_stream_is_uni(id) && quic_stream_is_remote(qcc, id)) {
-			node = eb64_next(node);
+	for (urg = 0; urg <= HTTP_PRIO_URGENCY_MAX; urg++) {
+		if (!(urg_mask & (1U << urg)))
 			continue;
-		}
 
-		if (qcs->flags & QC_SF_TO_RESET) {
-			qcs_send_reset(qcs);
-			node = eb64_next(node);
-			continue;
-		}
+		node = eb64_first(&qcc->streams_by_id);
+		while (node) {
+			uint64_t id;
 
-		if (qcs_is_close_local(qcs)) {
-			node = eb64_next(node);
-			continue;
-		}
+			qcs = eb64_entry(node, struct qcs, by_id);
+			id = qcs->id;
 
-		if (qcc->flags & QC_CF_BLK_MFCTL ||
-		    qcs->flags & QC_SF_BLK_SFCTL) {
-			node = eb64_next(node);
-			continue;
-		}
+			if (qcs->urgency != urg) {
+				node = eb64_next(node);
+				continue;
+			}
 
-		/* Check if there is something to send. */
-		if (!b_data(&qcs->tx.buf) && !qcs_stream_fin(qcs) &&
-		    !qc_stream_buf_get(qcs->stream)) {
-			node = eb64_next(node);
-			continue;
-		}
+			if (quic_stream_is_uni(id) && quic_stream_is_remote(qcc, id)) {
+				node = eb64_next(node);
+				continue;
+			}
 
-		if ((ret = _qc_send_qcs(qcs, &frms)) < 0) {
+			if (qcs->flags & QC_SF_TO_RESET) {
+				qcs_send_reset(qcs);
+				node = eb64_next(node);
+				continue;
+			}
+
+			if (qcs_is_close_local(qcs)) {
+				node = eb64_next(node);
+				continue;
+			}
+
+			if (qcc->flags & QC_CF_BLK_MFCTL ||
+			    qcs->flags & QC_SF_BLK_SFCTL) {
+				node = eb64_next(node);
+				continue;
+			}
+
+			/* Check if there is something to send. */
+			if (!b_data(&qcs->tx.buf) && !qcs_stream_fin(qcs) &&
+			    !qc_stream_buf_get(qcs->stream)) {
+				node = eb64_next(node);
+				continue;
+			}
+
+			if ((ret = _qc_send_qcs(qcs, &frms)) < 0) {
+				node = eb64_next(node);
+				continue;
+			}
+
+			total += ret;
 			node = eb64_next(node);
-			continue;
 		}
-
-		total += ret;
-		node = eb64_next(node);
 	}
 
 	if (qc_send_frames(qcc, &frms)) {
@@ -114,6 +114,8 @@ int mworker_ext_launch_all()
 
 				/* This one must not be exported, it's internal! */
 				unsetenv("HAPROXY_MWORKER_REEXEC");
+				/* nor this secret kept by the master for TLS ticket keys */
+				unsetenv("HAPROXY_TLSKEYS_SECRET");
 				execvp(child->command[0], child->command);
 
 				ha_alert("Cannot execute %s: %s\n", child->command[0], strerror(errno));
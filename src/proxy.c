@@ -35,6 +35,7 @@
 #include <haproxy/listener.h>
 #include <haproxy/log.h>
 #include <haproxy/obj_type-t.h>
+#include <haproxy/pattern.h>
 #include <haproxy/peers.h>
 #include <haproxy/pool.h>
 #include <haproxy/protocol.h>
@@ -231,7 +232,16 @@ void free_proxy(struct proxy *p)
 			prune_acl_cond(rule->cond);
 			free(rule->cond);
 		}
-		if (rule->dynamic) {
+		if (rule->dynamic == 2) {
+			release_sample_expr(rule->map_key);
+			if (rule->map) {
+				pattern_prune(rule->map);
+				free(rule->map);
+			}
+			else
+				free(rule->be.name);
+		}
+		else if (rule->dynamic) {
 			list_for_each_entry_safe(lf, lfb, &rule->be.expr, list) {
 				LIST_DELETE(&lf->list);
 				release_sample_expr(lf->expr);
@@ -1061,6 +1071,71 @@ void proxy_store_name(struct proxy *px)
 	ebis_insert(root, &px->conf.by_name);
 }
 
+/* Parses the value of a "use_backend_map" map entry, which must be the name of
+ * an existing backend. The backend itself is stored as an integer into <data>
+ * so that pattern_exec_match() copies it whole and that it never has to be
+ * looked up by name when processing requests. The CLI still reports the name,
+ * which is kept in the map's reference. This is also used when the map is
+ * updated at runtime. Returns non-zero on success.
+ */
+static int proxy_parse_map_backend(const char *text, struct sample_data *data)
+{
+	struct proxy *be;
+
+	be = proxy_be_by_name(text);
+	if (!be)
+		return 0;
+
+	data->type = SMP_T_SINT;
+	data->u.sint = (intptr_t)be;
+	return 1;
+}
+
+/* Loads the map file <filename> associating strings to backend names for a
+ * "use_backend_map" rule declared in <file> at line <line>. All backends must
+ * already be known. Returns the pattern head to look keys up into, or NULL
+ * with <err> filled on error.
+ */
+struct pattern_head *proxy_load_backend_map(const char *filename, const char *file, int line, char **err)
+{
+	struct pattern_head *head;
+
+	head = calloc(1, sizeof(*head));
+	if (!head) {
+		memprintf(err, "out of memory");
+		return NULL;
+	}
+
+	pattern_init_head(head);
+	head->match = pat_match_str;
+	head->parse = pat_parse_str;
+	head->index = pat_idx_tree_str;
+	head->prune = pat_prune_gen;
+	head->expect_type = SMP_T_STR;
+	head->parse_smp = proxy_parse_map_backend;
+
+	if (!pattern_read_from_file(head, PAT_REF_MAP, filename, PAT_MF_NO_DNS, 1, err, file, line)) {
+		pattern_prune(head);
+		free(head);
+		return NULL;
+	}
+	return head;
+}
+
+/* Returns the backend associated with the string sample <smp> in the map
+ * <head> of a "use_backend_map" rule, or NULL if the key is not in the map.
+ * Backends were resolved when the entries were loaded, and are never removed.
+ */
+struct proxy *proxy_map_lookup_backend(struct pattern_head *head, struct sample *smp)
+{
+	struct pattern *pat;
+
+	pat = pattern_exec_match(head, smp, 1);
+	if (!pat || !pat->data)
+		return NULL;
+	return (struct proxy *)(intptr_t)pat->data->u.sint;
+}
+
 /* Returns a pointer to the first proxy matching capabilities <cap> and id
  * <id>. NULL is returned if no match is found. If <table> is non-zero, it
  * only considers proxies having a table.
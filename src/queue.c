@@ -738,7 +738,7 @@ static enum act_parse_ret parse_set_priority_class(const char **args, int *arg,
 		memprintf(err,
 			  "fetch method '%s' extracts information from '%s', none of which is available here",
 			  args[0], sample_src_names(rule->arg.expr->fetch->use));
-		free(rule->arg.expr);
+		release_sample_expr(rule->arg.expr);
 		return ACT_RET_PRS_ERR;
 	}
 
@@ -766,7 +766,7 @@ static enum act_parse_ret parse_set_priority_offset(const char **args, int *arg,
 		memprintf(err,
 			  "fetch method '%s' extracts information from '%s', none of which is available here",
 			  args[0], sample_src_names(rule->arg.expr->fetch->use));
-		free(rule->arg.expr);
+		release_sample_expr(rule->arg.expr);
 		return ACT_RET_PRS_ERR;
 	}
 
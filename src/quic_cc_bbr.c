@@ -0,0 +1,414 @@
+/*
+ * BBR congestion control algorithm.
+ *
+ * This file contains definitions for QUIC congestion control.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <string.h>
+
+#include <haproxy/api-t.h>
+#include <haproxy/buf.h>
+#include <haproxy/chunk.h>
+#include <haproxy/quic_cc.h>
+#include <haproxy/quic_conn-t.h>
+#include <haproxy/ticks.h>
+#include <haproxy/trace.h>
+
+/* This is a model-based congestion controller following the principles of
+ * BBR (draft-cardwell-iccrg-bbr-congestion-control). Instead of reacting to
+ * losses only, it continuously estimates the bottleneck bandwidth (maximum of
+ * the recent delivery rates) and the propagation delay (windowed minimum RTT),
+ * and sizes both the congestion window and the pacing rate from their product.
+ * As in BBRv2, losses are not ignored: they bound the volume of data in flight
+ * until the next bandwidth probing phase, and end the startup phase.
+ *
+ * Since the congestion controller API only reports the number of acknowledged
+ * bytes for each packet, the delivery rate is sampled over intervals of at
+ * least one minimum RTT instead of per packet. Bandwidth values are expressed
+ * in bytes per millisecond, times in milliseconds, and gains are scaled by
+ * BBR_UNIT like in the Linux kernel implementation (net/ipv4/tcp_bbr.c).
+ */
+#define TRACE_SOURCE    &trace_quic
+
+#define BBR_SCALE                 8
+#define BBR_UNIT                  (1 << BBR_SCALE)
+
+/* 2/ln(2) is the smallest gain doubling the sending rate each round */
+#define BBR_STARTUP_GAIN          739  /* 2.89 */
+#define BBR_DRAIN_GAIN            88   /* 1/2.89 */
+#define BBR_CWND_GAIN             (2 * BBR_UNIT)
+/* multiplicative decrease of the inflight bound on loss */
+#define BBR_BETA                  179  /* 0.7 */
+
+/* the bandwidth filter covers 2 slots of BBR_BW_SLOT_ROUNDS round trips */
+#define BBR_BW_SLOT_ROUNDS        5
+/* startup ends after this number of rounds without 25% bandwidth growth */
+#define BBR_FULL_BW_ROUNDS        3
+/* lifetime of the minimum RTT estimate, and PROBE_RTT duration */
+#define BBR_MIN_RTT_WIN_MS        10000
+#define BBR_PROBE_RTT_MS          200
+/* minimum window in packets, which is also the PROBE_RTT window */
+#define BBR_MIN_CWND_PKTS         4
+/* headroom for ACK aggregation, in packets */
+#define BBR_ACK_AGGR_PKTS         3
+
+/* pacing gains of the PROBE_BW cycle phases, each lasting one minimum RTT */
+static const uint32_t bbr_probe_bw_gains[] = {
+	BBR_UNIT * 5 / 4,        /* probe up */
+	BBR_UNIT * 3 / 4,        /* drain the queue created by the probe */
+	BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT, /* cruise */
+};
+#define BBR_CYCLE_LEN    (sizeof(bbr_probe_bw_gains) / sizeof(*bbr_probe_bw_gains))
+
+enum bbr_state {
+	BBR_ST_STARTUP,
+	BBR_ST_DRAIN,
+	BBR_ST_PROBE_BW,
+	BBR_ST_PROBE_RTT,
+};
+
+/* By connection BBR algorithm state. It must fit in quic_cc priv[]. Note that
+ * the current congestion window value is not stored in this structure.
+ */
+struct bbr {
+	uint32_t state;          /* BBR_ST_* */
+	uint32_t pacing_gain;    /* current pacing gain (scaled) */
+	uint32_t cwnd_gain;      /* current congestion window gain (scaled) */
+	uint32_t full_bw_reached;/* non-zero once the startup phase ended */
+	uint32_t full_bw;        /* bandwidth reference for startup exit (bytes/ms) */
+	uint32_t full_bw_cnt;    /* rounds without significant bandwidth growth */
+	uint32_t bw[2];          /* max bandwidth filter slots (bytes/ms) */
+	uint32_t round_count;    /* number of round trips elapsed */
+	uint32_t round_start;    /* send date of the first packet of the current round */
+	uint32_t loss_round;     /* round_count + 1 of the last loss reaction, 0 if none */
+	uint32_t rs_start;       /* start date of the current delivery rate sample */
+	uint32_t rs_delivered;   /* bytes acknowledged since <rs_start> */
+	uint32_t min_rtt;        /* windowed minimum RTT (ms), 0 if unknown */
+	uint32_t min_rtt_stamp;  /* date <min_rtt> was measured */
+	uint32_t probe_rtt_done; /* end date of the PROBE_RTT phase, 0 if not started */
+	uint32_t cycle_idx;      /* current PROBE_BW phase */
+	uint32_t cycle_stamp;    /* start date of the current PROBE_BW phase */
+	uint32_t inflight_hi;    /* upper bound of the window after losses, 0 if none */
+	uint64_t prior_cwnd;     /* window saved before PROBE_RTT */
+};
+
+static inline const char *bbr_state_str(uint32_t state)
+{
+	switch (state) {
+	case BBR_ST_STARTUP:   return "startup";
+	case BBR_ST_DRAIN:     return "drain";
+	case BBR_ST_PROBE_BW:  return "probe_bw";
+	case BBR_ST_PROBE_RTT: return "probe_rtt";
+	default:               return "unknown";
+	}
+}
+
+static inline uint32_t bbr_max_bw(const struct bbr *bbr)
+{
+	return QUIC_MAX(bbr->bw[0], bbr->bw[1]);
+}
+
+/* Returns the estimated bandwidth-delay product in bytes scaled by <gain>, or
+ * 0 if no estimate is available yet.
+ */
+static inline uint64_t bbr_bdp(const struct bbr *bbr, uint32_t gain)
+{
+	return ((uint64_t)bbr_max_bw(bbr) * bbr->min_rtt * gain) >> BBR_SCALE;
+}
+
+static inline uint32_t bbr_min_cwnd(const struct quic_path *path)
+{
+	return QUIC_MAX(BBR_MIN_CWND_PKTS * path->mtu, path->min_cwnd);
+}
+
+static void bbr_enter_startup(struct bbr *bbr)
+{
+	bbr->state = BBR_ST_STARTUP;
+	bbr->pacing_gain = BBR_STARTUP_GAIN;
+	bbr->cwnd_gain = BBR_STARTUP_GAIN;
+}
+
+static void bbr_enter_probe_bw(struct bbr *bbr)
+{
+	bbr->state = BBR_ST_PROBE_BW;
+	bbr->cwnd_gain = BBR_CWND_GAIN;
+	/* start in a cruising phase so that probing only starts after a round */
+	bbr->cycle_idx = BBR_CYCLE_LEN - 1;
+	bbr->cycle_stamp = now_ms;
+	bbr->pacing_gain = bbr_probe_bw_gains[bbr->cycle_idx];
+}
+
+static void quic_cc_bbr_reset(struct quic_cc *cc)
+{
+	struct bbr *bbr = quic_cc_priv(cc);
+
+	TRACE_ENTER(QUIC_EV_CONN_CC, cc->qc);
+	memset(bbr, 0, sizeof(*bbr));
+	bbr_enter_startup(bbr);
+	bbr->round_start = now_ms;
+	bbr->rs_start = now_ms;
+	bbr->min_rtt_stamp = now_ms;
+	TRACE_LEAVE(QUIC_EV_CONN_CC, cc->qc);
+}
+
+static int quic_cc_bbr_init(struct quic_cc *cc)
+{
+	BUG_ON(sizeof(struct bbr) > sizeof(cc->priv));
+	quic_cc_bbr_reset(cc);
+	return 1;
+}
+
+/* Persistent congestion: restart from the minimum window and re-estimate the
+ * path bandwidth.
+ */
+static void quic_cc_bbr_slow_start(struct quic_cc *cc)
+{
+	struct quic_path *path = container_of(cc, struct quic_path, cc);
+
+	TRACE_ENTER(QUIC_EV_CONN_CC, cc->qc);
+	quic_cc_bbr_reset(cc);
+	path->cwnd = path->min_cwnd;
+	TRACE_LEAVE(QUIC_EV_CONN_CC, cc->qc);
+}
+
+/* Updates the windowed minimum RTT from the latest RTT sample, and enters the
+ * PROBE_RTT phase when it was not refreshed for BBR_MIN_RTT_WIN_MS.
+ */
+static void bbr_update_min_rtt(struct quic_cc *cc)
+{
+	struct quic_path *path = container_of(cc, struct quic_path, cc);
+	struct bbr *bbr = quic_cc_priv(cc);
+	uint32_t rtt = path->loss.latest_rtt;
+	int expired;
+
+	expired = tick_is_expired(tick_add(bbr->min_rtt_stamp, BBR_MIN_RTT_WIN_MS), now_ms);
+	if (rtt && (!bbr->min_rtt || rtt <= bbr->min_rtt || expired)) {
+		bbr->min_rtt = rtt;
+		bbr->min_rtt_stamp = now_ms;
+	}
+
+	if (expired && bbr->state != BBR_ST_PROBE_RTT) {
+		bbr->state = BBR_ST_PROBE_RTT;
+		bbr->pacing_gain = BBR_UNIT;
+		bbr->cwnd_gain = BBR_UNIT;
+		bbr->prior_cwnd = path->cwnd;
+		bbr->probe_rtt_done = tick_add(now_ms, BBR_PROBE_RTT_MS);
+	}
+
+	if (bbr->state == BBR_ST_PROBE_RTT && tick_is_expired(bbr->probe_rtt_done, now_ms)) {
+		bbr->min_rtt_stamp = now_ms;
+		path->cwnd = QUIC_MAX(path->cwnd, bbr->prior_cwnd);
+		if (bbr->full_bw_reached)
+			bbr_enter_probe_bw(bbr);
+		else
+			bbr_enter_startup(bbr);
+	}
+}
+
+/* Accounts for <acked> newly acknowledged bytes in the delivery rate sample,
+ * and feeds the bandwidth filter once the sample covers a minimum RTT.
+ */
+static void bbr_update_bw(struct bbr *bbr, uint32_t acked)
+{
+	uint32_t elapsed, bw;
+
+	bbr->rs_delivered += acked;
+	elapsed = now_ms - bbr->rs_start;
+	if (!bbr->min_rtt || elapsed < QUIC_MAX(bbr->min_rtt, 1U))
+		return;
+
+	bw = bbr->rs_delivered / elapsed;
+	if (bw > bbr->bw[(bbr->round_count / BBR_BW_SLOT_ROUNDS) & 1])
+		bbr->bw[(bbr->round_count / BBR_BW_SLOT_ROUNDS) & 1] = bw;
+	bbr->rs_start = now_ms;
+	bbr->rs_delivered = 0;
+}
+
+/* Called at the start of each round trip. */
+static void bbr_on_new_round(struct quic_cc *cc)
+{
+	struct quic_path *path = container_of(cc, struct quic_path, cc);
+	struct bbr *bbr = quic_cc_priv(cc);
+	uint32_t bw;
+
+	bbr->round_count++;
+	bbr->round_start = now_ms;
+	/* expire the oldest bandwidth filter slot */
+	if (!(bbr->round_count % BBR_BW_SLOT_ROUNDS))
+		bbr->bw[(bbr->round_count / BBR_BW_SLOT_ROUNDS) & 1] = 0;
+
+	bw = bbr_max_bw(bbr);
+	if (!bbr->full_bw_reached && bw) {
+		if ((uint64_t)bw * 4 >= (uint64_t)bbr->full_bw * 5) {
+			bbr->full_bw = bw;
+			bbr->full_bw_cnt = 0;
+		}
+		else if (++bbr->full_bw_cnt >= BBR_FULL_BW_ROUNDS)
+			bbr->full_bw_reached = 1;
+	}
+
+	if (bbr->state == BBR_ST_STARTUP && bbr->full_bw_reached) {
+		TRACE_STATE("BBR startup done", QUIC_EV_CONN_CC, cc->qc);
+		bbr->state = BBR_ST_DRAIN;
+		bbr->pacing_gain = BBR_DRAIN_GAIN;
+		bbr->cwnd_gain = BBR_STARTUP_GAIN;
+	}
+
+	if (bbr->state == BBR_ST_DRAIN && path->in_flight <= bbr_bdp(bbr, BBR_UNIT))
+		bbr_enter_probe_bw(bbr);
+}
+
+/* Advances the PROBE_BW cycle, each phase lasting one minimum RTT. */
+static void bbr_update_cycle(struct bbr *bbr)
+{
+	if (bbr->state != BBR_ST_PROBE_BW)
+		return;
+
+	if (now_ms - bbr->cycle_stamp < QUIC_MAX(bbr->min_rtt, 1U))
+		return;
+
+	bbr->cycle_idx = (bbr->cycle_idx + 1) % BBR_CYCLE_LEN;
+	bbr->cycle_stamp = now_ms;
+	bbr->pacing_gain = bbr_probe_bw_gains[bbr->cycle_idx];
+	/* probing for more bandwidth lifts the bound set by past losses */
+	if (bbr->cycle_idx == 0)
+		bbr->inflight_hi = 0;
+}
+
+/* Sets the congestion window from the bandwidth-delay product estimation. */
+static void bbr_set_cwnd(struct quic_cc *cc, uint32_t acked)
+{
+	struct quic_path *path = container_of(cc, struct quic_path, cc);
+	struct bbr *bbr = quic_cc_priv(cc);
+	uint64_t target, cwnd;
+
+	cwnd = path->cwnd;
+	if (bbr->state == BBR_ST_PROBE_RTT) {
+		cwnd = bbr_min_cwnd(path);
+		goto done;
+	}
+
+	target = bbr_bdp(bbr, bbr->cwnd_gain);
+	if (target)
+		target += BBR_ACK_AGGR_PKTS * path->mtu;
+
+	if (!bbr->full_bw_reached || !target)
+		cwnd += acked;
+	else
+		cwnd = QUIC_MIN(cwnd + acked, target);
+
+	if (bbr->inflight_hi)
+		cwnd = QUIC_MIN(cwnd, (uint64_t)bbr->inflight_hi);
+ done:
+	path->cwnd = QUIC_MAX(cwnd, (uint64_t)bbr_min_cwnd(path));
+	path->mcwnd = QUIC_MAX(path->cwnd, path->mcwnd);
+}
+
+static void quic_cc_bbr_on_ack(struct quic_cc *cc, struct quic_cc_event *ev)
+{
+	struct bbr *bbr = quic_cc_priv(cc);
+
+	bbr_update_min_rtt(cc);
+	/* a round ends when a packet sent after its start is acknowledged */
+	if (tick_is_lt(bbr->round_start, ev->ack.time_sent))
+		bbr_on_new_round(cc);
+	bbr_update_bw(bbr, ev->ack.acked);
+	bbr_update_cycle(bbr);
+	bbr_set_cwnd(cc, ev->ack.acked);
+}
+
+/* Losses end the startup phase and bound the window to BBR_BETA times its
+ * current value until the next bandwidth probe. This is done at most once
+ * per round trip.
+ */
+static void quic_cc_bbr_on_loss(struct quic_cc *cc, struct quic_cc_event *ev)
+{
+	struct quic_path *path = container_of(cc, struct quic_path, cc);
+	struct bbr *bbr = quic_cc_priv(cc);
+
+	if (bbr->loss_round == bbr->round_count + 1)
+		return;
+
+	bbr->loss_round = bbr->round_count + 1;
+	bbr->inflight_hi = QUIC_MAX((path->cwnd * BBR_BETA) >> BBR_SCALE,
+	                            (uint64_t)bbr_min_cwnd(path));
+	path->cwnd = QUIC_MIN(path->cwnd, (uint64_t)bbr->inflight_hi);
+
+	if (bbr->state == BBR_ST_STARTUP && bbr_max_bw(bbr)) {
+		bbr->full_bw_reached = 1;
+		bbr->state = BBR_ST_DRAIN;
+		bbr->pacing_gain = BBR_DRAIN_GAIN;
+		bbr->cwnd_gain = BBR_STARTUP_GAIN;
+	}
+}
+
+static void quic_cc_bbr_event(struct quic_cc *cc, struct quic_cc_event *ev)
+{
+	TRACE_ENTER(QUIC_EV_CONN_CC, cc->qc, ev);
+	switch (ev->type) {
+	case QUIC_CC_EVT_ACK:
+		quic_cc_bbr_on_ack(cc, ev);
+		break;
+	case QUIC_CC_EVT_LOSS:
+		quic_cc_bbr_on_loss(cc, ev);
+		break;
+	case QUIC_CC_EVT_ECN_CE:
+		/* TODO */
+		break;
+	}
+	TRACE_LEAVE(QUIC_EV_CONN_CC, cc->qc, NULL, cc);
+}
+
+/* Returns the pacing rate in bytes per second. Before the first bandwidth
+ * estimation, it is derived from the initial window and the smoothed RTT.
+ */
+static uint64_t quic_cc_bbr_pacing_rate(const struct quic_cc *cc)
+{
+	const struct quic_path *path = container_of(cc, struct quic_path, cc);
+	const struct bbr *bbr = quic_cc_priv(cc);
+	uint64_t bw = bbr_max_bw(bbr);
+
+	if (!bw)
+		bw = path->cwnd / QUIC_MAX(path->loss.srtt, 1U);
+
+	return ((bw * bbr->pacing_gain) >> BBR_SCALE) * 1000;
+}
+
+static void quic_cc_bbr_state_trace(struct buffer *buf, const struct quic_cc *cc)
+{
+	const struct quic_path *path = container_of(cc, struct quic_path, cc);
+	const struct bbr *bbr = quic_cc_priv(cc);
+
+	chunk_appendf(buf, " state=%s cwnd=%llu mcwnd=%llu bw=%uB/ms min_rtt=%ums"
+	              " pgain=%u cgain=%u inflight_hi=%u rounds=%u pktloss=%llu",
+	              bbr_state_str(bbr->state),
+	              (unsigned long long)path->cwnd,
+	              (unsigned long long)path->mcwnd,
+	              bbr_max_bw(bbr), bbr->min_rtt,
+	              bbr->pacing_gain, bbr->cwnd_gain, bbr->inflight_hi,
+	              bbr->round_count,
+	              (unsigned long long)path->loss.nb_lost_pkt);
+}
+
+struct quic_cc_algo quic_cc_algo_bbr = {
+	.type        = QUIC_CC_ALGO_TP_BBR,
+	.init        = quic_cc_bbr_init,
+	.event       = quic_cc_bbr_event,
+	.slow_start  = quic_cc_bbr_slow_start,
+	.pacing_rate = quic_cc_bbr_pacing_rate,
+	.state_trace = quic_cc_bbr_state_trace,
+};
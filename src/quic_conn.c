@@ -227,6 +227,7 @@ static void qc_idle_timer_rearm(struct quic_conn *qc, int read);
 static int qc_conn_alloc_ssl_ctx(struct quic_conn *qc);
 static int quic_conn_init_timer(struct quic_conn *qc);
 static int quic_conn_init_idle_timer_task(struct quic_conn *qc);
+static int quic_conn_init_pacing_task(struct quic_conn *qc);
 
 /* Only for debug purpose */
 struct enc_debug_info {
@@ -3320,6 +3321,71 @@ static int qc_may_build_pkt(struct quic_conn *qc, struct list *frms,
 	return 1;
 }
 
+/* Returns the pacing rate of <qc> in bytes per second, or 0 if it cannot be
+ * paced yet. The congestion controller's own rate is used when it provides
+ * one, otherwise the congestion window is spread over the smoothed RTT with a
+ * 5/4 gain as suggested by RFC9002 7.7 so as not to underutilize it.
+ */
+static inline uint64_t qc_pacing_rate(const struct quic_conn *qc)
+{
+	const struct quic_path *path = qc->path;
+	uint64_t rate;
+
+	rate = quic_cc_pacing_rate(&path->cc);
+	if (!rate && path->loss.srtt)
+		rate = path->cwnd * 1000 * 5 / 4 / path->loss.srtt;
+	return rate;
+}
+
+/* Refills the pacing credit of <qc> according to its pacing rate and the time
+ * elapsed since the last refill. The credit cannot exceed the amount of data
+ * allowed during one millisecond, which is the timers resolution, nor be lower
+ * than QUIC_PACING_MIN_BURST datagrams. Returns non-zero if a datagram may be
+ * sent. Otherwise the pacing task is scheduled to retry when enough credit will
+ * be available, and zero is returned.
+ */
+static int qc_pacing_may_send(struct quic_conn *qc)
+{
+	uint64_t rate, now, elapsed, burst;
+	unsigned int wait;
+
+	if (!qc->pacing_task)
+		return 1;
+
+	rate = qc_pacing_rate(qc);
+	if (!rate)
+		return 1;
+
+	now = now_mono_time();
+	elapsed = QUIC_MIN(now - qc->pacing_last, (uint64_t)1000000000);
+	qc->pacing_last = now;
+
+	burst = QUIC_MAX(rate / 1000, (uint64_t)QUIC_PACING_MIN_BURST * qc->path->mtu);
+	qc->pacing_credit = QUIC_MIN(qc->pacing_credit + elapsed * rate / (uint64_t)1000000000, burst);
+	if (qc->pacing_credit >= qc->path->mtu)
+		return 1;
+
+	if (!tick_isset(qc->pacing_task->expire)) {
+		wait = (qc->path->mtu - qc->pacing_credit) * 1000 / rate + 1;
+		TRACE_STATE("emission deferred by pacing", QUIC_EV_CONN_PHPKTS, qc);
+		task_schedule(qc->pacing_task, tick_add(now_ms, MS_TO_TICKS(wait)));
+		HA_ATOMIC_INC(&qc->prx_counters->pacing_deferred);
+	}
+	return 0;
+}
+
+/* Consumes <len> bytes of pacing credit of <qc> for an emitted datagram.
+ * Returns non-zero if the datagram was emitted under pacing control.
+ */
+static inline int qc_pacing_sent(struct quic_conn *qc, size_t len)
+{
+	if (!qc->pacing_task)
+		return 0;
+
+	qc->pacing_credit = qc->pacing_credit > len ? qc->pacing_credit - len : 0;
+	return 1;
+}
+
 /* Prepare as much as possible QUIC packets for sending from prebuilt frames
  * <frms>. Each packet is stored in a distinct datagram written to <buf>.
  *
@@ -3337,6 +3403,7 @@ static int qc_prep_app_pkts(struct quic_conn *qc, struct buffer *buf,
 	unsigned char *end, *pos;
 	struct quic_tx_packet *pkt;
 	size_t total;
+	unsigned int paced_dgrams = 0;
 	/* Each datagram is prepended with its length followed by the address
 	 * of the first packet in the datagram.
 	 */
@@ -3348,7 +3415,7 @@ static int qc_prep_app_pkts(struct quic_conn *qc, struct buffer *buf,
 	total = 0;
 	pos = (unsigned char *)b_tail(buf);
 	while (b_contig_space(buf) >= (int)qc->path->mtu + dg_headlen) {
-		int err, probe, cc, must_ack;
+		int err, probe, cc, must_ack, paced;
 
 		TRACE_PROTO("TX prep app pkts", QUIC_EV_CONN_PHPKTS, qc, qel, frms);
 		probe = 0;
@@ -3360,6 +3427,13 @@ static int qc_prep_app_pkts(struct quic_conn *qc, struct buffer *buf,
 		if (!qc_may_build_pkt(qc, frms, qel, cc, probe, &must_ack))
 			break;
 
+		/* Only packets carrying frames are paced. ACKs, probes and
+		 * CONNECTION_CLOSE must not be delayed.
+		 */
+		paced = !cc && !probe && !LIST_ISEMPTY(frms);
+		if (paced && !qc_pacing_may_send(qc))
+			break;
+
 		/* Leave room for the datagram header */
 		pos += dg_headlen;
 		if (!quic_peer_validated_addr(qc) && qc_is_listener(qc)) {
@@ -3395,6 +3469,8 @@ static int qc_prep_app_pkts(struct quic_conn *qc, struct buffer *buf,
 			pkt->flags |= QUIC_FL_TX_PACKET_PROBE_WITH_OLD_DATA;
 
 		total += pkt->len;
+		if (paced && qc_pacing_sent(qc, pkt->len))
+			paced_dgrams++;
 
 		/* Write datagram header. */
 		qc_txb_store(buf, pkt->len, pkt);
@@ -3403,6 +3479,9 @@ static int qc_prep_app_pkts(struct quic_conn *qc, struct buffer *buf,
  out:
 	ret = total;
  leave:
+	/* the shared counter is only updated once per burst */
+	if (paced_dgrams)
+		HA_ATOMIC_ADD(&qc->prx_counters->paced_dgrams, paced_dgrams);
 	TRACE_LEAVE(QUIC_EV_CONN_PHPKTS, qc);
 	return ret;
 }
@@ -5292,7 +5371,8 @@ static struct quic_conn *qc_new_conn(const struct quic_version *qv, int ipv4,
 
 	if (qc_conn_alloc_ssl_ctx(qc) ||
 	    !quic_conn_init_timer(qc) ||
-	    !quic_conn_init_idle_timer_task(qc))
+	    !quic_conn_init_idle_timer_task(qc) ||
+	    !quic_conn_init_pacing_task(qc))
 		goto err;
 
 	ictx = &qc->els[QUIC_TLS_ENC_LEVEL_INITIAL].tls_ctx;
@@ -5378,6 +5458,11 @@ void quic_conn_release(struct quic_conn *qc)
 		qc->timer_task = NULL;
 	}
 
+	if (qc->pacing_task) {
+		task_destroy(qc->pacing_task);
+		qc->pacing_task = NULL;
+	}
+
 	if (qc->wait_event.tasklet)
 		tasklet_free(qc->wait_event.tasklet);
 
@@ -5425,6 +5510,57 @@ void quic_conn_release(struct quic_conn *qc)
 	TRACE_LEAVE(QUIC_EV_CONN_CLOSE, qc);
 }
 
+/* Pacing task callback: enough pacing credit is available again for <qc>, so
+ * its I/O handler and the MUX, if it was waiting for sending, are woken up.
+ */
+static struct task *qc_pacing_task(struct task *t, void *ctx, unsigned int state)
+{
+	struct quic_conn *qc = ctx;
+
+	TRACE_ENTER(QUIC_EV_CONN_PTIMER, qc);
+
+	t->expire = TICK_ETERNITY;
+	tasklet_wakeup(qc->wait_event.tasklet);
+	if (qc->subs && qc->subs->events & SUB_RETRY_SEND) {
+		tasklet_wakeup(qc->subs->tasklet);
+		qc->subs->events &= ~SUB_RETRY_SEND;
+		if (!qc->subs->events)
+			qc->subs = NULL;
+	}
+
+	TRACE_LEAVE(QUIC_EV_CONN_PTIMER, qc);
+	return t;
+}
+
+/* Initialize the pacing task of <qc> QUIC connection if pacing is enabled.
+ * Returns 1 if succeeded, 0 if not.
+ */
+static int quic_conn_init_pacing_task(struct quic_conn *qc)
+{
+	int ret = 0;
+
+	TRACE_ENTER(QUIC_EV_CONN_NEW, qc);
+
+	if (!(global.tune.options & GTUNE_QUIC_PACING))
+		goto done;
+
+	qc->pacing_task = task_new_on(qc->tid);
+	if (!qc->pacing_task) {
+		TRACE_ERROR("pacing task allocation failed", QUIC_EV_CONN_NEW, qc);
+		goto leave;
+	}
+
+	qc->pacing_task->process = qc_pacing_task;
+	qc->pacing_task->context = qc;
+	qc->pacing_last = now_mono_time();
+	qc->pacing_credit = 0;
+ done:
+	ret = 1;
+ leave:
+	TRACE_LEAVE(QUIC_EV_CONN_NEW, qc);
+	return ret;
+}
+
 /* Initialize the timer task of <qc> QUIC connection.
  * Returns 1 if succeeded, 0 if not.
  */
@@ -6188,6 +6324,8 @@ static int send_retry(int fd, struct sockaddr_storage *addr,
 		TRACE_ERROR("RAND_bytes() failed", QUIC_EV_CONN_TXPKT);
 		goto out;
 	}
+	/* the next Initial packets will be handled by the current thread */
+	quic_pin_cid_to_tid(scid.data, tid);
 
 	buf[i++] = scid.len;
 	memcpy(&buf[i], scid.data, scid.len);
@@ -162,6 +162,16 @@ struct connection *quic_sock_accept_conn(struct listener *l, int *status)
 
 /* Retrieve the DCID from the datagram found in <buf> and deliver it to the
  * correct datagram handler.
+ *
+ * The datagrams carrying a CID generated by haproxy are delivered to the thread
+ * encoded in it. The other ones can only open a new connection. When they are
+ * received on a listener bound to a single thread (e.g. with "shards
+ * by-thread"), they are kept on the current thread. Indeed, the system's
+ * SO_REUSEPORT hashing delivers all the datagrams of a client to the same
+ * socket, and all the CIDs of the new connection will be pinned to the thread
+ * which created it. Thus most datagrams never have to be passed to another
+ * thread.
+ *
  * Return 1 if a correct datagram could be found, 0 if not.
  */
 static int quic_lstnr_dgram_dispatch(unsigned char *buf, size_t len, void *owner,
@@ -169,6 +179,8 @@ static int quic_lstnr_dgram_dispatch(unsigned char *buf, size_t len, void *owner
                                      struct sockaddr_storage *daddr,
                                      struct quic_dgram *new_dgram, struct list *dgrams)
 {
+	struct listener *l = owner;
+	struct quic_counters *prx_counters;
 	struct quic_dgram *dgram;
 	unsigned char *dcid;
 	size_t dcid_len;
@@ -181,7 +193,19 @@ static int quic_lstnr_dgram_dispatch(unsigned char *buf, size_t len, void *owner
 	if (!dgram)
 		goto err;
 
-	cid_tid = quic_get_cid_tid(dcid);
+	if (!quic_cid_is_pinned(dcid, dcid_len) &&
+	    (*buf & QUIC_PACKET_LONG_HEADER_BIT) &&
+	    my_popcountl(l->rx.bind_thread) == 1)
+		cid_tid = tid;
+	else
+		cid_tid = quic_get_cid_tid(dcid);
+
+	prx_counters = EXTRA_COUNTERS_GET(l->bind_conf->frontend->extra_counters_fe,
+	                                  &quic_stats_module);
+	if (cid_tid == tid)
+		HA_ATOMIC_INC(&prx_counters->dgram_direct);
+	else
+		HA_ATOMIC_INC(&prx_counters->dgram_redispatched);
 
 	/* All the members must be initialized! */
 	dgram->owner = owner;
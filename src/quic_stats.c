@@ -79,6 +79,14 @@ static struct name_desc quic_stats[] = {
 	                                        .desc = "Total number of received STREAM_DATA_BLOCKED_BIDI frames" },
 	[QUIC_ST_STREAMS_DATA_BLOCKED_UNI]  = { .name = "quic_streams_data_blocked_uni",
 	                                        .desc = "Total number of received STREAM_DATA_BLOCKED_UNI frames" },
+	[QUIC_ST_PACING_DEFERRED] = { .name = "quic_pacing_deferred",
+	                              .desc = "Total number of times emission was deferred by pacing" },
+	[QUIC_ST_PACED_DGRAMS]    = { .name = "quic_paced_dgrams",
+	                              .desc = "Total number of datagrams emitted under pacing control" },
+	[QUIC_ST_DGRAM_DIRECT]       = { .name = "quic_dgram_direct",
+	                                 .desc = "Total number of received datagrams handled by the receiving thread" },
+	[QUIC_ST_DGRAM_REDISPATCHED] = { .name = "quic_dgram_redispatched",
+	                                 .desc = "Total number of received datagrams passed to another thread" },
 };
 
 struct quic_counters quic_counters;
@@ -126,6 +134,10 @@ static void quic_fill_stats(void *data, struct field *stats)
 	stats[QUIC_ST_STREAM_DATA_BLOCKED]       = mkf_u64(FN_COUNTER, counters->stream_data_blocked);
 	stats[QUIC_ST_STREAMS_DATA_BLOCKED_BIDI] = mkf_u64(FN_COUNTER, counters->streams_data_blocked_bidi);
 	stats[QUIC_ST_STREAMS_DATA_BLOCKED_UNI]  = mkf_u64(FN_COUNTER, counters->streams_data_blocked_uni);
+	stats[QUIC_ST_PACING_DEFERRED]           = mkf_u64(FN_COUNTER, counters->pacing_deferred);
+	stats[QUIC_ST_PACED_DGRAMS]              = mkf_u64(FN_COUNTER, counters->paced_dgrams);
+	stats[QUIC_ST_DGRAM_DIRECT]              = mkf_u64(FN_COUNTER, counters->dgram_direct);
+	stats[QUIC_ST_DGRAM_REDISPATCHED]        = mkf_u64(FN_COUNTER, counters->dgram_redispatched);
 }
 
 struct stats_module quic_stats_module = {
@@ -63,6 +63,21 @@ DECLARE_STATIC_POOL(resolv_answer_item_pool, "resolv_answer_item", sizeof(struct
 DECLARE_STATIC_POOL(resolv_resolution_pool,  "resolv_resolution",  sizeof(struct resolv_resolution));
 DECLARE_POOL(resolv_requester_pool,  "resolv_requester",  sizeof(struct resolv_requester));
 
+/* process-wide DNS answer cache, shared by all resolvers sections */
+static struct eb_root resolv_cache_tree = EB_ROOT;
+static struct list resolv_cache_list = LIST_HEAD_INIT(resolv_cache_list);
+static unsigned int resolv_cache_size = 0;      /* max number of entries, 0 = disabled */
+static unsigned int resolv_cache_prefetch = 10; /* % of the TTL left before prefetching */
+static unsigned int resolv_cache_entries = 0;   /* current number of entries */
+static struct {
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long prefetches;
+	unsigned long long stores;
+	unsigned long long evictions;
+} resolv_cache_stats;
+__decl_spinlock(resolv_cache_lock);
+
 static unsigned int resolution_uuid = 1;
 unsigned int resolv_failed_resolutions = 0;
 static struct task *process_resolvers(struct task *t, void *context, unsigned int state);
@@ -156,6 +171,12 @@ struct show_resolvers_ctx {
 	struct dns_nameserver *ns;
 };
 
+/* CLI context used during "show resolvers-cache" */
+struct show_resolv_cache_ctx {
+	int header_done;    /* the counters were already dumped */
+	unsigned int skip;  /* number of entries already dumped */
+};
+
 /* Returns a pointer to the resolvers matching the id <id>. NULL is returned if
  * no match is found.
  */
@@ -393,6 +414,35 @@ static int resolv_send_query(struct resolv_resolution *resolution)
 	return 0;
 }
 
+/* Returns the largest response accepted from nameserver <ns>, <stream> being
+ * set when it was received over its stream transport. Such responses are not
+ * bound to the advertised UDP payload size, even for a datagram nameserver
+ * which retries truncated responses over TCP.
+ */
+static inline int resolv_ns_max_response_size(const struct dns_nameserver *ns, int stream)
+{
+	const struct resolvers *resolvers = ns->parent;
+
+	return stream ? DNS_TCP_MSG_MAX_SIZE : resolvers->accepted_payload_size;
+}
+
+/* Sends the current query of resolution <res> again, to the stream transport
+ * of nameserver <ns> only. It returns 0 on success or -1 on error.
+ */
+static int resolv_send_query_stream(struct resolv_resolution *res, struct dns_nameserver *ns)
+{
+	int len;
+
+	len = resolv_build_query(res->query_id, res->query_type,
+	                         res->resolvers->accepted_payload_size,
+	                         res->hostname_dn, res->hostname_dn_len,
+	                         trash.area, trash.size);
+	if (len < 0)
+		return -1;
+
+	return (dns_send_nameserver_stream(ns, trash.area, len) < 0) ? -1 : 0;
+}
+
 /* Prepares and sends a DNS resolution. It returns 1 if the query was sent, 0 if
  * skipped and -1 if an error occurred.
  */
@@ -2128,6 +2178,244 @@ void resolv_unlink_resolution(struct resolv_requester *requester)
 	leave_resolver_code();
 }
 
+/* Skips the domain name starting at <reader> in a DNS message ending at
+ * <bufend>. Returns a pointer to the first byte after the name, or NULL if the
+ * name is malformed.
+ */
+static unsigned char *resolv_skip_name(unsigned char *reader, unsigned char *bufend)
+{
+	while (reader < bufend) {
+		if (*reader == 0)
+			return reader + 1;
+		if ((*reader & 0xc0) == 0xc0)
+			return (reader + 2 <= bufend) ? reader + 2 : NULL;
+		reader += *reader + 1;
+	}
+	return NULL;
+}
+
+/* Returns the lowest TTL in seconds among the answer records of the DNS
+ * response <resp> ending at <bufend>, or -1 if there is no answer or if the
+ * message is malformed. The response is expected to have already been
+ * validated.
+ */
+static int resolv_response_min_ttl(unsigned char *resp, unsigned char *bufend)
+{
+	unsigned char *reader = resp;
+	int qdcount, ancount, i;
+	int ttl, min_ttl = -1;
+
+	if (reader + DNS_HEADER_SIZE > bufend)
+		return -1;
+
+	qdcount = read_n16(reader + 4);
+	ancount = read_n16(reader + 6);
+	reader += DNS_HEADER_SIZE;
+
+	for (i = 0; i < qdcount; i++) {
+		reader = resolv_skip_name(reader, bufend);
+		if (!reader || reader + 4 > bufend)
+			return -1;
+		reader += 4; /* type + class */
+	}
+
+	for (i = 0; i < ancount; i++) {
+		reader = resolv_skip_name(reader, bufend);
+		if (!reader || reader + 10 > bufend)
+			return -1;
+		ttl = read_n32(reader + 4) & 0x7fffffff;
+		if (min_ttl < 0 || ttl < min_ttl)
+			min_ttl = ttl;
+		reader += 10 + read_n16(reader + 8);
+	}
+	return min_ttl;
+}
+
+/* Unlinks and frees cache entry <ce>. Must be called with the cache lock
+ * held.
+ */
+static void resolv_cache_free_entry(struct resolv_cache_entry *ce)
+{
+	eb32_delete(&ce->node);
+	LIST_DELETE(&ce->list);
+	resolv_cache_entries--;
+	free(ce);
+}
+
+/* Looks up the cache entry for hostname <dn> of length <dn_len> and query
+ * type <query_type>. Expired entries are released on the fly. Returns the
+ * entry or NULL if none is valid. Must be called with the cache lock held.
+ */
+static struct resolv_cache_entry *resolv_cache_lookup(int query_type, const char *dn, int dn_len)
+{
+	struct resolv_cache_entry *ce;
+	struct eb32_node *node;
+	uint32_t key = XXH32(dn, dn_len, query_type);
+
+	for (node = eb32_lookup(&resolv_cache_tree, key); node; node = eb32_next_dup(node)) {
+		ce = eb32_entry(node, struct resolv_cache_entry, node);
+		if (ce->query_type != query_type || ce->hostname_dn_len != dn_len ||
+		    memcmp(ce->hostname_dn, dn, dn_len) != 0)
+			continue;
+
+		if (tick_is_expired(ce->expire, now_ms)) {
+			resolv_cache_free_entry(ce);
+			return NULL;
+		}
+		return ce;
+	}
+	return NULL;
+}
+
+/* Stores the response <resp> of length <resp_len> received for resolution
+ * <res> into the shared cache, replacing any previous entry for the same name
+ * and query type. The entry is keyed on the query type the response answers,
+ * which differs from the preferred one after the A<->AAAA fallback.
+ * Positive responses are kept for the lowest TTL of their answer records,
+ * negative ones (NXDOMAIN, <negative> set) for the "hold nx" period of the
+ * resolvers section. The oldest entries are evicted when the cache is full.
+ */
+static void resolv_cache_store(struct resolv_resolution *res, unsigned char *resp, int resp_len, int negative)
+{
+	struct resolv_cache_entry *ce;
+	int ttl;
+
+	if (!resolv_cache_size || !res->hostname_dn)
+		return;
+
+	if (negative)
+		ttl = res->resolvers->hold.nx;
+	else {
+		ttl = resolv_response_min_ttl(resp, resp + resp_len);
+		/* keep ticks arithmetic safe, no need to trust a TTL beyond a day */
+		ttl = MIN(ttl, 86400) * 1000;
+	}
+	if (ttl <= 0)
+		return;
+
+	HA_SPIN_LOCK(DNS_LOCK, &resolv_cache_lock);
+
+	ce = resolv_cache_lookup(res->query_type, res->hostname_dn, res->hostname_dn_len);
+	if (ce)
+		resolv_cache_free_entry(ce);
+
+	while (resolv_cache_entries >= resolv_cache_size) {
+		ce = LIST_ELEM(resolv_cache_list.n, struct resolv_cache_entry *, list);
+		if (!tick_is_expired(ce->expire, now_ms))
+			resolv_cache_stats.evictions++;
+		resolv_cache_free_entry(ce);
+	}
+
+	ce = malloc(sizeof(*ce) + res->hostname_dn_len + resp_len);
+	if (!ce)
+		goto end;
+
+	ce->query_type      = res->query_type;
+	ce->negative        = negative;
+	ce->fallback        = (res->query_type != res->prefered_query_type);
+	ce->prefetching     = 0;
+	ce->stored          = now_ms;
+	ce->expire          = tick_add(now_ms, ttl);
+	ce->hits            = 0;
+	ce->hostname_dn_len = res->hostname_dn_len;
+	ce->resp_len        = resp_len;
+	ce->hostname_dn     = ce->area;
+	ce->resp            = (unsigned char *)ce->area + res->hostname_dn_len;
+	memcpy(ce->hostname_dn, res->hostname_dn, res->hostname_dn_len);
+	memcpy(ce->resp, resp, resp_len);
+
+	ce->node.key = XXH32(ce->hostname_dn, ce->hostname_dn_len, ce->query_type);
+	eb32_insert(&resolv_cache_tree, &ce->node);
+	LIST_APPEND(&resolv_cache_list, &ce->list);
+	resolv_cache_entries++;
+	resolv_cache_stats.stores++;
+ end:
+	HA_SPIN_UNLOCK(DNS_LOCK, &resolv_cache_lock);
+}
+
+/* Tries to feed the resolution <res> from the shared cache instead of sending
+ * a query. On a hit, the requesters are notified exactly as if the response
+ * had just been received and the resolution is reset. Returns 0 if no usable
+ * entry was found, 1 if the resolution was served from the cache, or 2 if it
+ * was served but the entry is about to expire and a real query must be sent
+ * to refresh it (prefetch). Must be called with the resolvers lock held on a
+ * resolution which is not running.
+ */
+static int resolv_cache_serve(struct resolv_resolution *res)
+{
+	struct resolvers *resolvers = res->resolvers;
+	struct resolv_cache_entry *ce;
+	struct resolv_requester *req;
+	unsigned char buf[DNS_MAX_UDP_MESSAGE + 1];
+	int buflen, dns_resp, max_answer_records;
+	int keep_answer_items;
+	int ret = 1;
+
+	if (!resolv_cache_size || !res->hostname_dn)
+		return 0;
+
+	HA_SPIN_LOCK(DNS_LOCK, &resolv_cache_lock);
+	ce = resolv_cache_lookup(res->prefered_query_type, res->hostname_dn, res->hostname_dn_len);
+	if (!ce && (res->prefered_query_type == DNS_RTYPE_A || res->prefered_query_type == DNS_RTYPE_AAAA)) {
+		/* an answer for the other family only stands for this one if it
+		 * was obtained after the preferred type failed.
+		 */
+		ce = resolv_cache_lookup(res->prefered_query_type == DNS_RTYPE_A ? DNS_RTYPE_AAAA : DNS_RTYPE_A,
+		                         res->hostname_dn, res->hostname_dn_len);
+		if (ce && !ce->fallback)
+			ce = NULL;
+	}
+	if (!ce || (ce->resp_len > resolvers->accepted_payload_size && !resolvers->tcp_fallback)) {
+		resolv_cache_stats.misses++;
+		HA_SPIN_UNLOCK(DNS_LOCK, &resolv_cache_lock);
+		return 0;
+	}
+
+	ce->hits++;
+	resolv_cache_stats.hits++;
+	if (!ce->negative && !ce->prefetching && resolv_cache_prefetch) {
+		int lifetime = ce->expire - ce->stored;
+
+		if (tick_is_expired(tick_add(ce->stored, lifetime - lifetime / 100 * resolv_cache_prefetch), now_ms)) {
+			resolv_cache_stats.prefetches++;
+			ce->prefetching = 1;
+			ret = 2;
+		}
+	}
+	buflen = ce->resp_len;
+	memcpy(buf, ce->resp, buflen);
+	res->query_type = ce->query_type;
+	HA_SPIN_UNLOCK(DNS_LOCK, &resolv_cache_lock);
+
+	max_answer_records = (buflen - DNS_HEADER_SIZE) / DNS_MIN_RECORD_SIZE;
+	dns_resp = resolv_validate_dns_response(buf, buf + buflen, res, max_answer_records);
+
+	if (dns_resp == RSLV_RESP_VALID) {
+		res->status     = RSLV_STATUS_VALID;
+		res->last_valid = now_ms;
+		list_for_each_entry(req, &res->requesters, list) {
+			struct server *s = objt_server(req->owner);
+
+			if (s)
+				HA_SPIN_LOCK(SERVER_LOCK, &s->lock);
+			req->requester_cb(req, NULL);
+			if (s)
+				HA_SPIN_UNLOCK(SERVER_LOCK, &s->lock);
+		}
+	}
+	else {
+		res->status = (dns_resp == RSLV_RESP_NX_DOMAIN) ? RSLV_STATUS_NX : RSLV_STATUS_OTHER;
+		keep_answer_items = 0;
+		list_for_each_entry(req, &res->requesters, list)
+			keep_answer_items |= req->requester_error_cb(req, dns_resp);
+		if (!keep_answer_items)
+			resolv_purge_resolution_answer_records(res);
+	}
+
+	resolv_reset_resolution(res);
+	return ret;
+}
+
 /* Called when a network IO is generated on a name server socket for an incoming
  * packet. It performs the following actions:
  *  - check if the packet requires processing (not outdated resolution)
@@ -2143,7 +2431,7 @@ static int resolv_process_responses(struct dns_nameserver *ns)
 	unsigned char  buf[DNS_MAX_UDP_MESSAGE + 1];
 	unsigned char *bufend;
 	int buflen, dns_resp;
-	int max_answer_records;
+	int max_answer_records, max_size, from_stream;
 	unsigned short query_id;
 	struct eb32_node *eb;
 	struct resolv_requester *req;
@@ -2155,14 +2443,22 @@ static int resolv_process_responses(struct dns_nameserver *ns)
 
 	/* process all pending input messages */
 	while (1) {
-		/* read message received */
-		memset(buf, '\0', resolvers->accepted_payload_size + 1);
-		if ((buflen = dns_recv_nameserver(ns, (void *)buf, sizeof(buf))) <= 0) {
-			break;
+		/* read message received. Once its datagrams are drained, a UDP
+		 * nameserver may still deliver the responses retried over TCP.
+		 */
+		memset(buf, '\0', resolv_ns_max_response_size(ns, !!ns->stream) + 1);
+		from_stream = !ns->dgram;
+		buflen = dns_recv_nameserver(ns, (void *)buf, sizeof(buf));
+		if (buflen <= 0 && ns->dgram && ns->stream) {
+			from_stream = 1;
+			buflen = dns_recv_nameserver_stream(ns, (void *)buf, sizeof(buf));
 		}
+		if (buflen <= 0)
+			break;
+		max_size = resolv_ns_max_response_size(ns, from_stream);
 
 		/* message too big */
-		if (buflen > resolvers->accepted_payload_size) {
+		if (buflen > max_size) {
 			ns->counters->app.resolver.too_big++;
 			continue;
 		}
@@ -2190,7 +2486,23 @@ static int resolv_process_responses(struct dns_nameserver *ns)
 		/* number of responses received */
 		res->nb_responses++;
 
-		max_answer_records = (resolvers->accepted_payload_size - DNS_HEADER_SIZE) / DNS_MIN_RECORD_SIZE;
+		/* A truncated response from a datagram nameserver is retried
+		 * over its TCP fallback when available, and the full response
+		 * will be delivered there. The query is accounted once more and
+		 * the retry timer rearmed to leave time to set up the connection.
+		 */
+		if (!from_stream && ns->stream && buf + 4 <= bufend &&
+		    (read_n16(buf + 2) & DNS_FLAG_TRUNCATED) &&
+		    resolv_send_query_stream(res, ns) == 0) {
+			ns->counters->app.resolver.truncated++;
+			res->nb_queries++;
+			res->last_query = now_ms;
+			LIST_DEL_INIT(&res->list);
+			LIST_APPEND(&resolvers->resolutions.curr, &res->list);
+			continue;
+		}
+
+		max_answer_records = (max_size - DNS_HEADER_SIZE) / DNS_MIN_RECORD_SIZE;
 		dns_resp = resolv_validate_dns_response(buf, bufend, res, max_answer_records);
 
 		switch (dns_resp) {
@@ -2273,6 +2585,8 @@ static int resolv_process_responses(struct dns_nameserver *ns)
 		goto report_res_success;
 
 	report_res_error:
+		if (dns_resp == RSLV_RESP_NX_DOMAIN)
+			resolv_cache_store(res, buf, buflen, 1);
 		keep_answer_items = 0;
 		list_for_each_entry(req, &res->requesters, list)
 			keep_answer_items |= req->requester_error_cb(req, dns_resp);
@@ -2284,6 +2598,8 @@ static int resolv_process_responses(struct dns_nameserver *ns)
 		continue;
 
 	report_res_success:
+		resolv_cache_store(res, buf, buflen, 0);
+
 		/* Only the 1rst requester s managed by the server, others are
 		 * from the cache */
 		tmpcounters = ns->counters;
@@ -2317,7 +2633,7 @@ static struct task *process_resolvers(struct task *t, void *context, unsigned in
 {
 	struct resolvers  *resolvers = context;
 	struct resolv_resolution *res, *resback;
-	int exp;
+	int exp, cached;
 
 	enter_resolver_code();
 	HA_SPIN_LOCK(DNS_LOCK, &resolvers->lock);
@@ -2445,6 +2761,16 @@ static struct task *process_resolvers(struct task *t, void *context, unsigned in
 		if (tick_isset(res->last_resolution) && !tick_is_expired(exp, now_ms))
 			continue;
 
+		/* a fresh answer from the shared cache avoids the query, unless
+		 * it is about to expire and must be prefetched. Requesters'
+		 * callbacks may have released other resolutions.
+		 */
+		cached = (res->step == RSLV_STEP_NONE) ? resolv_cache_serve(res) : 0;
+		if (cached)
+			resback = LIST_NEXT(&res->list, struct resolv_resolution *, list);
+		if (cached == 1)
+			continue;
+
 		if (resolv_run_resolution(res) != 1) {
 			res->last_resolution = now_ms;
 			LIST_DEL_INIT(&res->list);
@@ -2543,6 +2869,9 @@ static void resolvers_deinit(void)
 		LIST_DEL_INIT(&srvrq->list);
 		free(srvrq);
 	}
+
+	while (!LIST_ISEMPTY(&resolv_cache_list))
+		resolv_cache_free_entry(LIST_ELEM(resolv_cache_list.n, struct resolv_cache_entry *, list));
 }
 
 /* Finalizes the DNS configuration by allocating required resources and checking
@@ -2909,10 +3238,67 @@ static int cli_io_handler_dump_resolvers_to_buffer(struct appctx *appctx)
 	return 0;
 }
 
+/* Dumps the shared DNS answer cache, its global counters first then one line
+ * per entry. It returns 0 if the output buffer is full and it needs to be
+ * called again, otherwise non-zero. Entries already dumped are counted in the
+ * <skip> field of the show_resolv_cache_ctx pointed to by <svcctx>.
+ */
+static int cli_io_handler_dump_resolv_cache(struct appctx *appctx)
+{
+	struct show_resolv_cache_ctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+	struct resolv_cache_entry *ce;
+	unsigned int idx = 0;
+	char name[DNS_MAX_NAME_SIZE + 1];
+	int ret = 1;
+
+	HA_SPIN_LOCK(DNS_LOCK, &resolv_cache_lock);
+
+	if (!ctx->header_done) {
+		chunk_printf(&trash,
+		             "# size: %u entries: %u hits: %llu misses: %llu prefetches: %llu stores: %llu evictions: %llu\n"
+		             "# name type result expire(ms) hits\n",
+		             resolv_cache_size, resolv_cache_entries,
+		             resolv_cache_stats.hits, resolv_cache_stats.misses,
+		             resolv_cache_stats.prefetches, resolv_cache_stats.stores,
+		             resolv_cache_stats.evictions);
+		if (applet_putchk(appctx, &trash) == -1) {
+			ret = 0;
+			goto end;
+		}
+		ctx->header_done = 1;
+	}
+
+	list_for_each_entry(ce, &resolv_cache_list, list) {
+		if (idx++ < ctx->skip)
+			continue;
+
+		if (resolv_dn_label_to_str(ce->hostname_dn, ce->hostname_dn_len, name, sizeof(name)) < 0)
+			strcpy(name, "?");
+
+		chunk_printf(&trash, "%s %s %s %d %u\n", name,
+		             ce->query_type == DNS_RTYPE_A ? "A" :
+		             ce->query_type == DNS_RTYPE_AAAA ? "AAAA" :
+		             ce->query_type == DNS_RTYPE_SRV ? "SRV" : "other",
+		             ce->negative ? "NX" : ce->fallback ? "fallback" : "valid",
+		             tick_is_expired(ce->expire, now_ms) ? 0 : TICKS_TO_MS(tick_remain(now_ms, ce->expire)),
+		             ce->hits);
+		if (applet_putchk(appctx, &trash) == -1) {
+			ret = 0;
+			break;
+		}
+		ctx->skip = idx;
+	}
+ end:
+	HA_SPIN_UNLOCK(DNS_LOCK, &resolv_cache_lock);
+	return ret;
+}
+
 /* register cli keywords */
 static struct cli_kw_list cli_kws = {{ }, {
 		{ { "show", "resolvers", NULL }, "show resolvers [id]                     : dumps counters from all resolvers section and associated name servers",
 		  cli_parse_stat_resolvers, cli_io_handler_dump_resolvers_to_buffer },
+		{ { "show", "resolvers-cache", NULL }, "show resolvers-cache                    : dump the shared DNS answer cache",
+		  NULL, cli_io_handler_dump_resolv_cache },
 		{{},}
 	}
 };
@@ -3180,7 +3566,7 @@ enum act_parse_ret resolv_parse_do_resolve(const char **args, int *orig_arg, str
 		memprintf(err,
 			  "fetch method '%s' extracts information from '%s', none of which is available here",
 			  args[cur_arg-1], sample_src_names(expr->fetch->use));
-		free(expr);
+		release_sample_expr(expr);
 		return ACT_RET_PRS_ERR;
 	}
 	rule->arg.resolv.expr = expr;
@@ -3662,6 +4048,18 @@ int cfg_parse_resolvers(const char *file, int linenum, char **args, int kwm)
 
 		curr_resolvers->accepted_payload_size = i;
 	}
+	else if (strcmp(args[0], "tcp-fallback") == 0) {
+		if (strcmp(args[1], "on") == 0)
+			curr_resolvers->tcp_fallback = 1;
+		else if (strcmp(args[1], "off") == 0)
+			curr_resolvers->tcp_fallback = 0;
+		else {
+			ha_alert("parsing [%s:%d] : '%s' expects 'on' or 'off' as argument.\n",
+				 file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+	}
 	else if (strcmp(args[0], "resolution_pool_size") == 0) {
 		ha_alert("parsing [%s:%d] : '%s' directive is not supported anymore (it never appeared in a stable release).\n",
 			   file, linenum, args[0]);
@@ -3783,6 +4181,50 @@ int resolvers_create_default()
 	return 0;
 }
 
+/* Creates a stream transport for the datagram nameserver <ns>, towards the
+ * same address, so that truncated responses may be retried over TCP. The
+ * server is declared in the resolvers section's proxy just like for a TCP
+ * nameserver. Returns the ERR_* codes.
+ */
+static int resolv_nameserver_init_tcp_fallback(struct dns_nameserver *ns)
+{
+	struct resolvers *resolvers = ns->parent;
+	struct sockaddr_storage *sk = &ns->dgram->conn.addr.to;
+	char addr[INET6_ADDRSTRLEN];
+	char *srv_addr = NULL;
+	char *args[4];
+	int err_code;
+
+	if (addr_to_str(sk, addr, sizeof(addr)) < 0) {
+		ha_alert("resolvers '%s': cannot use TCP fallback for nameserver '%s' (unsupported address family).\n",
+			 resolvers->id, ns->id);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	memprintf(&srv_addr, "%s@%s:%d", sk->ss_family == AF_INET6 ? "tcp6" : "tcp4",
+		  addr, get_host_port(sk));
+	if (!srv_addr) {
+		ha_alert("resolvers '%s': out of memory.\n", resolvers->id);
+		return ERR_ALERT | ERR_ABORT;
+	}
+
+	args[0] = "nameserver";
+	args[1] = ns->id;
+	args[2] = srv_addr;
+	args[3] = "";
+	err_code = parse_server(ns->conf.file, ns->conf.line, args, resolvers->px, NULL,
+				SRV_PARSE_PARSE_ADDR|SRV_PARSE_INITIAL_RESOLVE);
+	free(srv_addr);
+	if (err_code & (ERR_FATAL|ERR_ABORT))
+		return err_code | ERR_ABORT;
+
+	if (dns_stream_init(ns, resolvers->px->srv) < 0) {
+		ha_alert("resolvers '%s': out of memory.\n", resolvers->id);
+		err_code |= ERR_ALERT | ERR_ABORT;
+	}
+	return err_code;
+}
+
 int cfg_post_parse_resolvers()
 {
 	int err_code = 0;
@@ -3790,6 +4232,20 @@ int cfg_post_parse_resolvers()
 
 	if (curr_resolvers) {
 
+		/* nameservers reached over UDP get a TCP transport to the same
+		 * address to retry truncated responses.
+		 */
+		if (curr_resolvers->tcp_fallback) {
+			struct dns_nameserver *ns;
+
+			list_for_each_entry(ns, &curr_resolvers->nameservers, list) {
+				if (ns->dgram && !ns->stream)
+					err_code |= resolv_nameserver_init_tcp_fallback(ns);
+				if (err_code & (ERR_FATAL|ERR_ABORT))
+					goto out;
+			}
+		}
+
 		/* prepare forward server descriptors */
 		if (curr_resolvers->px) {
 			srv = curr_resolvers->px->srv;
@@ -3806,10 +4262,49 @@ int cfg_post_parse_resolvers()
 			}
 		}
 	}
+ out:
 	curr_resolvers = NULL;
 	return err_code;
 }
 
+/* config parser for global "tune.resolvers.cache-size" and
+ * "tune.resolvers.cache-prefetch"
+ */
+static int resolv_parse_cache_tune(char **args, int section_type, struct proxy *curpx,
+                                   const struct proxy *defpx, const char *file, int line,
+                                   char **err)
+{
+	int val;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	val = atoi(args[1]);
+	if (strcmp(args[0], "tune.resolvers.cache-size") == 0) {
+		if (*args[1] < '0' || *args[1] > '9' || val < 0) {
+			memprintf(err, "'%s' expects a positive numeric value.", args[0]);
+			return -1;
+		}
+		resolv_cache_size = val;
+	}
+	else {
+		if (*args[1] < '0' || *args[1] > '9' || val < 0 || val > 100) {
+			memprintf(err, "'%s' expects a percentage between 0 and 100.", args[0]);
+			return -1;
+		}
+		resolv_cache_prefetch = val;
+	}
+	return 0;
+}
+
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.resolvers.cache-size",     resolv_parse_cache_tune },
+	{ CFG_GLOBAL, "tune.resolvers.cache-prefetch", resolv_parse_cache_tune },
+	{ 0, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
 REGISTER_CONFIG_SECTION("resolvers",      cfg_parse_resolvers, cfg_post_parse_resolvers);
 REGISTER_POST_DEINIT(resolvers_deinit);
 REGISTER_CONFIG_POSTPARSER("dns runtime resolver", resolvers_finalize_config);
@@ -19,27 +19,34 @@
 #include <import/mjson.h>
 #include <import/sha1.h>
 
+#include <haproxy/activity.h>
 #include <haproxy/api.h>
+#include <haproxy/applet.h>
 #include <haproxy/arg.h>
 #include <haproxy/auth.h>
 #include <haproxy/base64.h>
 #include <haproxy/buf.h>
+#include <haproxy/cfgparse.h>
 #include <haproxy/chunk.h>
+#include <haproxy/cli.h>
 #include <haproxy/clock.h>
 #include <haproxy/errors.h>
 #include <haproxy/fix.h>
 #include <haproxy/global.h>
 #include <haproxy/hash.h>
 #include <haproxy/http.h>
+#include <haproxy/htx.h>
 #include <haproxy/istbuf.h>
 #include <haproxy/mqtt.h>
 #include <haproxy/net_helper.h>
+#include <haproxy/pool.h>
 #include <haproxy/protobuf.h>
 #include <haproxy/proxy.h>
 #include <haproxy/regex.h>
 #include <haproxy/sample.h>
 #include <haproxy/sink.h>
 #include <haproxy/stick_table.h>
+#include <haproxy/stream.h>
 #include <haproxy/tools.h>
 #include <haproxy/uri_auth-t.h>
 #include <haproxy/vars.h>
@@ -62,6 +69,15 @@ const char *smp_to_type[SMP_TYPES] = {
 /* static sample used in sample_process() when <p> is NULL */
 static THREAD_LOCAL struct sample temp_smp;
 
+/* all compiled sample expressions, for profiling */
+static struct list sample_exprs = LIST_HEAD_INIT(sample_exprs);
+__decl_spinlock(sample_exprs_lock);
+
+/* number of entries of the per-stream sample cache, 0 when disabled */
+static unsigned int smp_memo_entries = 0;
+static unsigned int smp_memo_mask = 0;
+static struct pool_head *pool_head_smp_memo __read_mostly = NULL;
+
 /* list head of all known sample fetch keywords */
 static struct sample_fetch_kw_list sample_fetches = {
 	.list = LIST_HEAD_INIT(sample_fetches.list)
@@ -1011,6 +1027,8 @@ struct sample_expr *sample_parse_expr(char **str, int *idx, const char *file, in
 	unsigned long prev_type;
 	char *fkw = NULL;
 	char *ckw = NULL;
+	char *text = NULL;
+	int start_idx = *idx;
 	int err_arg;
 
 	begw = str[*idx];
@@ -1046,6 +1064,7 @@ struct sample_expr *sample_parse_expr(char **str, int *idx, const char *file, in
 	if (!expr)
 		goto out_error;
 
+	LIST_INIT(&expr->list);
 	LIST_INIT(&(expr->conv_exprs));
 	expr->fetch = fetch;
 	expr->arg_p = empty_arg_list;
@@ -1186,9 +1205,31 @@ struct sample_expr *sample_parse_expr(char **str, int *idx, const char *file, in
 		*endptr = (char *)endt;
 	}
 
+	/* rebuild the expression's text from the words it was made of, for
+	 * profiling purposes.
+	 */
+	for (; start_idx <= *idx && str[start_idx]; start_idx++) {
+		const char *word = str[start_idx];
+		size_t len = strlen(word);
+
+		if (endt >= word && endt <= word + len)
+			len = endt - word;
+		if (!len)
+			break;
+		memprintf(&text, "%s%s%.*s", text ? text : "", text ? " " : "", (int)len, word);
+		if (len < strlen(word))
+			break;
+	}
+
+	if (sample_expr_compile(expr, text ? text : fkw, file, line) != 0) {
+		memprintf(err_msg, "out of memory");
+		goto out_error;
+	}
+
  out:
 	free(fkw);
 	free(ckw);
+	free(text);
 	return expr;
 
 out_error:
@@ -1221,11 +1262,12 @@ struct sample_expr *sample_parse_expr(char **str, int *idx, const char *file, in
  *   smp      1        0     Present, may change (eg: request length)
  *   smp      1        1     Present, last known value (eg: request length)
  */
-struct sample *sample_process(struct proxy *px, struct session *sess,
-                              struct stream *strm, unsigned int opt,
-                              struct sample_expr *expr, struct sample *p)
+static inline struct sample *__sample_process(struct proxy *px, struct session *sess,
+                                              struct stream *strm, unsigned int opt,
+                                              struct sample_expr *expr, struct sample *p)
 {
 	struct sample_conv_expr *conv_expr;
+	sample_cast_fct cast;
 
 	if (p == NULL) {
 		p = &temp_smp;
@@ -1238,16 +1280,22 @@ struct sample *sample_process(struct proxy *px, struct session *sess,
 
 	list_for_each_entry(conv_expr, &expr->conv_exprs, list) {
 		/* we want to ensure that p->type can be casted into
-		 * conv_expr->conv->in_type. We have 3 possibilities :
+		 * conv_expr->conv->in_type. The cast was resolved at parse
+		 * time for the declared type of the previous step, which is
+		 * almost always the one we get. We have 3 possibilities :
 		 *  - NULL   => not castable.
 		 *  - c_none => nothing to do (let's optimize it)
 		 *  - other  => apply cast and prepare to fail
 		 */
-		if (!sample_casts[p->data.type][conv_expr->conv->in_type])
+		if (likely(p->data.type == conv_expr->in_type))
+			cast = conv_expr->cast;
+		else
+			cast = sample_casts[p->data.type][conv_expr->conv->in_type];
+
+		if (!cast)
 			return NULL;
 
-		if (sample_casts[p->data.type][conv_expr->conv->in_type] != c_none &&
-		    !sample_casts[p->data.type][conv_expr->conv->in_type](p))
+		if (cast != c_none && !cast(p))
 			return NULL;
 
 		/* OK cast succeeded */
@@ -1258,6 +1306,233 @@ struct sample *sample_process(struct proxy *px, struct session *sess,
 	return p;
 }
 
+/* Same as __sample_process() but also accounts for the evaluation when sample
+ * profiling is enabled.
+ */
+static inline struct sample *sample_process_prof(struct proxy *px, struct session *sess,
+                                                 struct stream *strm, unsigned int opt,
+                                                 struct sample_expr *expr, struct sample *p)
+{
+	struct sample *ret;
+	uint64_t start;
+
+	if (likely(!(profiling & HA_PROF_SAMPLES)))
+		return __sample_process(px, sess, strm, opt, expr, p);
+
+	start = now_mono_time();
+	ret = __sample_process(px, sess, strm, opt, expr, p);
+	_HA_ATOMIC_INC(&expr->calls);
+	_HA_ATOMIC_ADD(&expr->cpu_time, now_mono_time() - start);
+	return ret;
+}
+
+/* Returns the entry of the sample cache <memo> dedicated to the expression
+ * whose key is <key>, evaluated in iterate mode or not. It may currently hold
+ * another expression's result or none, see smp_memo_match().
+ */
+static inline struct smp_memo_entry *smp_memo_slot(struct smp_memo *memo, uint64_t key,
+                                                   unsigned int iterate)
+{
+	return &memo->entries[(key + iterate) & smp_memo_mask];
+}
+
+/* Returns non-zero if the cache entry <entry> of <memo> holds the result of the
+ * expression whose key is <key>, evaluated in iterate mode or not.
+ */
+static inline int smp_memo_match(const struct smp_memo *memo, const struct smp_memo_entry *entry,
+                                 uint64_t key, unsigned int iterate)
+{
+	return entry->epoch == memo->epoch && entry->key == key && entry->iterate == iterate;
+}
+
+/* Appends the value of sample <smp> to the cache entry <entry> whose area
+ * already holds <*used> bytes. Returns 0 if it does not fit.
+ */
+static int smp_memo_append(struct smp_memo_entry *entry, unsigned int *used, const struct sample *smp)
+{
+	struct sample_data *data;
+	struct buffer *str;
+
+	if (entry->count >= SMP_MEMO_MAX_VALUES)
+		return 0;
+
+	data = &entry->data[entry->count];
+	*data = smp->data;
+
+	if (data->type == SMP_T_STR || data->type == SMP_T_BIN)
+		str = &data->u.str;
+	else if (data->type == SMP_T_METH && data->u.meth.meth == HTTP_METH_OTHER)
+		str = &data->u.meth.str;
+	else
+		str = NULL;
+
+	if (str) {
+		if (str->data > SMP_MEMO_MAX_LEN - *used)
+			return 0;
+		memcpy(entry->area + *used, str->area, str->data);
+		str->area = entry->area + *used;
+		str->size = 0;
+		*used += str->data;
+	}
+	entry->count++;
+	return 1;
+}
+
+/* Serves the value at index <idx> of the cache entry <entry> in sample <p>.
+ * The position of the next value of multi-valued samples is kept in the
+ * sample's context so that the caller's next iteration is served from the
+ * cache as well.
+ */
+static struct sample *smp_memo_replay(const struct smp_memo_entry *entry, unsigned int idx,
+                                      struct proxy *px, struct session *sess,
+                                      struct stream *strm, unsigned int opt, struct sample *p)
+{
+	smp_set_owner(p, px, sess, strm, opt);
+	p->flags = entry->flags;
+	if (idx >= entry->count)
+		return NULL;
+
+	p->data = entry->data[idx];
+	p->flags |= SMP_F_CONST;
+	if (idx + 1 < entry->count) {
+		p->flags |= SMP_F_NOT_LAST;
+		p->ctx.a[0] = (void *)&smp_memo_entries;
+		p->ctx.a[1] = (void *)(uintptr_t)(idx + 1);
+	}
+	return p;
+}
+
+/* Returns the generation of the request's HTX message of stream <strm>, which
+ * changes with any header or start-line modification, including those made by
+ * filters and analysers. Streams not using HTX always report 0.
+ */
+static inline unsigned int smp_memo_req_gen(struct stream *strm)
+{
+	return IS_HTX_STRM(strm) ? htxbuf(&strm->req.buf)->gen : 0;
+}
+
+/* Looks up the result of the cacheable expression <expr> in the sample cache of
+ * stream <strm>, or evaluates it and stores its result there when it is stable
+ * and small enough. All values of a multi-valued sample are retrieved at once.
+ * See sample_process() for the arguments and return value.
+ */
+static struct sample *sample_process_memo(struct proxy *px, struct session *sess,
+                                          struct stream *strm, unsigned int opt,
+                                          struct sample_expr *expr, struct sample *p)
+{
+	unsigned int iterate = !!(opt & SMP_OPT_ITERATE);
+	struct smp_memo_entry *entry;
+	struct smp_memo *memo;
+	struct sample tmp, *ret;
+	unsigned int gen = smp_memo_req_gen(strm);
+	unsigned int used = 0;
+	unsigned int idx = 0;
+
+	if (p == NULL) {
+		p = &temp_smp;
+		memset(p, 0, sizeof(*p));
+	}
+
+	if (p->flags & SMP_F_NOT_LAST) {
+		/* next value of a multi-valued sample, which is only in the
+		 * cache if the first one was served from there.
+		 */
+		if (p->ctx.a[0] != (void *)&smp_memo_entries)
+			return sample_process_prof(px, sess, strm, opt, expr, p);
+		idx = (uintptr_t)p->ctx.a[1];
+	}
+
+	/* entries stored before the request was modified are stale */
+	memo = strm->smp_memo;
+	if (memo && memo->htx_gen != gen) {
+		smp_memo_reset(memo);
+		memo->htx_gen = gen;
+	}
+
+	entry = memo ? smp_memo_slot(memo, expr->memo_key, iterate) : NULL;
+	if (entry && smp_memo_match(memo, entry, expr->memo_key, iterate)) {
+		if (!idx)
+			activity[tid].smp_memo_hit++;
+		return smp_memo_replay(entry, idx, px, sess, strm, opt, p);
+	}
+
+	if (idx) {
+		/* the entry vanished during the iteration, which is not
+		 * supposed to happen. Report the end of the list.
+		 */
+		p->flags &= ~SMP_F_NOT_LAST;
+		return NULL;
+	}
+
+	activity[tid].smp_memo_miss++;
+
+	if (!memo) {
+		memo = strm->smp_memo = pool_alloc(pool_head_smp_memo);
+		if (!memo)
+			return sample_process_prof(px, sess, strm, opt, expr, p);
+		smp_memo_clear(memo);
+		memo->htx_gen = gen;
+		entry = smp_memo_slot(memo, expr->memo_key, iterate);
+	}
+
+	/* the expression takes over its slot from any previous one */
+	entry->key = 0;
+	entry->epoch = memo->epoch;
+	entry->iterate = iterate;
+	entry->count = 0;
+
+	memset(&tmp, 0, sizeof(tmp));
+	while (1) {
+		ret = sample_process_prof(px, sess, strm, opt, expr, &tmp);
+		if (!ret) {
+			if (tmp.flags & SMP_F_MAY_CHANGE)
+				goto not_cached;
+			break;
+		}
+
+		if ((tmp.flags & SMP_F_MAY_CHANGE) || !smp_memo_append(entry, &used, &tmp))
+			goto not_cached;
+
+		if (entry->count == 1)
+			entry->flags = tmp.flags & ~SMP_F_NOT_LAST;
+
+		if (!(tmp.flags & SMP_F_NOT_LAST))
+			break;
+	}
+
+	if (!entry->count)
+		entry->flags = tmp.flags;
+	entry->key = expr->memo_key;
+	return smp_memo_replay(entry, 0, px, sess, strm, opt, p);
+
+ not_cached:
+	entry->key = 0;
+
+	/* the first evaluation is returned as-is, with its context so that
+	 * the caller may go on with the next values.
+	 */
+	if (!entry->count) {
+		*p = tmp;
+		return ret ? p : NULL;
+	}
+
+	/* some values were already consumed, start over */
+	memset(p, 0, sizeof(*p));
+	return sample_process_prof(px, sess, strm, opt, expr, p);
+}
+
+struct sample *sample_process(struct proxy *px, struct session *sess,
+                              struct stream *strm, unsigned int opt,
+                              struct sample_expr *expr, struct sample *p)
+{
+	/* results only depending on the request may be cached in the stream */
+	if (expr->memo_key && strm && smp_memo_entries &&
+	    (opt & SMP_OPT_DIR) == SMP_OPT_DIR_REQ)
+		return sample_process_memo(px, sess, strm, opt, expr, p);
+
+	return sample_process_prof(px, sess, strm, opt, expr, p);
+}
+
 /*
  * Resolve all remaining arguments in proxy <p>. Returns the number of
  * errors or 0 if everything is fine. If at least one error is met, it will
@@ -1613,6 +1888,12 @@ void release_sample_expr(struct sample_expr *expr)
 	if (!expr)
 		return;
 
+	if (LIST_INLIST(&expr->list)) {
+		HA_SPIN_LOCK(OTHER_LOCK, &sample_exprs_lock);
+		LIST_DELETE(&expr->list);
+		HA_SPIN_UNLOCK(OTHER_LOCK, &sample_exprs_lock);
+	}
+
 	list_for_each_entry_safe(conv_expr, conv_exprb, &expr->conv_exprs, list) {
 		LIST_DELETE(&conv_expr->list);
 		release_sample_arg(conv_expr->arg_p);
@@ -1620,9 +1901,172 @@ void release_sample_expr(struct sample_expr *expr)
 	}
 
 	release_sample_arg(expr->arg_p);
+	free(expr->text);
+	free((char *)expr->file);
 	free(expr);
 }
 
+static int sample_conv_str2lower(const struct arg *arg_p, struct sample *smp, void *private);
+static int sample_conv_str2upper(const struct arg *arg_p, struct sample *smp, void *private);
+static int sample_conv_length(const struct arg *arg_p, struct sample *smp, void *private);
+
+/* Returns non-zero if the converter <conv_expr> may be dropped because its
+ * output is entirely rewritten by the next one <next>, which accepts the same
+ * input type. This is the case for case changes followed by another case
+ * change or by a length computation (e.g. "lower,upper" or "lower,length").
+ */
+static int sample_conv_is_overridden(const struct sample_conv_expr *conv_expr,
+                                     const struct sample_conv_expr *next)
+{
+	const struct sample_conv *conv = conv_expr->conv;
+
+	if (conv_expr->arg_p && conv_expr->arg_p != empty_arg_list)
+		return 0;
+
+	if (conv->in_type != next->conv->in_type || conv->out_type != next->conv->in_type)
+		return 0;
+
+	if (conv->process != sample_conv_str2lower && conv->process != sample_conv_str2upper)
+		return 0;
+
+	return next->conv->process == sample_conv_str2lower ||
+	       next->conv->process == sample_conv_str2upper ||
+	       next->conv->process == sample_conv_length;
+}
+
+/* Returns non-zero if the arguments list <args> only contains values known at
+ * parsing time, and no reference to a variable, a table, a proxy or a server
+ * whose contents may change while a stream is being processed.
+ */
+static int sample_args_are_stable(const struct arg *args)
+{
+	for (; args && args->type != ARGT_STOP; args++) {
+		switch (args->type) {
+		case ARGT_FE:
+		case ARGT_BE:
+		case ARGT_TAB:
+		case ARGT_SRV:
+		case ARGT_VAR:
+		case ARGT_PTR:
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Returns non-zero if the result of the sample expression <expr> only depends
+ * on the client connection and the request headers, so that it may be cached
+ * in the stream and reused as long as the request is not modified. Converters
+ * known to have side effects make the expression non-cacheable.
+ */
+static int sample_expr_is_cacheable(const struct sample_expr *expr)
+{
+	const struct sample_conv_expr *conv_expr;
+
+	if (expr->fetch->use & ~(SMP_USE_L4CLI | SMP_USE_L5CLI | SMP_USE_HRQHV | SMP_USE_HRQHP))
+		return 0;
+
+	if (!sample_args_are_stable(expr->arg_p))
+		return 0;
+
+	list_for_each_entry(conv_expr, &expr->conv_exprs, list) {
+		if (!sample_args_are_stable(conv_expr->arg_p))
+			return 0;
+		if (strcmp(conv_expr->conv->kw, "debug") == 0 ||
+		    strncmp(conv_expr->conv->kw, "lua.", 4) == 0)
+			return 0;
+	}
+	return 1;
+}
+
+/* Compiles the fully parsed sample expression <expr>: converters whose output
+ * is overridden by the next one are dropped, and the cast between each step is
+ * resolved from the declared output type of the previous one so that
+ * sample_process() does not need to look it up. The expression's <text> and
+ * location are saved and it is registered for profiling. Returns 0 on success
+ * or -1 on memory allocation failure.
+ */
+int sample_expr_compile(struct sample_expr *expr, const char *text, const char *file, int line)
+{
+	struct sample_conv_expr *conv_expr, *next;
+	unsigned int prev_type;
+
+	list_for_each_entry_safe(conv_expr, next, &expr->conv_exprs, list) {
+		if (&next->list == &expr->conv_exprs)
+			break;
+		if (sample_conv_is_overridden(conv_expr, next)) {
+			LIST_DELETE(&conv_expr->list);
+			release_sample_arg(conv_expr->arg_p);
+			free(conv_expr);
+		}
+	}
+
+	prev_type = expr->fetch->out_type;
+	list_for_each_entry(conv_expr, &expr->conv_exprs, list) {
+		conv_expr->in_type = prev_type;
+		conv_expr->cast = sample_casts[prev_type][conv_expr->conv->in_type];
+		prev_type = conv_expr->conv->out_type;
+	}
+
+	/* the cache key is derived from the expression's text, 0 is reserved
+	 * for non-cacheable expressions.
+	 */
+	expr->memo_key = 0;
+	if (sample_expr_is_cacheable(expr)) {
+		expr->memo_key = XXH64(text, strlen(text), 0);
+		if (!expr->memo_key)
+			expr->memo_key = 1;
+	}
+
+	if (expr->text)
+		return 0;
+
+	expr->text = strdup(text);
+	expr->file = file ? strdup(file) : NULL;
+	expr->line = line;
+	if (!expr->text || (file && !expr->file)) {
+		ha_free(&expr->text);
+		ha_free((char **)&expr->file);
+		return -1;
+	}
+
+	HA_SPIN_LOCK(OTHER_LOCK, &sample_exprs_lock);
+	LIST_APPEND(&sample_exprs, &expr->list);
+	HA_SPIN_UNLOCK(OTHER_LOCK, &sample_exprs_lock);
+	return 0;
+}
+
+/* Empties the per-stream sample cache <memo> and starts a new epoch. It is
+ * used on allocation and when the epoch wraps.
+ */
+void smp_memo_clear(struct smp_memo *memo)
+{
+	unsigned int i;
+
+	for (i = 0; i < smp_memo_entries; i++)
+		memo->entries[i].epoch = 0;
+	memo->epoch = 1;
+}
+
+/* Releases the per-stream sample cache <memo>, which may be NULL */
+void smp_memo_free(struct smp_memo *memo)
+{
+	pool_free(pool_head_smp_memo, memo);
+}
+
+/* Resets the profiling counters of all sample expressions */
+void sample_expr_prof_reset(void)
+{
+	struct sample_expr *expr;
+
+	HA_SPIN_LOCK(OTHER_LOCK, &sample_exprs_lock);
+	list_for_each_entry(expr, &sample_exprs, list) {
+		HA_ATOMIC_STORE(&expr->calls, 0);
+		HA_ATOMIC_STORE(&expr->cpu_time, 0);
+	}
+	HA_SPIN_UNLOCK(OTHER_LOCK, &sample_exprs_lock);
+}
+
 /*****************************************************************/
 /*    Sample format convert functions                            */
 /*    These functions set the data type on return.               */
@@ -2021,32 +2465,45 @@ static int sample_conv_length(const struct arg *arg_p, struct sample *smp, void
 }
 
 
-static int sample_conv_str2lower(const struct arg *arg_p, struct sample *smp, void *private)
+/* Changes the case of the string sample <smp>, letters between <from> and
+ * <from> + 25 being shifted by <ofs>. A read-only sample is converted while
+ * being copied to a trash chunk instead of being duplicated first.
+ */
+static inline int smp_conv_case(struct sample *smp, char from, char ofs)
 {
-	int i;
+	const char *src = smp->data.u.str.area;
+	struct buffer *dst;
+	size_t i, len;
 
-	if (!smp_make_rw(smp))
-		return 0;
+	if (smp_is_rw(smp))
+		dst = &smp->data.u.str;
+	else {
+		dst = get_trash_chunk();
+		len = smp->data.u.str.data;
+		if (len > dst->size - 1)
+			len = dst->size - 1;
+		dst->data = len;
+		dst->area[len] = 0;
+	}
 
-	for (i = 0; i < smp->data.u.str.data; i++) {
-		if ((smp->data.u.str.area[i] >= 'A') && (smp->data.u.str.area[i] <= 'Z'))
-			smp->data.u.str.area[i] += 'a' - 'A';
+	for (i = 0; i < dst->data; i++)
+		dst->area[i] = src[i] + (((unsigned char)(src[i] - from) < 26) ? ofs : 0);
+
+	if (dst != &smp->data.u.str) {
+		smp->data.u.str = *dst;
+		smp->flags &= ~SMP_F_CONST;
 	}
 	return 1;
 }
 
-static int sample_conv_str2upper(const struct arg *arg_p, struct sample *smp, void *private)
+static int sample_conv_str2lower(const struct arg *arg_p, struct sample *smp, void *private)
 {
-	int i;
-
-	if (!smp_make_rw(smp))
-		return 0;
+	return smp_conv_case(smp, 'A', 'a' - 'A');
+}
 
-	for (i = 0; i < smp->data.u.str.data; i++) {
-		if ((smp->data.u.str.area[i] >= 'a') && (smp->data.u.str.area[i] <= 'z'))
-			smp->data.u.str.area[i] += 'A' - 'a';
-	}
-	return 1;
+static int sample_conv_str2upper(const struct arg *arg_p, struct sample *smp, void *private)
+{
+	return smp_conv_case(smp, 'a', 'A' - 'a');
 }
 
 /* takes the IPv4 mask in args[0] and an optional IPv6 mask in args[1] */
@@ -4460,3 +4917,162 @@ static struct sample_conv_kw_list sample_conv_kws = {ILH, {
 }};
 
 INITCALL1(STG_REGISTER, sample_register_convs, &sample_conv_kws);
+
+/* one entry of the "show sample-profile" output */
+struct smp_prof_entry {
+	uint64_t calls;
+	uint64_t cpu_time;
+	char loc[64];
+	char text[128];
+};
+
+/* CLI context for the "show sample-profile" command */
+struct show_smp_prof_ctx {
+	struct smp_prof_entry *entries; /* snapshot sorted by decreasing CPU time */
+	int count;                      /* number of valid entries */
+	int pos;                        /* next entry to dump */
+};
+
+/* parses "show sample-profile [<max>]". A snapshot of the <max> (default 20)
+ * sample expressions having used the most CPU is taken at once so that the
+ * expressions may safely disappear while dumping.
+ */
+static int cli_parse_show_sample_profile(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct show_smp_prof_ctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+	struct smp_prof_entry *ent;
+	struct sample_expr *expr;
+	int max = 20;
+	int i;
+
+	if (!cli_has_level(appctx, ACCESS_LVL_OPER))
+		return 1;
+
+	if (*args[2]) {
+		max = atoi(args[2]);
+		if (max <= 0 || max > 1000)
+			return cli_err(appctx, "Expects a max number of expressions between 1 and 1000.\n");
+	}
+
+	ctx->entries = calloc(max, sizeof(*ctx->entries));
+	if (!ctx->entries)
+		return cli_err(appctx, "Out of memory.\n");
+
+	HA_SPIN_LOCK(OTHER_LOCK, &sample_exprs_lock);
+	list_for_each_entry(expr, &sample_exprs, list) {
+		uint64_t cpu_time = HA_ATOMIC_LOAD(&expr->cpu_time);
+		uint64_t calls = HA_ATOMIC_LOAD(&expr->calls);
+
+		if (!calls)
+			continue;
+
+		/* insertion sort, dropping the last entry when full */
+		for (i = ctx->count; i > 0 && ctx->entries[i - 1].cpu_time < cpu_time; i--) {
+			if (i < max)
+				ctx->entries[i] = ctx->entries[i - 1];
+		}
+		if (i >= max)
+			continue;
+		if (ctx->count < max)
+			ctx->count++;
+
+		ent = &ctx->entries[i];
+		ent->calls = calls;
+		ent->cpu_time = cpu_time;
+		snprintf(ent->loc, sizeof(ent->loc), "%s:%d", expr->file ? expr->file : "?", expr->line);
+		snprintf(ent->text, sizeof(ent->text), "%s", expr->text);
+	}
+	HA_SPIN_UNLOCK(OTHER_LOCK, &sample_exprs_lock);
+	return 0;
+}
+
+/* dumps the snapshot taken by cli_parse_show_sample_profile(). Returns 0 if
+ * the output buffer is full and it needs to be called again, otherwise 1.
+ */
+static int cli_io_handler_show_sample_profile(struct appctx *appctx)
+{
+	struct show_smp_prof_ctx *ctx = appctx->svcctx;
+	struct smp_prof_entry *ent;
+
+	if (!ctx->pos) {
+		chunk_printf(&trash, "Sample expressions profiling is %s (set profiling samples {on|off}).\n"
+		             "  calls      cpu_tot(us)   cpu_avg(ns)  location                      expression\n",
+		             (profiling & HA_PROF_SAMPLES) ? "on" : "off");
+		if (applet_putchk(appctx, &trash) == -1)
+			return 0;
+		ctx->pos = 1;
+	}
+
+	while (ctx->pos <= ctx->count) {
+		ent = &ctx->entries[ctx->pos - 1];
+		chunk_printf(&trash, "  %-10llu %-13llu %-12llu %-29s %s\n",
+		             (unsigned long long)ent->calls, (unsigned long long)(ent->cpu_time / 1000),
+		             (unsigned long long)(ent->cpu_time / ent->calls), ent->loc, ent->text);
+		if (applet_putchk(appctx, &trash) == -1)
+			return 0;
+		ctx->pos++;
+	}
+	return 1;
+}
+
+static void cli_release_show_sample_profile(struct appctx *appctx)
+{
+	struct show_smp_prof_ctx *ctx = appctx->svcctx;
+
+	ha_free(&ctx->entries);
+}
+
+static struct cli_kw_list cli_kws = {{ },{
+	{ { "show", "sample-profile", NULL }, "show sample-profile [<max>]              : show the sample expressions using the most CPU", cli_parse_show_sample_profile, cli_io_handler_show_sample_profile, cli_release_show_sample_profile },
+	{{},}
+}};
+
+INITCALL1(STG_REGISTER, cli_register_kw, &cli_kws);
+
+/* config parser for global "tune.sample-cache.entries" */
+static int smp_parse_memo_entries(char **args, int section_type, struct proxy *curpx,
+                                  const struct proxy *defpx, const char *file, int line,
+                                  char **err)
+{
+	char *stop;
+	long val;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	val = strtol(args[1], &stop, 10);
+	if (!*args[1] || *stop || val < 0 || val > 64) {
+		memprintf(err, "'%s' expects a number of entries between 0 and 64.", args[0]);
+		return -1;
+	}
+
+	/* entries are indexed by the expressions' hash */
+	smp_memo_entries = val ? 1U << my_flsl(val - 1) : 0;
+	smp_memo_mask = smp_memo_entries ? smp_memo_entries - 1 : 0;
+	return 0;
+}
+
+static struct cfg_kw_list smp_cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.sample-cache.entries", smp_parse_memo_entries },
+	{ /* END */ }
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &smp_cfg_kws);
+
+/* creates the pool of per-stream sample caches once their size is known */
+static int smp_memo_init(void)
+{
+	if (!smp_memo_entries)
+		return ERR_NONE;
+
+	pool_head_smp_memo = create_pool("smp_memo", sizeof(struct smp_memo) +
+	                                 smp_memo_entries * sizeof(struct smp_memo_entry),
+	                                 MEM_F_SHARED);
+	if (!pool_head_smp_memo) {
+		ha_alert("failed to allocate the sample cache pool.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+	return ERR_NONE;
+}
+
+REGISTER_POST_CHECK(smp_memo_init);
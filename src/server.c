@@ -99,7 +99,7 @@ int srv_getinter(const struct check *check)
 	const struct server *s = check->server;
 
 	if ((check->state & CHK_ST_CONFIGURED) && (check->health == check->rise + check->fall - 1))
-		return check->inter;
+		return (check->adapt_inter)?(check->adapt_inter):(check->inter);
 
 	if ((s->next_state == SRV_ST_STOPPED) && check->health == 0)
 		return (check->downinter)?(check->downinter):(check->inter);
@@ -2190,6 +2190,7 @@ void srv_settings_init(struct server *srv)
 	srv->check.inter = DEF_CHKINTR;
 	srv->check.fastinter = 0;
 	srv->check.downinter = 0;
+	srv->check.adaptive_inter = 0;
 	srv->check.rise = DEF_RISETIME;
 	srv->check.fall = DEF_FALLTIME;
 	srv->check.port = 0;
@@ -2262,6 +2263,7 @@ void srv_settings_cpy(struct server *srv, const struct server *src, int srv_tmpl
 	srv->check.inter              = src->check.inter;
 	srv->check.fastinter          = src->check.fastinter;
 	srv->check.downinter          = src->check.downinter;
+	srv->check.adaptive_inter     = src->check.adaptive_inter;
 	srv->agent.use_ssl            = src->agent.use_ssl;
 	srv->agent.port               = src->agent.port;
 
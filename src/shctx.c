@@ -91,6 +91,10 @@ struct shared_block *shctx_row_reserve_hot(struct shared_context *shctx,
 			if (first_len && shctx->free_block)
 				shctx->free_block(next, block);
 
+			/* a used row is being recycled */
+			if (first_len && block == next)
+				shctx->evictions++;
+
 			block->block_count = 1;
 			block->len = 0;
 
@@ -326,8 +330,10 @@ int shctx_init(struct shared_context **orig_shctx, int maxblocks, int blocksize,
 		goto err;
 	}
 
-	HA_SPIN_INIT(&shctx->lock);
+	HA_RWLOCK_INIT(&shctx->lock);
 	shctx->nbav = 0;
+	shctx->nbblocks = maxblocks;
+	shctx->hits = shctx->misses = shctx->evictions = 0;
 
 	LIST_INIT(&shctx->avail);
 	LIST_INIT(&shctx->hot);
@@ -353,3 +359,30 @@ int shctx_init(struct shared_context **orig_shctx, int maxblocks, int blocksize,
 	return ret;
 }
 
+/* Allocate <nbshards> independent shared memory contexts into <shards>, which
+ * share the <maxblocks> blocks evenly. Each of them has its own lock and its
+ * own lists, so that users spreading their objects over them using a hash of
+ * their key do not contend on a single lock. <nbshards> must be a power of two
+ * and the other arguments are the same as for shctx_init(). Returns the same
+ * codes as shctx_init() with the total number of blocks on success. On error,
+ * the shards which could be allocated are left in place.
+ */
+int shctx_init_shards(struct shared_context **shards, int nbshards,
+                      int maxblocks, int blocksize, unsigned int maxobjsz,
+                      int extra, int shared)
+{
+	int i, ret;
+	int total = 0;
+
+	if (maxblocks <= 0)
+		return 0;
+
+	for (i = 0; i < nbshards; i++) {
+		ret = shctx_init(&shards[i], (maxblocks + nbshards - 1) / nbshards,
+		                 blocksize, maxobjsz, extra, shared);
+		if (ret <= 0)
+			return ret;
+		total += ret;
+	}
+	return total;
+}
@@ -411,7 +411,27 @@ static void sink_forward_io_handler(struct appctx *appctx)
 			chunk_reset(&trash);
 			len = b_getblk(buf, trash.area, msg_len, ofs + cnt);
 			trash.data += len;
-			trash.area[trash.data++] = '\n';
+
+			if (likely(!memchr(trash.area, '\n', trash.data)))
+				trash.area[trash.data++] = '\n';
+			else {
+				/* messages which cannot be delimited by a LF (e.g.
+				 * binary log lines) are sent using octet counting
+				 * instead, which receivers detect for each message.
+				 */
+				const char *pfx = ultoa(msg_len);
+				size_t pfx_len = strlen(pfx);
+
+				if (trash.data + pfx_len + 1 > b_size(&trash)) {
+					/* too large a message to ever fit, let's skip it */
+					ofs += cnt + msg_len;
+					continue;
+				}
+				memmove(trash.area + pfx_len + 1, trash.area, trash.data);
+				memcpy(trash.area, pfx, pfx_len);
+				trash.area[pfx_len] = ' ';
+				trash.data += pfx_len + 1;
+			}
 
 			if (applet_putchk(appctx, &trash) == -1) {
 				ret = 0;
@@ -50,6 +50,7 @@
 #include <haproxy/channel.h>
 #include <haproxy/chunk.h>
 #include <haproxy/cli.h>
+#include <haproxy/clock.h>
 #include <haproxy/connection.h>
 #include <haproxy/dynbuf.h>
 #include <haproxy/errors.h>
@@ -59,6 +60,7 @@
 #include <haproxy/global.h>
 #include <haproxy/http_rules.h>
 #include <haproxy/log.h>
+#include <haproxy/net_helper.h>
 #include <haproxy/openssl-compat.h>
 #include <haproxy/pattern-t.h>
 #include <haproxy/proto_tcp.h>
@@ -146,6 +148,19 @@ enum {
 	SSL_ST_SESS,
 	SSL_ST_REUSED_SESS,
 	SSL_ST_FAILED_HANDSHAKE,
+	SSL_ST_ASYNC_WAIT,
+	SSL_ST_ASYNC_BATCH_1,
+	SSL_ST_ASYNC_BATCH_2_7,
+	SSL_ST_ASYNC_BATCH_8,
+	SSL_ST_HS_CPU,
+	SSL_ST_HS_CPU_LT_100US,
+	SSL_ST_HS_CPU_LT_1MS,
+	SSL_ST_HS_CPU_LT_10MS,
+	SSL_ST_HS_CPU_GE_10MS,
+	SSL_ST_HS_LAT_LT_1MS,
+	SSL_ST_HS_LAT_LT_10MS,
+	SSL_ST_HS_LAT_LT_100MS,
+	SSL_ST_HS_LAT_GE_100MS,
 
 	SSL_ST_STATS_COUNT /* must be the last member of the enum */
 };
@@ -157,12 +172,43 @@ static struct name_desc ssl_stats[] = {
 	                              .desc = "Total number of ssl sessions reused" },
 	[SSL_ST_FAILED_HANDSHAKE] = { .name = "ssl_failed_handshake",
 	                              .desc = "Total number of failed handshake" },
+	[SSL_ST_ASYNC_WAIT]       = { .name = "ssl_async_wait",
+	                              .desc = "Total number of handshakes paused waiting for an async engine" },
+	[SSL_ST_ASYNC_BATCH_1]    = { .name = "ssl_async_batch_1",
+	                              .desc = "Total number of async handshakes submitted alone on their thread" },
+	[SSL_ST_ASYNC_BATCH_2_7]  = { .name = "ssl_async_batch_2_7",
+	                              .desc = "Total number of async handshakes submitted with 1 to 6 others pending on their thread" },
+	[SSL_ST_ASYNC_BATCH_8]    = { .name = "ssl_async_batch_8",
+	                              .desc = "Total number of async handshakes submitted with 7 or more others pending on their thread" },
+	[SSL_ST_HS_CPU]           = { .name = "ssl_hs_cpu_us",
+	                              .desc = "Total CPU time spent computing successful handshakes, in microseconds" },
+	[SSL_ST_HS_CPU_LT_100US]  = { .name = "ssl_hs_cpu_lt_100us",
+	                              .desc = "Total number of successful handshakes which used less than 100 microseconds of CPU" },
+	[SSL_ST_HS_CPU_LT_1MS]    = { .name = "ssl_hs_cpu_lt_1ms",
+	                              .desc = "Total number of successful handshakes which used 100 microseconds to 1 millisecond of CPU" },
+	[SSL_ST_HS_CPU_LT_10MS]   = { .name = "ssl_hs_cpu_lt_10ms",
+	                              .desc = "Total number of successful handshakes which used 1 to 10 milliseconds of CPU" },
+	[SSL_ST_HS_CPU_GE_10MS]   = { .name = "ssl_hs_cpu_ge_10ms",
+	                              .desc = "Total number of successful handshakes which used 10 milliseconds of CPU or more" },
+	[SSL_ST_HS_LAT_LT_1MS]    = { .name = "ssl_hs_lat_lt_1ms",
+	                              .desc = "Total number of successful handshakes completed in less than 1 millisecond" },
+	[SSL_ST_HS_LAT_LT_10MS]   = { .name = "ssl_hs_lat_lt_10ms",
+	                              .desc = "Total number of successful handshakes completed in 1 to 10 milliseconds" },
+	[SSL_ST_HS_LAT_LT_100MS]  = { .name = "ssl_hs_lat_lt_100ms",
+	                              .desc = "Total number of successful handshakes completed in 10 to 100 milliseconds" },
+	[SSL_ST_HS_LAT_GE_100MS]  = { .name = "ssl_hs_lat_ge_100ms",
+	                              .desc = "Total number of successful handshakes completed in 100 milliseconds or more" },
 };
 
 static struct ssl_counters {
 	long long sess;
 	long long reused_sess;
 	long long failed_handshake;
+	long long async_wait;
+	long long async_batch[3];    /* 1, 2-7, 8+ handshakes pending on the engine */
+	long long hs_cpu_us;
+	long long hs_cpu[4];         /* <100us, <1ms, <10ms, >=10ms of CPU */
+	long long hs_lat[4];         /* <1ms, <10ms, <100ms, >=100ms to complete */
 } ssl_counters;
 
 static void ssl_fill_stats(void *data, struct field *stats)
@@ -172,6 +218,19 @@ static void ssl_fill_stats(void *data, struct field *stats)
 	stats[SSL_ST_SESS]             = mkf_u64(FN_COUNTER, counters->sess);
 	stats[SSL_ST_REUSED_SESS]      = mkf_u64(FN_COUNTER, counters->reused_sess);
 	stats[SSL_ST_FAILED_HANDSHAKE] = mkf_u64(FN_COUNTER, counters->failed_handshake);
+	stats[SSL_ST_ASYNC_WAIT]       = mkf_u64(FN_COUNTER, counters->async_wait);
+	stats[SSL_ST_ASYNC_BATCH_1]    = mkf_u64(FN_COUNTER, counters->async_batch[0]);
+	stats[SSL_ST_ASYNC_BATCH_2_7]  = mkf_u64(FN_COUNTER, counters->async_batch[1]);
+	stats[SSL_ST_ASYNC_BATCH_8]    = mkf_u64(FN_COUNTER, counters->async_batch[2]);
+	stats[SSL_ST_HS_CPU]           = mkf_u64(FN_COUNTER, counters->hs_cpu_us);
+	stats[SSL_ST_HS_CPU_LT_100US]  = mkf_u64(FN_COUNTER, counters->hs_cpu[0]);
+	stats[SSL_ST_HS_CPU_LT_1MS]    = mkf_u64(FN_COUNTER, counters->hs_cpu[1]);
+	stats[SSL_ST_HS_CPU_LT_10MS]   = mkf_u64(FN_COUNTER, counters->hs_cpu[2]);
+	stats[SSL_ST_HS_CPU_GE_10MS]   = mkf_u64(FN_COUNTER, counters->hs_cpu[3]);
+	stats[SSL_ST_HS_LAT_LT_1MS]    = mkf_u64(FN_COUNTER, counters->hs_lat[0]);
+	stats[SSL_ST_HS_LAT_LT_10MS]   = mkf_u64(FN_COUNTER, counters->hs_lat[1]);
+	stats[SSL_ST_HS_LAT_LT_100MS]  = mkf_u64(FN_COUNTER, counters->hs_lat[2]);
+	stats[SSL_ST_HS_LAT_GE_100MS]  = mkf_u64(FN_COUNTER, counters->hs_lat[3]);
 }
 
 static struct stats_module ssl_stats_module = {
@@ -537,8 +596,8 @@ const char *SSL_SOCK_KEYTYPE_NAMES[] = {
 	"rsa"
 };
 
-static struct shared_context *ssl_shctx = NULL; /* ssl shared session cache */
-static struct eb_root *sh_ssl_sess_tree; /* ssl shared session tree */
+static struct shared_context *ssl_shctx[SSL_SOCK_MAX_CACHE_SHARDS]; /* ssl shared session cache shards */
+static unsigned int ssl_shctx_shards = 0; /* number of shards, 0 if no cache */
 
 /* Dedicated callback functions for heartbeat and clienthello.
  */
@@ -745,6 +804,46 @@ int ssl_init_provider(const char *provider_name)
 #endif /* HAVE_SSL_PROVIDERS */
 
 #ifdef SSL_MODE_ASYNC
+/* number of handshakes of the current thread waiting for an async engine */
+static THREAD_LOCAL unsigned int ssl_async_pending;
+
+/* Marks the handshake on <ctx> as waiting for an async engine and accounts it
+ * in <counters> and <counters_px> (which may be NULL), along with the number
+ * of other handshakes of the same thread already pending on the engine, which
+ * is the batch size an engine processing requests in parallel may work with.
+ * Nothing is done if the handshake was already marked.
+ */
+static inline void ssl_async_wait_start(struct ssl_sock_ctx *ctx,
+                                        struct ssl_counters *counters,
+                                        struct ssl_counters *counters_px)
+{
+	int bucket;
+
+	if (ctx->xprt_st & SSL_SOCK_ST_FL_ASYNC_WAIT)
+		return;
+
+	ctx->xprt_st |= SSL_SOCK_ST_FL_ASYNC_WAIT;
+	bucket = ssl_async_pending >= 7 ? 2 : ssl_async_pending ? 1 : 0;
+	ssl_async_pending++;
+
+	if (counters) {
+		HA_ATOMIC_INC(&counters->async_wait);
+		HA_ATOMIC_INC(&counters_px->async_wait);
+		HA_ATOMIC_INC(&counters->async_batch[bucket]);
+		HA_ATOMIC_INC(&counters_px->async_batch[bucket]);
+	}
+}
+
+/* Unmarks the handshake on <ctx> as waiting for an async engine, if it was */
+static inline void ssl_async_wait_stop(struct ssl_sock_ctx *ctx)
+{
+	if (!(ctx->xprt_st & SSL_SOCK_ST_FL_ASYNC_WAIT))
+		return;
+
+	ctx->xprt_st &= ~SSL_SOCK_ST_FL_ASYNC_WAIT;
+	ssl_async_pending--;
+}
+
 /*
  * openssl async fd handler
  */
@@ -1162,6 +1261,184 @@ static int ssl_hmac_init(MAC_CTX *hctx, unsigned char *key, int key_len, const E
 
 #if (defined SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB && TLS_TICKETS_NO > 0)
 
+/* Derives into <key> the ticket key of rotating reference <ref> for rotation
+ * period <epoch>, as HMAC-SHA256 of the period number using the reference's
+ * secret. All processes sharing the same secret thus use the same keys at the
+ * same time without having to exchange them. Returns 0 on success, -1 on
+ * error.
+ */
+static int ssl_sock_derive_tlskey(struct tls_keys_ref *ref, long long epoch, union tls_sess_key *key)
+{
+	unsigned char out[3 * 32];
+	unsigned char msg[9];
+	unsigned int len;
+	int i;
+
+	write_n64(msg, epoch);
+	for (i = 0; i < 3; i++) {
+		msg[8] = i;
+		if (!HMAC(EVP_sha256(), ref->secret, ref->secret_len, msg, sizeof(msg), out + 32 * i, &len))
+			return -1;
+	}
+
+	memcpy(key, out, ref->key_size_bits == 128 ? sizeof(struct tls_sess_key_128) : sizeof(struct tls_sess_key_256));
+	return 0;
+}
+
+/* Regenerates all the keys of rotating reference <ref> if the current rotation
+ * period changed since they were last derived. The current key is used for
+ * encryption, the next one is already accepted to cope with clock drift
+ * between nodes, and the remaining ones are the previous ones so that tickets
+ * issued during the last periods may still be resumed.
+ */
+static void ssl_sock_rotate_tlskeys(struct tls_keys_ref *ref)
+{
+	long long epoch = date.tv_sec / ref->rotate;
+	long long e;
+	int i;
+
+	if (likely(HA_ATOMIC_LOAD(&ref->epoch) == epoch))
+		return;
+
+	HA_RWLOCK_WRLOCK(TLSKEYS_REF_LOCK, &ref->lock);
+	if (ref->epoch != epoch) {
+		for (i = 0; i < ref->nb_keys; i++) {
+			e = !i ? epoch : i == 1 ? epoch + 1 : epoch - (i - 1);
+			if (ssl_sock_derive_tlskey(ref, e, &ref->tlskeys[i]) < 0)
+				break;
+		}
+		ref->tls_ticket_enc_index = 0;
+		HA_ATOMIC_STORE(&ref->epoch, epoch);
+	}
+	HA_RWLOCK_WRUNLOCK(TLSKEYS_REF_LOCK, &ref->lock);
+}
+
+/* environment variable carrying the base secret across master re-executions */
+#define TLSKEYS_SECRET_ENV "HAPROXY_TLSKEYS_SECRET"
+
+/* base secret of the rotating keys of bind lines without "tls-ticket-keys" */
+static unsigned char tlskeys_base_secret[32];
+static int tlskeys_base_secret_set;
+
+/* Initializes the base secret the rotating keys of bind lines not using
+ * "tls-ticket-keys" are derived from, if not done yet. It is randomly generated
+ * on the first start. In master-worker mode, it is saved in the environment so
+ * that the master process keeps it when re-executed on reload, and the new
+ * workers keep on accepting the tickets issued by the previous ones. Returns 0
+ * on success, -1 on error.
+ */
+static int ssl_sock_init_tlskeys_base_secret(void)
+{
+	char hex[2 * sizeof(tlskeys_base_secret) + 1];
+	const char *env;
+	int i;
+
+	if (tlskeys_base_secret_set)
+		return 0;
+
+	env = getenv(TLSKEYS_SECRET_ENV);
+	if (env && getenv("HAPROXY_MWORKER_REEXEC") && strlen(env) == sizeof(hex) - 1) {
+		for (i = 0; i < sizeof(tlskeys_base_secret); i++) {
+			int h = hex2i(env[2 * i]), l = hex2i(env[2 * i + 1]);
+
+			if (h < 0 || l < 0)
+				break;
+			tlskeys_base_secret[i] = (h << 4) + l;
+		}
+		if (i == sizeof(tlskeys_base_secret))
+			goto done;
+	}
+
+	if (RAND_bytes(tlskeys_base_secret, sizeof(tlskeys_base_secret)) != 1)
+		return -1;
+
+	if (global.mode & MODE_MWORKER) {
+		for (i = 0; i < sizeof(tlskeys_base_secret); i++) {
+			hex[2 * i]     = hextab[tlskeys_base_secret[i] >> 4];
+			hex[2 * i + 1] = hextab[tlskeys_base_secret[i] & 15];
+		}
+		hex[2 * i] = 0;
+		if (setenv(TLSKEYS_SECRET_ENV, hex, 1) < 0)
+			return -1;
+	}
+ done:
+	tlskeys_base_secret_set = 1;
+	return 0;
+}
+
+/* Enables automatic rotation of the TLS ticket keys of <bind_conf>. If the bind
+ * line already uses keys loaded from a file, the current key of this file is
+ * used as the secret so that all nodes using the same file derive the same
+ * keys. Otherwise a new reference is created, whose secret is derived from the
+ * process' base secret and the bind line's frontend and address, so that it
+ * survives reloads. Returns 0 on success, otherwise emits an alert and returns
+ * -1.
+ */
+static int ssl_sock_init_tlskeys_rotation(struct bind_conf *bind_conf)
+{
+	struct tls_keys_ref *ref = bind_conf->keys_ref;
+	int nb_keys = (bind_conf->tls_ticket_history ? bind_conf->tls_ticket_history : 1) + 2;
+	union tls_sess_key *keys;
+	char *name = NULL;
+	unsigned int len;
+
+	if (ref) {
+		if (ref->rotate && (ref->rotate != bind_conf->tls_ticket_rotate || ref->nb_keys != nb_keys)) {
+			ha_alert("Proxy '%s': 'tls-ticket-rotate' or 'tls-ticket-history' for bind '%s' at [%s:%d] differs from another bind line using TLS ticket keys '%s'.\n",
+			         bind_conf->frontend->id, bind_conf->arg, bind_conf->file, bind_conf->line, ref->filename);
+			return -1;
+		}
+		if (!ref->rotate) {
+			keys = realloc(ref->tlskeys, nb_keys * sizeof(*keys));
+			if (!keys) {
+				ha_alert("Proxy '%s': unable to allocate rotating TLS ticket keys for bind '%s' at [%s:%d].\n",
+				         bind_conf->frontend->id, bind_conf->arg, bind_conf->file, bind_conf->line);
+				return -1;
+			}
+			ref->secret_len = ref->key_size_bits == 128 ? sizeof(struct tls_sess_key_128) : sizeof(struct tls_sess_key_256);
+			memcpy(ref->secret, &keys[ref->tls_ticket_enc_index], ref->secret_len);
+			ref->tlskeys = keys;
+			ref->nb_keys = nb_keys;
+			ref->rotate = bind_conf->tls_ticket_rotate;
+		}
+		goto rotate;
+	}
+
+	memprintf(&name, "%s:%d", bind_conf->file, bind_conf->line);
+	ref = calloc(1, sizeof(*ref));
+	if (ref)
+		ref->tlskeys = calloc(nb_keys, sizeof(union tls_sess_key));
+	chunk_printf(&trash, "%s/%s", bind_conf->frontend->id, bind_conf->arg);
+	if (!name || !ref || !ref->tlskeys ||
+	    ssl_sock_init_tlskeys_base_secret() < 0 ||
+	    !HMAC(EVP_sha256(), tlskeys_base_secret, sizeof(tlskeys_base_secret),
+	          (unsigned char *)trash.area, trash.data, ref->secret, &len)) {
+		ha_alert("Proxy '%s': unable to allocate rotating TLS ticket keys for bind '%s' at [%s:%d].\n",
+		         bind_conf->frontend->id, bind_conf->arg, bind_conf->file, bind_conf->line);
+		if (ref)
+			free(ref->tlskeys);
+		free(ref);
+		free(name);
+		return -1;
+	}
+
+	ref->filename = name;
+	ref->nb_keys = nb_keys;
+	ref->key_size_bits = 256;
+	ref->secret_len = len;
+	ref->rotate = bind_conf->tls_ticket_rotate;
+	ref->unique_id = -1;
+	ref->refcount = 1;
+	HA_RWLOCK_INIT(&ref->lock);
+	LIST_INSERT(&tlskeys_reference, &ref->list);
+	bind_conf->keys_ref = ref;
+
+ rotate:
+	ref->epoch = -1;
+	ssl_sock_rotate_tlskeys(ref);
+	return 0;
+}
+
 static int ssl_tlsext_ticket_key_cb(SSL *s, unsigned char key_name[16], unsigned char *iv, EVP_CIPHER_CTX *ectx, MAC_CTX *hctx, int enc)
 {
 	struct tls_keys_ref *ref = NULL;
@@ -1186,6 +1463,9 @@ static int ssl_tlsext_ticket_key_cb(SSL *s, unsigned char key_name[16], unsigned
 		ABORT_NOW();
 	}
 
+	if (ref->rotate)
+		ssl_sock_rotate_tlskeys(ref);
+
 	HA_RWLOCK_RDLOCK(TLSKEYS_REF_LOCK, &ref->lock);
 
 	keys = ref->tlskeys;
@@ -1216,8 +1496,8 @@ static int ssl_tlsext_ticket_key_cb(SSL *s, unsigned char key_name[16], unsigned
 			ret = 1;
 		}
 	} else {
-		for (i = 0; i < TLS_TICKETS_NO; i++) {
-			if (!memcmp(key_name, keys[(head + i) % TLS_TICKETS_NO].name, 16))
+		for (i = 0; i < ref->nb_keys; i++) {
+			if (!memcmp(key_name, keys[(head + i) % ref->nb_keys].name, 16))
 				goto found;
 		}
 		ret = 0;
@@ -1225,17 +1505,17 @@ static int ssl_tlsext_ticket_key_cb(SSL *s, unsigned char key_name[16], unsigned
 
 	  found:
 		if (ref->key_size_bits == 128) {
-			if (ssl_hmac_init(hctx, keys[(head + i) % TLS_TICKETS_NO].key_128.hmac_key, 16, TLS_TICKET_HASH_FUNCT()) < 0)
+			if (ssl_hmac_init(hctx, keys[(head + i) % ref->nb_keys].key_128.hmac_key, 16, TLS_TICKET_HASH_FUNCT()) < 0)
 				goto end;
-			if(!EVP_DecryptInit_ex(ectx, EVP_aes_128_cbc(), NULL, keys[(head + i) % TLS_TICKETS_NO].key_128.aes_key, iv))
+			if(!EVP_DecryptInit_ex(ectx, EVP_aes_128_cbc(), NULL, keys[(head + i) % ref->nb_keys].key_128.aes_key, iv))
 				goto end;
 			/* 2 for key renewal, 1 if current key is still valid */
 			ret = i ? 2 : 1;
 		}
 		else if (ref->key_size_bits == 256) {
-			if (ssl_hmac_init(hctx, keys[(head + i) % TLS_TICKETS_NO].key_256.hmac_key, 32, TLS_TICKET_HASH_FUNCT()) < 0)
+			if (ssl_hmac_init(hctx, keys[(head + i) % ref->nb_keys].key_256.hmac_key, 32, TLS_TICKET_HASH_FUNCT()) < 0)
 				goto end;
-			if(!EVP_DecryptInit_ex(ectx, EVP_aes_256_cbc(), NULL, keys[(head + i) % TLS_TICKETS_NO].key_256.aes_key, iv))
+			if(!EVP_DecryptInit_ex(ectx, EVP_aes_256_cbc(), NULL, keys[(head + i) % ref->nb_keys].key_256.aes_key, iv))
 				goto end;
 			/* 2 for key renewal, 1 if current key is still valid */
 			ret = i ? 2 : 1;
@@ -1269,7 +1549,9 @@ struct tls_keys_ref *tlskeys_ref_lookupid(int unique_id)
 
 /* Update the key into ref: if keysize doesn't
  * match existing ones, this function returns -1
- * else it returns 0 on success.
+ * else it returns 0 on success. For references
+ * with automatic rotation, the key replaces the
+ * secret all keys are derived from.
  */
 int ssl_sock_update_tlskey_ref(struct tls_keys_ref *ref,
 				struct buffer *tlskey)
@@ -1285,10 +1567,20 @@ int ssl_sock_update_tlskey_ref(struct tls_keys_ref *ref,
 	else
 		return -1;
 
+	if (ref->rotate) {
+		HA_RWLOCK_WRLOCK(TLSKEYS_REF_LOCK, &ref->lock);
+		memcpy(ref->secret, tlskey->area, tlskey->data);
+		ref->secret_len = tlskey->data;
+		HA_ATOMIC_STORE(&ref->epoch, -1);
+		HA_RWLOCK_WRUNLOCK(TLSKEYS_REF_LOCK, &ref->lock);
+		ssl_sock_rotate_tlskeys(ref);
+		return 0;
+	}
+
 	HA_RWLOCK_WRLOCK(TLSKEYS_REF_LOCK, &ref->lock);
-	memcpy((char *) (ref->tlskeys + ((ref->tls_ticket_enc_index + 2) % TLS_TICKETS_NO)),
+	memcpy((char *) (ref->tlskeys + ((ref->tls_ticket_enc_index + 2) % ref->nb_keys)),
 	       tlskey->area, tlskey->data);
-	ref->tls_ticket_enc_index = (ref->tls_ticket_enc_index + 1) % TLS_TICKETS_NO;
+	ref->tls_ticket_enc_index = (ref->tls_ticket_enc_index + 1) % ref->nb_keys;
 	HA_RWLOCK_WRUNLOCK(TLSKEYS_REF_LOCK, &ref->lock);
 
 	return 0;
@@ -4497,6 +4789,18 @@ static inline void sh_ssl_sess_free_blocks(struct shared_block *first, struct sh
 	}
 }
 
+/* return the shard of the session cache in charge of zero-padded session id <s_id> */
+static inline struct shared_context *sh_ssl_sess_shard(const unsigned char *s_id)
+{
+	return shctx_shard(ssl_shctx, ssl_shctx_shards, XXH32(s_id, SSL_MAX_SSL_SESSION_ID_LENGTH, 0));
+}
+
+/* return the session tree root stored in the extra space of shard <shctx> */
+static inline struct eb_root *sh_ssl_sess_root(struct shared_context *shctx)
+{
+	return (struct eb_root *)((void *)shctx + sizeof(struct shared_context));
+}
+
 /* return first block from sh_ssl_sess  */
 static inline struct shared_block *sh_ssl_sess_first_block(struct sh_ssl_sess_hdr *sh_ssl_sess)
 {
@@ -4505,17 +4809,18 @@ static inline struct shared_block *sh_ssl_sess_first_block(struct sh_ssl_sess_hd
 }
 
 /* store a session into the cache
+ * shctx: cache shard in charge of this session, must be locked
  * s_id : session id padded with zero to SSL_MAX_SSL_SESSION_ID_LENGTH
  * data: asn1 encoded session
  * data_len: asn1 encoded session length
  * Returns 1 id session was stored (else 0)
  */
-static int sh_ssl_sess_store(unsigned char *s_id, unsigned char *data, int data_len)
+static int sh_ssl_sess_store(struct shared_context *shctx, unsigned char *s_id, unsigned char *data, int data_len)
 {
 	struct shared_block *first;
 	struct sh_ssl_sess_hdr *sh_ssl_sess, *oldsh_ssl_sess;
 
-	first = shctx_row_reserve_hot(ssl_shctx, NULL, data_len + sizeof(struct sh_ssl_sess_hdr));
+	first = shctx_row_reserve_hot(shctx, NULL, data_len + sizeof(struct sh_ssl_sess_hdr));
 	if (!first) {
 		/* Could not retrieve enough free blocks to store that session */
 		return 0;
@@ -4528,26 +4833,26 @@ static int sh_ssl_sess_store(unsigned char *s_id, unsigned char *data, int data_
 
 	/* it returns the already existing node
            or current node if none, never returns null */
-	oldsh_ssl_sess = sh_ssl_sess_tree_insert(sh_ssl_sess);
+	oldsh_ssl_sess = sh_ssl_sess_tree_insert(sh_ssl_sess_root(shctx), sh_ssl_sess);
 	if (oldsh_ssl_sess != sh_ssl_sess) {
 		 /* NOTE: Row couldn't be in use because we lock read & write function */
 		/* release the reserved row */
 		first->len = 0; /* the len must be liberated in order not to call the release callback on it */
-		shctx_row_dec_hot(ssl_shctx, first);
+		shctx_row_dec_hot(shctx, first);
 		/* replace the previous session already in the tree */
 		sh_ssl_sess = oldsh_ssl_sess;
 		/* ignore the previous session data, only use the header */
 		first = sh_ssl_sess_first_block(sh_ssl_sess);
-		shctx_row_inc_hot(ssl_shctx, first);
+		shctx_row_inc_hot(shctx, first);
 		first->len = sizeof(struct sh_ssl_sess_hdr);
 	}
 
-	if (shctx_row_data_append(ssl_shctx, first, NULL, data, data_len) < 0) {
-		shctx_row_dec_hot(ssl_shctx, first);
+	if (shctx_row_data_append(shctx, first, NULL, data, data_len) < 0) {
+		shctx_row_dec_hot(shctx, first);
 		return 0;
 	}
 
-	shctx_row_dec_hot(ssl_shctx, first);
+	shctx_row_dec_hot(shctx, first);
 
 	return 1;
 }
@@ -4617,6 +4922,7 @@ int sh_ssl_sess_new_cb(SSL *ssl, SSL_SESSION *sess)
 	int data_len;
 	unsigned int sid_length;
 	const unsigned char *sid_data;
+	struct shared_context *shctx;
 
 	/* Session id is already stored in to key and session id is known
 	 * so we don't store it to keep size.
@@ -4652,10 +4958,11 @@ int sh_ssl_sess_new_cb(SSL *ssl, SSL_SESSION *sess)
 	i2d_SSL_SESSION(sess, &p);
 
 
-	shctx_lock(ssl_shctx);
+	shctx = sh_ssl_sess_shard(encid);
+	shctx_lock(shctx);
 	/* store to cache */
-	sh_ssl_sess_store(encid, encsess, data_len);
-	shctx_unlock(ssl_shctx);
+	sh_ssl_sess_store(shctx, encid, encsess, data_len);
+	shctx_unlock(shctx);
 err:
 	/* reset original length values */
 	SSL_SESSION_set1_id(sess, encid, sid_length);
@@ -4672,6 +4979,7 @@ SSL_SESSION *sh_ssl_sess_get_cb(SSL *ssl, __OPENSSL_110_CONST__ unsigned char *k
 	unsigned char tmpkey[SSL_MAX_SSL_SESSION_ID_LENGTH];
 	SSL_SESSION *sess;
 	struct shared_block *first;
+	struct shared_context *shctx;
 
 	_HA_ATOMIC_INC(&global.shctx_lookups);
 
@@ -4685,14 +4993,16 @@ SSL_SESSION *sh_ssl_sess_get_cb(SSL *ssl, __OPENSSL_110_CONST__ unsigned char *k
 		key = tmpkey;
 	}
 
-	/* lock cache */
-	shctx_lock(ssl_shctx);
+	/* lock the cache shard, lookups only need to exclude writers */
+	shctx = sh_ssl_sess_shard(key);
+	shctx_rdlock(shctx);
 
 	/* lookup for session */
-	sh_ssl_sess = sh_ssl_sess_tree_lookup(key);
+	sh_ssl_sess = sh_ssl_sess_tree_lookup(sh_ssl_sess_root(shctx), key);
 	if (!sh_ssl_sess) {
 		/* no session found: unlock cache and exit */
-		shctx_unlock(ssl_shctx);
+		shctx_rdunlock(shctx);
+		_HA_ATOMIC_INC(&shctx->misses);
 		_HA_ATOMIC_INC(&global.shctx_misses);
 		return NULL;
 	}
@@ -4700,9 +5010,10 @@ SSL_SESSION *sh_ssl_sess_get_cb(SSL *ssl, __OPENSSL_110_CONST__ unsigned char *k
 	/* sh_ssl_sess (shared_block->data) is at the end of shared_block */
 	first = sh_ssl_sess_first_block(sh_ssl_sess);
 
-	shctx_row_data_get(ssl_shctx, first, data, sizeof(struct sh_ssl_sess_hdr), first->len-sizeof(struct sh_ssl_sess_hdr));
+	shctx_row_data_get(shctx, first, data, sizeof(struct sh_ssl_sess_hdr), first->len-sizeof(struct sh_ssl_sess_hdr));
 
-	shctx_unlock(ssl_shctx);
+	shctx_rdunlock(shctx);
+	_HA_ATOMIC_INC(&shctx->hits);
 
 	/* decode ASN1 session */
 	p = data;
@@ -4724,6 +5035,7 @@ void sh_ssl_sess_remove_cb(SSL_CTX *ctx, SSL_SESSION *sess)
 	unsigned char tmpkey[SSL_MAX_SSL_SESSION_ID_LENGTH];
 	unsigned int sid_length;
 	const unsigned char *sid_data;
+	struct shared_context *shctx;
 	(void)ctx;
 
 	sid_data = SSL_SESSION_get_id(sess, &sid_length);
@@ -4734,17 +5046,18 @@ void sh_ssl_sess_remove_cb(SSL_CTX *ctx, SSL_SESSION *sess)
 		sid_data = tmpkey;
 	}
 
-	shctx_lock(ssl_shctx);
+	shctx = sh_ssl_sess_shard(sid_data);
+	shctx_lock(shctx);
 
 	/* lookup for session */
-	sh_ssl_sess = sh_ssl_sess_tree_lookup(sid_data);
+	sh_ssl_sess = sh_ssl_sess_tree_lookup(sh_ssl_sess_root(shctx), sid_data);
 	if (sh_ssl_sess) {
 		/* free session */
 		sh_ssl_sess_tree_delete(sh_ssl_sess);
 	}
 
 	/* unlock cache */
-	shctx_unlock(ssl_shctx);
+	shctx_unlock(shctx);
 }
 
 /* Set session cache mode to server and disable openssl internal cache.
@@ -4754,7 +5067,7 @@ void ssl_set_shctx(SSL_CTX *ctx)
 {
 	SSL_CTX_set_session_id_context(ctx, (const unsigned char *)SHCTX_APPNAME, strlen(SHCTX_APPNAME));
 
-	if (!ssl_shctx) {
+	if (!ssl_shctx_shards) {
 		SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
 		return;
 	}
@@ -5586,10 +5899,23 @@ int ssl_sock_prepare_bind_conf(struct bind_conf *bind_conf)
 			return -1;
 		}
 	}
-	if (!ssl_shctx && global.tune.sslcachesize) {
-		alloc_ctx = shctx_init(&ssl_shctx, global.tune.sslcachesize,
-		                       sizeof(struct sh_ssl_sess_hdr) + SHSESS_BLOCK_MIN_SIZE, -1,
-		                       sizeof(*sh_ssl_sess_tree), (global.nbthread > 1));
+	if (!ssl_shctx_shards && global.tune.sslcachesize) {
+		unsigned int shards = global_ssl.cache_shards;
+		int i;
+
+		if (!shards) {
+			/* one shard per thread, as long as each of them keeps
+			 * enough room for a few hundred sessions.
+			 */
+			for (shards = 1; shards < global.nbthread && shards < SSL_SOCK_MAX_CACHE_SHARDS; shards <<= 1)
+				;
+			while (shards > 1 && global.tune.sslcachesize / shards < 256)
+				shards >>= 1;
+		}
+
+		alloc_ctx = shctx_init_shards(ssl_shctx, shards, global.tune.sslcachesize,
+		                              sizeof(struct sh_ssl_sess_hdr) + SHSESS_BLOCK_MIN_SIZE, -1,
+		                              sizeof(struct eb_root), (global.nbthread > 1));
 		if (alloc_ctx <= 0) {
 			if (alloc_ctx == SHCTX_E_INIT_LOCK)
 				ha_alert("Unable to initialize the lock for the shared SSL session cache. You can retry using the global statement 'tune.ssl.force-private-cache' but it could increase CPU usage due to renegotiations if nbproc > 1.\n");
@@ -5597,12 +5923,21 @@ int ssl_sock_prepare_bind_conf(struct bind_conf *bind_conf)
 				ha_alert("Unable to allocate SSL session cache.\n");
 			return -1;
 		}
-		/* free block callback */
-		ssl_shctx->free_block = sh_ssl_sess_free_blocks;
-		/* init the root tree within the extra space */
-		sh_ssl_sess_tree = (void *)ssl_shctx + sizeof(struct shared_context);
-		*sh_ssl_sess_tree = EB_ROOT_UNIQUE;
+		for (i = 0; i < shards; i++) {
+			/* free block callback */
+			ssl_shctx[i]->free_block = sh_ssl_sess_free_blocks;
+			/* init the root tree within the extra space */
+			*sh_ssl_sess_root(ssl_shctx[i]) = EB_ROOT_UNIQUE;
+		}
+		ssl_shctx_shards = shards;
 	}
+#if (defined SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB && TLS_TICKETS_NO > 0)
+	if (bind_conf->tls_ticket_rotate && ssl_sock_init_tlskeys_rotation(bind_conf) < 0)
+		return -1;
+	if (bind_conf->tls_ticket_history && !bind_conf->tls_ticket_rotate)
+		ha_warning("Proxy '%s': 'tls-ticket-history' is ignored without 'tls-ticket-rotate' for bind '%s' at [%s:%d].\n",
+		           bind_conf->frontend->id, bind_conf->arg, bind_conf->file, bind_conf->line);
+#endif
 	err = 0;
 	/* initialize all certificate contexts */
 	err += ssl_sock_prepare_all_ctx(bind_conf);
@@ -5928,6 +6263,8 @@ static int ssl_sock_init(struct connection *conn, void **xprt_ctx)
 	ctx->conn = conn;
 	ctx->subs = NULL;
 	ctx->xprt_st = 0;
+	ctx->hs_start = now_mono_time();
+	ctx->hs_cpu = 0;
 	ctx->xprt_ctx = NULL;
 	ctx->error_code = 0;
 
@@ -6034,6 +6371,7 @@ static int ssl_sock_handshake(struct connection *conn, unsigned int flag)
 	struct server *srv;
 	socklen_t lskerr;
 	int skerr;
+	uint64_t hs_start;
 
 
 	if (!conn_ctrl_ready(conn))
@@ -6062,6 +6400,13 @@ static int ssl_sock_handshake(struct connection *conn, unsigned int flag)
 	if (!ctx)
 		goto out_error;
 
+#ifdef SSL_MODE_ASYNC
+	/* we're called again after the engine completed or the connection
+	 * died, either way we're not waiting anymore.
+	 */
+	ssl_async_wait_stop(ctx);
+#endif
+
 	/* don't start calculating a handshake on a dead connection */
 	if (conn->flags & (CO_FL_ERROR | CO_FL_SOCK_RD_SH | CO_FL_SOCK_WR_SH))
 		goto out_error;
@@ -6089,9 +6434,11 @@ static int ssl_sock_handshake(struct connection *conn, unsigned int flag)
 		size_t read_data = 0;
 
 		while (1) {
+			hs_start = now_cpu_time();
 			ret = SSL_read_early_data(ctx->ssl,
 			    b_tail(&ctx->early_buf), b_room(&ctx->early_buf),
 			    &read_data);
+			ctx->hs_cpu += now_cpu_time() - hs_start;
 			if (ret == SSL_READ_EARLY_DATA_ERROR)
 				goto check_error;
 			if (read_data > 0) {
@@ -6142,6 +6489,7 @@ static int ssl_sock_handshake(struct connection *conn, unsigned int flag)
 			}
 #ifdef SSL_MODE_ASYNC
 			else if (ret == SSL_ERROR_WANT_ASYNC) {
+				ssl_async_wait_start(ctx, counters, counters_px);
 				ssl_async_process_fds(ctx);
 				return 0;
 			}
@@ -6205,7 +6553,9 @@ static int ssl_sock_handshake(struct connection *conn, unsigned int flag)
 		/* read some data: consider handshake completed */
 		goto reneg_ok;
 	}
+	hs_start = now_cpu_time();
 	ret = SSL_do_handshake(ctx->ssl);
+	ctx->hs_cpu += now_cpu_time() - hs_start;
 check_error:
 	if (ret != 1) {
 		/* handshake did not complete, let's find why */
@@ -6229,6 +6579,7 @@ static int ssl_sock_handshake(struct connection *conn, unsigned int flag)
 		}
 #ifdef SSL_MODE_ASYNC
 		else if (ret == SSL_ERROR_WANT_ASYNC) {
+			ssl_async_wait_start(ctx, counters, counters_px);
 			ssl_async_process_fds(ctx);
 			return 0;
 		}
@@ -6339,6 +6690,21 @@ static int ssl_sock_handshake(struct connection *conn, unsigned int flag)
 		HA_ATOMIC_INC(&counters_px->reused_sess);
 	}
 
+	if (counters) {
+		uint64_t us = ctx->hs_cpu / 1000;
+		uint64_t lat = (now_mono_time() - ctx->hs_start) / 1000000;
+		int bucket;
+
+		HA_ATOMIC_ADD(&counters->hs_cpu_us, us);
+		HA_ATOMIC_ADD(&counters_px->hs_cpu_us, us);
+		bucket = us < 100 ? 0 : us < 1000 ? 1 : us < 10000 ? 2 : 3;
+		HA_ATOMIC_INC(&counters->hs_cpu[bucket]);
+		HA_ATOMIC_INC(&counters_px->hs_cpu[bucket]);
+		bucket = lat < 1 ? 0 : lat < 10 ? 1 : lat < 100 ? 2 : 3;
+		HA_ATOMIC_INC(&counters->hs_lat[bucket]);
+		HA_ATOMIC_INC(&counters_px->hs_lat[bucket]);
+	}
+
 	/* The connection is now established at both layers, it's time to leave */
 	conn->flags &= ~(flag | CO_FL_WAIT_L4_CONN | CO_FL_WAIT_L6_CONN);
 	return 1;
@@ -6900,6 +7266,7 @@ void ssl_sock_close(struct connection *conn, void *xprt_ctx) {
 		if (ctx->xprt->close)
 			ctx->xprt->close(conn, ctx->xprt_ctx);
 #ifdef SSL_MODE_ASYNC
+		ssl_async_wait_stop(ctx);
 		if (global_ssl.async) {
 			OSSL_ASYNC_FD all_fd[32], afd;
 			size_t num_all_fds = 0;
@@ -7456,20 +7823,20 @@ static int cli_io_handler_tlskeys_files(struct appctx *appctx)
 
 				HA_RWLOCK_RDLOCK(TLSKEYS_REF_LOCK, &ref->lock);
 				head = ref->tls_ticket_enc_index;
-				while (ctx->next_index < TLS_TICKETS_NO) {
+				while (ctx->next_index < ref->nb_keys) {
 					struct buffer *t2 = get_trash_chunk();
 
 					chunk_reset(t2);
 					/* should never fail here because we dump only a key in the t2 buffer */
 					if (ref->key_size_bits == 128) {
-						t2->data = a2base64((char *)(ref->tlskeys + (head + 2 + ctx->next_index) % TLS_TICKETS_NO),
+						t2->data = a2base64((char *)(ref->tlskeys + (head + 2 + ctx->next_index) % ref->nb_keys),
 						                   sizeof(struct tls_sess_key_128),
 						                   t2->area, t2->size);
 						chunk_appendf(&trash, "%d.%d %s\n", ref->unique_id, ctx->next_index,
 							      t2->area);
 					}
 					else if (ref->key_size_bits == 256) {
-						t2->data = a2base64((char *)(ref->tlskeys + (head + 2 + ctx->next_index) % TLS_TICKETS_NO),
+						t2->data = a2base64((char *)(ref->tlskeys + (head + 2 + ctx->next_index) % ref->nb_keys),
 						                   sizeof(struct tls_sess_key_256),
 						                   t2->area, t2->size);
 						chunk_appendf(&trash, "%d.%d %s\n", ref->unique_id, ctx->next_index,
@@ -7844,6 +8211,27 @@ static int cli_io_handler_show_providers(struct appctx *appctx)
 }
 #endif
 
+/* dumps the state of each shard of the shared session cache, one per line */
+static int cli_io_handler_show_sess_cache(struct appctx *appctx)
+{
+	struct buffer *trash = get_trash_chunk();
+	struct shared_context *shctx;
+	int i;
+
+	chunk_appendf(trash, "# shard blocks hits misses evictions\n");
+	for (i = 0; i < ssl_shctx_shards; i++) {
+		shctx = ssl_shctx[i];
+		chunk_appendf(trash, "%d %u %llu %llu %llu\n", i, shctx->nbblocks,
+		              HA_ATOMIC_LOAD(&shctx->hits),
+		              HA_ATOMIC_LOAD(&shctx->misses),
+		              HA_ATOMIC_LOAD(&shctx->evictions));
+	}
+
+	if (applet_putchk(appctx, trash) == -1)
+		return 0;
+	return 1;
+}
+
 
 #if ((defined SSL_CTRL_SET_TLSEXT_STATUS_REQ_CB && !defined OPENSSL_NO_OCSP) && !defined OPENSSL_IS_BORINGSSL)
 /*
@@ -7984,6 +8372,7 @@ static struct cli_kw_list cli_kws = {{ },{
 #ifdef HAVE_SSL_PROVIDERS
 	{ { "show", "ssl", "providers", NULL },    "show ssl providers                      : show loaded SSL providers", NULL, cli_io_handler_show_providers },
 #endif
+	{ { "show", "ssl", "sess-cache", NULL },   "show ssl sess-cache                     : show the shards of the shared SSL session cache", NULL, cli_io_handler_show_sess_cache },
 	{ { NULL }, NULL, NULL, NULL }
 }};
 
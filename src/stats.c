@@ -23,6 +23,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <import/eb64tree.h>
+
 #include <haproxy/api.h>
 #include <haproxy/activity.h>
 #include <haproxy/applet.h>
@@ -65,6 +67,7 @@
 #include <haproxy/tools.h>
 #include <haproxy/uri_auth-t.h>
 #include <haproxy/version.h>
+#include <haproxy/xxhash.h>
 
 
 /* status codes available for the stats admin page (strictly 4 chars length) */
@@ -824,6 +827,193 @@ static int stats_dump_fields_json(struct buffer *out,
 	return 1;
 }
 
+/* Appends varint <v> to <out>. Returns non-zero on success, 0 if the buffer is
+ * full.
+ */
+static int stats_bin_put_varint(struct buffer *out, uint64_t v)
+{
+	char *p = b_tail(out);
+
+	if (encode_varint(v, &p, out->area + out->size) < 0)
+		return 0;
+	out->data = p - out->area;
+	return 1;
+}
+
+/* Appends byte <c> to <out>. Returns non-zero on success, 0 if the buffer is
+ * full.
+ */
+static int stats_bin_put_byte(struct buffer *out, unsigned char c)
+{
+	if (out->data >= out->size)
+		return 0;
+	out->area[out->data++] = c;
+	return 1;
+}
+
+/* Returns the raw value of field <f> as compared between two binary records,
+ * that is the value itself for numbers and a hash for strings.
+ */
+static uint64_t stats_bin_field_val(const struct field *f)
+{
+	uint64_t v = 0;
+
+	switch (field_format(f, 0)) {
+	case FF_S32: v = (uint32_t)f->u.s32; break;
+	case FF_U32: v = f->u.u32; break;
+	case FF_S64: v = f->u.s64; break;
+	case FF_U64: v = f->u.u64; break;
+	case FF_FLT: memcpy(&v, &f->u.flt, sizeof(v)); break;
+	case FF_STR: v = f->u.str ? XXH3(f->u.str, strlen(f->u.str), 0) : 0; break;
+	default: break;
+	}
+	return v;
+}
+
+/* Emits the value of field <f> into <out> in the binary stats format. Returns
+ * non-zero on success, 0 if the buffer is full.
+ */
+static int stats_bin_put_value(struct buffer *out, const struct field *f)
+{
+	const char *str;
+	uint64_t v;
+	int i;
+
+	switch (field_format(f, 0)) {
+	case FF_S32:
+		return stats_bin_put_varint(out, ((uint32_t)f->u.s32 << 1) ^ (uint32_t)(f->u.s32 >> 31));
+	case FF_U32:
+		return stats_bin_put_varint(out, f->u.u32);
+	case FF_S64:
+		return stats_bin_put_varint(out, ((uint64_t)f->u.s64 << 1) ^ (uint64_t)(f->u.s64 >> 63));
+	case FF_U64:
+		return stats_bin_put_varint(out, f->u.u64);
+	case FF_FLT:
+		memcpy(&v, &f->u.flt, sizeof(v));
+		for (i = 0; i < 8; i++, v >>= 8) {
+			if (!stats_bin_put_byte(out, v))
+				return 0;
+		}
+		return 1;
+	case FF_STR:
+		str = f->u.str ? f->u.str : "";
+		return stats_bin_put_varint(out, strlen(str)) &&
+		       chunk_memcat(out, str, strlen(str));
+	default:
+		return 1;
+	}
+}
+
+/* Dumps the binary stats header to the local trash buffer. <gen> is the
+ * snapshot generation reported with STAT_CHANGES. The caller is responsible
+ * for clearing it if needed.
+ */
+static void stats_dump_bin_header(struct show_stat_ctx *ctx, unsigned int gen)
+{
+	enum stats_domain domain = ctx->domain;
+	int field;
+
+	chunk_memcat(&trash_chunk, STATS_BIN_MAGIC, strlen(STATS_BIN_MAGIC));
+	stats_bin_put_byte(&trash_chunk, STATS_BIN_VERSION);
+	stats_bin_put_byte(&trash_chunk,
+	                   ((ctx->flags & STAT_BIN_DELTA) ? STATS_BIN_F_DELTA : 0) |
+	                   ((ctx->flags & STAT_CHANGES) ? STATS_BIN_F_GEN : 0));
+	stats_bin_put_varint(&trash_chunk, domain);
+	stats_bin_put_varint(&trash_chunk, stat_f[domain] ? stat_count[domain] : 0);
+	if (ctx->flags & STAT_CHANGES)
+		stats_bin_put_varint(&trash_chunk, gen);
+	for (field = 0; stat_f[domain] && field < stat_count[domain]; field++) {
+		stats_bin_put_varint(&trash_chunk, strlen(stat_f[domain][field].name));
+		chunk_strcat(&trash_chunk, stat_f[domain][field].name);
+	}
+}
+
+/* Dumps the binary stats trailer to the local trash buffer. The caller is
+ * responsible for clearing it if needed.
+ */
+static void stats_dump_bin_end()
+{
+	stats_bin_put_byte(&trash_chunk, STATS_BIN_REC_END);
+}
+
+/* Dump all fields from <stats> into <out> as a binary record, see the format
+ * description in stats-t.h. Returns non-zero on success, 0 if the buffer is
+ * full, in which case nothing is emitted.
+ */
+static int stats_dump_fields_bin(struct buffer *out,
+                                 const struct field *stats, size_t stats_count,
+                                 struct show_stat_ctx *ctx)
+{
+	struct stats_bin_ctx *bin = ctx->bin;
+	struct stats_bin_field *prev, *cur;
+	size_t orig = out->data;
+	int delta = ctx->flags & STAT_BIN_DELTA;
+	int field, last = -1;
+	uint64_t val;
+
+	if (bin->key1 != ctx->obj1 || bin->key2 != ctx->obj2 || bin->key3 != ctx->px_st) {
+		/* new object: the last record built was sent */
+		if (bin->pending) {
+			prev = bin->prev;
+			bin->prev = bin->cur;
+			bin->cur = prev;
+		}
+		bin->key1 = ctx->obj1;
+		bin->key2 = ctx->obj2;
+		bin->key3 = ctx->px_st;
+	}
+	bin->pending = 0;
+	prev = bin->prev;
+	cur = bin->cur;
+
+	if (!stats_bin_put_byte(out, STATS_BIN_REC_LINE))
+		goto full;
+
+	for (field = 0; field < stats_count; field++) {
+		const struct field *f = &stats[field];
+
+		val = stats_bin_field_val(f);
+		if (delta ? (f->type == prev[field].type && val == prev[field].val) : !f->type) {
+			/* not emitted, the decoder's view is unchanged */
+			cur[field] = prev[field];
+			continue;
+		}
+
+		cur[field].type = f->type;
+		cur[field].val = val;
+
+		if (!stats_bin_put_varint(out, (field - last) << 1 | (f->type != prev[field].type)))
+			goto full;
+		last = field;
+
+		if (f->type == prev[field].type) {
+			/* same type as last sent */
+		}
+		else if ((f->type & ~FF_MASK) == (prev[field].type & ~FF_MASK)) {
+			if (!stats_bin_put_byte(out, field_format(f, 0)))
+				goto full;
+		}
+		else if (!stats_bin_put_byte(out, field_format(f, 0) | STATS_BIN_TAGS) ||
+		         !stats_bin_put_byte(out, (f->type & FO_MASK) >> 8) ||
+		         !stats_bin_put_byte(out, (f->type & FN_MASK) >> 16) ||
+		         !stats_bin_put_byte(out, (f->type & FS_MASK) >> 24))
+			goto full;
+
+		if (!stats_bin_put_value(out, f))
+			goto full;
+	}
+
+	if (!stats_bin_put_varint(out, 0))
+		goto full;
+
+	bin->pending = 1;
+	return 1;
+
+ full:
+	out->data = orig;
+	return 0;
+}
+
 /* Dump all fields from <stats> into <out> using the HTML format. A column is
  * reserved for the checkbox is STAT_ADMIN is set in <flags>. Some extra info
  * are provided if STAT_SHLGNDS is present in <flags>. The statistics from
@@ -1647,12 +1837,170 @@ int stats_dump_one_line(const struct field *stats, size_t stats_count,
 		ret = stats_dump_fields_typed(&trash_chunk, stats, stats_count, ctx);
 	else if (ctx->flags & STAT_FMT_JSON)
 		ret = stats_dump_fields_json(&trash_chunk, stats, stats_count, ctx);
+	else if (ctx->flags & STAT_FMT_BIN)
+		ret = stats_dump_fields_bin(&trash_chunk, stats, stats_count, ctx);
 	else
 		ret = stats_dump_fields_csv(&trash_chunk, stats, stats_count, ctx);
 
 	return ret;
 }
 
+/* A statistics snapshot holds one pre-filled line per frontend, listener,
+ * server and backend. It is periodically rebuilt by a low priority task when
+ * "tune.stats.snapshot-interval" is set, so that dumps only have to copy lines
+ * instead of computing them. A new snapshot is always built aside and replaces
+ * the current one under the write lock, then the old one is released. Readers
+ * only hold the read lock while copying a line.
+ *
+ * Each snapshot has a generation number, incremented for each new snapshot.
+ * When a line is built, its fields are compared to the ones of the previous
+ * snapshot, and each field carries the generation of its last change. This
+ * allows "show stat changes since <gen>" to only report what changed.
+ */
+struct stats_snap_line {
+	struct eb64_node node;            /* key: object's address | STATS_TYPE_* */
+	unsigned int id;                  /* object's numeric ID, to detect address reuse */
+	unsigned int count;               /* number of fields */
+	unsigned int gen;                 /* generation of the last change of any field */
+	size_t str_len;                   /* length of the strings following the fields */
+	struct field fields[VAR_ARRAY];   /* <count> fields, then <count> generations
+	                                   * of the last change of each field, then
+	                                   * the strings
+	                                   */
+};
+
+struct stats_snap {
+	struct eb_root lines;             /* stats_snap_line indexed by object */
+	unsigned int date;                /* date the snapshot was completed (ms ticks) */
+	unsigned int gen;                 /* generation number, starts at 1 */
+};
+
+/* returns the array of the generations of the last change of each field of
+ * snapshot line <line>.
+ */
+static inline unsigned int *stats_snap_line_gens(const struct stats_snap_line *line)
+{
+	return (unsigned int *)(line->fields + line->count);
+}
+
+/* returns the strings area of snapshot line <line> */
+static inline char *stats_snap_line_strs(const struct stats_snap_line *line)
+{
+	return (char *)(stats_snap_line_gens(line) + line->count);
+}
+
+/* Snapshots are built with STAT_SHLGNDS, and the few fields it adds are
+ * cleared when serving dumps without it. Other dump flags which change the
+ * contents of the lines require that the lines are computed live.
+ */
+#define STATS_SNAP_LIVE_FLAGS  (STAT_HIDE_DOWN | STAT_HIDE_MAINT)
+
+/* minimum number of lines added to a snapshot before the task yields */
+#define STATS_SNAP_BATCH       256
+
+static unsigned int stats_snap_interval;  /* 0 = snapshots disabled */
+static struct stats_snap *stats_snap_cur; /* current snapshot, may be NULL */
+static struct stats_snap *stats_snap_next; /* snapshot being built, or NULL */
+static struct proxy *stats_snap_px;        /* next proxy to add to stats_snap_next */
+static struct task *stats_snap_task;
+__decl_thread(static HA_RWLOCK_T stats_snap_lock);
+
+/* Copies into <stats> the line of object <obj> of type <type> (STATS_TYPE_*)
+ * with numeric ID <id> from the current snapshot, and its strings into a trash
+ * chunk. The fields only reported with STAT_SHLGNDS are cleared if the flags
+ * of <ctx> do not have it. With STAT_CHANGES, the fields which did not change
+ * since generation ctx->since are cleared, except the ones identifying the
+ * object and the ones of nature FN_AGE. Nothing is copied if snapshots are
+ * disabled, if the flags require a live line, if the snapshot is older than
+ * twice the refresh interval or if the object was not known when it was built.
+ * Returns the number of fields copied, 0 if the caller must compute the line
+ * itself, or -1 if nothing changed in the line since ctx->since.
+ */
+static int stats_snap_fetch(int type, const void *obj, unsigned int id,
+                            const struct show_stat_ctx *ctx, struct field *stats)
+{
+	struct stats_snap_line *line;
+	struct eb64_node *node;
+	struct buffer *out;
+	const unsigned int *gens;
+	const char *strs;
+	int flags = ctx->flags;
+	int count = 0;
+	int i;
+
+	if (!stats_snap_interval || (flags & STATS_SNAP_LIVE_FLAGS))
+		return 0;
+
+	HA_RWLOCK_RDLOCK(STATS_LOCK, &stats_snap_lock);
+
+	if (!stats_snap_cur ||
+	    tick_is_expired(tick_add(stats_snap_cur->date, 2 * stats_snap_interval), now_ms))
+		goto end;
+
+	node = eb64_lookup(&stats_snap_cur->lines, (uintptr_t)obj | type);
+	if (!node)
+		goto end;
+
+	line = eb64_entry(node, struct stats_snap_line, node);
+	out = get_trash_chunk();
+	if (line->id != id || line->str_len > out->size)
+		goto end;
+
+	if ((flags & STAT_CHANGES) && line->gen <= ctx->since) {
+		count = -1;
+		goto end;
+	}
+
+	strs = stats_snap_line_strs(line);
+	memcpy(stats, line->fields, line->count * sizeof(*stats));
+	memcpy(out->area, strs, line->str_len);
+	for (i = 0; i < line->count; i++) {
+		if (field_format(stats, i) == FF_STR && stats[i].u.str)
+			stats[i].u.str = out->area + (stats[i].u.str - strs);
+	}
+
+	if (!(flags & STAT_SHLGNDS)) {
+		memset(&stats[ST_F_ADDR], 0, sizeof(*stats));
+		memset(&stats[ST_F_COOKIE], 0, sizeof(*stats));
+		memset(&stats[ST_F_ALGO], 0, sizeof(*stats));
+	}
+
+	if (flags & STAT_CHANGES) {
+		gens = stats_snap_line_gens(line);
+		for (i = 0; i < line->count; i++) {
+			if (gens[i] > ctx->since || (stats[i].type & FN_MASK) == FN_AGE)
+				continue;
+			if (i == ST_F_PXNAME || i == ST_F_SVNAME || i == ST_F_IID ||
+			    i == ST_F_SID || i == ST_F_TYPE || i == ST_F_PID)
+				continue;
+			memset(&stats[i], 0, sizeof(*stats));
+		}
+	}
+	count = line->count;
+ end:
+	HA_RWLOCK_RDUNLOCK(STATS_LOCK, &stats_snap_lock);
+	return count;
+}
+
+/* Prepares a dump of the changes since generation ctx->since. It is reset to
+ * zero if it is more recent than the current snapshot, which happens after a
+ * restart, so that everything is dumped. Returns the current generation, to be
+ * reported to the client for its next request.
+ */
+static unsigned int stats_snap_changes_start(struct show_stat_ctx *ctx)
+{
+	unsigned int gen = 0;
+
+	HA_RWLOCK_RDLOCK(STATS_LOCK, &stats_snap_lock);
+	if (stats_snap_cur)
+		gen = stats_snap_cur->gen;
+	HA_RWLOCK_RDUNLOCK(STATS_LOCK, &stats_snap_lock);
+
+	if (ctx->since > gen)
+		ctx->since = 0;
+	return gen;
+}
+
 /* Fill <stats> with the frontend statistics. <stats> is preallocated array of
  * length <len>. If <selected_field> is != NULL, only fill this one. The length
  * of the array must be at least ST_F_TOTAL_FIELDS. If this length is less than
@@ -1833,25 +2181,14 @@ int stats_fill_fe_stats(struct proxy *px, struct field *stats, int len,
 	return 1;
 }
 
-/* Dumps a frontend's line to the local trash buffer for the current proxy <px>
- * and uses the state from stream connector <sc>. The caller is responsible for
- * clearing the local trash buffer if needed. Returns non-zero if it emits
- * anything, zero otherwise.
+/* Fills <stats> with the complete line of frontend <px>, including the extra
+ * counters of the stats modules. Returns the number of fields, or 0 on error.
  */
-static int stats_dump_fe_stats(struct stconn *sc, struct proxy *px)
+static size_t stats_fill_fe_line(struct proxy *px, struct field *stats)
 {
-	struct appctx *appctx = __sc_appctx(sc);
-	struct show_stat_ctx *ctx = appctx->svcctx;
-	struct field *stats = stat_l[STATS_DOMAIN_PROXY];
 	struct stats_module *mod;
 	size_t stats_count = ST_F_TOTAL_FIELDS;
 
-	if (!(px->cap & PR_CAP_FE))
-		return 0;
-
-	if ((ctx->flags & STAT_BOUND) && !(ctx->type & (1 << STATS_TYPE_FE)))
-		return 0;
-
 	memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
 
 	if (!stats_fill_fe_stats(px, stats, ST_F_TOTAL_FIELDS, NULL))
@@ -1870,6 +2207,35 @@ static int stats_dump_fe_stats(struct stconn *sc, struct proxy *px)
 		stats_count += mod->stats_count;
 	}
 
+	return stats_count;
+}
+
+/* Dumps a frontend's line to the local trash buffer for the current proxy <px>
+ * and uses the state from stream connector <sc>. The caller is responsible for
+ * clearing the local trash buffer if needed. Returns non-zero if it emits
+ * anything, zero otherwise.
+ */
+static int stats_dump_fe_stats(struct stconn *sc, struct proxy *px)
+{
+	struct appctx *appctx = __sc_appctx(sc);
+	struct show_stat_ctx *ctx = appctx->svcctx;
+	struct field *stats = stat_l[STATS_DOMAIN_PROXY];
+	int stats_count;
+
+	if (!(px->cap & PR_CAP_FE))
+		return 0;
+
+	if ((ctx->flags & STAT_BOUND) && !(ctx->type & (1 << STATS_TYPE_FE)))
+		return 0;
+
+	stats_count = stats_snap_fetch(STATS_TYPE_FE, px, px->uuid, ctx, stats);
+	if (stats_count < 0)
+		return 0;
+	if (!stats_count)
+		stats_count = stats_fill_fe_line(px, stats);
+	if (!stats_count)
+		return 0;
+
 	return stats_dump_one_line(stats, stats_count, appctx);
 }
 
@@ -2002,22 +2368,19 @@ int stats_fill_li_stats(struct proxy *px, struct listener *l, int flags,
 	return 1;
 }
 
-/* Dumps a line for listener <l> and proxy <px> to the local trash buffer and
- * uses the state from stream connector <sc>. The caller is responsible for
- * clearing the local trash buffer if needed. Returns non-zero if it emits
- * anything, zero otherwise.
+/* Fills <stats> with the complete line of listener <l> of proxy <px>, including
+ * the extra counters of the stats modules. <flags> are passed to
+ * stats_fill_li_stats(). Returns the number of fields, or 0 on error.
  */
-static int stats_dump_li_stats(struct stconn *sc, struct proxy *px, struct listener *l)
+static size_t stats_fill_li_line(struct proxy *px, struct listener *l, int flags,
+                                 struct field *stats)
 {
-	struct appctx *appctx = __sc_appctx(sc);
-	struct show_stat_ctx *ctx = appctx->svcctx;
-	struct field *stats = stat_l[STATS_DOMAIN_PROXY];
 	struct stats_module *mod;
 	size_t stats_count = ST_F_TOTAL_FIELDS;
 
 	memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
 
-	if (!stats_fill_li_stats(px, l, ctx->flags, stats,
+	if (!stats_fill_li_stats(px, l, flags, stats,
 				 ST_F_TOTAL_FIELDS, NULL))
 		return 0;
 
@@ -2034,6 +2397,29 @@ static int stats_dump_li_stats(struct stconn *sc, struct proxy *px, struct liste
 		stats_count += mod->stats_count;
 	}
 
+	return stats_count;
+}
+
+/* Dumps a line for listener <l> and proxy <px> to the local trash buffer and
+ * uses the state from stream connector <sc>. The caller is responsible for
+ * clearing the local trash buffer if needed. Returns non-zero if it emits
+ * anything, zero otherwise.
+ */
+static int stats_dump_li_stats(struct stconn *sc, struct proxy *px, struct listener *l)
+{
+	struct appctx *appctx = __sc_appctx(sc);
+	struct show_stat_ctx *ctx = appctx->svcctx;
+	struct field *stats = stat_l[STATS_DOMAIN_PROXY];
+	int stats_count;
+
+	stats_count = stats_snap_fetch(STATS_TYPE_SO, l, l->luid, ctx, stats);
+	if (stats_count < 0)
+		return 0;
+	if (!stats_count)
+		stats_count = stats_fill_li_line(px, l, ctx->flags, stats);
+	if (!stats_count)
+		return 0;
+
 	return stats_dump_one_line(stats, stats_count, appctx);
 }
 
@@ -2514,22 +2900,19 @@ int stats_fill_sv_stats(struct proxy *px, struct server *sv, int flags,
 	return 1;
 }
 
-/* Dumps a line for server <sv> and proxy <px> to the local trash vbuffer and
- * uses the state from stream connector <sc>, and server state <state>. The
- * caller is responsible for clearing the local trash buffer if needed. Returns
- * non-zero if it emits anything, zero otherwise.
+/* Fills <stats> with the complete line of server <sv> of proxy <px>, including
+ * the extra counters of the stats modules. <flags> are passed to
+ * stats_fill_sv_stats(). Returns the number of fields, or 0 on error.
  */
-static int stats_dump_sv_stats(struct stconn *sc, struct proxy *px, struct server *sv)
+static size_t stats_fill_sv_line(struct proxy *px, struct server *sv, int flags,
+                                 struct field *stats)
 {
-	struct appctx *appctx = __sc_appctx(sc);
-	struct show_stat_ctx *ctx = appctx->svcctx;
 	struct stats_module *mod;
-	struct field *stats = stat_l[STATS_DOMAIN_PROXY];
 	size_t stats_count = ST_F_TOTAL_FIELDS;
 
 	memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
 
-	if (!stats_fill_sv_stats(px, sv, ctx->flags, stats,
+	if (!stats_fill_sv_stats(px, sv, flags, stats,
 				 ST_F_TOTAL_FIELDS, NULL))
 		return 0;
 
@@ -2549,6 +2932,29 @@ static int stats_dump_sv_stats(struct stconn *sc, struct proxy *px, struct serve
 		stats_count += mod->stats_count;
 	}
 
+	return stats_count;
+}
+
+/* Dumps a line for server <sv> and proxy <px> to the local trash vbuffer and
+ * uses the state from stream connector <sc>, and server state <state>. The
+ * caller is responsible for clearing the local trash buffer if needed. Returns
+ * non-zero if it emits anything, zero otherwise.
+ */
+static int stats_dump_sv_stats(struct stconn *sc, struct proxy *px, struct server *sv)
+{
+	struct appctx *appctx = __sc_appctx(sc);
+	struct show_stat_ctx *ctx = appctx->svcctx;
+	struct field *stats = stat_l[STATS_DOMAIN_PROXY];
+	int stats_count;
+
+	stats_count = stats_snap_fetch(STATS_TYPE_SV, sv, sv->puid, ctx, stats);
+	if (stats_count < 0)
+		return 0;
+	if (!stats_count)
+		stats_count = stats_fill_sv_line(px, sv, ctx->flags, stats);
+	if (!stats_count)
+		return 0;
+
 	return stats_dump_one_line(stats, stats_count, appctx);
 }
 
@@ -2845,28 +3251,18 @@ int stats_fill_be_stats(struct proxy *px, int flags, struct field *stats, int le
 	return 1;
 }
 
-/* Dumps a line for backend <px> to the local trash buffer for and uses the
- * state from stream interface <si>. The caller is responsible for clearing the
- * local trash buffer if needed.  Returns non-zero if it emits anything, zero
- * otherwise.
+/* Fills <stats> with the complete line of backend <px>, including the extra
+ * counters of the stats modules. <flags> are passed to stats_fill_be_stats().
+ * Returns the number of fields, or 0 on error.
  */
-static int stats_dump_be_stats(struct stconn *sc, struct proxy *px)
+static size_t stats_fill_be_line(struct proxy *px, int flags, struct field *stats)
 {
-	struct appctx *appctx = __sc_appctx(sc);
-	struct show_stat_ctx *ctx = appctx->svcctx;
-	struct field *stats = stat_l[STATS_DOMAIN_PROXY];
 	struct stats_module *mod;
 	size_t stats_count = ST_F_TOTAL_FIELDS;
 
-	if (!(px->cap & PR_CAP_BE))
-		return 0;
-
-	if ((ctx->flags & STAT_BOUND) && !(ctx->type & (1 << STATS_TYPE_BE)))
-		return 0;
-
 	memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
 
-	if (!stats_fill_be_stats(px, ctx->flags, stats, ST_F_TOTAL_FIELDS, NULL))
+	if (!stats_fill_be_stats(px, flags, stats, ST_F_TOTAL_FIELDS, NULL))
 		return 0;
 
 	list_for_each_entry(mod, &stats_module_list[STATS_DOMAIN_PROXY], list) {
@@ -2885,6 +3281,35 @@ static int stats_dump_be_stats(struct stconn *sc, struct proxy *px)
 		stats_count += mod->stats_count;
 	}
 
+	return stats_count;
+}
+
+/* Dumps a line for backend <px> to the local trash buffer for and uses the
+ * state from stream interface <si>. The caller is responsible for clearing the
+ * local trash buffer if needed.  Returns non-zero if it emits anything, zero
+ * otherwise.
+ */
+static int stats_dump_be_stats(struct stconn *sc, struct proxy *px)
+{
+	struct appctx *appctx = __sc_appctx(sc);
+	struct show_stat_ctx *ctx = appctx->svcctx;
+	struct field *stats = stat_l[STATS_DOMAIN_PROXY];
+	int stats_count;
+
+	if (!(px->cap & PR_CAP_BE))
+		return 0;
+
+	if ((ctx->flags & STAT_BOUND) && !(ctx->type & (1 << STATS_TYPE_BE)))
+		return 0;
+
+	stats_count = stats_snap_fetch(STATS_TYPE_BE, px, px->uuid, ctx, stats);
+	if (stats_count < 0)
+		return 0;
+	if (!stats_count)
+		stats_count = stats_fill_be_line(px, ctx->flags, stats);
+	if (!stats_count)
+		return 0;
+
 	return stats_dump_one_line(stats, stats_count, appctx);
 }
 
@@ -3737,21 +4162,26 @@ static void stats_dump_html_end()
 	chunk_appendf(&trash_chunk, "</body></html>\n");
 }
 
-/* Dumps the stats JSON header to the local trash buffer buffer which. The
- * caller is responsible for clearing it if needed.
+/* Dumps the stats JSON header to the local trash buffer buffer which. With
+ * STAT_CHANGES in <ctx>, the array of objects is wrapped into an object also
+ * carrying the snapshot generation <gen>. The caller is responsible for
+ * clearing it if needed.
  */
-static void stats_dump_json_header()
+static void stats_dump_json_header(const struct show_stat_ctx *ctx, unsigned int gen)
 {
+	if (ctx->flags & STAT_CHANGES)
+		chunk_appendf(&trash_chunk, "{\"gen\":%u,\"stats\":", gen);
 	chunk_strcat(&trash_chunk, "[");
 }
 
 
-/* Dumps the JSON stats trailer block to the local trash buffer. The caller is
- * responsible for clearing the local trash buffer if needed.
+/* Dumps the JSON stats trailer block to the local trash buffer, closing the
+ * wrapper object with STAT_CHANGES in <ctx>. The caller is responsible for
+ * clearing the local trash buffer if needed.
  */
-static void stats_dump_json_end()
+static void stats_dump_json_end(const struct show_stat_ctx *ctx)
 {
-	chunk_strcat(&trash_chunk, "]\n");
+	chunk_strcat(&trash_chunk, (ctx->flags & STAT_CHANGES) ? "]}\n" : "]\n");
 }
 
 /* Uses <appctx.ctx.stats.obj1> as a pointer to the current proxy and <obj2> as
@@ -3811,6 +4241,7 @@ static int stats_dump_stat_to_buffer(struct stconn *sc, struct htx *htx)
 	struct show_stat_ctx *ctx = appctx->svcctx;
 	struct channel *rep = sc_ic(sc);
 	enum stats_domain domain = ctx->domain;
+	unsigned int gen = 0;
 
 	chunk_reset(&trash_chunk);
 
@@ -3820,14 +4251,29 @@ static int stats_dump_stat_to_buffer(struct stconn *sc, struct htx *htx)
 		/* fall through */
 
 	case STAT_STATE_HEAD:
+		/* with STAT_CHANGES, the generation is reported in a way
+		 * which does not break the output format.
+		 */
+		if (ctx->flags & STAT_CHANGES)
+			gen = stats_snap_changes_start(ctx);
+
 		if (ctx->flags & STAT_FMT_HTML)
 			stats_dump_html_head(appctx);
 		else if (ctx->flags & STAT_JSON_SCHM)
 			stats_dump_json_schema(&trash_chunk);
 		else if (ctx->flags & STAT_FMT_JSON)
-			stats_dump_json_header();
-		else if (!(ctx->flags & STAT_FMT_TYPED))
+			stats_dump_json_header(ctx, gen);
+		else if (ctx->flags & STAT_FMT_BIN)
+			stats_dump_bin_header(ctx, gen);
+		else if (ctx->flags & STAT_FMT_TYPED) {
+			if (ctx->flags & STAT_CHANGES)
+				chunk_appendf(&trash_chunk, "G.gen:MCP:u32:%u\n", gen);
+		}
+		else {
+			if (ctx->flags & STAT_CHANGES)
+				chunk_appendf(&trash_chunk, "# gen %u\n", gen);
 			stats_dump_csv_header(ctx->domain);
+		}
 
 		if (!stats_putchk(rep, htx))
 			goto full;
@@ -3876,11 +4322,13 @@ static int stats_dump_stat_to_buffer(struct stconn *sc, struct htx *htx)
 		/* fall through */
 
 	case STAT_STATE_END:
-		if (ctx->flags & (STAT_FMT_HTML|STAT_FMT_JSON)) {
+		if (ctx->flags & (STAT_FMT_HTML|STAT_FMT_JSON|STAT_FMT_BIN)) {
 			if (ctx->flags & STAT_FMT_HTML)
 				stats_dump_html_end();
+			else if (ctx->flags & STAT_FMT_JSON)
+				stats_dump_json_end(ctx);
 			else
-				stats_dump_json_end();
+				stats_dump_bin_end();
 			if (!stats_putchk(rep, htx))
 				goto full;
 		}
@@ -5078,6 +5526,7 @@ static int cli_parse_show_stat(char **args, char *payload, struct appctx *appctx
 	ctx->scope_len = 0;
 	ctx->http_px = NULL; // not under http context
 	ctx->flags = STAT_SHNODE | STAT_SHDESC;
+	ctx->since = 0;
 
 	if ((strm_li(appctx_strm(appctx))->bind_conf->level & ACCESS_LVL_MASK) >= ACCESS_LVL_OPER)
 		ctx->flags |= STAT_SHLGNDS;
@@ -5097,7 +5546,7 @@ static int cli_parse_show_stat(char **args, char *payload, struct appctx *appctx
 		}
 	}
 
-	if (ctx->domain == STATS_DOMAIN_PROXY
+	if (ctx->domain == STATS_DOMAIN_PROXY && strcmp(args[arg], "changes") != 0
 	    && *args[arg] && *args[arg+1] && *args[arg+2]) {
 		struct proxy *px;
 
@@ -5127,9 +5576,46 @@ static int cli_parse_show_stat(char **args, char *payload, struct appctx *appctx
 			ctx->flags |= STAT_HIDE_MAINT;
 		else if (strcmp(args[arg], "up") == 0)
 			ctx->flags |= STAT_HIDE_DOWN;
+		else if (strcmp(args[arg], "bin") == 0)
+			ctx->flags = (ctx->flags & ~STAT_FMT_MASK) | STAT_FMT_BIN;
+		else if (strcmp(args[arg], "delta") == 0)
+			ctx->flags |= STAT_BIN_DELTA;
+		else if (strcmp(args[arg], "changes") == 0) {
+			unsigned long since;
+			char *end;
+
+			if (strcmp(args[arg+1], "since") != 0 || !*args[arg+2])
+				return cli_err(appctx, "'changes' expects 'since' followed by a generation number.\n");
+			if (!stats_snap_interval)
+				return cli_err(appctx, "'changes' requires 'tune.stats.snapshot-interval' in the global section.\n");
+			if (ctx->domain != STATS_DOMAIN_PROXY)
+				return cli_err(appctx, "'changes' is only supported for the proxy domain.\n");
+			errno = 0;
+			since = strtoul(args[arg+2], &end, 10);
+			if (*end || !isdigit((unsigned char)*args[arg+2]) || errno || since > UINT_MAX)
+				return cli_err(appctx, "'since' expects a generation number between 0 and 4294967295.\n");
+			ctx->flags |= STAT_CHANGES;
+			ctx->since = since;
+			arg += 2;
+		}
 		arg++;
 	}
 
+	/* hiding servers requires live lines, which do not track changes */
+	if ((ctx->flags & STAT_CHANGES) && (ctx->flags & STATS_SNAP_LIVE_FLAGS))
+		return cli_err(appctx, "'changes' cannot be combined with 'up' or 'no-maint'.\n");
+
+	ctx->bin = NULL;
+	if (ctx->flags & STAT_FMT_BIN) {
+		size_t count = stat_count[ctx->domain];
+
+		ctx->bin = calloc(1, sizeof(*ctx->bin) + 2 * count * sizeof(struct stats_bin_field));
+		if (!ctx->bin)
+			return cli_err(appctx, "Out of memory.\n");
+		ctx->bin->prev = (struct stats_bin_field *)(ctx->bin + 1);
+		ctx->bin->cur = ctx->bin->prev + count;
+	}
+
 	return 0;
 }
 
@@ -5154,6 +5640,7 @@ static void cli_io_handler_release_stat(struct appctx *appctx)
 
 	if (ctx->px_st == STAT_PX_ST_SV)
 		srv_drop(ctx->obj2);
+	ha_free(&ctx->bin);
 }
 
 static int cli_io_handler_dump_json_schema(struct appctx *appctx)
@@ -5374,6 +5861,250 @@ static void deinit_stat_lines_per_thread(void)
 
 REGISTER_PER_THREAD_FREE(deinit_stat_lines_per_thread);
 
+/* Returns non-zero if fields <a> and <b> have the same type and value */
+static int stats_snap_field_equal(const struct field *a, const struct field *b)
+{
+	if (a->type != b->type)
+		return 0;
+
+	switch (field_format(a, 0)) {
+	case FF_S32: return a->u.s32 == b->u.s32;
+	case FF_U32: return a->u.u32 == b->u.u32;
+	case FF_S64: return a->u.s64 == b->u.s64;
+	case FF_U64: return a->u.u64 == b->u.u64;
+	case FF_FLT: return a->u.flt == b->u.flt;
+	case FF_STR: return strcmp(a->u.str ? a->u.str : "", b->u.str ? b->u.str : "") == 0;
+	default:     return 1;
+	}
+}
+
+/* Appends to snapshot <snap> the line of <count> fields <stats> for object
+ * <obj> of type <type> with numeric ID <id>, the strings being duplicated. The
+ * fields are compared to the ones of the same object in the current snapshot
+ * to find which ones changed. Only the snapshot task replaces the current
+ * snapshot, so it is read without locking. Returns 0 on allocation failure,
+ * otherwise 1.
+ */
+static int stats_snap_add(struct stats_snap *snap, int type, const void *obj,
+                          unsigned int id, const struct field *stats, size_t count)
+{
+	struct stats_snap_line *line, *old = NULL;
+	struct eb64_node *node;
+	unsigned int *gens;
+	size_t str_len = 0, len;
+	char *p;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (field_format(stats, i) == FF_STR && stats[i].u.str)
+			str_len += strlen(stats[i].u.str) + 1;
+	}
+
+	line = malloc(sizeof(*line) + count * (sizeof(*stats) + sizeof(*gens)) + str_len);
+	if (!line)
+		return 0;
+
+	line->node.key = (uintptr_t)obj | type;
+	line->id = id;
+	line->count = count;
+	line->str_len = str_len;
+	memcpy(line->fields, stats, count * sizeof(*stats));
+
+	p = stats_snap_line_strs(line);
+	for (i = 0; i < count; i++) {
+		if (field_format(stats, i) == FF_STR && stats[i].u.str) {
+			len = strlen(stats[i].u.str) + 1;
+			memcpy(p, stats[i].u.str, len);
+			line->fields[i].u.str = p;
+			p += len;
+		}
+	}
+
+	if (stats_snap_cur) {
+		node = eb64_lookup(&stats_snap_cur->lines, line->node.key);
+		if (node) {
+			old = eb64_entry(node, struct stats_snap_line, node);
+			if (old->id != id || old->count != count)
+				old = NULL;
+		}
+	}
+
+	/* the ages change all the time and are not considered as changes */
+	gens = stats_snap_line_gens(line);
+	line->gen = 0;
+	for (i = 0; i < count; i++) {
+		if (old && ((stats[i].type & FN_MASK) == FN_AGE ||
+		            stats_snap_field_equal(&line->fields[i], &old->fields[i])))
+			gens[i] = stats_snap_line_gens(old)[i];
+		else
+			gens[i] = snap->gen;
+		if (gens[i] > line->gen)
+			line->gen = gens[i];
+	}
+
+	eb64_insert(&snap->lines, &line->node);
+	return 1;
+}
+
+/* Releases snapshot <snap> and all its lines. Supports NULL. */
+static void stats_snap_free(struct stats_snap *snap)
+{
+	struct eb64_node *node, *next;
+
+	if (!snap)
+		return;
+
+	node = eb64_first(&snap->lines);
+	while (node) {
+		next = eb64_next(node);
+		eb64_delete(node);
+		free(eb64_entry(node, struct stats_snap_line, node));
+		node = next;
+	}
+	free(snap);
+}
+
+/* Builds a new snapshot of all proxies, listeners and servers, installs it in
+ * place of the current one and reschedules itself. It runs with the lowest
+ * priority since it is never urgent, and yields after each proxy once at least
+ * STATS_SNAP_BATCH lines were added, so that large configurations do not
+ * monopolize a thread. The snapshot being built and the next proxy to add are
+ * kept between the calls. On allocation failure the previous snapshot is kept,
+ * and dumps will fall back to live lines once it gets too old.
+ */
+static struct task *stats_snap_refresh(struct task *t, void *context, unsigned int state)
+{
+	struct field *stats = stat_l[STATS_DOMAIN_PROXY];
+	struct stats_snap *snap, *old;
+	struct listener *l;
+	struct server *sv;
+	struct proxy *px;
+	unsigned int lines = 0;
+	size_t count;
+
+	snap = stats_snap_next;
+	if (!snap) {
+		snap = calloc(1, sizeof(*snap));
+		if (!snap)
+			goto out;
+
+		snap->lines = EB_ROOT_UNIQUE;
+		snap->gen = (stats_snap_cur ? stats_snap_cur->gen : 0) + 1;
+		stats_snap_next = snap;
+		stats_snap_px = proxies_list;
+	}
+
+	for (px = stats_snap_px; px; px = px->next) {
+		if (lines >= STATS_SNAP_BATCH) {
+			/* let other tasks run, we'll continue from here */
+			stats_snap_px = px;
+			t->expire = TICK_ETERNITY;
+			task_wakeup(t, TASK_WOKEN_OTHER);
+			return t;
+		}
+
+		if (px->cap & PR_CAP_FE) {
+			count = stats_fill_fe_line(px, stats);
+			if (count && !stats_snap_add(snap, STATS_TYPE_FE, px, px->uuid, stats, count))
+				goto fail;
+			lines++;
+		}
+
+		list_for_each_entry(l, &px->conf.listeners, by_fe) {
+			if (!l->counters)
+				continue;
+			count = stats_fill_li_line(px, l, STAT_SHLGNDS, stats);
+			if (count && !stats_snap_add(snap, STATS_TYPE_SO, l, l->luid, stats, count))
+				goto fail;
+			lines++;
+		}
+
+		for (sv = px->srv; sv; sv = sv->next) {
+			count = stats_fill_sv_line(px, sv, STAT_SHLGNDS, stats);
+			if (count && !stats_snap_add(snap, STATS_TYPE_SV, sv, sv->puid, stats, count))
+				goto fail;
+			lines++;
+		}
+
+		if (px->cap & PR_CAP_BE) {
+			count = stats_fill_be_line(px, STAT_SHLGNDS, stats);
+			if (count && !stats_snap_add(snap, STATS_TYPE_BE, px, px->uuid, stats, count))
+				goto fail;
+			lines++;
+		}
+	}
+	snap->date = now_ms;
+	stats_snap_next = NULL;
+	stats_snap_px = NULL;
+
+	HA_RWLOCK_WRLOCK(STATS_LOCK, &stats_snap_lock);
+	old = stats_snap_cur;
+	stats_snap_cur = snap;
+	HA_RWLOCK_WRUNLOCK(STATS_LOCK, &stats_snap_lock);
+
+	stats_snap_free(old);
+ out:
+	t->expire = tick_add(now_ms, stats_snap_interval);
+	return t;
+ fail:
+	stats_snap_free(snap);
+	stats_snap_next = NULL;
+	stats_snap_px = NULL;
+	goto out;
+}
+
+/* starts the snapshot task if snapshots are enabled. Returns ERR_* flags. */
+static int stats_snap_init(void)
+{
+	if (!stats_snap_interval)
+		return ERR_NONE;
+
+	stats_snap_task = task_new_anywhere();
+	if (!stats_snap_task) {
+		ha_alert("stats: failed to allocate the statistics snapshot task.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+	stats_snap_task->process = stats_snap_refresh;
+	stats_snap_task->nice = 1024;
+	task_wakeup(stats_snap_task, TASK_WOKEN_INIT);
+	return ERR_NONE;
+}
+
+REGISTER_POST_CHECK(stats_snap_init);
+
+/* parse "tune.stats.snapshot-interval" */
+static int stats_parse_snapshot_interval(char **args, int section_type, struct proxy *curpx,
+                                         const struct proxy *defpx, const char *file, int line,
+                                         char **err)
+{
+	const char *res;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (!*args[1]) {
+		memprintf(err, "'%s' expects a delay in milliseconds (0 to disable).", args[0]);
+		return -1;
+	}
+
+	res = parse_time_err(args[1], &stats_snap_interval, TIME_UNIT_MS);
+	if (res == PARSE_TIME_OVER) {
+		memprintf(err, "timer overflow in argument '%s' to '%s' (maximum value is 2147483647 ms or ~24.8 days)",
+		          args[1], args[0]);
+		return -1;
+	}
+	else if (res == PARSE_TIME_UNDER) {
+		memprintf(err, "timer underflow in argument '%s' to '%s' (minimum non-null value is 1 ms)",
+		          args[1], args[0]);
+		return -1;
+	}
+	else if (res) {
+		memprintf(err, "unexpected character '%c' in '%s'", *res, args[0]);
+		return -1;
+	}
+	return 0;
+}
+
 static void deinit_stats(void)
 {
 	int domains[] = { STATS_DOMAIN_PROXY, STATS_DOMAIN_RESOLVERS }, i;
@@ -5384,6 +6115,13 @@ static void deinit_stats(void)
 		if (stat_f[domain])
 			free(stat_f[domain]);
 	}
+
+	task_destroy(stats_snap_task);
+	stats_snap_task = NULL;
+	stats_snap_free(stats_snap_cur);
+	stats_snap_cur = NULL;
+	stats_snap_free(stats_snap_next);
+	stats_snap_next = NULL;
 }
 
 REGISTER_POST_DEINIT(deinit_stats);
@@ -5400,13 +6138,21 @@ REGISTER_PER_THREAD_FREE(free_trash_counters);
 static struct cli_kw_list cli_kws = {{ },{
 	{ { "clear", "counters",  NULL },      "clear counters [all]                    : clear max statistics counters (or all counters)", cli_parse_clear_counters, NULL, NULL },
 	{ { "show", "info",  NULL },           "show info [desc|json|typed|float]*      : report information about the running process",    cli_parse_show_info, cli_io_handler_dump_info, NULL },
-	{ { "show", "stat",  NULL },           "show stat [desc|json|no-maint|typed|up]*: report counters for each proxy and server",       cli_parse_show_stat, cli_io_handler_dump_stat, cli_io_handler_release_stat },
+	{ { "show", "stat",  NULL },           "show stat [desc|json|no-maint|typed|up|bin|delta|changes since <gen>]*: report counters for each proxy and server", cli_parse_show_stat, cli_io_handler_dump_stat, cli_io_handler_release_stat },
 	{ { "show", "schema",  "json", NULL }, "show schema json                        : report schema used for stats",                    NULL, cli_io_handler_dump_json_schema, NULL },
 	{{},}
 }};
 
 INITCALL1(STG_REGISTER, cli_register_kw, &cli_kws);
 
+/* config keyword parsers */
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.stats.snapshot-interval", stats_parse_snapshot_interval },
+	{ 0, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
 struct applet http_stats_applet = {
 	.obj_type = OBJ_TYPE_APPLET,
 	.name = "<STATS>", /* used for logging */
@@ -2769,7 +2769,7 @@ static enum act_parse_ret parse_set_gpt(const char **args, int *arg, struct prox
 		if (!(rule->arg.gpt.expr->fetch->val & smp_val)) {
 			memprintf(err, "fetch method '%s' extracts information from '%s', none of which is available here", args[*arg-1],
 			          sample_src_names(rule->arg.gpt.expr->fetch->use));
-			free(rule->arg.gpt.expr);
+			release_sample_expr(rule->arg.gpt.expr);
 			return ACT_RET_PRS_ERR;
 		}
 	}
@@ -531,6 +531,7 @@ struct stream *stream_new(struct session *sess, struct stconn *sc, struct buffer
 
 	s->txn = NULL;
 	s->hlua[0] = s->hlua[1] = NULL;
+	s->smp_memo = NULL;
 
 	s->resolv_ctx.requester = NULL;
 	s->resolv_ctx.hostname_dn = NULL;
@@ -650,6 +651,9 @@ void stream_free(struct stream *s)
 	hlua_ctx_destroy(s->hlua[1]);
 	s->hlua[0] = s->hlua[1] = NULL;
 
+	smp_memo_free(s->smp_memo);
+	s->smp_memo = NULL;
+
 	if (s->txn)
 		http_destroy_txn(s);
 
@@ -1066,7 +1070,20 @@ static int process_switching_rules(struct stream *s, struct channel *req, int an
 				 */
 				struct proxy *backend = NULL;
 
-				if (rule->dynamic) {
+				if (rule->dynamic == 2) {
+					struct sample *smp;
+
+					/* "use_backend_map": the rule only applies if the
+					 * key is found in the map and the backend is usable.
+					 */
+					smp = sample_fetch_as_type(fe, sess, s, SMP_OPT_DIR_REQ|SMP_OPT_FINAL, rule->map_key, SMP_T_STR);
+					if (smp)
+						backend = proxy_map_lookup_backend(rule->map, smp);
+					if (!backend || backend == fe ||
+					    (backend->mode != fe->mode && !(fe->mode == PR_MODE_TCP && backend->mode == PR_MODE_HTTP)))
+						continue;
+				}
+				else if (rule->dynamic) {
 					struct buffer *tmp;
 
 					tmp = alloc_trash_chunk();
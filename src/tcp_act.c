@@ -387,7 +387,7 @@ static enum act_parse_ret tcp_parse_set_src_dst(const char **args, int *orig_arg
 		memprintf(err,
 			  "fetch method '%s' extracts information from '%s', none of which is available here",
 			  args[cur_arg-1], sample_src_names(expr->fetch->use));
-		free(expr);
+		release_sample_expr(expr);
 		return ACT_RET_PRS_ERR;
 	}
 	rule->arg.expr = expr;
@@ -98,6 +98,7 @@ int tcp_inspect_request(struct stream *s, struct channel *req, int an_bit)
 	struct list *def_rules, *rules;
 	struct session *sess = s->sess;
 	struct act_rule *rule;
+	enum act_return act_ret;
 	int partial;
 	int act_opts = 0;
 
@@ -159,7 +160,12 @@ int tcp_inspect_request(struct stream *s, struct channel *req, int an_bit)
 resume_execution:
 			/* Always call the action function if defined */
 			if (rule->action_ptr) {
-				switch (rule->action_ptr(rule, s->be, s->sess, s, act_opts)) {
+				act_ret = rule->action_ptr(rule, s->be, s->sess, s, act_opts);
+
+				/* the action may have modified the request */
+				smp_memo_reset(s->smp_memo);
+
+				switch (act_ret) {
 					case ACT_RET_CONT:
 						break;
 					case ACT_RET_STOP:
@@ -903,7 +909,7 @@ static int tcp_parse_request_rule(char **args, int arg, int section_type,
 			memprintf(err,
 				  "'%s %s %s' : a positive 'len' argument is mandatory",
 				  args[0], args[1], args[kw]);
-			free(expr);
+			release_sample_expr(expr);
 			return -1;
 		}
 
@@ -1045,7 +1045,7 @@ static enum act_parse_ret parse_store(const char **args, int *arg, struct proxy
 			memprintf(err,
 			          "fetch method '%s' extracts information from '%s', none of which is available here",
 			          kw_name, sample_src_names(rule->arg.vars.expr->fetch->use));
-			free(rule->arg.vars.expr);
+			release_sample_expr(rule->arg.vars.expr);
 			return ACT_RET_PRS_ERR;
 		}
 	}